@@ -0,0 +1,43 @@
+# Writes a header with the SPIR-V of every shader as constexpr arrays, so the
+# executable doesn't depend on the shaderbuild directory at runtime
+#
+# cmake -DOUTPUT=<header> -DSPIRV_FILES=<a.spv|b.spv|...> -P embed_shaders.cmake
+#
+# The list is separated by | since ; would split the command line argument
+
+string(REPLACE "|" ";" SPIRV_FILES "${SPIRV_FILES}")
+list(SORT SPIRV_FILES)
+list(LENGTH SPIRV_FILES SHADER_COUNT)
+
+set(ARRAYS "")
+set(ENTRIES "")
+foreach(SPIRV ${SPIRV_FILES})
+  get_filename_component(FILE_NAME ${SPIRV} NAME)
+  string(REGEX REPLACE "\\.spv$" "" SHADER_NAME ${FILE_NAME})
+  string(MAKE_C_IDENTIFIER "spv_${SHADER_NAME}" IDENTIFIER)
+  file(READ ${SPIRV} HEX HEX)
+  # SPIR-V is a stream of little-endian 32-bit words
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u,\n" WORDS "${HEX}")
+  # vkCreateShaderModule needs the code 4-byte aligned
+  string(APPEND ARRAYS
+         "alignas(4) inline constexpr uint32_t ${IDENTIFIER}[] = {\n${WORDS}};\n")
+  string(APPEND ENTRIES
+         "    EmbeddedShader{ \"${SHADER_NAME}\", ${IDENTIFIER} },\n")
+endforeach()
+
+file(
+  WRITE ${OUTPUT}
+  "// Generated by cmake/embed_shaders.cmake, do not edit
+#pragma once
+
+#include \"embedded_shaders.hpp\"
+
+#include <array>
+#include <cstdint>
+
+namespace kovra::embedded {
+${ARRAYS}
+inline constexpr std::array<EmbeddedShader, ${SHADER_COUNT}> SHADERS{
+${ENTRIES}};
+} // namespace kovra::embedded
+")
@@ -0,0 +1,21 @@
+// Requires GL_EXT_nonuniform_qualifier
+
+// Must match the constants in src/bindless.hpp
+const uint MAX_BINDLESS_TEXTURES = 4096;
+// Texture index of material features that are off, which are never sampled
+const uint BINDLESS_TEXTURE_NONE = 0xFFFFFFFFu;
+
+// Must match the GpuBindlessMaterial struct in src/gpu_data.hpp
+struct BindlessMaterial {
+    vec4 color_factors;
+    // z: alpha cutoff, zero unless the material is alpha masked
+    vec4 metal_rough_factors;
+    // x: albedo, y: metal rough, z: ambient occlusion, w: emissive
+    // BINDLESS_TEXTURE_NONE for the textures the material doesn't have
+    uvec4 texture_indices;
+};
+
+layout (set = 3, binding = 0) uniform sampler2D bindless_textures[];
+layout (std430, set = 3, binding = 1) readonly buffer BindlessMaterialBuffer {
+    BindlessMaterial materials[];
+};
@@ -0,0 +1,67 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "upscale.glsl"
+
+// Writes the (upscaled) draw image to the swapchain image, sharpened with
+// robust contrast-adaptive sharpening: each pixel is pushed away from its 4
+// neighbors by as much as it can be without leaving their range
+
+// Largest negative lobe, keeps the filter from ringing
+#define SHARPEN_LIMIT (0.25f - (1.0f / 16.0f))
+
+layout (location = 0) out vec4 out_color;
+
+// Same size as the swapchain image
+layout (set = 0, binding = 0) uniform sampler2D source_image;
+
+layout (push_constant) uniform PushConstants {
+    // 0 copies the source, 1 is the strongest sharpening
+    float sharpening;
+} pc;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 max_texel = textureSize(source_image, 0) - 1;
+    //    b
+    //  d e f
+    //    h
+    vec3 e = texelFetch(source_image, p, 0).rgb;
+    if (pc.sharpening <= 0.0f) {
+        out_color = vec4(clamp(e, 0.0f, 1.0f), 1.0f);
+        return;
+    }
+    vec3 b = texelFetch(source_image, clamp(p + ivec2(0, -1), ivec2(0), max_texel), 0).rgb;
+    vec3 d = texelFetch(source_image, clamp(p + ivec2(-1, 0), ivec2(0), max_texel), 0).rgb;
+    vec3 f = texelFetch(source_image, clamp(p + ivec2(1, 0), ivec2(0), max_texel), 0).rgb;
+    vec3 h = texelFetch(source_image, clamp(p + ivec2(0, 1), ivec2(0), max_texel), 0).rgb;
+    // Sharpening assumes the [0, 1] range of the swapchain image
+    b = clamp(b, 0.0f, 1.0f);
+    d = clamp(d, 0.0f, 1.0f);
+    e = clamp(e, 0.0f, 1.0f);
+    f = clamp(f, 0.0f, 1.0f);
+    h = clamp(h, 0.0f, 1.0f);
+
+    vec3 min4 = min(min(b, d), min(f, h));
+    vec3 max4 = max(max(b, d), max(f, h));
+    // Lobe that would take the pixel to the darkest and the brightest value
+    // the neighbors allow
+    vec3 hit_min = min(min4, e) / max(4.0f * max4, vec3(1.0f / 32768.0f));
+    vec3 hit_max = (1.0f - max(max4, e)) / min(4.0f * min4 - 4.0f, vec3(-1.0f / 32768.0f));
+    vec3 lobe3 = max(-hit_min, hit_max);
+    float lobe = max(-SHARPEN_LIMIT, min(max(lobe3.r, max(lobe3.g, lobe3.b)), 0.0f)) * pc.sharpening;
+
+    // Less sharpening where the neighborhood looks like noise
+    float bl = upscale_luma(b);
+    float dl = upscale_luma(d);
+    float el = upscale_luma(e);
+    float fl = upscale_luma(f);
+    float hl = upscale_luma(h);
+    float noise = 0.25f * (bl + dl + fl + hl) - el;
+    float luma_range = max(max(max(bl, dl), max(el, fl)), hl) - min(min(min(bl, dl), min(el, fl)), hl);
+    noise = clamp(abs(noise) / max(luma_range, 1.0f / 32768.0f), 0.0f, 1.0f);
+    lobe *= -0.5f * noise + 1.0f;
+
+    vec3 color = (lobe * (b + d + f + h) + e) / (4.0f * lobe + 1.0f);
+    out_color = vec4(color, 1.0f);
+}
@@ -0,0 +1,149 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "upscale.glsl"
+
+// Edge-adaptive spatial upsampling
+// Every output pixel is filtered from the 12 input texels around it with a
+// Lanczos-like kernel that is stretched along the local edge direction and
+// sharpened where the edge is strong, then clamped to the 4 nearest texels to
+// avoid ringing.
+
+layout (location = 0) out vec4 out_color;
+
+layout (set = 0, binding = 0) uniform sampler2D draw_image;
+
+layout (push_constant) uniform PushConstants {
+    // Drawn part of the draw image, in texels
+    vec2 input_size;
+    vec2 output_size;
+} pc;
+
+vec3 fetch(ivec2 texel) {
+    ivec2 max_texel = ivec2(pc.input_size) - 1;
+    return texelFetch(draw_image, clamp(texel, ivec2(0), max_texel), 0).rgb;
+}
+
+// Accumulate the edge direction and length of one of the 4 texels nearest
+// to the output pixel, weighted bilinearly
+//    a
+//  b c d
+//    e
+void accumulate_edge(
+    inout vec2 dir, inout float len, float w,
+    float la, float lb, float lc, float ld, float le
+) {
+    float dir_x = ld - lb;
+    float len_x = max(abs(ld - lc), abs(lc - lb));
+    len_x = clamp(abs(dir_x) / max(len_x, 1.0f / 32768.0f), 0.0f, 1.0f);
+    dir.x += dir_x * w;
+    len += len_x * len_x * w;
+
+    float dir_y = le - la;
+    float len_y = max(abs(le - lc), abs(lc - la));
+    len_y = clamp(abs(dir_y) / max(len_y, 1.0f / 32768.0f), 0.0f, 1.0f);
+    dir.y += dir_y * w;
+    len += len_y * len_y * w;
+}
+
+void accumulate_tap(
+    inout vec3 color_sum, inout float weight_sum,
+    vec2 offset, vec2 dir, vec2 len, float lobe, float clip, vec3 color
+) {
+    // Rotate into the edge direction and stretch
+    vec2 v = vec2(offset.x * dir.x + offset.y * dir.y,
+                  offset.x * -dir.y + offset.y * dir.x) * len;
+    float d2 = min(dot(v, v), clip);
+    // Polynomial approximation of a windowed Lanczos-2 kernel
+    float window = 2.0f / 5.0f * d2 - 1.0f;
+    float base = lobe * d2 - 1.0f;
+    window *= window;
+    base *= base;
+    window = 25.0f / 16.0f * window - (25.0f / 16.0f - 1.0f);
+    float w = window * base;
+    color_sum += color * w;
+    weight_sum += w;
+}
+
+void main() {
+    // Position of the output pixel center between input texel centers
+    vec2 pp = gl_FragCoord.xy * pc.input_size / pc.output_size - 0.5f;
+    vec2 fp = floor(pp);
+    pp -= fp;
+    ivec2 p = ivec2(fp);
+
+    //    b c
+    //  e f g h
+    //  i j k l
+    //    n o
+    vec3 b = fetch(p + ivec2(0, -1));
+    vec3 c = fetch(p + ivec2(1, -1));
+    vec3 e = fetch(p + ivec2(-1, 0));
+    vec3 f = fetch(p + ivec2(0, 0));
+    vec3 g = fetch(p + ivec2(1, 0));
+    vec3 h = fetch(p + ivec2(2, 0));
+    vec3 i = fetch(p + ivec2(-1, 1));
+    vec3 j = fetch(p + ivec2(0, 1));
+    vec3 k = fetch(p + ivec2(1, 1));
+    vec3 l = fetch(p + ivec2(2, 1));
+    vec3 n = fetch(p + ivec2(0, 2));
+    vec3 o = fetch(p + ivec2(1, 2));
+
+    float bl = upscale_luma(b);
+    float cl = upscale_luma(c);
+    float el = upscale_luma(e);
+    float fl = upscale_luma(f);
+    float gl = upscale_luma(g);
+    float hl = upscale_luma(h);
+    float il = upscale_luma(i);
+    float jl = upscale_luma(j);
+    float kl = upscale_luma(k);
+    float ll = upscale_luma(l);
+    float nl = upscale_luma(n);
+    float ol = upscale_luma(o);
+
+    vec2 dir = vec2(0.0f);
+    float len = 0.0f;
+    accumulate_edge(dir, len, (1.0f - pp.x) * (1.0f - pp.y), bl, el, fl, gl, jl);
+    accumulate_edge(dir, len, pp.x * (1.0f - pp.y), cl, fl, gl, hl, kl);
+    accumulate_edge(dir, len, (1.0f - pp.x) * pp.y, fl, il, jl, kl, nl);
+    accumulate_edge(dir, len, pp.x * pp.y, gl, jl, kl, ll, ol);
+
+    // Normalize the direction, flat areas filter along x
+    float dir_len2 = dot(dir, dir);
+    if (dir_len2 < 1.0f / 32768.0f) {
+        dir = vec2(1.0f, 0.0f);
+    } else {
+        dir *= inversesqrt(dir_len2);
+    }
+
+    // Stretch the kernel along the edge and shrink it across it, the more so
+    // the stronger the edge
+    len = len * 0.5f;
+    len *= len;
+    float stretch = dot(dir, dir) / max(abs(dir.x), abs(dir.y));
+    vec2 len2 = vec2(1.0f + (stretch - 1.0f) * len, 1.0f - 0.5f * len);
+    // Negative lobe, stronger along edges
+    float lobe = 0.5f + ((1.0f / 4.0f - 0.04f) - 0.5f) * len;
+    float clip = 1.0f / lobe;
+
+    vec3 color_sum = vec3(0.0f);
+    float weight_sum = 0.0f;
+    accumulate_tap(color_sum, weight_sum, vec2(0.0f, -1.0f) - pp, dir, len2, lobe, clip, b);
+    accumulate_tap(color_sum, weight_sum, vec2(1.0f, -1.0f) - pp, dir, len2, lobe, clip, c);
+    accumulate_tap(color_sum, weight_sum, vec2(-1.0f, 1.0f) - pp, dir, len2, lobe, clip, i);
+    accumulate_tap(color_sum, weight_sum, vec2(0.0f, 1.0f) - pp, dir, len2, lobe, clip, j);
+    accumulate_tap(color_sum, weight_sum, vec2(0.0f, 0.0f) - pp, dir, len2, lobe, clip, f);
+    accumulate_tap(color_sum, weight_sum, vec2(-1.0f, 0.0f) - pp, dir, len2, lobe, clip, e);
+    accumulate_tap(color_sum, weight_sum, vec2(1.0f, 1.0f) - pp, dir, len2, lobe, clip, k);
+    accumulate_tap(color_sum, weight_sum, vec2(2.0f, 1.0f) - pp, dir, len2, lobe, clip, l);
+    accumulate_tap(color_sum, weight_sum, vec2(2.0f, 0.0f) - pp, dir, len2, lobe, clip, h);
+    accumulate_tap(color_sum, weight_sum, vec2(1.0f, 0.0f) - pp, dir, len2, lobe, clip, g);
+    accumulate_tap(color_sum, weight_sum, vec2(1.0f, 2.0f) - pp, dir, len2, lobe, clip, o);
+    accumulate_tap(color_sum, weight_sum, vec2(0.0f, 2.0f) - pp, dir, len2, lobe, clip, n);
+
+    // Deringing
+    vec3 min4 = min(min(f, g), min(j, k));
+    vec3 max4 = max(max(f, g), max(j, k));
+    out_color = vec4(clamp(color_sum / weight_sum, min4, max4), 1.0f);
+}
@@ -0,0 +1,48 @@
+// Helpers shared by the image-based lighting precomputation shaders
+// (ibl-irradiance.comp, ibl-prefilter.comp and ibl-brdf-lut.comp)
+
+const float PI = 3.14159265359f;
+
+// Must match IBL_WORKGROUP_SIZE in src/ibl.cpp
+const uint IBL_WORKGROUP_SIZE = 8;
+
+// Direction through the center of a texel of a cube face (id.z)
+// Faces are in Vulkan order: +X, -X, +Y, -Y, +Z, -Z
+vec3 cube_direction(uvec3 id, vec2 face_size) {
+    vec2 uv = (vec2(id.xy) + 0.5f) / face_size * 2.0f - 1.0f;
+    switch (id.z) {
+        case 0: return normalize(vec3(1.0f, -uv.y, -uv.x));
+        case 1: return normalize(vec3(-1.0f, -uv.y, uv.x));
+        case 2: return normalize(vec3(uv.x, 1.0f, uv.y));
+        case 3: return normalize(vec3(uv.x, -1.0f, -uv.y));
+        case 4: return normalize(vec3(uv.x, -uv.y, 1.0f));
+        default: return normalize(vec3(-uv.x, -uv.y, -1.0f));
+    }
+}
+
+// Point i of a low-discrepancy sequence of count points in [0, 1)^2
+vec2 hammersley(uint i, uint count) {
+    float radical_inverse = float(bitfieldReverse(i)) * 2.3283064365386963e-10f;
+    return vec2(float(i) / float(count), radical_inverse);
+}
+
+// Half vector around N distributed according to the GGX NDF
+vec3 importance_sample_ggx(vec2 xi, vec3 N, float roughness) {
+    float a = roughness * roughness;
+
+    float phi = 2.0f * PI * xi.x;
+    float cos_theta = sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+    float sin_theta = sqrt(1.0f - cos_theta * cos_theta);
+    vec3 H = vec3(cos(phi) * sin_theta, sin(phi) * sin_theta, cos_theta);
+
+    // Tangent space to world space
+    vec3 up = abs(N.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+    vec3 tangent = normalize(cross(up, N));
+    vec3 bitangent = cross(N, tangent);
+    return normalize(tangent * H.x + bitangent * H.y + N * H.z);
+}
+
+// The skybox faces are sRGB-encoded, but lighting needs linear radiance
+vec3 sample_environment(samplerCube environment, vec3 direction) {
+    return pow(textureLod(environment, direction, 0.0f).rgb, vec3(2.2f));
+}
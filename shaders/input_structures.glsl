@@ -1,15 +1,4 @@
-layout (set = 0, binding = 0) uniform GpuSceneData {
-    // Camera
-    mat4 viewproj;
-    vec4 cam_world_pos;
-    float near;
-    float far;
-
-    // Lighting
-    vec4 ambient_color;
-    vec4 sunlight_direction; // w for sun power
-    vec4 sunlight_color;
-} Scene;
+#include "scene_data.glsl"
 
 layout (set = 1, binding = 0) uniform GpuPbrMaterialData {
     vec4 color_factors;
@@ -0,0 +1,28 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "input_structures.glsl"
+#include "pbr_material.glsl"
+
+layout (location = 0) in vec3 in_normal;
+layout (location = 1) in vec3 in_world_pos;
+layout (location = 2) in vec2 in_uv;
+layout (location = 3) in vec4 in_color;
+
+// Must match GBuffer::FORMATS in src/gbuffer.hpp
+layout (location = 0) out vec4 out_albedo;
+layout (location = 1) out vec4 out_normal;
+layout (location = 2) out vec4 out_material; // metallic, roughness, AO
+layout (location = 3) out vec4 out_emissive;
+
+void main()
+{
+    MaterialSample material = sample_material(in_uv, in_color);
+
+    out_albedo = vec4(material.albedo.rgb, 1.0f);
+    out_normal = vec4(normalize(in_normal), 0.0f);
+    out_material = vec4(
+        material.metallic, material.roughness, material.ambient_occlusion, 0.0f
+    );
+    out_emissive = material.emissive;
+}
@@ -0,0 +1,39 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "input_structures.glsl"
+#include "pbr_lighting.glsl"
+#include "pbr_material.glsl"
+
+layout (location = 0) in vec3 in_normal;
+layout (location = 1) in vec3 in_world_pos;
+layout (location = 2) in vec2 in_uv;
+layout (location = 3) in vec4 in_color;
+layout (location = 4) in vec4 in_clip_pos;
+layout (location = 5) in vec4 in_prev_clip_pos;
+
+layout (location = 0) out vec4 out_color;
+// UV offset from where the surface was in the previous frame
+// Must match MOTION_VECTOR_FORMAT in src/taa.hpp
+layout (location = 1) out vec2 out_motion;
+
+void main()
+{
+    MaterialSample material = sample_material(in_uv, in_color);
+
+    SurfaceData surface;
+    surface.world_pos = in_world_pos;
+    surface.normal = in_normal;
+    surface.albedo = material.albedo.rgb;
+    surface.metallic = material.metallic;
+    surface.roughness = material.roughness;
+    surface.ambient_occlusion = material.ambient_occlusion;
+    surface.emissive = material.emissive;
+
+    out_color = shade_surface(surface, gl_FragCoord.xy);
+
+    // The jitter is removed so still images have no motion
+    vec2 ndc = in_clip_pos.xy / in_clip_pos.w - Scene.taa_jitter.xy;
+    vec2 prev_ndc = in_prev_clip_pos.xy / in_prev_clip_pos.w;
+    out_motion = (ndc - prev_ndc) * 0.5f;
+}
@@ -8,6 +8,9 @@ layout (location = 0) out vec3 out_normal;
 layout (location = 1) out vec3 out_world_pos;
 layout (location = 2) out vec2 out_uv;
 layout (location = 3) out vec4 out_color;
+// Only read by pbr-motion.frag
+layout (location = 4) out vec4 out_clip_pos;
+layout (location = 5) out vec4 out_prev_clip_pos;
 
 struct Vertex {
     vec3 position;
@@ -28,12 +31,18 @@ layout (push_constant) uniform GpuPushConstants {
 
 void main() {
     Vertex v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
-    gl_Position = Scene.viewproj * PushConstants.object_transform * vec4(v.position, 1.0);
+    vec4 world_pos = PushConstants.object_transform * vec4(v.position, 1.0);
+    gl_Position = Scene.viewproj * world_pos;
 
     out_normal = (PushConstants.object_transform * vec4(v.normal, 0.0f)).xyz;
     out_normal = normalize(out_normal);
 
-    out_world_pos = (PushConstants.object_transform * vec4(v.position, 1.0)).xyz;
+    out_world_pos = world_pos.xyz;
+
+    // Objects are assumed not to have moved, so only the camera motion ends
+    // up in the motion vectors
+    out_clip_pos = gl_Position;
+    out_prev_clip_pos = Scene.prev_viewproj * world_pos;
 
     out_uv = vec2(v.uv_x, v.uv_y);
 
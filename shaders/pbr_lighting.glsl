@@ -0,0 +1,212 @@
+// Shading shared by the forward (pbr.frag), deferred
+// (deferred-lighting.comp) and visibility (visibility-resolve.comp) paths
+// Requires scene_data.glsl to be included first
+
+const float PI = 3.14159265359f;
+
+vec3 fresnel_schlick(float cos_theta, vec3 F0) {
+    return F0 + (1.0f - F0) * pow(clamp(1.0f - cos_theta, 0.0f, 1.0f), 5.0f);
+}
+
+// Fresnel for the ambient term, where there is no single half vector
+vec3 fresnel_schlick_roughness(float cos_theta, vec3 F0, float roughness) {
+    return F0 + (max(vec3(1.0f - roughness), F0) - F0) *
+                pow(clamp(1.0f - cos_theta, 0.0f, 1.0f), 5.0f);
+}
+
+float distribution_ggx(vec3 N, vec3 H, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH = max(dot(N, H), 0.0f);
+    float NdotH2 = NdotH * NdotH;
+
+    float num = a2;
+    float denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+float geometry_schlick_ggx(float NdotV, float roughness) {
+    float r = (roughness + 1.0f);
+    float k = (r * r) / 8.0f;
+
+    float num = NdotV;
+    float denom = NdotV * (1.0f - k) + k;
+
+    return num / denom;
+}
+
+float geometry_smith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0f);
+    float NdotL = max(dot(N, L), 0.0f);
+    float ggx1 = geometry_schlick_ggx(NdotV, roughness);
+    float ggx2 = geometry_schlick_ggx(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+// Windowed inverse-square falloff that reaches zero at the light's range
+float distance_attenuation(float distance, float range) {
+    float ratio = distance / range;
+    float window = clamp(1.0f - ratio * ratio * ratio * ratio, 0.0f, 1.0f);
+    return (window * window) / max(distance * distance, 0.0001f);
+}
+
+float spot_attenuation(GpuLight light, vec3 L) {
+    if (uint(light.direction_type.w) != LIGHT_TYPE_SPOT) {
+        return 1.0f;
+    }
+    float cos_angle = dot(-L, light.direction_type.xyz);
+    return smoothstep(light.spot_angles.y, light.spot_angles.x, cos_angle);
+}
+
+// Map the number of lights in a cluster to a blue-green-red gradient
+vec3 heat_map(uint count) {
+    float t = clamp(float(count) / max(Scene.screen_params.w, 1.0f), 0.0f, 1.0f);
+    return clamp(vec3(2.0f * t - 0.5f, 1.5f - abs(2.0f * t - 1.0f) * 1.5f, 1.0f - 2.0f * t), 0.0f, 1.0f);
+}
+
+struct SurfaceData {
+    vec3 world_pos;
+    vec3 normal;
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    float ambient_occlusion;
+    vec4 emissive;
+};
+
+// Outgoing radiance towards V for light arriving from L, per unit of radiance
+vec3 evaluate_brdf(SurfaceData surface, vec3 N, vec3 V, vec3 L, vec3 F0) {
+    vec3 H = normalize(V + L);
+
+    vec3 F = fresnel_schlick(max(dot(H, V), 0.0f), F0);
+
+    float NDF = distribution_ggx(N, H, surface.roughness);
+    float G = geometry_smith(N, V, L, surface.roughness);
+
+    // Calculate Cook-Torrance BRDF
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0f * max(dot(N, V), 0.0f) * max(dot(N, L), 0.0f) + 0.0001f;
+    vec3 specular = numerator / denominator;
+
+    vec3 kS = F; // Energy of light that is reflected
+    vec3 kD = vec3(1.0f) - kS; // Energy of light that is refracted
+    kD *= 1.0f - surface.metallic; // Energy of light that is absorbed
+
+    float NdotL = max(dot(N, L), 0.0f);
+    return (kD * surface.albedo / PI + specular) * NdotL;
+}
+
+// Fraction of sunlight that reaches the given position (1 when fully lit)
+float sun_shadow(vec3 world_pos, vec3 N) {
+    if (Scene.shadow_params.x == 0.0f) {
+        return 1.0f;
+    }
+
+    // Pick the first cascade that contains the position
+    float view_depth = -(Scene.view * vec4(world_pos, 1.0f)).z;
+    uint cascade = 0;
+    while (cascade < SHADOW_CASCADE_COUNT && view_depth > Scene.cascade_splits[cascade]) {
+        cascade++;
+    }
+    if (cascade == SHADOW_CASCADE_COUNT) {
+        return 1.0f;
+    }
+    mat4 light_viewproj = Scene.cascade_viewprojs[cascade];
+
+    // Offset along the normal by a fraction of a texel to avoid shadow acne
+    vec2 map_size = vec2(textureSize(shadow_map, 0).xy);
+    float texels_per_unit = length(vec3(light_viewproj[0][0], light_viewproj[1][0], light_viewproj[2][0])) *
+                            map_size.x * 0.5f;
+    vec3 offset_pos = world_pos + N * (Scene.shadow_params.y / texels_per_unit);
+
+    vec4 shadow_pos = light_viewproj * vec4(offset_pos, 1.0f);
+    vec2 uv = shadow_pos.xy * 0.5f + 0.5f;
+    if (shadow_pos.z > 1.0f) {
+        return 1.0f;
+    }
+
+    // 3x3 PCF
+    vec2 texel_size = 1.0f / map_size;
+    float lit = 0.0f;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 offset = vec2(x, y) * texel_size;
+            lit += texture(shadow_map, vec4(uv + offset, float(cascade), shadow_pos.z));
+        }
+    }
+    return lit / 9.0f;
+}
+
+// Split-sum approximation of the light arriving from the skybox
+vec3 ambient_lighting(SurfaceData surface, vec3 N, vec3 V, vec3 F0) {
+    float NdotV = max(dot(N, V), 0.0f);
+    vec3 F = fresnel_schlick_roughness(NdotV, F0, surface.roughness);
+
+    vec3 kD = (1.0f - F) * (1.0f - surface.metallic);
+    vec3 diffuse = texture(irradiance_map, N).rgb * surface.albedo;
+
+    vec3 R = reflect(-V, N);
+    float max_lod = float(textureQueryLevels(prefiltered_map) - 1);
+    vec3 prefiltered = textureLod(prefiltered_map, R, surface.roughness * max_lod).rgb;
+    vec2 brdf = texture(brdf_lut, vec2(NdotV, surface.roughness)).rg;
+    vec3 specular = prefiltered * (F * brdf.x + brdf.y);
+
+    return (kD * diffuse + specular) * surface.ambient_occlusion;
+}
+
+// Shade a surface with the sun, the lights of its cluster and the skybox
+// Returns the tonemapped, gamma-corrected color
+vec4 shade_surface(SurfaceData surface, vec2 frag_coord) {
+    vec3 N = surface.normal;
+    vec3 V = normalize(Scene.cam_world_pos.xyz - surface.world_pos);
+
+    vec3 F0 = vec3(0.04f);
+    F0 = mix(F0, surface.albedo, vec3(surface.metallic));
+
+    // Reflectance equation
+    vec3 Lo = vec3(0.0f);
+
+    // Sun (w of the direction is its power)
+    {
+        vec3 L = -normalize(Scene.sunlight_direction.xyz);
+        vec3 radiance = Scene.sunlight_color.rgb * Scene.sunlight_direction.w;
+        Lo += evaluate_brdf(surface, N, V, L, F0) * radiance *
+              sun_shadow(surface.world_pos, N);
+    }
+
+    // Only evaluate the lights that were assigned to this fragment's cluster
+    uint cluster_base = cluster_index(frag_coord, surface.world_pos) * CLUSTER_STRIDE;
+    uint cluster_light_count = ClusterLights.data[cluster_base];
+    for (uint i = 0; i < cluster_light_count; i++) {
+        GpuLight light = Lights.lights[ClusterLights.data[cluster_base + 1 + i]];
+        vec3 light_position = light.position_range.xyz;
+
+        vec3 L = normalize(light_position - surface.world_pos);
+
+        // Calculate per-light radiance
+        float distance = length(light_position - surface.world_pos);
+        float attenuation = distance_attenuation(distance, light.position_range.w) *
+                            spot_attenuation(light, L);
+        vec3 radiance = light.color_intensity.rgb * light.color_intensity.a * attenuation;
+
+        // Add to outgoing radiance Lo
+        Lo += evaluate_brdf(surface, N, V, L, F0) * radiance;
+    }
+
+    vec3 ambient_color = ambient_lighting(surface, N, V, F0);
+    vec4 color = vec4(Lo + ambient_color, 1.0f);
+    color /= color + vec4(1.0f);
+    color = pow(color, vec4(1.0f / 2.2f));
+
+    color += surface.emissive;
+
+    // Debug view of the number of lights per cluster
+    if (Scene.screen_params.z > 0.0f) {
+        color.rgb = mix(color.rgb, heat_map(cluster_light_count), 0.75f);
+    }
+
+    return color;
+}
@@ -0,0 +1,51 @@
+// Material inputs shared by the PBR fragment shaders (pbr.frag,
+// pbr-gbuffer.frag and pbr-motion.frag)
+// Requires input_structures.glsl to be included first
+
+// Features of the material, set per pipeline variant
+// Must match PbrSpecializationData in src/pbr_material.cpp
+layout (constant_id = 0) const bool HAS_METAL_ROUGH_TEXTURE = true;
+layout (constant_id = 1) const bool HAS_AMBIENT_OCCLUSION_TEXTURE = true;
+layout (constant_id = 2) const bool HAS_EMISSIVE_TEXTURE = true;
+layout (constant_id = 3) const bool ALPHA_MASK = false;
+
+struct MaterialSample {
+    vec4 albedo;
+    float metallic;
+    float roughness;
+    float ambient_occlusion;
+    vec4 emissive;
+};
+
+// Textures of features the material doesn't have are never sampled, their
+// inputs come from the material factors alone
+// The color is the vertex color with the color factors applied (pbr.vert)
+MaterialSample sample_material(vec2 uv, vec4 color) {
+    MaterialSample result;
+    result.albedo = color * texture(albedo_tex, uv);
+
+    // Fragments below the cutoff (z of the metal-rough factors) are discarded
+    if (ALPHA_MASK && result.albedo.a < Material.metal_rough_factors.z) {
+        discard;
+    }
+
+    result.metallic = Material.metal_rough_factors.r;
+    result.roughness = Material.metal_rough_factors.g;
+    if (HAS_METAL_ROUGH_TEXTURE) {
+        vec4 metallic_roughness = texture(metal_rough_tex, uv);
+        result.metallic *= metallic_roughness.b;
+        result.roughness *= metallic_roughness.g;
+    }
+
+    result.ambient_occlusion = 1.0f;
+    if (HAS_AMBIENT_OCCLUSION_TEXTURE) {
+        result.ambient_occlusion = texture(ambient_occlusion_tex, uv).r;
+    }
+
+    result.emissive = vec4(0.0f);
+    if (HAS_EMISSIVE_TEXTURE) {
+        result.emissive = texture(emissive_tex, uv);
+    }
+
+    return result;
+}
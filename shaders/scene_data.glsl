@@ -0,0 +1,89 @@
+// Must match the constants in src/light.hpp
+const uint MAX_LIGHTS = 4096;
+const uint MAX_LIGHTS_PER_CLUSTER = 127;
+const uint CLUSTER_STRIDE = MAX_LIGHTS_PER_CLUSTER + 1;
+
+// Must match the constant in src/gpu_data.hpp
+const uint SHADOW_CASCADE_COUNT = 4;
+
+// Must match the constant in src/frame.hpp
+const vec4 BACKGROUND_COLOR = vec4(0.1f, 0.1f, 0.1f, 1.0f);
+
+const uint LIGHT_TYPE_POINT = 0;
+const uint LIGHT_TYPE_SPOT = 1;
+
+layout (set = 0, binding = 0) uniform GpuSceneData {
+    // Camera
+    mat4 viewproj;
+    vec4 cam_world_pos;
+    float near;
+    float far;
+
+    // Lighting
+    vec4 ambient_color;
+    vec4 sunlight_direction; // w for sun power
+    vec4 sunlight_color;
+
+    // Clustered lighting
+    mat4 view;
+    mat4 inv_proj;
+    uvec4 cluster_grid; // xyz: number of clusters per axis, w: number of lights
+    vec4 cluster_params; // xy: tile size in pixels, z: slice scale, w: slice bias
+    vec4 screen_params; // xy: draw extent, z: heat map enabled, w: heat map max
+
+    // Deferred shading
+    mat4 inv_viewproj;
+
+    // Sun shadows
+    mat4 cascade_viewprojs[SHADOW_CASCADE_COUNT];
+    vec4 cascade_splits; // View-space depth where each cascade ends
+    vec4 shadow_params; // x: shadows enabled, y: normal offset in texels
+
+    // Temporal anti-aliasing
+    mat4 prev_viewproj; // Without jitter
+    vec4 taa_jitter; // xy: jitter of viewproj in NDC
+} Scene;
+
+struct GpuLight {
+    vec4 position_range; // xyz: world position, w: range
+    vec4 color_intensity; // rgb: color, a: intensity
+    vec4 direction_type; // xyz: spot direction, w: light type
+    vec4 spot_angles; // x: cos(inner cone), y: cos(outer cone)
+};
+
+layout (std430, set = 0, binding = 1) readonly buffer LightBuffer {
+    GpuLight lights[];
+} Lights;
+
+// Each cluster stores its light count followed by its light indices
+layout (std430, set = 0, binding = 2)
+#ifndef CLUSTER_LIGHTS_WRITABLE
+readonly
+#endif
+buffer ClusterLightBuffer {
+    uint data[];
+} ClusterLights;
+
+// One layer per cascade
+layout (set = 0, binding = 3) uniform sampler2DArrayShadow shadow_map;
+
+// Image-based lighting derived from the skybox
+layout (set = 0, binding = 4) uniform samplerCube irradiance_map;
+layout (set = 0, binding = 5) uniform samplerCube prefiltered_map; // Roughness per mip
+layout (set = 0, binding = 6) uniform sampler2D brdf_lut;
+
+// Find the cluster that contains the given fragment
+uint cluster_index(vec2 frag_coord, vec3 world_pos) {
+    float view_depth = -(Scene.view * vec4(world_pos, 1.0f)).z;
+    uint slice = uint(max(
+        log(max(view_depth, Scene.near)) * Scene.cluster_params.z + Scene.cluster_params.w,
+        0.0f
+    ));
+    uvec3 cluster = min(
+        uvec3(uvec2(frag_coord / Scene.cluster_params.xy), slice),
+        Scene.cluster_grid.xyz - uvec3(1)
+    );
+    return cluster.x +
+           cluster.y * Scene.cluster_grid.x +
+           cluster.z * Scene.cluster_grid.x * Scene.cluster_grid.y;
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// Depth-only pass: only vertex positions are read
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout (buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout (push_constant) uniform GpuShadowPushConstants {
+    mat4 light_transform; // Cascade viewproj * object transform
+    VertexBuffer vertex_buffer;
+} PushConstants;
+
+void main() {
+    vec3 position = PushConstants.vertex_buffer.vertices[gl_VertexIndex].position;
+    gl_Position = PushConstants.light_transform * vec4(position, 1.0f);
+}
@@ -0,0 +1,7 @@
+// Shared by the spatial upscale and sharpen passes, which follow AMD FidelityFX
+// Super Resolution 1 (EASU and RCAS)
+
+// Luma times two, enough to find edges
+float upscale_luma(vec3 color) {
+    return color.b * 0.5f + (color.r * 0.5f + color.g);
+}
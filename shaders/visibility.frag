@@ -0,0 +1,37 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "visibility_data.glsl"
+#include "bindless.glsl"
+
+// Set for the pipeline that draws alpha masked materials, the other one keeps
+// early depth testing
+layout (constant_id = 0) const bool ALPHA_MASK = false;
+
+layout (push_constant) uniform VisibilityPushConstants {
+    uint draw_index;
+} PushConstants;
+
+layout (location = 0) in vec2 in_uv;
+layout (location = 1) in float in_alpha;
+
+layout (location = 0) out uint out_visibility;
+
+void main() {
+    if (ALPHA_MASK) {
+        // Same test as sample_material in pbr_material.glsl
+        uint material_index = draws[PushConstants.draw_index].material_index;
+        BindlessMaterial material = materials[material_index];
+        uint albedo_texture = material.texture_indices.x;
+        float alpha = in_alpha * material.color_factors.a *
+                      texture(bindless_textures[albedo_texture], in_uv).a;
+        if (alpha < material.metal_rough_factors.z) {
+            discard;
+        }
+    }
+
+    out_visibility = ((PushConstants.draw_index + 1u) << VISIBILITY_PRIMITIVE_BITS) |
+                     (uint(gl_PrimitiveID) & VISIBILITY_PRIMITIVE_MASK);
+}
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+#include "scene_data.glsl"
+#include "visibility_data.glsl"
+
+layout (push_constant) uniform VisibilityPushConstants {
+    uint draw_index;
+} PushConstants;
+
+// Only read by the alpha masked variant of visibility.frag
+layout (location = 0) out vec2 out_uv;
+layout (location = 1) out float out_alpha;
+
+void main() {
+    VisibilityDraw draw = draws[PushConstants.draw_index];
+    Vertex v = draw.vertex_buffer.vertices[gl_VertexIndex];
+    gl_Position = Scene.viewproj * draw.transform * vec4(v.position, 1.0);
+    out_uv = vec2(v.uv_x, v.uv_y);
+    out_alpha = v.color.a;
+}
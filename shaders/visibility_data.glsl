@@ -0,0 +1,36 @@
+// Requires GL_EXT_buffer_reference
+
+// Visibility buffer texels pack (draw index + 1) and the primitive ID, so 0
+// means nothing was drawn
+// Must match the constants in src/frame.hpp
+const uint VISIBILITY_PRIMITIVE_BITS = 23;
+const uint VISIBILITY_PRIMITIVE_MASK = (1u << VISIBILITY_PRIMITIVE_BITS) - 1u;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+layout (buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout (buffer_reference, std430) readonly buffer IndexBuffer {
+    uint indices[];
+};
+
+// Must match the GpuVisibilityDraw struct in src/gpu_data.hpp
+struct VisibilityDraw {
+    mat4 transform;
+    VertexBuffer vertex_buffer;
+    IndexBuffer index_buffer;
+    uint first_index;
+    uint material_index;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer VisibilityDrawBuffer {
+    VisibilityDraw draws[];
+};
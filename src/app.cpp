@@ -1,13 +1,20 @@
 #include "app.hpp"
 #include "SDL.h"
 #include "SDL_vulkan.h"
+#include "glm/gtc/constants.hpp"
 #include "spdlog/spdlog.h"
 
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
 #include "imgui_impl_vulkan.h"
 
+#include <random>
+
 namespace kovra {
+// MSAA is fixed once the renderer is created
+// With a single sample, temporal anti-aliasing smooths the edges instead
+static constexpr auto MSAA_SAMPLE_COUNT = vk::SampleCountFlagBits::e1;
+
 SDL_Window *
 create_window();
 std::unique_ptr<Renderer>
@@ -26,7 +33,10 @@ App::App()
         "./assets/damaged-helmet/DamagedHelmet.glb", "DamagedHelmet"
       );
     */
-    renderer->load_gltf("./assets/boom-box/BoomBox.glb", "BoomBox");
+    renderer->load_gltf_async("./assets/boom-box/BoomBox.glb", "BoomBox");
+
+    renderer->set_taa_enabled(taa_enabled);
+    update_sun();
 }
 App::~App()
 {
@@ -115,6 +125,7 @@ App::run()
             }
         }
 
+        update_lights();
         renderer->draw_frame(camera, objects_to_render);
     }
 }
@@ -151,25 +162,212 @@ App::draw_imgui()
     ImGui::End();
 
     // Slider for render scale
+    // Follows the scale picked by dynamic resolution while it is enabled
+    render_scale = renderer->get_render_scale();
+    ImGui::BeginDisabled(dynamic_resolution_enabled);
     if (ImGui::SliderFloat("Render Scale", &render_scale, 0.3f, 1.0f)) {
         renderer->set_render_scale(render_scale);
     }
+    ImGui::EndDisabled();
+    bool dynamic_resolution_changed =
+      ImGui::Checkbox("Dynamic resolution", &dynamic_resolution_enabled);
+    dynamic_resolution_changed |= ImGui::SliderFloat(
+      "Target GPU time (ms)", &target_frame_time, 4.0f, 33.3f
+    );
+    if (dynamic_resolution_changed) {
+        renderer->set_dynamic_resolution(
+          dynamic_resolution_enabled, target_frame_time
+        );
+    }
+    if (ImGui::SliderFloat("Sharpening", &sharpening, 0.0f, 1.0f)) {
+        renderer->set_sharpening(sharpening);
+    }
+    // Only available without MSAA
+    ImGui::BeginDisabled(
+      renderer->get_sample_count() != vk::SampleCountFlagBits::e1
+    );
+    if (ImGui::Checkbox("Temporal anti-aliasing", &taa_enabled)) {
+        renderer->set_taa_enabled(taa_enabled);
+    }
+    ImGui::EndDisabled();
+
+    // Render path
+    if (ImGui::Combo(
+          "Render Path", &render_path, "Forward\0Deferred\0Visibility\0"
+        )) {
+        renderer->set_render_path(static_cast<RenderPath>(render_path));
+    }
+
+    // Frames in flight
+    if (ImGui::SliderInt(
+          "Frames in flight",
+          &frames_in_flight,
+          static_cast<int>(MIN_FRAMES_IN_FLIGHT),
+          static_cast<int>(MAX_FRAMES_IN_FLIGHT)
+        )) {
+        renderer->set_frames_in_flight(static_cast<uint32_t>(frames_in_flight)
+        );
+    }
+
+    // Lights
+    ImGui::Begin("Lights");
+    ImGui::SliderInt(
+      "Extra lights", &extra_light_count, 0, static_cast<int>(MAX_LIGHTS) - 4
+    );
+    if (ImGui::Checkbox("Heat map", &light_heat_map_enabled)) {
+        renderer->set_light_heat_map_enabled(light_heat_map_enabled);
+    }
+    ImGui::Separator();
+    if (ImGui::Checkbox("Sun shadows", &shadows_enabled)) {
+        renderer->set_shadows_enabled(shadows_enabled);
+    }
+    bool sun_changed =
+      ImGui::SliderFloat("Sun azimuth", &sun_azimuth_deg, 0.0f, 360.0f);
+    sun_changed |=
+      ImGui::SliderFloat("Sun elevation", &sun_elevation_deg, 5.0f, 90.0f);
+    if (sun_changed) {
+        update_sun();
+    }
+    ImGui::End();
 
     // Renderer profiling stats
     const auto &stats = renderer->get_stats();
     ImGui::Begin("Profiling Stats");
     ImGui::Text("Frame time: %.2f ms", stats.frame_time);
+    ImGui::Text(
+      "Frame wait time: %.2f ms (%d in flight)",
+      stats.frame_wait_time,
+      stats.frames_in_flight
+    );
     ImGui::Text("Triangle count: %d", stats.triangle_count);
     ImGui::Text("Draw call count: %d", stats.draw_call_count);
+    ImGui::Text("Light count: %d", stats.light_count);
     ImGui::Text("Scene update time: %.2f ms", stats.scene_update_time);
     ImGui::Text(
       "Render objects draw time: %.2f ms", stats.render_objects_draw_time
     );
+    ImGui::Separator();
+    const auto render_path_names =
+      std::array{ "Forward", "Deferred", "Visibility" };
+    ImGui::Text(
+      "Render path: %s",
+      render_path_names[static_cast<size_t>(renderer->get_render_path())]
+    );
+    const auto sample_count = static_cast<int>(renderer->get_sample_count());
+    if (sample_count > 1) {
+        ImGui::Text("Anti-aliasing: %dx MSAA", sample_count);
+    } else {
+        ImGui::Text(
+          "Anti-aliasing: %s", renderer->is_taa_active() ? "TAA" : "off"
+        );
+    }
+    ImGui::Text("Async compute: %s", stats.async_compute ? "on" : "off");
+    ImGui::Text(
+      "Barriers: %d in %d batches",
+      stats.barrier_count,
+      stats.barrier_batch_count
+    );
+    ImGui::Text(
+      "Render passes: %d (%d culled)",
+      stats.render_pass_count,
+      stats.culled_pass_count
+    );
+    ImGui::Text(
+      "Transient images: %.1f MB (%.1f MB unaliased)",
+      stats.transient_megabytes,
+      stats.transient_unaliased_megabytes
+    );
+    ImGui::Text(
+      "Uploads: %d copies in %d submits (%.1f MB)",
+      stats.upload_copy_count,
+      stats.upload_submit_count,
+      stats.uploaded_megabytes
+    );
+    ImGui::Text("Upload stalls: %d", stats.upload_stall_count);
+    ImGui::Text("Scenes loading: %d", stats.loading_scene_count);
+    ImGui::Text(
+      "Last load: %.2f MB staged, %.2f MB copied",
+      stats.last_load_staged_megabytes,
+      stats.last_load_copied_megabytes
+    );
+    ImGui::Text(
+      "Derived data cache: %.0f%% hits, %.2f MB saved",
+      stats.derived_data_hit_rate * 100.0f,
+      stats.derived_data_saved_megabytes
+    );
+    ImGui::Text(
+      "Pipelines: %d in %.2f ms (%d cache hits)",
+      stats.pipeline_count,
+      stats.pipeline_creation_time,
+      stats.pipeline_cache_hit_count
+    );
+    ImGui::Text("GPU frame time: %.2f ms", stats.gpu_frame_time);
+    ImGui::Text("GPU shadow time: %.2f ms", stats.gpu_shadow_time);
+    ImGui::Text(
+      "Shadow cascades rendered: %d (%d draws)",
+      stats.shadow_cascades_rendered,
+      stats.shadow_draw_call_count
+    );
+    ImGui::Text("GPU opaque time: %.2f ms", stats.gpu_opaque_time);
+    ImGui::Text("GPU lighting time: %.2f ms", stats.gpu_lighting_time);
     ImGui::End();
 
     ImGui::Render();
 }
 
+void
+App::update_sun()
+{
+    const float azimuth = glm::radians(sun_azimuth_deg);
+    const float elevation = glm::radians(sun_elevation_deg);
+    // The sun shines down from the given angles
+    renderer->set_sun_direction(-glm::vec3(
+      std::cos(elevation) * std::sin(azimuth),
+      std::sin(elevation),
+      std::cos(elevation) * std::cos(azimuth)
+    ));
+}
+
+void
+App::update_lights()
+{
+    // Four static lights in front of the scene
+    lights.clear();
+    for (const auto &position : { glm::vec3(-5.0f, 5.0f, 10.0f),
+                                  glm::vec3(5.0f, 5.0f, 10.0f),
+                                  glm::vec3(-5.0f, -5.0f, 10.0f),
+                                  glm::vec3(5.0f, -5.0f, 10.0f) }) {
+        lights.emplace_back(Light{
+          .position = position, .intensity = 100.0f, .range = 100.0f });
+    }
+
+    // Extra point and spot lights orbiting the origin to stress the culling
+    std::mt19937 rng{ 1337 };
+    std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+    const float time = SDL_GetTicks() / 1000.0f;
+    for (int i = 0; i < extra_light_count; i++) {
+        const float radius = 5.0f + unit(rng) * 60.0f;
+        const float height = -20.0f + unit(rng) * 40.0f;
+        const float speed = 0.2f + unit(rng) * 0.8f;
+        const float phase = unit(rng) * glm::two_pi<float>();
+        const float angle = phase + time * speed;
+
+        const auto type = i % 4 == 0 ? LightType::Spot : LightType::Point;
+        const auto position =
+          glm::vec3(radius * glm::cos(angle), height, radius * glm::sin(angle));
+        lights.emplace_back(Light{
+          .type = type,
+          .position = position,
+          .direction = -position,
+          .color = glm::vec3(unit(rng), unit(rng), unit(rng)),
+          .intensity = 20.0f,
+          .range = 5.0f + unit(rng) * 10.0f,
+        });
+    }
+
+    renderer->set_lights(lights);
+}
+
 SDL_Window *
 create_window()
 {
@@ -207,6 +405,6 @@ create_window()
 std::unique_ptr<Renderer>
 create_renderer(SDL_Window *window)
 {
-    return std::make_unique<Renderer>(window, true);
+    return std::make_unique<Renderer>(window, MSAA_SAMPLE_COUNT);
 }
 } // namespace kovra
@@ -2,6 +2,7 @@
 
 #include "SDL_video.h"
 #include "camera.hpp"
+#include "light.hpp"
 #include "renderer.hpp"
 #include <memory>
 
@@ -22,12 +23,28 @@ class App
     int frame_count_since_last_second = 0;
     double fps = 0;
     float render_scale = 1.0f;
+    bool dynamic_resolution_enabled = false;
+    float target_frame_time = 1000.0f / 60.0f;
+    float sharpening = 0.8f;
+    bool taa_enabled = true;
+    int render_path = static_cast<int>(RenderPath::Forward);
+    int frames_in_flight = static_cast<int>(DEFAULT_FRAMES_IN_FLIGHT);
+    int extra_light_count = 0;
+    bool light_heat_map_enabled = false;
+    bool shadows_enabled = true;
+    float sun_azimuth_deg = 53.0f;
+    float sun_elevation_deg = 63.0f;
 
     // Camera
     Camera camera;
     glm::vec2 prev_mouse_pos{ 0.0f, 0.0f };
     bool camera_movable{ false };
 
+    // Lights
+    std::vector<Light> lights;
+
     void draw_imgui();
+    void update_lights();
+    void update_sun();
 };
 } // namespace kovra
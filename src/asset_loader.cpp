@@ -1,12 +1,20 @@
 #include "asset_loader.hpp"
 
 #include "buffer.hpp"
+#include "derived_data_cache.hpp"
 #include "descriptor.hpp"
+#include "format.hpp"
+#include "gltf_geometry.hpp"
+#include "mapped_file.hpp"
 #include "mesh.hpp"
+#include "mip_chain.hpp"
+#include "mip_generator.hpp"
 #include "pbr_material.hpp"
 #include "render_object.hpp"
 #include "render_resources.hpp"
 #include "renderer.hpp"
+#include "scene_pack.hpp"
+#include "utils.hpp"
 #include "vertex.hpp"
 
 #include "fastgltf/core.hpp"
@@ -18,6 +26,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <future>
+#include <thread>
+
 namespace kovra {
 
 vk::Filter
@@ -58,6 +74,50 @@ extract_mipmap_mode(fastgltf::Filter filter)
     }
 }
 
+// How the mip chain of each image is filtered, from the material slots that
+// sample it
+std::vector<MipGenerationInfo>
+get_mip_generation_infos(const fastgltf::Asset &gltf)
+{
+    std::vector<MipGenerationInfo> infos(gltf.images.size());
+    const auto set_info = [&](size_t texture_index, MipGenerationInfo info) {
+        if (texture_index >= gltf.textures.size()) {
+            return;
+        }
+        const auto &image_index = gltf.textures[texture_index].imageIndex;
+        if (image_index.has_value() && image_index.value() < infos.size()) {
+            infos[image_index.value()] = info;
+        }
+    };
+
+    for (const fastgltf::Material &mat : gltf.materials) {
+        if (mat.pbrData.baseColorTexture.has_value()) {
+            const bool alpha_tested =
+              mat.alphaMode == fastgltf::AlphaMode::Mask;
+            set_info(
+              mat.pbrData.baseColorTexture.value().textureIndex,
+              MipGenerationInfo{
+                .filter = MipFilter::Srgb,
+                .alpha_cutoff = alpha_tested ? mat.alphaCutoff : 0.0f,
+              }
+            );
+        }
+        if (mat.emissiveTexture.has_value()) {
+            set_info(
+              mat.emissiveTexture.value().textureIndex,
+              MipGenerationInfo{ .filter = MipFilter::Srgb }
+            );
+        }
+        if (mat.normalTexture.has_value()) {
+            set_info(
+              mat.normalTexture.value().textureIndex,
+              MipGenerationInfo{ .filter = MipFilter::Normal }
+            );
+        }
+    }
+    return infos;
+}
+
 std::optional<std::unique_ptr<LoadedGltfScene>>
 AssetLoader::load_gltf(
   std::filesystem::path filepath,
@@ -65,16 +125,34 @@ AssetLoader::load_gltf(
   const RenderResources &resources
 )
 {
+    if (ScenePack::is_scene_pack(filepath)) {
+        return load_scene_pack(filepath, device, resources);
+    }
     spdlog::debug("Loading GLTF file: {}", filepath.string());
+    const auto start = std::chrono::system_clock::now();
 
-    // Load the glTF file data into buffer
+    // Parse the file straight from a mapping of it, the binary chunk of a
+    // GLB then stays in the mapping too and accessors are read from there
+    // The mapping has to outlive the scene constructor
+    auto file = MappedFile::open(filepath, fastgltf::getGltfBufferPadding());
     fastgltf::GltfDataBuffer data;
-    data.loadFromFile(filepath);
+    uint64_t bytes_copied = 0;
+    if (!file.has_value() ||
+        !data.fromByteView(
+          reinterpret_cast<std::uint8_t *>(file->get_data()),
+          file->get_bytes().size(),
+          file->get_capacity()
+        )) {
+        spdlog::warn("Failed to map {}, reading it instead", filepath.string());
+        data.loadFromFile(filepath);
+        bytes_copied += data.getBufferSize();
+    }
 
-    fastgltf::Parser parser{};
+    // KTX2 images of KHR_texture_basisu textures are used when their payload
+    // is already block-compressed
+    fastgltf::Parser parser{ fastgltf::Extensions::KHR_texture_basisu };
     constexpr auto parse_opts = fastgltf::Options::DontRequireValidAssetMember |
                                 fastgltf::Options::AllowDouble |
-                                fastgltf::Options::LoadGLBBuffers |
                                 fastgltf::Options::LoadExternalBuffers;
 
     // Parse the glTF file
@@ -91,9 +169,51 @@ AssetLoader::load_gltf(
     fastgltf::Asset gltf;
     gltf = std::move(parse_result.get());
 
-    return std::make_unique<LoadedGltfScene>(
-      std::move(gltf), device, resources
+    auto scene = std::make_unique<LoadedGltfScene>(
+      std::move(gltf), filepath, device, resources
     );
+    scene->load_stats.bytes_copied += bytes_copied;
+    const auto end = std::chrono::system_clock::now();
+    spdlog::debug(
+      "Loaded GLTF file {} in {:.2f} ms",
+      filepath.string(),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count() /
+        1000.0f
+    );
+    spdlog::debug(
+      "Staged {:.2f} MB of geometry in place, copied {:.2f} MB on the way",
+      static_cast<float>(scene->load_stats.bytes_staged) / (1024.0f * 1024.0f),
+      static_cast<float>(scene->load_stats.bytes_copied) / (1024.0f * 1024.0f)
+    );
+    return scene;
+}
+
+std::optional<std::unique_ptr<LoadedGltfScene>>
+AssetLoader::load_scene_pack(
+  const std::filesystem::path &filepath,
+  const Device &device,
+  const RenderResources &resources
+)
+{
+    spdlog::debug("Loading scene pack: {}", filepath.string());
+    const auto start = std::chrono::system_clock::now();
+
+    const auto pack = ScenePack::open(filepath);
+    if (!pack.has_value()) {
+        return std::nullopt;
+    }
+    auto scene =
+      std::make_unique<LoadedGltfScene>(pack.value(), device, resources);
+    const auto end = std::chrono::system_clock::now();
+    spdlog::debug(
+      "Loaded scene pack {} in {:.2f} ms",
+      filepath.string(),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count() /
+        1000.0f
+    );
+    return scene;
 }
 
 std::optional<std::unique_ptr<unsigned char[], StbImageDeleter>>
@@ -125,17 +245,39 @@ AssetLoader::load_image_raw(
     return std::nullopt;
 }
 
-std::optional<std::unique_ptr<GpuImage>>
-LoadedGltfScene::load_image(
+std::optional<LoadedGltfScene::DecodedImage>
+LoadedGltfScene::decode_image(
   const fastgltf::Asset &asset,
   const fastgltf::Image &image,
-  const Device &device,
-  const RenderResources &resources
+  const std::optional<std::filesystem::path> &compressed_filepath,
+  DerivedDataCache *cache,
+  const MipGenerationInfo &mip_info
 )
 {
-    std::unique_ptr<GpuImage> img = nullptr;
-    int width, height, channels;
+    std::optional<DecodedImage> decoded = std::nullopt;
+
+    const auto decode_ktx2 = [&decoded](std::optional<Ktx2Image> &&ktx2) {
+        if (ktx2.has_value()) {
+            decoded = DecodedImage{ .pixels = nullptr,
+                                    .width = static_cast<int>(ktx2->width),
+                                    .height = static_cast<int>(ktx2->height),
+                                    .ktx2 = std::move(ktx2) };
+        }
+    };
+    if (compressed_filepath.has_value()) {
+        spdlog::debug(
+          "Loading compressed image from filepath: {}",
+          compressed_filepath->string()
+        );
+        decode_ktx2(read_ktx2(compressed_filepath.value()));
+        if (decoded.has_value()) {
+            return decoded;
+        }
+    }
 
+    // Find the encoded bytes of the image
+    std::vector<std::byte> file_bytes;
+    std::span<const std::byte> bytes;
     std::visit(
       fastgltf::visitor{
         [](auto &arg) {
@@ -152,45 +294,17 @@ LoadedGltfScene::load_image(
             spdlog::debug(
               "Loading image from filepath: {}", asset_filepath.string()
             );
-
-            auto result = AssetLoader::load_image_raw(
-              asset_filepath, &width, &height, &channels
-            );
-            if (result.has_value()) {
-                unsigned char *data = result.value().get();
-                img = device.create_color_image(
-                  data,
-                  width,
-                  height,
-                  resources.get_sampler(vk::Filter::eLinear),
-                  vk::Format::eR8G8B8A8Unorm,
-                  true
-                );
-                result.reset();
+            if (auto result = utils::read_file(asset_filepath);
+                result.has_value()) {
+                file_bytes = std::move(result.value());
+                bytes = file_bytes;
             }
         },
         [&](const fastgltf::sources::Vector &vector) {
             spdlog::debug("Loading image from vector");
-
-            unsigned char *data = stbi_load_from_memory(
-              vector.bytes.data(),
-              static_cast<int>(vector.bytes.size()),
-              &width,
-              &height,
-              &channels,
-              4
+            bytes = std::as_bytes(
+              std::span{ vector.bytes.data(), vector.bytes.size() }
             );
-            if (data) {
-                img = device.create_color_image(
-                  data,
-                  width,
-                  height,
-                  resources.get_sampler(vk::Filter::eLinear),
-                  vk::Format::eR8G8B8A8Unorm,
-                  true
-                );
-                stbi_image_free(data);
-            }
         },
         [&](const fastgltf::sources::BufferView &view) {
             spdlog::debug("Loading image from buffer view");
@@ -198,49 +312,173 @@ LoadedGltfScene::load_image(
             const auto &buffer_view = asset.bufferViews[view.bufferViewIndex];
             const auto &buffer = asset.buffers[buffer_view.bufferIndex];
 
-            std::visit(
-              fastgltf::visitor{
-                [](auto &arg) {
-                    spdlog::error(
-                      "Unknown buffer data type: {}", typeid(arg).name()
-                    );
-                },
-                [&](const fastgltf::sources::Array &vector) {
-                    unsigned char *data = stbi_load_from_memory(
-                      vector.bytes.data() + buffer_view.byteOffset,
-                      static_cast<int>(buffer_view.byteLength),
-                      &width,
-                      &height,
-                      &channels,
-                      4
-                    );
-                    if (data) {
-                        img = device.create_color_image(
-                          data,
-                          width,
-                          height,
-                          resources.get_sampler(vk::Filter::eLinear),
-                          vk::Format::eR8G8B8A8Unorm,
-                          true
-                        );
-                        stbi_image_free(data);
-                    }
-                } },
-              buffer.data
+            // Either in the mapped file or loaded by the parser
+            const auto buffer_bytes = get_buffer_bytes(buffer);
+            if (buffer_view.byteOffset + buffer_view.byteLength >
+                buffer_bytes.size()) {
+                spdlog::error("Image buffer view is out of range");
+                return;
+            }
+            bytes = buffer_bytes.subspan(
+              buffer_view.byteOffset, buffer_view.byteLength
             );
         } },
       image.data
     );
+    if (bytes.empty()) {
+        return std::nullopt;
+    }
+    if (is_ktx2(bytes)) {
+        decode_ktx2(read_ktx2(bytes));
+        return decoded;
+    }
 
-    if (!img) {
+    // Decoding and building the mip chain are skipped if an earlier load of
+    // the same image left the result in the cache
+    std::optional<DerivedDataKey> cache_key;
+    if (cache != nullptr) {
+        // The chain depends on how the image is used, which can differ
+        // between assets that share it, e.g. as a base color or normal map
+        const auto mip_key = std::array{
+            static_cast<uint32_t>(MIP_CHAIN_FORMAT),
+            static_cast<uint32_t>(mip_info.filter),
+            std::bit_cast<uint32_t>(mip_info.alpha_cutoff),
+        };
+        cache_key = DerivedDataCache::make_key(
+          "rgba8-mips",
+          MIP_CHAIN_VERSION,
+          bytes,
+          std::as_bytes(std::span{ mip_key })
+        );
+        if (auto cached = cache->get(cache_key.value()); cached.has_value()) {
+            decode_ktx2(read_ktx2(cached.value()));
+            if (decoded.has_value()) {
+                return decoded;
+            }
+            cache->remove(cache_key.value());
+        }
+    }
+
+    int width, height, channels;
+    unsigned char *data = stbi_load_from_memory(
+      reinterpret_cast<const stbi_uc *>(bytes.data()),
+      static_cast<int>(bytes.size()),
+      &width,
+      &height,
+      &channels,
+      4
+    );
+    if (!data) {
         return std::nullopt;
-    } else {
-        return img;
     }
+    auto pixels = std::unique_ptr<unsigned char[], StbImageDeleter>(data);
+    if (!cache_key.has_value()) {
+        // The mip chain is blitted on the GPU instead
+        return DecodedImage{ .pixels = std::move(pixels),
+                             .width = width,
+                             .height = height };
+    }
+
+    auto mip_chain = build_rgba8_mip_chain(
+      std::span{ pixels.get(), static_cast<size_t>(width) * height * 4 },
+      static_cast<uint32_t>(width),
+      static_cast<uint32_t>(height),
+      mip_info
+    );
+    if (const auto encoded = encode_ktx2(mip_chain); encoded.has_value()) {
+        cache->put(cache_key.value(), encoded.value());
+    }
+    decode_ktx2(std::move(mip_chain));
+    return decoded;
+}
+
+std::vector<std::optional<LoadedGltfScene::DecodedImage>>
+LoadedGltfScene::decode_images(
+  const fastgltf::Asset &asset,
+  const std::filesystem::path &filepath,
+  bool load_compressed,
+  DerivedDataCache *cache,
+  std::span<const MipGenerationInfo> mip_infos,
+  std::vector<ImageDecodeStats> &stats
+)
+{
+    const size_t image_count = asset.images.size();
+    std::vector<std::optional<DecodedImage>> decoded(image_count);
+    stats.assign(image_count, ImageDecodeStats{});
+
+    // Each worker takes the next image that nobody has started on yet, and
+    // only writes the slots of the images it decodes
+    std::atomic<size_t> next_image = 0;
+    const auto decode_next_images = [&]() {
+        for (size_t i = next_image++; i < image_count; i = next_image++) {
+            std::optional<std::filesystem::path> compressed_filepath;
+            if (load_compressed) {
+                compressed_filepath = get_compressed_texture_path(filepath, i);
+                if (!std::filesystem::exists(compressed_filepath.value())) {
+                    compressed_filepath.reset();
+                }
+            }
+
+            const auto start = std::chrono::system_clock::now();
+            decoded[i] = decode_image(
+              asset, asset.images[i], compressed_filepath, cache, mip_infos[i]
+            );
+            const auto end = std::chrono::system_clock::now();
+
+            stats[i] = ImageDecodeStats{
+                .name = std::string{ asset.images[i].name },
+                .width = decoded[i].has_value() ? decoded[i]->width : 0,
+                .height = decoded[i].has_value() ? decoded[i]->height : 0,
+                .decode_time =
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                    end - start
+                  )
+                    .count() /
+                  1000.0f,
+            };
+        }
+    };
+
+    const auto start = std::chrono::system_clock::now();
+    const size_t worker_count = std::min(
+      image_count,
+      static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))
+    );
+    std::vector<std::future<void>> workers;
+    workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back(std::async(std::launch::async, decode_next_images)
+        );
+    }
+    for (auto &worker : workers) {
+        worker.get();
+    }
+    const auto end = std::chrono::system_clock::now();
+
+    for (const auto &image_stats : stats) {
+        spdlog::debug(
+          "Decoded image {} ({}x{}) in {:.2f} ms",
+          image_stats.name,
+          image_stats.width,
+          image_stats.height,
+          image_stats.decode_time
+        );
+    }
+    spdlog::debug(
+      "Decoded {} images on {} threads in {:.2f} ms",
+      image_count,
+      worker_count,
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count() /
+        1000.0f
+    );
+
+    return decoded;
 }
 
 LoadedGltfScene::LoadedGltfScene(
   fastgltf::Asset gltf,
+  const std::filesystem::path &filepath,
   const Device &device,
   const RenderResources &resources
 )
@@ -279,20 +517,78 @@ LoadedGltfScene::LoadedGltfScene(
     }
 
     // Load textures
-    for (const fastgltf::Image &img : gltf.images) {
-        auto result = load_image(gltf, img, device, resources);
+    // Decoding is spread over all cores, then every upload is enqueued
+    // before the next flush so the whole set goes out in one batch
+    // Compressed versions written by kovra-texc replace the originals
+    // Other images come with a mip chain from the derived data cache, built
+    // on a miss with the filters the compute MipGenerator would use
+    const bool load_compressed = device.supports_bc_textures();
+    auto &cache = resources.get_derived_data_cache();
+    const auto mip_infos = get_mip_generation_infos(gltf);
+    auto decoded_images = decode_images(
+      gltf,
+      filepath,
+      load_compressed,
+      cache.is_enabled() ? &cache : nullptr,
+      mip_infos,
+      image_decode_stats
+    );
+    // Only KTX2 images the device can sample are used
+    std::vector<bool> compressed_images(gltf.images.size(), false);
+    for (size_t i = 0; i < gltf.images.size(); i++) {
+        auto &decoded = decoded_images[i];
+        if (decoded.has_value() && decoded->ktx2.has_value() &&
+            is_block_compressed(decoded->ktx2->format) && !load_compressed) {
+            spdlog::error("Device does not support BCn textures");
+            decoded.reset();
+        }
 
         std::shared_ptr<GpuImage> texture = nullptr;
-        if (result.has_value()) {
-            texture = std::move(result.value());
+        if (decoded.has_value() && decoded->ktx2.has_value()) {
+            const auto &ktx2 = decoded->ktx2.value();
+            texture = device.create_compressed_image(
+              ktx2.data.data(),
+              ktx2.width,
+              ktx2.height,
+              ktx2.level_count,
+              resources.get_sampler(vk::Filter::eLinear),
+              ktx2.format
+            );
+            compressed_images[i] = is_block_compressed(ktx2.format);
+            decoded.reset();
+        } else if (decoded.has_value()) {
+            texture = device.create_color_image(
+              decoded->pixels.get(),
+              decoded->width,
+              decoded->height,
+              resources.get_sampler(vk::Filter::eLinear),
+              vk::Format::eR8G8B8A8Unorm,
+              true,
+              mip_infos[i]
+            );
+            // The pixels were copied to staging memory
+            decoded.reset();
         } else {
             texture = resources.get_texture_owned("checkerboard");
-            spdlog::error("Failed to load image: {}", img.name.c_str());
+            spdlog::error(
+              "Failed to load image: {}", gltf.images[i].name.c_str()
+            );
         }
 
         textures.push_back(texture);
     }
 
+    // KHR_texture_basisu textures point at a KTX2 image as well, which is
+    // used if it could be loaded
+    const auto get_image_index = [&](const fastgltf::Texture &tex) {
+        if (const auto basisu_idx = tex.basisuImageIndex;
+            basisu_idx.has_value() && basisu_idx.value() < textures.size() &&
+            compressed_images[basisu_idx.value()]) {
+            return basisu_idx;
+        }
+        return tex.imageIndex;
+    };
+
     // Load materials
     for (size_t i = 0; i < gltf.materials.size(); i++) {
         const fastgltf::Material &mat = gltf.materials[i];
@@ -306,7 +602,7 @@ LoadedGltfScene::LoadedGltfScene(
                               .metal_rough_factors = glm::vec4(
                                 mat.pbrData.metallicFactor,
                                 mat.pbrData.roughnessFactor,
-                                0.0f,
+                                mat.alphaCutoff,
                                 0.0f
                               ),
                               ._padding = {} };
@@ -338,7 +634,7 @@ LoadedGltfScene::LoadedGltfScene(
               );
 
             // Assign albedo texture
-            if (auto img_idx = tex.imageIndex; img_idx.has_value()) {
+            if (auto img_idx = get_image_index(tex); img_idx.has_value()) {
                 if (img_idx.value() < textures.size()) {
                     albedo_texture = textures.at(img_idx.value());
                 } else {
@@ -384,7 +680,7 @@ LoadedGltfScene::LoadedGltfScene(
             );
 
             // Assign metallic roughness texture
-            if (auto img_idx = tex.imageIndex; img_idx.has_value()) {
+            if (auto img_idx = get_image_index(tex); img_idx.has_value()) {
                 if (img_idx.value() < textures.size()) {
                     metal_rough_texture = textures.at(img_idx.value());
                 } else {
@@ -429,7 +725,7 @@ LoadedGltfScene::LoadedGltfScene(
               gltf.textures.at(mat.occlusionTexture.value().textureIndex);
 
             // Assign ambient occlusion texture
-            if (auto img_idx = tex.imageIndex; img_idx.has_value()) {
+            if (auto img_idx = get_image_index(tex); img_idx.has_value()) {
                 if (img_idx.value() < textures.size()) {
                     ambient_occlusion_texture = textures.at(img_idx.value());
                 } else {
@@ -478,7 +774,7 @@ LoadedGltfScene::LoadedGltfScene(
               gltf.textures.at(mat.emissiveTexture.value().textureIndex);
 
             // Assign ambient occlusion texture
-            if (auto img_idx = tex.imageIndex; img_idx.has_value()) {
+            if (auto img_idx = get_image_index(tex); img_idx.has_value()) {
                 if (img_idx.value() < textures.size()) {
                     emissive_texture = textures.at(img_idx.value());
                 } else {
@@ -508,6 +804,17 @@ LoadedGltfScene::LoadedGltfScene(
             spdlog::warn("No emissive texture found in material: {}", mat.name);
         }
 
+        // Textures that weren't found are left white, the pipeline variant
+        // without them skips sampling them
+        const auto white_texture = resources.get_texture_owned("white");
+        const auto features = PbrFeatures{
+            .metal_rough_texture = metal_rough_texture != white_texture,
+            .ambient_occlusion_texture =
+              ambient_occlusion_texture != white_texture,
+            .emissive_texture = emissive_texture != white_texture,
+            .alpha_mask = mat.alphaMode == fastgltf::AlphaMode::Mask,
+        };
+
         auto mat_inst_ci = PbrMaterialInstanceCreateInfo{
             .albedo_texture = *albedo_texture,
             .albedo_sampler = albedo_sampler,
@@ -522,6 +829,10 @@ LoadedGltfScene::LoadedGltfScene(
             .material_buffer_offset =
               static_cast<uint32_t>(i * sizeof(GpuPbrMaterialData)),
             .pass = pass,
+            .features = features,
+
+            .bindless_registry = resources.get_bindless_registry(),
+            .material_data = &material_data,
         };
         auto material_instance = std::make_shared<MaterialInstance>(
           resources.get_pbr_material().create_material_instance(
@@ -531,144 +842,49 @@ LoadedGltfScene::LoadedGltfScene(
         material_instances.push_back(material_instance);
     }
 
+    // Buffers the parser loaded into memory instead of leaving them in the
+    // mapped file were copied once already
+    for (const fastgltf::Buffer &buffer : gltf.buffers) {
+        if (!std::holds_alternative<fastgltf::sources::ByteView>(buffer.data)) {
+            load_stats.bytes_copied += get_buffer_bytes(buffer).size();
+        }
+    }
+
     // Load meshes
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
+    // Accessors are converted straight into staging memory as the upload
+    // queue hands it out
     for (fastgltf::Mesh &mesh : gltf.meshes) {
         auto mesh_asset = std::make_shared<MeshAsset>();
         mesh_asset->name = mesh.name;
 
-        vertices.clear();
-        indices.clear();
-
-        for (auto &&p : mesh.primitives) {
-            auto surface = GeometrySurface{
-                .start_index = static_cast<uint32_t>(indices.size()),
-                .count = static_cast<uint32_t>(
-                  gltf.accessors[p.indicesAccessor.value()].count
-                ),
-                .bounds = {},
-            };
-            size_t initial_vertex_count = vertices.size();
-
-            // Load indices
-            {
-                fastgltf::Accessor &accessor =
-                  gltf.accessors[p.indicesAccessor.value()];
-                indices.reserve(indices.size() + accessor.count);
-                fastgltf::iterateAccessor<uint32_t>(
-                  gltf,
-                  accessor,
-                  [&](uint32_t idx) {
-                      indices.push_back(initial_vertex_count + idx);
-                  }
-                );
-            }
-
-            // Load vertex positions
-            {
-                fastgltf::Accessor &accessor =
-                  gltf.accessors[p.findAttribute("POSITION")->second];
-                vertices.resize(vertices.size() + accessor.count);
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(
-                  gltf,
-                  accessor,
-                  [&](glm::vec3 pos, size_t idx) {
-                      auto vertex = Vertex{
-                          .position = pos,
-                          .normal = glm::vec3(0.0f, 1.0f, 0.0f),
-                          .color = glm::vec3(1.0f),
-                          .uv = glm::vec2(0.0f),
-                      };
-                      vertices[initial_vertex_count + idx] = std::move(vertex);
-                  }
-                );
-            }
-
-            // Load vertex normals
-            if (auto normals = p.findAttribute("NORMAL");
-                normals != p.attributes.end()) {
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(
-                  gltf,
-                  gltf.accessors[(*normals).second],
-                  [&](glm::vec3 normal, size_t idx) {
-                      vertices[initial_vertex_count + idx].normal = normal;
-                  }
-                );
-            } else {
-                spdlog::warn(
-                  "No vertex normals found in mesh: {}", mesh_asset->name
-                );
-            }
-
-            // Load UVs
-            if (auto uvs = p.findAttribute("TEXCOORD_0");
-                uvs != p.attributes.end()) {
-                fastgltf::iterateAccessorWithIndex<glm::vec2>(
-                  gltf,
-                  gltf.accessors[(*uvs).second],
-                  [&](glm::vec2 uv, size_t idx) {
-                      vertices[initial_vertex_count + idx].uv = uv;
-                  }
-                );
-            } else {
-                spdlog::warn("No UVs found in mesh: {}", mesh_asset->name);
-            }
-
-            // Load vertex colors
-            if (auto colors = p.findAttribute("COLOR_0");
-                colors != p.attributes.end()) {
-                fastgltf::iterateAccessorWithIndex<glm::vec4>(
-                  gltf,
-                  gltf.accessors[(*colors).second],
-                  [&](glm::vec4 color, size_t idx) {
-                      vertices[initial_vertex_count + idx].color = color;
-                  }
-                );
-            } else {
-                spdlog::warn(
-                  "No vertex colors found in mesh: {}", mesh_asset->name
-                );
-            }
-
-            // Load material
-            if (p.materialIndex.has_value()) {
-                surface.material_instance =
-                  material_instances[p.materialIndex.value()];
-            } else {
-                surface.material_instance = material_instances[0];
-            }
-
-            // Set bounds
-            {
-                glm::vec3 min_pos = vertices[initial_vertex_count].position;
-                glm::vec3 max_pos = vertices[initial_vertex_count].position;
-                // Loop through vertices of surface to find the min and max
-                // bounds
-                for (size_t i = initial_vertex_count; i < vertices.size();
-                     i++) {
-                    min_pos = glm::min(min_pos, vertices[i].position);
-                    max_pos = glm::max(max_pos, vertices[i].position);
-                }
-                // Calculate the origin and extents from the min/max
-                surface.bounds.origin = (min_pos + max_pos) / 2.0f;
-                surface.bounds.extents = (max_pos - min_pos) / 2.0f;
-                // Use entents length as sphere radius
-                surface.bounds.sphere_radius =
-                  glm::length(surface.bounds.extents);
-            }
-
-            mesh_asset->surfaces.push_back(std::move(surface));
-        }
+        GltfMeshReader reader{ gltf, mesh, USE_NORMALS_AS_COLORS };
+        mesh_asset->mesh = std::make_unique<Mesh>(
+          reader.get_vertex_count(),
+          [&reader](std::span<std::byte> dst, size_t first, size_t count) {
+              reader.write_vertices(dst, first, count);
+          },
+          reader.get_index_count(),
+          [&reader](std::span<std::byte> dst, size_t first, size_t count) {
+              reader.write_indices(dst, first, count);
+          },
+          device
+        );
 
-        // Override vertex colors with normals
-        if (USE_NORMALS_AS_COLORS) {
-            for (Vertex &v : vertices) {
-                v.color = glm::vec4(v.normal, 1.0f);
-            }
+        // Bounds were taken while the vertices were written
+        for (size_t i = 0; i < reader.get_primitive_count(); i++) {
+            const auto &material_index = mesh.primitives[i].materialIndex;
+            mesh_asset->surfaces.emplace_back(GeometrySurface{
+              .start_index = reader.get_first_index(i),
+              .count = reader.get_index_count(i),
+              .bounds = reader.get_bounds(i),
+              .material_instance = material_instances
+                [material_index.has_value() ? material_index.value() : 0],
+            });
         }
-
-        mesh_asset->mesh = std::make_unique<Mesh>(vertices, indices, device);
+        load_stats.bytes_copied += reader.get_bytes_copied();
+        load_stats.bytes_staged +=
+          sizeof(GpuVertexData) * reader.get_vertex_count() +
+          sizeof(uint32_t) * reader.get_index_count();
 
         mesh_assets.push_back(mesh_asset);
     }
@@ -730,6 +946,169 @@ LoadedGltfScene::LoadedGltfScene(
     }
 }
 
+LoadedGltfScene::LoadedGltfScene(
+  const ScenePack &pack,
+  const Device &device,
+  const RenderResources &resources
+)
+  : desc_alloc{ std::make_unique<DescriptorAllocator>(
+      device.get(),
+      static_cast<uint32_t>(pack.get_materials().size()),
+      std::vector<DescriptorPoolSizeRatio>{
+        DescriptorPoolSizeRatio{ vk::DescriptorType::eUniformBuffer, 3.0f },
+        DescriptorPoolSizeRatio{ vk::DescriptorType::eStorageBuffer, 1.0f },
+        DescriptorPoolSizeRatio{ vk::DescriptorType::eCombinedImageSampler,
+                                 5.0f } }
+    ) }
+  , material_buffer{ device.create_buffer(
+      sizeof(GpuPbrMaterialData) * pack.get_materials().size(),
+      vk::BufferUsageFlagBits::eUniformBuffer,
+      VMA_MEMORY_USAGE_CPU_TO_GPU,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    ) }
+{
+    // Load samplers
+    for (const PackSampler &sampler : pack.get_samplers()) {
+        auto vk_sampler_ci = vk::SamplerCreateInfo{}
+                               .setMaxLod(vk::LodClampNone)
+                               .setMinLod(0.0f)
+                               .setMagFilter(sampler.mag_filter)
+                               .setMinFilter(sampler.min_filter)
+                               .setMipmapMode(sampler.mipmap_mode);
+        samplers.emplace_back(device.get().createSamplerUnique(vk_sampler_ci));
+    }
+
+    // Load textures
+    // Every mip level was built by kovra-cook, so nothing is generated here
+    for (const PackTexture &texture : pack.get_textures()) {
+        if (is_block_compressed(texture.format) &&
+            !device.supports_bc_textures()) {
+            spdlog::error("Device does not support BCn textures");
+            textures.push_back(resources.get_texture_owned("checkerboard"));
+            continue;
+        }
+        textures.push_back(device.create_compressed_image(
+          pack.get_texture_data(texture).data(),
+          texture.width,
+          texture.height,
+          texture.level_count,
+          resources.get_sampler(vk::Filter::eLinear),
+          texture.format
+        ));
+    }
+
+    // Load materials
+    // The material table is laid out like the material buffer
+    const auto material_data = pack.get_material_data();
+    material_buffer->write(material_data.data(), material_data.size_bytes());
+    const auto get_texture = [&](const PackTextureRef &ref) {
+        return ref.texture >= 0 ? textures[ref.texture]
+                                : resources.get_texture_owned("white");
+    };
+    const auto get_sampler = [&](const PackTextureRef &ref) {
+        return ref.sampler >= 0 ? samplers[ref.sampler].get()
+                                : resources.get_sampler(vk::Filter::eLinear);
+    };
+    const auto pack_materials = pack.get_materials();
+    for (size_t i = 0; i < pack_materials.size(); i++) {
+        const PackMaterial &mat = pack_materials[i];
+        const auto albedo_texture = get_texture(mat.albedo);
+        const auto metal_rough_texture = get_texture(mat.metal_rough);
+        const auto ambient_occlusion_texture =
+          get_texture(mat.ambient_occlusion);
+        const auto emissive_texture = get_texture(mat.emissive);
+        const vk::Sampler albedo_sampler = get_sampler(mat.albedo);
+        const vk::Sampler metal_rough_sampler = get_sampler(mat.metal_rough);
+        const vk::Sampler ambient_occlusion_sampler =
+          get_sampler(mat.ambient_occlusion);
+        const vk::Sampler emissive_sampler = get_sampler(mat.emissive);
+
+        auto mat_inst_ci = PbrMaterialInstanceCreateInfo{
+            .albedo_texture = *albedo_texture,
+            .albedo_sampler = albedo_sampler,
+            .metal_rough_texture = *metal_rough_texture,
+            .metal_rough_sampler = metal_rough_sampler,
+            .ambient_occlusion_texture = *ambient_occlusion_texture,
+            .ambient_occlusion_sampler = ambient_occlusion_sampler,
+            .emissive_texture = *emissive_texture,
+            .emissive_sampler = emissive_sampler,
+
+            .material_buffer = material_buffer->get(),
+            .material_buffer_offset =
+              static_cast<uint32_t>(i * sizeof(GpuPbrMaterialData)),
+            .pass = mat.pass == PackMaterialPass::Transparent
+                      ? MaterialPass::Transparent
+                      : MaterialPass::Opaque,
+            .features = { .metal_rough_texture = mat.metal_rough.texture >= 0,
+                          .ambient_occlusion_texture =
+                            mat.ambient_occlusion.texture >= 0,
+                          .emissive_texture = mat.emissive.texture >= 0,
+                          .alpha_mask = mat.alpha_mask != 0 },
+
+            .bindless_registry = resources.get_bindless_registry(),
+            .material_data = &material_data[i],
+        };
+        auto material_instance = std::make_shared<MaterialInstance>(
+          resources.get_pbr_material().create_material_instance(
+            mat_inst_ci, device, *desc_alloc
+          )
+        );
+        material_instances.push_back(material_instance);
+    }
+
+    // Load meshes
+    // Vertices and indices go from the mapped file to staging memory
+    for (const PackMesh &mesh : pack.get_meshes()) {
+        auto mesh_asset = std::make_shared<MeshAsset>();
+        mesh_asset->name = pack.get_name(mesh);
+        for (const PackSurface &surface : pack.get_surfaces(mesh)) {
+            mesh_asset->surfaces.emplace_back(GeometrySurface{
+              .start_index = surface.start_index,
+              .count = surface.count,
+              .bounds = Bounds{ .origin = surface.origin,
+                                .sphere_radius = surface.sphere_radius,
+                                .extents = surface.extents },
+              .material_instance = material_instances[surface.material],
+            });
+        }
+        mesh_asset->mesh = std::make_unique<Mesh>(
+          pack.get_vertices(mesh), pack.get_indices(mesh), device
+        );
+        // Copied from the mapped pack to staging memory with nothing in
+        // between
+        load_stats.bytes_staged +=
+          sizeof(GpuVertexData) * mesh.vertex_count +
+          sizeof(uint32_t) * mesh.index_count;
+        mesh_assets.push_back(mesh_asset);
+    }
+
+    // Load scene nodes
+    const auto pack_nodes = pack.get_nodes();
+    for (const PackNode &node : pack_nodes) {
+        std::shared_ptr<SceneNode> scene_node = nullptr;
+        if (node.mesh >= 0) {
+            scene_node = std::make_shared<MeshNode>(mesh_assets[node.mesh]);
+        } else {
+            scene_node = std::make_shared<SceneNode>();
+        }
+        scene_node->set_local_transform(node.local_transform);
+        scene_nodes.push_back(scene_node);
+    }
+    for (size_t i = 0; i < pack_nodes.size(); i++) {
+        for (const uint32_t child : pack.get_children(pack_nodes[i])) {
+            scene_nodes[i]->add_child(scene_nodes[child]);
+        }
+    }
+
+    // Find the root nodes
+    for (const auto &scene_node : scene_nodes) {
+        if (!scene_node->has_parent()) {
+            root_nodes.push_back(scene_node);
+            scene_node->refresh_world_transform(glm::identity<glm::mat4>());
+        }
+    }
+}
+
 void
 LoadedGltfScene::queue_draw(const glm::mat4 &root_transform, DrawContext &ctx)
   const
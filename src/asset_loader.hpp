@@ -1,12 +1,15 @@
 #pragma once
 
 #include "descriptor.hpp"
+#include "ktx2.hpp"
+#include "mip_generator.hpp"
 #include "render_object.hpp"
 
 #include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -18,6 +21,8 @@ namespace kovra {
 class Mesh;
 class Renderer;
 class LoadedGltfScene;
+class ScenePack;
+class DerivedDataCache;
 
 struct StbImageDeleter
 {
@@ -27,11 +32,17 @@ struct StbImageDeleter
 class AssetLoader
 {
   public:
+    // Scene packs cooked by kovra-cook (.kpack) are loaded as well
     static std::optional<std::unique_ptr<LoadedGltfScene>> load_gltf(
       std::filesystem::path filepath,
       const Device &device,
       const RenderResources &resources
     );
+    static std::optional<std::unique_ptr<LoadedGltfScene>> load_scene_pack(
+      const std::filesystem::path &filepath,
+      const Device &device,
+      const RenderResources &resources
+    );
 
     static std::optional<std::unique_ptr<unsigned char[], StbImageDeleter>>
     load_image_raw(
@@ -57,11 +68,39 @@ struct MeshAsset
     std::unique_ptr<Mesh> mesh;
 };
 
+// Time it took to decode one image of a glTF file
+struct ImageDecodeStats
+{
+    std::string name;
+    int width;
+    int height;
+    // In ms
+    float decode_time;
+};
+
+// Where the geometry of a glTF file went on its way to the GPU
+struct GltfLoadStats
+{
+    // Vertices and indices converted straight into staging memory
+    uint64_t bytes_staged;
+    // Bytes copied to intermediate CPU memory first: the file itself or its
+    // buffers if they couldn't be mapped, and accessors that needed decoding
+    uint64_t bytes_copied;
+};
+
 class LoadedGltfScene : public IRenderable
 {
   public:
     explicit LoadedGltfScene(
       fastgltf::Asset gltf,
+      const std::filesystem::path &filepath,
+      const Device &device,
+      const RenderResources &resources
+    );
+    // Nothing is parsed or converted, every section of the pack is copied to
+    // staging memory as it is
+    explicit LoadedGltfScene(
+      const ScenePack &pack,
       const Device &device,
       const RenderResources &resources
     );
@@ -70,9 +109,26 @@ class LoadedGltfScene : public IRenderable
     virtual void queue_draw(const glm::mat4 &root_transform, DrawContext &ctx)
       const override;
 
+    // One entry per image in the file, in file order
+    [[nodiscard]] std::span<const ImageDecodeStats> get_image_decode_stats(
+    ) const noexcept
+    {
+        return image_decode_stats;
+    }
+    [[nodiscard]] const GltfLoadStats &get_load_stats() const noexcept
+    {
+        return load_stats;
+    }
+
   private:
+    // Adds the copies made before the asset was parsed
+    friend class AssetLoader;
+
     constexpr static bool USE_NORMALS_AS_COLORS = false;
     constexpr static std::string_view ASSETS_DIR = "./assets";
+    // Bump whenever the mip chains built for the derived data cache change
+    constexpr static uint32_t MIP_CHAIN_VERSION = 2;
+    constexpr static vk::Format MIP_CHAIN_FORMAT = vk::Format::eR8G8B8A8Unorm;
 
     // Storage for all the data on a given GLTF file
     std::vector<std::shared_ptr<MeshAsset>> mesh_assets;
@@ -89,11 +145,40 @@ class LoadedGltfScene : public IRenderable
     // Stores GpuPbrMaterialData
     std::unique_ptr<GpuBuffer> material_buffer;
 
-    static std::optional<std::unique_ptr<GpuImage>> load_image(
+    std::vector<ImageDecodeStats> image_decode_stats;
+    GltfLoadStats load_stats = {};
+
+    struct DecodedImage
+    {
+        // Null for KTX2 images
+        std::unique_ptr<unsigned char[], StbImageDeleter> pixels;
+        int width;
+        int height;
+        // Complete mip chain, either block-compressed or from the derived
+        // data cache, used instead of the pixels
+        std::optional<Ktx2Image> ktx2;
+    };
+    // Only touches the CPU, so it is safe to call from any thread
+    // Loads the compressed version of the image instead if it is given
+    // With a cache, the decoded image and its mip chain are looked up there
+    // first and stored there otherwise, the chain is filtered like the
+    // compute MipGenerator would with mip_info
+    static std::optional<DecodedImage> decode_image(
       const fastgltf::Asset &asset,
       const fastgltf::Image &image,
-      const Device &device,
-      const RenderResources &resources
+      const std::optional<std::filesystem::path> &compressed_filepath,
+      DerivedDataCache *cache,
+      const MipGenerationInfo &mip_info
+    );
+    // Decode every image of the asset on a pool of worker threads
+    // Set load_compressed if the device can sample BCn textures
+    static std::vector<std::optional<DecodedImage>> decode_images(
+      const fastgltf::Asset &asset,
+      const std::filesystem::path &filepath,
+      bool load_compressed,
+      DerivedDataCache *cache,
+      std::span<const MipGenerationInfo> mip_infos,
+      std::vector<ImageDecodeStats> &stats
     );
 };
 }
@@ -0,0 +1,154 @@
+#include "bindless.hpp"
+#include "buffer.hpp"
+#include "descriptor.hpp"
+#include "device.hpp"
+#include "image.hpp"
+
+#include "spdlog/spdlog.h"
+
+namespace kovra {
+BindlessRegistry::BindlessRegistry(const Device &device)
+  : device{ device.get() }
+  , material_buffer{ device.create_buffer(
+      sizeof(GpuBindlessMaterial) * MAX_BINDLESS_MATERIALS,
+      vk::BufferUsageFlagBits::eStorageBuffer,
+      VMA_MEMORY_USAGE_CPU_TO_GPU,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    ) }
+{
+    spdlog::debug("BindlessRegistry::BindlessRegistry()");
+
+    const auto stages =
+      vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+    const auto bindings = std::array{
+        // Textures
+        vk::DescriptorSetLayoutBinding{}
+          .setBinding(0)
+          .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+          .setDescriptorCount(MAX_BINDLESS_TEXTURES)
+          .setStageFlags(stages),
+        // Materials
+        vk::DescriptorSetLayoutBinding{}
+          .setBinding(1)
+          .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+          .setDescriptorCount(1)
+          .setStageFlags(stages),
+    };
+    // Textures get registered while frames that use the set are in flight,
+    // and most of the array is never written
+    const auto binding_flags = std::array<vk::DescriptorBindingFlags, 2>{
+        vk::DescriptorBindingFlagBits::ePartiallyBound |
+          vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+        {},
+    };
+    auto binding_flags_ci =
+      vk::DescriptorSetLayoutBindingFlagsCreateInfo{}.setBindingFlags(
+        binding_flags
+      );
+    desc_set_layout = this->device.createDescriptorSetLayoutUnique(
+      vk::DescriptorSetLayoutCreateInfo{}
+        .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+        .setBindings(bindings)
+        .setPNext(&binding_flags_ci)
+    );
+
+    const auto pool_sizes = std::array{
+        vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler,
+                                MAX_BINDLESS_TEXTURES },
+        vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, 1 },
+    };
+    desc_pool = this->device.createDescriptorPoolUnique(
+      vk::DescriptorPoolCreateInfo{}
+        .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+        .setMaxSets(1)
+        .setPoolSizes(pool_sizes)
+    );
+    desc_set = this->device
+                 .allocateDescriptorSets(
+                   vk::DescriptorSetAllocateInfo{}
+                     .setDescriptorPool(desc_pool.get())
+                     .setSetLayouts(desc_set_layout.get())
+                 )
+                 .front();
+
+    // The material buffer never changes, only its contents do
+    DescriptorWriter writer{};
+    writer.write_buffer(
+      1,
+      material_buffer->get(),
+      material_buffer->get_size(),
+      0,
+      vk::DescriptorType::eStorageBuffer
+    );
+    writer.update_set(this->device, desc_set);
+}
+
+BindlessRegistry::~BindlessRegistry()
+{
+    spdlog::debug("BindlessRegistry::~BindlessRegistry()");
+    material_buffer.reset();
+    desc_pool.reset();
+    desc_set_layout.reset();
+}
+
+uint32_t
+BindlessRegistry::register_texture(
+  const GpuImage &texture,
+  vk::Sampler sampler
+)
+{
+    std::lock_guard lock{ mutex };
+    const auto key = std::pair{ static_cast<VkImageView>(texture.get_view()),
+                                static_cast<VkSampler>(sampler) };
+    if (const auto it = texture_indices.find(key);
+        it != texture_indices.end()) {
+        return it->second;
+    }
+
+    const auto index = static_cast<uint32_t>(texture_indices.size());
+    if (index >= MAX_BINDLESS_TEXTURES) {
+        spdlog::error(
+          "Too many bindless textures (max {})", MAX_BINDLESS_TEXTURES
+        );
+        throw std::runtime_error("Too many bindless textures");
+    }
+
+    const auto image_info =
+      vk::DescriptorImageInfo{}
+        .setImageView(texture.get_view())
+        .setSampler(sampler)
+        .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    device.updateDescriptorSets(
+      vk::WriteDescriptorSet{}
+        .setDstSet(desc_set)
+        .setDstBinding(0)
+        .setDstArrayElement(index)
+        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+        .setImageInfo(image_info),
+      {}
+    );
+
+    texture_indices.emplace(key, index);
+    return index;
+}
+
+uint32_t
+BindlessRegistry::register_material(const GpuBindlessMaterial &material)
+{
+    std::lock_guard lock{ mutex };
+    if (material_count >= MAX_BINDLESS_MATERIALS) {
+        spdlog::error(
+          "Too many bindless materials (max {})", MAX_BINDLESS_MATERIALS
+        );
+        throw std::runtime_error("Too many bindless materials");
+    }
+
+    const uint32_t index = material_count++;
+    material_buffer->write(
+      &material,
+      sizeof(GpuBindlessMaterial),
+      index * sizeof(GpuBindlessMaterial)
+    );
+    return index;
+}
+} // namespace kovra
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "gpu_data.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class Device;
+class GpuBuffer;
+class GpuImage;
+
+// Must match the constants in shaders/bindless.glsl
+static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+static constexpr uint32_t MAX_BINDLESS_MATERIALS = 4096;
+// Texture index of material features that are off, which are never sampled
+static constexpr uint32_t BINDLESS_TEXTURE_NONE = UINT32_MAX;
+
+// Global descriptor set that holds every texture and material, so shaders can
+// look them up by index instead of having a descriptor set bound per material
+// Requires descriptor indexing (see Device::supports_bindless)
+class BindlessRegistry
+{
+  public:
+    explicit BindlessRegistry(const Device &device);
+    ~BindlessRegistry();
+    BindlessRegistry() = delete;
+    BindlessRegistry(const BindlessRegistry &) = delete;
+    BindlessRegistry &operator=(const BindlessRegistry &) = delete;
+    BindlessRegistry(BindlessRegistry &&) = delete;
+    BindlessRegistry &operator=(BindlessRegistry &&) = delete;
+
+    // Returns the index of the texture in the bindless texture array
+    // Registering the same texture and sampler twice returns the same index
+    // Both register functions are safe to call from scenes loading on worker
+    // threads
+    [[nodiscard]] uint32_t
+    register_texture(const GpuImage &texture, vk::Sampler sampler);
+    // Returns the index of the material in the bindless material buffer
+    [[nodiscard]] uint32_t register_material(const GpuBindlessMaterial &material
+    );
+
+    [[nodiscard]] vk::DescriptorSetLayout get_desc_set_layout() const noexcept
+    {
+        return desc_set_layout.get();
+    }
+    [[nodiscard]] vk::DescriptorSet get_desc_set() const noexcept
+    {
+        return desc_set;
+    }
+
+  private:
+    vk::Device device;
+    vk::UniqueDescriptorSetLayout desc_set_layout;
+    vk::UniqueDescriptorPool desc_pool;
+    vk::DescriptorSet desc_set;
+    std::unique_ptr<GpuBuffer> material_buffer;
+
+    std::map<std::pair<VkImageView, VkSampler>, uint32_t> texture_indices;
+    uint32_t material_count = 0;
+    std::mutex mutex;
+};
+} // namespace kovra
@@ -8,7 +8,8 @@ GpuBuffer::GpuBuffer(
   vk::DeviceSize size,
   vk::BufferUsageFlags buffer_usage,
   VmaMemoryUsage alloc_usage,
-  VmaAllocationCreateFlags alloc_flags
+  VmaAllocationCreateFlags alloc_flags,
+  const std::vector<uint32_t> &queue_families
 )
 {
     if (size == 0) {
@@ -17,12 +18,19 @@ GpuBuffer::GpuBuffer(
     }
 
     buffer_size = size;
+    usage = buffer_usage;
 
     VkBufferCreateInfo buffer_info{};
     buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_info.size = size;
     buffer_info.usage = static_cast<VkBufferUsageFlags>(buffer_usage);
     buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (queue_families.size() > 1) {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount =
+          static_cast<uint32_t>(queue_families.size());
+        buffer_info.pQueueFamilyIndices = queue_families.data();
+    }
 
     VmaAllocationCreateInfo alloc_info{};
     alloc_info.usage = alloc_usage;
@@ -95,4 +103,21 @@ GpuBuffer::write(const void *data, size_t size, size_t offset)
     vmaUnmapMemory(*allocator, allocation);
 }
 
+void
+GpuBuffer::read(void *data, size_t size, size_t offset)
+{
+    // Make GPU writes visible to the host if the memory is not coherent
+    vmaInvalidateAllocation(*allocator, allocation, offset, size);
+
+    if (allocation_info.pMappedData != nullptr) {
+        std::memcpy(data, (char *)allocation_info.pMappedData + offset, size);
+        return;
+    }
+
+    void *mapped_data;
+    vmaMapMemory(*allocator, allocation, &mapped_data);
+    std::memcpy(data, (char *)mapped_data + offset, size);
+    vmaUnmapMemory(*allocator, allocation);
+}
+
 } // namespace kovra
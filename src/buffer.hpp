@@ -2,6 +2,7 @@
 
 #include "vk_mem_alloc.h"
 #include <memory>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
@@ -13,15 +14,26 @@ class GpuBuffer
       vk::DeviceSize size,
       vk::BufferUsageFlags buffer_usage,
       VmaMemoryUsage alloc_usage,
-      VmaAllocationCreateFlags alloc_flags
+      VmaAllocationCreateFlags alloc_flags,
+      // Queue families that access the buffer without ownership transfers
+      // (concurrent sharing), exclusive to one family if fewer than two
+      const std::vector<uint32_t> &queue_families = {}
     );
     ~GpuBuffer();
     GpuBuffer(const GpuBuffer &) = delete;
 
     void write(const void *data, size_t size, size_t offset = 0);
+    // Only valid for host-visible buffers (e.g. VMA_MEMORY_USAGE_GPU_TO_CPU)
+    void read(void *data, size_t size, size_t offset = 0);
 
+    // Null unless the buffer was created with VMA_ALLOCATION_CREATE_MAPPED_BIT
+    [[nodiscard]] void *get_mapped_data() const
+    {
+        return allocation_info.pMappedData;
+    }
     [[nodiscard]] vk::Buffer get() const { return buffer; }
     [[nodiscard]] vk::DeviceSize get_size() const { return buffer_size; }
+    [[nodiscard]] vk::BufferUsageFlags get_usage() const { return usage; }
 
   private:
     std::shared_ptr<VmaAllocator> allocator;
@@ -29,5 +41,6 @@ class GpuBuffer
     VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
     uint32_t buffer_size;
+    vk::BufferUsageFlags usage;
 };
 } // namespace kovra
@@ -82,10 +82,14 @@ Camera::mouse_rotate(
 }
 
 [[nodiscard]] glm::mat4x4
-Camera::get_viewproj_mat(glm::f32 viewport_width, glm::f32 viewport_height)
-  const noexcept
+Camera::get_viewproj_mat(
+  glm::f32 viewport_width,
+  glm::f32 viewport_height,
+  glm::vec2 jitter
+) const noexcept
 {
-    return get_proj_mat(viewport_width, viewport_height) * get_view_mat();
+    return get_proj_mat(viewport_width, viewport_height, jitter) *
+           get_view_mat();
 }
 
 [[nodiscard]] glm::mat4x4
@@ -95,14 +99,47 @@ Camera::get_view_mat() const noexcept
 }
 
 [[nodiscard]] glm::mat4x4
-Camera::get_proj_mat(glm::f32 viewport_width, glm::f32 viewport_height)
-  const noexcept
+Camera::get_proj_mat(
+  glm::f32 viewport_width,
+  glm::f32 viewport_height,
+  glm::vec2 jitter
+) const noexcept
 {
     auto proj = glm::perspectiveRH(
       glm::radians(fov_y_deg), viewport_width / viewport_height, near, far
     );
     proj[1][1] *= -1.0f; // Flip the Y axis
-    return proj;
+    // Translate in NDC, after the perspective divide
+    return glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * proj;
+}
+
+// Radical inverse of index in the given base, in [0, 1)
+static glm::f32
+halton(uint32_t index, uint32_t base) noexcept
+{
+    glm::f32 result = 0.0f;
+    glm::f32 fraction = 1.0f;
+    while (index > 0) {
+        fraction /= static_cast<glm::f32>(base);
+        result += fraction * static_cast<glm::f32>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+[[nodiscard]] glm::vec2
+Camera::get_jitter(
+  uint32_t frame_number,
+  uint32_t phase_count,
+  glm::f32 viewport_width,
+  glm::f32 viewport_height
+) noexcept
+{
+    // Skip index 0, which is the pixel corner
+    const uint32_t index = frame_number % phase_count + 1;
+    const auto offset = glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+    // A pixel is 2 / viewport size wide in NDC
+    return offset * 2.0f / glm::vec2(viewport_width, viewport_height);
 }
 
 } // namespace kovra
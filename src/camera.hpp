@@ -20,18 +20,32 @@ class Camera
       glm::f32 viewport_height
     ) noexcept;
 
+    // jitter offsets the projection by a fraction of a pixel, in NDC
     [[nodiscard]] glm::mat4x4 get_viewproj_mat(
       glm::f32 viewport_width,
-      glm::f32 viewport_height
+      glm::f32 viewport_height,
+      glm::vec2 jitter = glm::vec2(0.0f)
     ) const noexcept;
     [[nodiscard]] glm::mat4x4 get_view_mat() const noexcept;
     [[nodiscard]] glm::mat4x4 get_proj_mat(
       glm::f32 viewport_width,
-      glm::f32 viewport_height
+      glm::f32 viewport_height,
+      glm::vec2 jitter = glm::vec2(0.0f)
     ) const noexcept;
+    // Sub-pixel jitter of the given frame in NDC, from a Halton(2, 3)
+    // sequence that repeats every phase_count frames
+    // Jittering every frame by a different offset lets temporal
+    // anti-aliasing accumulate samples across the pixel.
+    [[nodiscard]] static glm::vec2 get_jitter(
+      uint32_t frame_number,
+      uint32_t phase_count,
+      glm::f32 viewport_width,
+      glm::f32 viewport_height
+    ) noexcept;
     [[nodiscard]] glm::vec3 get_position() const noexcept { return position; }
     [[nodiscard]] glm::f32 get_near() const noexcept { return near; }
     [[nodiscard]] glm::f32 get_far() const noexcept { return far; }
+    [[nodiscard]] glm::f32 get_fov_y_deg() const noexcept { return fov_y_deg; }
 
   private:
     glm::vec3 position;
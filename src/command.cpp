@@ -1,4 +1,5 @@
 #include "command.hpp"
+#include "buffer.hpp"
 #include "device.hpp"
 #include "image.hpp"
 #include "utils.hpp"
@@ -7,9 +8,17 @@
 
 namespace kovra {
 CommandEncoder::CommandEncoder(const Device &device)
+  : CommandEncoder{ device, device.get_command_pool() }
+{
+}
+
+CommandEncoder::CommandEncoder(
+  const Device &device,
+  vk::CommandPool command_pool
+)
   : cmd_buffers{ device.get().allocateCommandBuffersUnique(
       vk::CommandBufferAllocateInfo{}
-        .setCommandPool(device.get_command_pool())
+        .setCommandPool(command_pool)
         .setLevel(vk::CommandBufferLevel::ePrimary)
         .setCommandBufferCount(CMD_BUFFER_COUNT)
     ) }
@@ -32,6 +41,7 @@ ComputePass
 CommandEncoder::begin_compute_pass()
 {
     begin_recording();
+    flush_barriers();
     return ComputePass{ cmd_buffers.at(cmd_index).get() };
 }
 
@@ -39,6 +49,7 @@ RenderPass
 CommandEncoder::begin_render_pass(const RenderPassCreateInfo &info)
 {
     begin_recording();
+    flush_barriers();
     return RenderPass{ info, cmd_buffers.at(cmd_index).get() };
 }
 
@@ -51,6 +62,9 @@ CommandEncoder::begin()
 vk::CommandBuffer
 CommandEncoder::finish()
 {
+    if (is_recording) {
+        flush_barriers();
+    }
     auto cmd = end_recording();
     if (!cmd.has_value()) {
         throw std::runtime_error(
@@ -76,6 +90,9 @@ CommandEncoder::begin_recording()
       vk::CommandBufferUsageFlagBits::eOneTimeSubmit
     ));
     is_recording = true;
+    // Nothing is known about the state of the resources in a new command
+    // buffer
+    resource_states.reset();
     return cmd;
 }
 
@@ -92,6 +109,54 @@ CommandEncoder::end_recording()
     return cmd;
 }
 
+void
+CommandEncoder::require(const GpuImage &image, ResourceUsage usage)
+{
+    begin_recording();
+    resource_states.require(image, usage);
+}
+
+void
+CommandEncoder::require(
+  vk::Image image,
+  vk::ImageAspectFlags aspect,
+  ResourceUsage usage,
+  uint32_t layer_count,
+  uint32_t level_count
+)
+{
+    begin_recording();
+    resource_states.require(image, aspect, usage, layer_count, level_count);
+}
+
+void
+CommandEncoder::require(const GpuBuffer &buffer, ResourceUsage usage)
+{
+    begin_recording();
+    resource_states.require(buffer, usage);
+}
+
+void
+CommandEncoder::set_image_usage(vk::Image image, ResourceUsage usage)
+{
+    begin_recording();
+    resource_states.set_image_usage(image, usage);
+}
+
+void
+CommandEncoder::set_buffer_usage(const GpuBuffer &buffer, ResourceUsage usage)
+{
+    begin_recording();
+    resource_states.set_buffer_usage(buffer, usage);
+}
+
+void
+CommandEncoder::flush_barriers()
+{
+    begin_recording();
+    resource_states.flush(get_current_cmd());
+}
+
 void
 CommandEncoder::transition_image_layout(
   const vk::Image &image,
@@ -123,6 +188,50 @@ CommandEncoder::transition_image_layout(
     image.transition_layout(get_current_cmd(), old_layout, new_layout);
 }
 
+void
+CommandEncoder::buffer_barrier(
+  const vk::Buffer &buffer,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access,
+  uint32_t src_queue_family,
+  uint32_t dst_queue_family
+) const
+{
+    utils::buffer_barrier(
+      get_current_cmd(),
+      buffer,
+      src_stage,
+      src_access,
+      dst_stage,
+      dst_access,
+      src_queue_family,
+      dst_queue_family
+    );
+}
+
+void
+CommandEncoder::reset_query_pool(
+  const vk::QueryPool &query_pool,
+  uint32_t first_query,
+  uint32_t query_count
+) const
+{
+    get_current_cmd().resetQueryPool(query_pool, first_query, query_count);
+}
+
+void
+CommandEncoder::write_timestamp(
+  const vk::QueryPool &query_pool,
+  uint32_t query,
+  vk::PipelineStageFlags2 stage
+)
+{
+    flush_barriers();
+    get_current_cmd().writeTimestamp2(stage, query_pool, query);
+}
+
 void
 CommandEncoder::resolve_image(
   const vk::Image &src,
@@ -130,8 +239,9 @@ CommandEncoder::resolve_image(
   const vk::Image &dst,
   const vk::ImageLayout &dst_layout,
   const vk::ImageResolve &region
-) const
+)
 {
+    flush_barriers();
     get_current_cmd().resolveImage(src, src_layout, dst, dst_layout, region);
 }
 
@@ -144,8 +254,9 @@ CommandEncoder::copy_image_to_image(
   vk::ImageAspectFlagBits src_aspect,
   vk::ImageAspectFlagBits dst_aspect,
   vk::Filter filter
-) const
+)
 {
+    flush_barriers();
     utils::copy_image_to_image(
       get_current_cmd(),
       src,
@@ -162,8 +273,9 @@ CommandEncoder::clear_color_image(
   const vk::Image &image,
   const vk::ImageLayout &layout,
   const vk::ClearColorValue &color
-) const
+)
 {
+    flush_barriers();
     get_current_cmd().clearColorImage(
       image,
       layout,
@@ -176,8 +288,9 @@ void
 CommandEncoder::clear_depth_image(
   const vk::Image &image,
   const vk::ImageLayout &layout
-) const
+)
 {
+    flush_barriers();
     get_current_cmd().clearDepthStencilImage(
       image,
       layout,
@@ -2,16 +2,21 @@
 
 #include "compute_pass.hpp"
 #include "render_pass.hpp"
+#include "resource_state.hpp"
 
 namespace kovra {
 // Forward declarations
 class Device;
+class GpuBuffer;
 class GpuImage;
 
 class CommandEncoder
 {
   public:
+    // Command buffers come from the graphics command pool unless another
+    // pool is given (e.g. Device::get_compute_command_pool())
     CommandEncoder(const Device &device);
+    CommandEncoder(const Device &device, vk::CommandPool command_pool);
     ~CommandEncoder();
     CommandEncoder() = delete;
     CommandEncoder(const CommandEncoder &) = delete;
@@ -29,6 +34,31 @@ class CommandEncoder
     // End recording commands
     [[nodiscard]] vk::CommandBuffer finish();
 
+    // Declare what the next commands do with a resource, and begin recording
+    // commands if not already recording
+    // The barriers it needs are batched and recorded right before the next
+    // pass or command, see ResourceStateTracker
+    void require(const GpuImage &image, ResourceUsage usage);
+    void require(
+      vk::Image image,
+      vk::ImageAspectFlags aspect,
+      ResourceUsage usage,
+      uint32_t layer_count = 1,
+      uint32_t level_count = 1
+    );
+    void require(const GpuBuffer &buffer, ResourceUsage usage);
+    // Declare the usage an earlier submission or an explicit barrier left a
+    // resource in
+    void set_image_usage(vk::Image image, ResourceUsage usage);
+    void set_buffer_usage(const GpuBuffer &buffer, ResourceUsage usage);
+    // Record the barriers of the resources required so far
+    void flush_barriers();
+    // Barriers recorded by the current or the last command buffer
+    [[nodiscard]] ResourceStateStats get_barrier_stats() const noexcept
+    {
+        return resource_states.get_stats();
+    }
+
     void transition_image_layout(
       const vk::Image &image,
       vk::ImageAspectFlagBits aspect,
@@ -42,13 +72,32 @@ class CommandEncoder
       vk::ImageLayout old_layout,
       vk::ImageLayout new_layout
     ) const;
+    void buffer_barrier(
+      const vk::Buffer &buffer,
+      vk::PipelineStageFlags2 src_stage,
+      vk::AccessFlags2 src_access,
+      vk::PipelineStageFlags2 dst_stage,
+      vk::AccessFlags2 dst_access,
+      uint32_t src_queue_family = vk::QueueFamilyIgnored,
+      uint32_t dst_queue_family = vk::QueueFamilyIgnored
+    ) const;
+    void reset_query_pool(
+      const vk::QueryPool &query_pool,
+      uint32_t first_query,
+      uint32_t query_count
+    ) const;
+    void write_timestamp(
+      const vk::QueryPool &query_pool,
+      uint32_t query,
+      vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eAllCommands
+    );
     void resolve_image(
       const vk::Image &src,
       const vk::ImageLayout &src_layout,
       const vk::Image &dst,
       const vk::ImageLayout &dst_layout,
       const vk::ImageResolve &region
-    ) const;
+    );
     void copy_image_to_image(
       vk::Image src,
       vk::Image dst,
@@ -57,19 +106,19 @@ class CommandEncoder
       vk::ImageAspectFlagBits src_aspect = vk::ImageAspectFlagBits::eColor,
       vk::ImageAspectFlagBits dst_aspect = vk::ImageAspectFlagBits::eColor,
       vk::Filter filter = vk::Filter::eLinear
-    ) const;
+    );
     void clear_color_image(
       const vk::Image &image,
       const vk::ImageLayout &layout,
       const vk::ClearColorValue &color =
         vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 0.0f }
-    ) const;
+    );
     // Clear depth image to 1.0f
     // NOTE: layout can only be either eGeneral or eTransferDstOptimal
     void clear_depth_image(
       const vk::Image &image,
       const vk::ImageLayout &layout
-    ) const;
+    );
 
   private:
     static constexpr const uint32_t CMD_BUFFER_COUNT = 1;
@@ -77,6 +126,7 @@ class CommandEncoder
     std::vector<vk::UniqueCommandBuffer> cmd_buffers;
     uint32_t cmd_index;
     bool is_recording;
+    ResourceStateTracker resource_states;
 
     std::optional<vk::CommandBuffer> begin_recording();
     std::optional<vk::CommandBuffer> end_recording();
@@ -10,7 +10,7 @@ pick_physical_device(
   const Surface &surface
 );
 
-Context::Context(SDL_Window *window, bool enable_multisampling)
+Context::Context(SDL_Window *window)
   : instance{ std::make_unique<Instance>(window) }
   , surface{ std::make_unique<Surface>(*instance, window) }
   , physical_device{ pick_physical_device(
@@ -68,6 +68,8 @@ pick_physical_device(
         scores[i] += features.dynamic_rendering ? 1 : 0;
         scores[i] += features.synchronization2 ? 1 : 0;
         scores[i] += features.buffer_device_address ? 1 : 0;
+        scores[i] += features.timeline_semaphore ? 1 : 0;
+        scores[i] += features.texture_compression_bc ? 1 : 0;
         scores[i] += features.runtime_descriptor_array ? 1 : 0;
         scores[i] += features.ray_tracing_pipeline ? 1 : 0;
         scores[i] += features.acceleration_structure ? 1 : 0;
@@ -7,7 +7,7 @@ namespace kovra {
 class Context
 {
   public:
-    explicit Context(SDL_Window *window, bool enable_multisampling);
+    explicit Context(SDL_Window *window);
     ~Context();
     Context() = delete;
     Context(const Context &) = delete;
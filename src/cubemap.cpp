@@ -1,6 +1,9 @@
 #include "cubemap.hpp"
 #include "device.hpp"
 #include "image.hpp"
+#include "utils.hpp"
+
+#include <cstring>
 
 namespace kovra {
 
@@ -11,31 +14,16 @@ Cubemap::Cubemap(CubemapCreateInfo &&ci, const Device &device)
     const vk::DeviceSize single_image_size = ci.width * ci.height * 4;
     const vk::DeviceSize cubemap_image_size = single_image_size * 6;
 
-    // Write image data to a staging buffer
-    auto staging_buffer = device.create_buffer(
-      cubemap_image_size,
-      vk::BufferUsageFlagBits::eTransferSrc,
-      VMA_MEMORY_USAGE_CPU_TO_GPU,
-      VMA_ALLOCATION_CREATE_MAPPED_BIT
-    );
-    staging_buffer->write(
-      ci.front.get(), single_image_size, single_image_size * 0
-    );
-    staging_buffer->write(
-      ci.back.get(), single_image_size, single_image_size * 1
-    );
-    staging_buffer->write(
-      ci.up.get(), single_image_size, single_image_size * 2
-    );
-    staging_buffer->write(
-      ci.down.get(), single_image_size, single_image_size * 3
-    );
-    staging_buffer->write(
-      ci.left.get(), single_image_size, single_image_size * 4
-    );
-    staging_buffer->write(
-      ci.right.get(), single_image_size, single_image_size * 5
-    );
+    // The faces are uploaded as consecutive array layers
+    std::vector<unsigned char> pixels(cubemap_image_size);
+    const auto faces = std::array{ ci.front.get(), ci.back.get(),
+                                   ci.up.get(),    ci.down.get(),
+                                   ci.left.get(),  ci.right.get() };
+    for (size_t i = 0; i < faces.size(); i++) {
+        std::memcpy(
+          pixels.data() + single_image_size * i, faces[i], single_image_size
+        );
+    }
 
     // Create the cubemap image
     auto img_ci = GpuImageCreateInfo{
@@ -51,6 +39,17 @@ Cubemap::Cubemap(CubemapCreateInfo &&ci, const Device &device)
         .flags = vk::ImageCreateFlagBits::eCubeCompatible,
     };
     cubemap = device.create_image(img_ci);
-    cubemap->upload(staging_buffer->get(), device, false);
+    upload_token = cubemap->upload(pixels.data(), device, false);
+
+    content_hash = utils::hash_bytes(utils::cast_to_bytes(ci.width));
+    content_hash =
+      utils::hash_bytes(utils::cast_to_bytes(ci.height), content_hash);
+    for (const auto *face : faces) {
+        content_hash = utils::hash_bytes(
+          std::span{ reinterpret_cast<const std::byte *>(face),
+                     single_image_size },
+          content_hash
+        );
+    }
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "asset_loader.hpp"
+#include "upload_queue.hpp"
 
 namespace kovra {
 // Forward declarations
@@ -37,8 +38,20 @@ class Cubemap
         return *cubemap;
     }
     [[nodiscard]] GpuImage &get_image_mut() noexcept { return *cubemap; }
+    // Complete once the faces can be sampled by the graphics queue
+    [[nodiscard]] UploadToken get_upload_token() const noexcept
+    {
+        return upload_token;
+    }
+    // Hash of the pixels of all six faces, used to key derived data caches
+    [[nodiscard]] uint64_t get_content_hash() const noexcept
+    {
+        return content_hash;
+    }
 
   private:
     std::unique_ptr<GpuImage> cubemap;
+    uint64_t content_hash = 0;
+    UploadToken upload_token = 0;
 };
 }
@@ -0,0 +1,211 @@
+#include "derived_data_cache.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <format>
+#include <utility>
+
+namespace kovra {
+DerivedDataCache::DerivedDataCache(
+  std::filesystem::path directory,
+  uint64_t max_size
+)
+  : directory{ std::move(directory) }
+  , max_size{ max_size }
+{
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        spdlog::warn(
+          "Derived data cache disabled, failed to create {}: {}",
+          this->directory.string(),
+          error.message()
+        );
+        return;
+    }
+    enabled = true;
+
+    // Rebuild the index, oldest entries first so they get evicted first
+    struct FoundEntry
+    {
+        std::string name;
+        std::filesystem::file_time_type last_write_time;
+        uint64_t size;
+    };
+    std::vector<FoundEntry> found;
+    for (const auto &dir_entry :
+         std::filesystem::directory_iterator{ this->directory, error }) {
+        if (!dir_entry.is_regular_file(error) ||
+            dir_entry.path().extension() != ENTRY_EXTENSION) {
+            continue;
+        }
+        found.emplace_back(FoundEntry{
+          .name = dir_entry.path().stem().string(),
+          .last_write_time = dir_entry.last_write_time(error),
+          .size = dir_entry.file_size(error),
+        });
+    }
+    std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) {
+        return a.last_write_time < b.last_write_time;
+    });
+    for (const auto &found_entry : found) {
+        entries.emplace(
+          found_entry.name,
+          Entry{ .size = found_entry.size, .last_use = use_counter++ }
+        );
+        stats.size += found_entry.size;
+    }
+
+    spdlog::debug(
+      "Derived data cache at {} holds {} entries ({:.2f} MB)",
+      this->directory.string(),
+      entries.size(),
+      static_cast<float>(stats.size) / (1024.0f * 1024.0f)
+    );
+    evict_locked();
+}
+
+DerivedDataKey
+DerivedDataCache::make_key(
+  std::string_view processor,
+  uint32_t processor_version,
+  std::span<const std::byte> source,
+  std::span<const std::byte> params
+)
+{
+    // The source is hashed on its own so entries of the same source can be
+    // told apart by eye, everything else goes into the second hash
+    const uint64_t source_hash = utils::hash_bytes(source);
+    uint64_t params_hash =
+      utils::hash_bytes(utils::cast_to_bytes(CACHE_VERSION));
+    params_hash = utils::hash_bytes(
+      utils::cast_to_bytes(processor_version), params_hash
+    );
+    params_hash =
+      utils::hash_bytes(utils::cast_to_bytes(source.size()), params_hash);
+    params_hash = utils::hash_bytes(params, params_hash);
+    return DerivedDataKey{
+        .name = std::format(
+          "{}-{:016x}-{:016x}", processor, source_hash, params_hash
+        ),
+    };
+}
+
+std::optional<std::vector<std::byte>>
+DerivedDataCache::get(const DerivedDataKey &key)
+{
+    if (!enabled) {
+        return std::nullopt;
+    }
+    {
+        std::lock_guard lock{ mutex };
+        if (!entries.contains(key.name)) {
+            stats.miss_count++;
+            return std::nullopt;
+        }
+    }
+
+    // Read without holding the lock, entries are only ever replaced as a
+    // whole
+    const auto entry_path = get_entry_path(key);
+    auto data = utils::read_file(entry_path);
+
+    std::lock_guard lock{ mutex };
+    if (!data.has_value()) {
+        spdlog::warn("Failed to read derived data: {}", entry_path.string());
+        remove_locked(key.name);
+        stats.miss_count++;
+        return std::nullopt;
+    }
+    if (auto it = entries.find(key.name); it != entries.end()) {
+        it->second.last_use = use_counter++;
+    }
+    // Persist the use for the next run
+    std::error_code error;
+    std::filesystem::last_write_time(
+      entry_path, std::filesystem::file_time_type::clock::now(), error
+    );
+    stats.hit_count++;
+    stats.bytes_saved += data->size();
+    return data;
+}
+
+void
+DerivedDataCache::put(
+  const DerivedDataKey &key,
+  std::span<const std::byte> data
+)
+{
+    if (!enabled || data.size() > max_size) {
+        return;
+    }
+    if (!utils::write_file_atomically(get_entry_path(key), data)) {
+        return;
+    }
+
+    std::lock_guard lock{ mutex };
+    auto &entry = entries[key.name];
+    stats.size = stats.size - entry.size + data.size();
+    entry = Entry{ .size = data.size(), .last_use = use_counter++ };
+    evict_locked();
+}
+
+void
+DerivedDataCache::remove(const DerivedDataKey &key)
+{
+    if (!enabled) {
+        return;
+    }
+    std::lock_guard lock{ mutex };
+    remove_locked(key.name);
+}
+
+DerivedDataCacheStats
+DerivedDataCache::get_stats() const
+{
+    std::lock_guard lock{ mutex };
+    return stats;
+}
+
+std::filesystem::path
+DerivedDataCache::get_entry_path(const DerivedDataKey &key) const
+{
+    auto path = directory / key.name;
+    path += ENTRY_EXTENSION;
+    return path;
+}
+
+void
+DerivedDataCache::remove_locked(const std::string &name)
+{
+    const auto it = entries.find(name);
+    if (it == entries.end()) {
+        return;
+    }
+    std::error_code error;
+    std::filesystem::remove(
+      get_entry_path(DerivedDataKey{ .name = name }), error
+    );
+    stats.size -= it->second.size;
+    entries.erase(it);
+}
+
+void
+DerivedDataCache::evict_locked()
+{
+    while (stats.size > max_size && !entries.empty()) {
+        const auto oldest = std::min_element(
+          entries.begin(),
+          entries.end(),
+          [](const auto &a, const auto &b) {
+              return a.second.last_use < b.second.last_use;
+          }
+        );
+        spdlog::debug("Evicting derived data: {}", oldest->first);
+        remove_locked(std::string{ oldest->first });
+        stats.eviction_count++;
+    }
+}
+} // namespace kovra
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace kovra {
+static constexpr const char *DERIVED_DATA_CACHE_DIR = "./cache/derived";
+static constexpr uint64_t DERIVED_DATA_CACHE_MAX_SIZE = 1024ull * 1024 * 1024;
+
+// Identifies the output of one processing step run on one source
+// Any change to the source bytes, the parameters or the processor version
+// produces a different key, so stale entries are never returned
+struct DerivedDataKey
+{
+    std::string name;
+};
+
+struct DerivedDataCacheStats
+{
+    uint64_t hit_count;
+    uint64_t miss_count;
+    uint64_t eviction_count;
+    // Size of the derived data that was read instead of being regenerated
+    uint64_t bytes_saved;
+    // Size of all the entries on disk
+    uint64_t size;
+
+    [[nodiscard]] float get_hit_rate() const noexcept
+    {
+        const uint64_t lookup_count = hit_count + miss_count;
+        return lookup_count == 0 ? 0.0f
+                                 : static_cast<float>(hit_count) / lookup_count;
+    }
+};
+
+// On-disk cache of the results of expensive asset processing steps
+// Entries are plain files, so the cache survives restarts. Once it grows
+// past its size limit the least recently used entries are deleted, and the
+// order is kept in the modification times of the files.
+// Safe to use from several threads.
+class DerivedDataCache
+{
+  public:
+    DerivedDataCache(std::filesystem::path directory, uint64_t max_size);
+    DerivedDataCache() = delete;
+    DerivedDataCache(const DerivedDataCache &) = delete;
+    DerivedDataCache &operator=(const DerivedDataCache &) = delete;
+
+    // Bump processor_version whenever the output of the step changes
+    [[nodiscard]] static DerivedDataKey make_key(
+      std::string_view processor,
+      uint32_t processor_version,
+      std::span<const std::byte> source,
+      std::span<const std::byte> params = {}
+    );
+
+    [[nodiscard]] std::optional<std::vector<std::byte>> get(
+      const DerivedDataKey &key
+    );
+    void put(const DerivedDataKey &key, std::span<const std::byte> data);
+    // Drop an entry whose data turned out to be unusable
+    void remove(const DerivedDataKey &key);
+
+    [[nodiscard]] DerivedDataCacheStats get_stats() const;
+    // False if the cache directory could not be created
+    [[nodiscard]] bool is_enabled() const noexcept { return enabled; }
+
+  private:
+    // Bump when the way keys are built changes
+    constexpr static uint32_t CACHE_VERSION = 1;
+    constexpr static std::string_view ENTRY_EXTENSION = ".ddc";
+
+    struct Entry
+    {
+        uint64_t size;
+        // Larger is more recent
+        uint64_t last_use;
+    };
+
+    [[nodiscard]] std::filesystem::path get_entry_path(
+      const DerivedDataKey &key
+    ) const;
+    void remove_locked(const std::string &name);
+    void evict_locked();
+
+    const std::filesystem::path directory;
+    const uint64_t max_size;
+    bool enabled = false;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t use_counter = 0;
+    DerivedDataCacheStats stats = {};
+};
+} // namespace kovra
@@ -13,13 +13,14 @@ DescriptorSetLayoutBuilder &
 DescriptorSetLayoutBuilder::add_binding(
   uint32_t binding,
   vk::DescriptorType descriptor_type,
-  vk::ShaderStageFlags stage_flags
+  vk::ShaderStageFlags stage_flags,
+  uint32_t descriptor_count
 )
 {
     bindings.emplace_back(vk::DescriptorSetLayoutBinding{}
                             .setBinding(binding)
                             .setDescriptorType(descriptor_type)
-                            .setDescriptorCount(1)
+                            .setDescriptorCount(descriptor_count)
                             .setStageFlags(stage_flags));
     return *this;
 }
@@ -176,7 +177,8 @@ DescriptorWriter::write_image(
   vk::ImageView image_view,
   vk::Sampler sampler,
   vk::ImageLayout layout,
-  vk::DescriptorType desc_type
+  vk::DescriptorType desc_type,
+  uint32_t array_element
 )
 {
     auto image_info = vk::DescriptorImageInfo{}
@@ -185,6 +187,7 @@ DescriptorWriter::write_image(
                         .setImageLayout(layout);
     auto image_write = vk::WriteDescriptorSet{}
                          .setDstBinding(binding)
+                         .setDstArrayElement(array_element)
                          .setDescriptorCount(1)
                          .setDescriptorType(desc_type);
     image_infos.emplace_back(std::make_tuple(image_info, image_write));
@@ -9,7 +9,8 @@ class DescriptorSetLayoutBuilder
     [[nodiscard]] DescriptorSetLayoutBuilder &add_binding(
       uint32_t binding,
       vk::DescriptorType descriptor_type,
-      vk::ShaderStageFlags stage_flags
+      vk::ShaderStageFlags stage_flags,
+      uint32_t descriptor_count = 1
     );
 
     [[nodiscard]] vk::DescriptorSetLayout build(const vk::Device &device) const;
@@ -87,7 +88,8 @@ class DescriptorWriter
       vk::ImageView image_view,
       vk::Sampler sampler,
       vk::ImageLayout layout,
-      vk::DescriptorType desc_type
+      vk::DescriptorType desc_type,
+      uint32_t array_element = 0
     );
     void clear();
     void update_set(const vk::Device &device, vk::DescriptorSet desc_set);
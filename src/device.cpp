@@ -3,6 +3,7 @@
 #include "queue.hpp"
 #include "spdlog/spdlog.h"
 
+#include <cstdlib>
 #include <set>
 #include <vulkan/vulkan_beta.h>
 
@@ -36,7 +37,9 @@ Device::Device(
 
     std::set<uint32_t> unique_queue_family_indices{
         physical_device->get_graphics_queue_family().get_index(),
-        physical_device->get_present_queue_family().get_index()
+        physical_device->get_present_queue_family().get_index(),
+        physical_device->get_transfer_queue_family().get_index(),
+        physical_device->get_compute_queue_family().get_index()
     };
 
     auto queue_priorities = std::array{ 1.0f };
@@ -68,15 +71,28 @@ Device::Device(
     */
     auto vulkan_12_features =
       vk::PhysicalDeviceVulkan12Features{}
-        //.setRuntimeDescriptorArray(device_features.runtime_descriptor_array)
-        .setBufferDeviceAddress(device_features.buffer_device_address);
+        .setRuntimeDescriptorArray(device_features.descriptor_indexing)
+        .setDescriptorBindingPartiallyBound(device_features.descriptor_indexing)
+        .setDescriptorBindingSampledImageUpdateAfterBind(
+          device_features.descriptor_indexing
+        )
+        .setShaderSampledImageArrayNonUniformIndexing(
+          device_features.descriptor_indexing
+        )
+        .setBufferDeviceAddress(device_features.buffer_device_address)
+        .setTimelineSemaphore(device_features.timeline_semaphore);
     //.setPNext(&acceleration_struct_features);
     auto vulkan_13_features =
       vk::PhysicalDeviceVulkan13Features{}
         .setDynamicRendering(device_features.dynamic_rendering)
         .setSynchronization2(device_features.synchronization2)
         .setPNext(&vulkan_12_features);
-    auto features = vk::PhysicalDeviceFeatures2{}.setPNext(&vulkan_13_features);
+    auto features =
+      vk::PhysicalDeviceFeatures2{}
+        .setFeatures(vk::PhysicalDeviceFeatures{}.setTextureCompressionBC(
+          device_features.texture_compression_bc
+        ))
+        .setPNext(&vulkan_13_features);
 
     device = physical_device->get().createDeviceUnique(
       vk::DeviceCreateInfo{}
@@ -106,15 +122,56 @@ Device::Device(
       device.get().createCommandPoolUnique(vk::CommandPoolCreateInfo{
         vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         graphics_queue->get_family_index() });
+    compute_command_pool =
+      device.get().createCommandPoolUnique(vk::CommandPoolCreateInfo{
+        vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        compute_queue->get_family_index() });
     transfer_context =
       std::make_unique<TransferContext>(*transfer_queue, device.get());
+    graphics_context =
+      std::make_unique<TransferContext>(*graphics_queue, device.get());
+    compute_context =
+      std::make_unique<TransferContext>(*compute_queue, device.get());
+    frame_timeline = std::make_unique<FrameTimeline>(device.get());
+    // The upload queue builds pipelines for mip generation
+    pipeline_cache = std::make_unique<PipelineCache>(
+      device.get(), physical_device->get().getProperties(), PIPELINE_CACHE_DIR
+    );
+    pipeline_build_queue =
+      std::make_unique<PipelineBuildQueue>(*pipeline_cache);
+    std::optional<std::filesystem::path> shader_dir;
+    if (const char *dir = std::getenv(SHADER_DIR_ENV_VAR)) {
+        shader_dir = dir;
+    }
+    shader_modules =
+      std::make_unique<ShaderModuleCache>(device.get(), shader_dir);
+    upload_queue = std::make_unique<UploadQueue>(*this);
+
+    if (has_async_compute()) {
+        spdlog::info(
+          "Using async compute queue family {}",
+          compute_queue->get_family_index()
+        );
+    }
 }
 
 Device::~Device()
 {
     spdlog::debug("Device::~Device()");
     device.get().waitIdle();
+    upload_queue.reset();
+    // Waits for the pipelines that are building
+    pipeline_build_queue.reset();
+    shader_modules.reset();
+    // Saves the cache to disk
+    pipeline_cache.reset();
+    // Nothing is in flight anymore, so every deferred destruction can run
+    frame_timeline->collect();
+    frame_timeline.reset();
+    compute_context.reset();
+    graphics_context.reset();
     transfer_context.reset();
+    compute_command_pool.reset();
     command_pool.reset();
     vmaDestroyAllocator(*allocator);
     allocator.reset();
@@ -136,11 +193,12 @@ Device::create_buffer(
   vk::DeviceSize size,
   vk::BufferUsageFlags buffer_usage,
   VmaMemoryUsage alloc_usage,
-  VmaAllocationCreateFlags alloc_flags
+  VmaAllocationCreateFlags alloc_flags,
+  const std::vector<uint32_t> &queue_families
 ) const
 {
     return std::make_unique<GpuBuffer>(
-      allocator, size, buffer_usage, alloc_usage, alloc_flags
+      allocator, size, buffer_usage, alloc_usage, alloc_flags, queue_families
     );
 }
 
@@ -153,6 +211,8 @@ DeviceFeatures::DeviceFeatures(const vk::PhysicalDevice &physical_device)
       vk::PhysicalDeviceRayTracingPipelineFeaturesKHR,
       vk::PhysicalDeviceAccelerationStructureFeaturesKHR>();
 
+    const auto &features10 =
+      features.get<vk::PhysicalDeviceFeatures2>().features;
     const auto &features12 = features.get<vk::PhysicalDeviceVulkan12Features>();
     const auto &features13 = features.get<vk::PhysicalDeviceVulkan13Features>();
     const auto &ray_tracing_features =
@@ -163,7 +223,14 @@ DeviceFeatures::DeviceFeatures(const vk::PhysicalDevice &physical_device)
     dynamic_rendering = features13.dynamicRendering;
     synchronization2 = features13.synchronization2;
     runtime_descriptor_array = features12.runtimeDescriptorArray;
+    descriptor_indexing =
+      features12.runtimeDescriptorArray &&
+      features12.descriptorBindingPartiallyBound &&
+      features12.descriptorBindingSampledImageUpdateAfterBind &&
+      features12.shaderSampledImageArrayNonUniformIndexing;
     buffer_device_address = features12.bufferDeviceAddress;
+    timeline_semaphore = features12.timelineSemaphore;
+    texture_compression_bc = features10.textureCompressionBC;
     ray_tracing_pipeline = ray_tracing_features.rayTracingPipeline;
     acceleration_structure =
       acceleration_structure_features.accelerationStructure;
@@ -175,7 +242,10 @@ DeviceFeatures::is_compatible_with(const DeviceFeatures &other) const
     return (!other.dynamic_rendering || dynamic_rendering) &&
            (!other.synchronization2 || synchronization2) &&
            (!other.runtime_descriptor_array || runtime_descriptor_array) &&
+           (!other.descriptor_indexing || descriptor_indexing) &&
            (!other.buffer_device_address || buffer_device_address) &&
+           (!other.timeline_semaphore || timeline_semaphore) &&
+           (!other.texture_compression_bc || texture_compression_bc) &&
            (!other.ray_tracing_pipeline || ray_tracing_pipeline) &&
            (!other.acceleration_structure || acceleration_structure);
 }
@@ -192,11 +262,26 @@ Device::create_color_image(
   uint32_t height,
   vk::Sampler sampler,
   vk::Format format,
-  bool mipmapped
+  bool mipmapped,
+  const MipGenerationInfo &mip_info
 ) const
 {
     return GpuImage::new_color_image(
-      data, width, height, *this, sampler, format, mipmapped
+      data, width, height, *this, sampler, format, mipmapped, mip_info
+    );
+}
+[[nodiscard]] std::unique_ptr<GpuImage>
+Device::create_compressed_image(
+  const void *data,
+  uint32_t width,
+  uint32_t height,
+  uint32_t level_count,
+  vk::Sampler sampler,
+  vk::Format format
+) const
+{
+    return GpuImage::new_compressed_image(
+      data, width, height, level_count, *this, sampler, format
     );
 }
 [[nodiscard]] std::unique_ptr<GpuImage>
@@ -204,12 +289,10 @@ Device::create_depth_image(
   uint32_t width,
   uint32_t height,
   std::optional<vk::Sampler> sampler,
-  bool enable_multisampling
+  vk::SampleCountFlagBits samples
 ) const
 {
-    return GpuImage::new_depth_image(
-      width, height, sampler, *this, enable_multisampling
-    );
+    return GpuImage::new_depth_image(width, height, sampler, *this, samples);
 }
 [[nodiscard]] std::unique_ptr<GpuImage>
 Device::create_storage_image(
@@ -221,10 +304,28 @@ Device::create_storage_image(
     return GpuImage::new_storage_image(width, height, sampler, *this);
 }
 void
-Device::immediate_submit(std::function<void(vk::CommandBuffer)> &&function
+Device::immediate_submit(
+  std::function<void(vk::CommandBuffer)> &&function,
+  QueueType queue
 ) const
 {
-    transfer_context->immediate_submit(std::move(function), device.get());
+    switch (queue) {
+        case QueueType::Graphics:
+            graphics_context->immediate_submit(
+              std::move(function), device.get()
+            );
+            break;
+        case QueueType::Compute:
+            compute_context->immediate_submit(
+              std::move(function), device.get()
+            );
+            break;
+        default:
+            transfer_context->immediate_submit(
+              std::move(function), device.get()
+            );
+            break;
+    }
 }
 
 std::vector<const char *>
@@ -4,14 +4,27 @@
 
 #include "buffer.hpp"
 #include "command.hpp"
+#include "pipeline_build_queue.hpp"
+#include "pipeline_cache.hpp"
 #include "queue.hpp"
+#include "shader.hpp"
+#include "timeline.hpp"
 #include "transfer_context.hpp"
+#include "upload_queue.hpp"
 
 namespace kovra {
 // Forward declarations
 class GpuImage;
 class GpuImageCreateInfo;
 
+// Queue that Device::immediate_submit() records to
+enum class QueueType
+{
+    Graphics,
+    Transfer,
+    Compute
+};
+
 class Device
 {
   public:
@@ -76,6 +89,37 @@ class Device
     {
         return command_pool.get();
     }
+    // Command buffers submitted to the compute queue must come from here
+    [[nodiscard]] const vk::CommandPool &get_compute_command_pool(
+    ) const noexcept
+    {
+        return compute_command_pool.get();
+    }
+    // Signaled by every frame, used to pace frames and to recycle resources
+    // once the GPU is done with them
+    [[nodiscard]] FrameTimeline &get_frame_timeline() const noexcept
+    {
+        return *frame_timeline;
+    }
+    // Every pipeline is created through it
+    [[nodiscard]] PipelineCache &get_pipeline_cache() const noexcept
+    {
+        return *pipeline_cache;
+    }
+    // Compiles the pipelines of materials on worker threads
+    [[nodiscard]] PipelineBuildQueue &get_pipeline_build_queue() const noexcept
+    {
+        return *pipeline_build_queue;
+    }
+    [[nodiscard]] ShaderModuleCache &get_shader_modules() const noexcept
+    {
+        return *shader_modules;
+    }
+    // Batches mesh and texture uploads to the transfer queue
+    [[nodiscard]] UploadQueue &get_upload_queue() const noexcept
+    {
+        return *upload_queue;
+    }
     //--------------------------------------------------------------------------
 
     [[nodiscard]] CommandEncoder create_command_encoder() const;
@@ -83,7 +127,8 @@ class Device
       vk::DeviceSize size,
       vk::BufferUsageFlags buffer_usage,
       VmaMemoryUsage alloc_usage,
-      VmaAllocationCreateFlags alloc_flags
+      VmaAllocationCreateFlags alloc_flags,
+      const std::vector<uint32_t> &queue_families = {}
     ) const;
     [[nodiscard]] std::unique_ptr<GpuImage> create_image(
       const GpuImageCreateInfo &info
@@ -94,20 +139,33 @@ class Device
       uint32_t height,
       vk::Sampler sampler,
       vk::Format format = vk::Format::eR8G8B8A8Unorm,
-      bool mipmapped = false
+      bool mipmapped = false,
+      const MipGenerationInfo &mip_info = {}
+    ) const;
+    [[nodiscard]] std::unique_ptr<GpuImage> create_compressed_image(
+      const void *data,
+      uint32_t width,
+      uint32_t height,
+      uint32_t level_count,
+      vk::Sampler sampler,
+      vk::Format format
     ) const;
     [[nodiscard]] std::unique_ptr<GpuImage> create_depth_image(
       uint32_t width,
       uint32_t height,
       std::optional<vk::Sampler> sampler,
-      bool enable_multisampling
+      vk::SampleCountFlagBits samples
     ) const;
     [[nodiscard]] std::unique_ptr<GpuImage> create_storage_image(
       uint32_t width,
       uint32_t height,
       std::optional<vk::Sampler> sampler
     ) const;
-    void immediate_submit(std::function<void(vk::CommandBuffer)> &&function
+    // Record commands and block until the queue has executed them
+    // Prefer the upload queue for copies, which batches them without blocking
+    void immediate_submit(
+      std::function<void(vk::CommandBuffer)> &&function,
+      QueueType queue = QueueType::Transfer
     ) const;
 
     [[nodiscard]] vk::DeviceSize get_buffer_alignment(const GpuBuffer &buffer
@@ -124,6 +182,24 @@ class Device
     {
         return (physical_device->get_sample_counts() & count) == count;
     }
+    // True if the compute queue belongs to a different family than the
+    // graphics queue, so compute work can overlap graphics work
+    // Resources shared by both queues then need queue family ownership
+    // transfers
+    [[nodiscard]] bool has_async_compute() const noexcept
+    {
+        return compute_queue->get_family_index() !=
+               graphics_queue->get_family_index();
+    }
+    [[nodiscard]] bool supports_bindless() const noexcept
+    {
+        return physical_device->get_supported_features().descriptor_indexing;
+    }
+    [[nodiscard]] bool supports_bc_textures() const noexcept
+    {
+        return physical_device->get_supported_features()
+          .texture_compression_bc;
+    }
 
   private:
     std::shared_ptr<PhysicalDevice> physical_device;
@@ -136,6 +212,14 @@ class Device
 
     std::shared_ptr<VmaAllocator> allocator;
     vk::UniqueCommandPool command_pool;
+    vk::UniqueCommandPool compute_command_pool;
     std::unique_ptr<TransferContext> transfer_context;
+    std::unique_ptr<TransferContext> graphics_context;
+    std::unique_ptr<TransferContext> compute_context;
+    std::unique_ptr<FrameTimeline> frame_timeline;
+    std::unique_ptr<PipelineCache> pipeline_cache;
+    std::unique_ptr<PipelineBuildQueue> pipeline_build_queue;
+    std::unique_ptr<ShaderModuleCache> shader_modules;
+    std::unique_ptr<UploadQueue> upload_queue;
 };
 } // namespace kovra
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "camera.hpp"
+#include "gbuffer.hpp"
 #include "gpu_data.hpp"
+#include "light.hpp"
 #include "profiling.hpp"
+#include "upload_queue.hpp"
+
+#include <span>
+#include <vulkan/vulkan.hpp>
 
 namespace kovra {
 // Forward declarations
@@ -13,6 +19,10 @@ class RenderResources;
 struct RenderObject;
 struct MaterialInstance;
 class Cubemap;
+class ImageBasedLighting;
+class ShadowMap;
+class TransientImagePool;
+class TemporalAntiAliasing;
 
 // WARNING: Do not store this struct in any class as a member.
 // It contains references to objects that may be destroyed.
@@ -23,18 +33,36 @@ struct DrawContext
     const Camera &camera;
 
     Swapchain &swapchain;
-    GpuImage &draw_image;
-    GpuImage &draw_depth_image;
-    GpuImage *draw_resolve_image = nullptr;
+    // Backs the images that only live while the frame is drawn
+    TransientImagePool &transient_images;
     Cubemap &skybox;
+    const ImageBasedLighting &ibl;
+    ShadowMap &shadow_map;
+    // Null unless temporal anti-aliasing is enabled
+    TemporalAntiAliasing *const taa = nullptr;
 
     // This vector will be filled each frame with opaque render objects
     std::vector<RenderObject> opaque_objects;
     // This vector will be filled each frame with transparent render objects
     std::vector<RenderObject> transparent_objects;
 
+    // Dynamic lights that get assigned to clusters each frame
+    const std::span<const Light> lights;
+    const bool shadows_enabled = true;
+
     const uint32_t frame_number;
+    // Samples per pixel of the draw image, which is resolved before
+    // presenting if there is more than one
+    const vk::SampleCountFlagBits sample_count = vk::SampleCountFlagBits::e1;
     const float render_scale = 1.0f;
+    // Contrast-adaptive sharpening applied after upscaling, from 0 to 1
+    const float sharpening = 0.0f;
+    const RenderPath render_path = RenderPath::Forward;
+    // Resolution to draw at (never larger than the swapchain)
+    const vk::Extent2D draw_extent;
+    // Uploads the frame waits for on the GPU, scenes loaded in the background
+    // are only drawn once theirs are complete, so they aren't covered
+    const UploadToken upload_token = 0;
 
     const GpuSceneData scene_data;
 
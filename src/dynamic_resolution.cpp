@@ -0,0 +1,58 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kovra {
+// Weight of the latest frame time in the moving average
+static constexpr float FRAME_TIME_SMOOTHING = 0.1f;
+// Frames whose times are ignored after a step, since they were recorded
+// before it (at most one per frame in flight)
+static constexpr uint32_t STEP_LATENCY_FRAMES = 4;
+
+float
+DynamicResolution::update(float gpu_frame_time, float scale) noexcept
+{
+    scale = std::clamp(scale, settings.min_scale, settings.max_scale);
+    if (gpu_frame_time <= 0.0f) {
+        return scale;
+    }
+    frames_since_step++;
+    if (frames_since_step <= STEP_LATENCY_FRAMES) {
+        return scale;
+    }
+    smoothed_frame_time =
+      smoothed_frame_time > 0.0f
+        ? std::lerp(smoothed_frame_time, gpu_frame_time, FRAME_TIME_SMOOTHING)
+        : gpu_frame_time;
+    if (frames_since_step < settings.settle_frames) {
+        return scale;
+    }
+
+    const float target = settings.target_frame_time;
+    if (smoothed_frame_time <= target * (1.0f + settings.hysteresis) &&
+        smoothed_frame_time >= target * (1.0f - settings.hysteresis)) {
+        return scale;
+    }
+    // Scale that would hit the target if GPU time is proportional to the
+    // pixel count
+    const float ideal_scale = scale * std::sqrt(target / smoothed_frame_time);
+    const float step = std::clamp(
+      ideal_scale - scale, -settings.max_step, settings.max_step
+    );
+    const float new_scale =
+      std::clamp(scale + step, settings.min_scale, settings.max_scale);
+    if (new_scale != scale) {
+        // Start measuring the new scale from scratch
+        reset();
+    }
+    return new_scale;
+}
+
+void
+DynamicResolution::reset() noexcept
+{
+    smoothed_frame_time = 0.0f;
+    frames_since_step = 0;
+}
+} // namespace kovra
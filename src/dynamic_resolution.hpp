@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+namespace kovra {
+struct DynamicResolutionSettings
+{
+    // GPU time (in ms) a frame should take
+    float target_frame_time = 1000.0f / 60.0f;
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    // Frame times within this fraction of the target leave the scale alone
+    float hysteresis = 0.1f;
+    // Largest change of the scale in one step
+    float max_step = 0.05f;
+    // Frames to wait after a step before the next one, so the measured times
+    // reflect it
+    uint32_t settle_frames = 16;
+};
+
+// Picks the render scale that keeps the GPU time of a frame close to a
+// target, from the times measured with timestamp queries
+// GPU time is assumed to grow with the number of pixels drawn, i.e. with the
+// square of the scale. The times are smoothed and the scale only moves once
+// they leave the hysteresis band around the target, by bounded steps, so it
+// doesn't oscillate from frame to frame.
+class DynamicResolution
+{
+  public:
+    DynamicResolution() = default;
+
+    // Returns the scale to draw the next frame at
+    [[nodiscard]] float update(float gpu_frame_time, float scale) noexcept;
+    // Forget the measured times, e.g. when the controller is re-enabled
+    void reset() noexcept;
+
+    [[nodiscard]] DynamicResolutionSettings &get_settings() noexcept
+    {
+        return settings;
+    }
+    [[nodiscard]] float get_smoothed_frame_time() const noexcept
+    {
+        return smoothed_frame_time;
+    }
+
+  private:
+    DynamicResolutionSettings settings;
+    // Exponential moving average of the GPU frame time, zero until measured
+    float smoothed_frame_time = 0.0f;
+    uint32_t frames_since_step = 0;
+};
+} // namespace kovra
@@ -0,0 +1,20 @@
+#include "embedded_shaders.hpp"
+#include "embedded_shaders_data.hpp"
+
+#include <algorithm>
+
+namespace kovra {
+std::optional<std::span<const uint32_t>>
+find_embedded_shader(std::string_view name) noexcept
+{
+    const auto it = std::find_if(
+      embedded::SHADERS.begin(),
+      embedded::SHADERS.end(),
+      [name](const EmbeddedShader &shader) { return shader.name == name; }
+    );
+    if (it == embedded::SHADERS.end()) {
+        return std::nullopt;
+    }
+    return it->spv;
+}
+} // namespace kovra
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace kovra {
+// SPIR-V of a shader compiled at build time, named after its source file
+// without the directory, e.g. "pbr.frag"
+struct EmbeddedShader
+{
+    std::string_view name;
+    std::span<const uint32_t> spv;
+};
+
+// Looks through every shader in shaders/, embedded by
+// cmake/embed_shaders.cmake
+[[nodiscard]] std::optional<std::span<const uint32_t>>
+find_embedded_shader(std::string_view name) noexcept;
+} // namespace kovra
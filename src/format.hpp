@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Smallest unit of texels a format stores together
+// Uncompressed formats store single texels, BCn formats store 4x4 blocks
+struct FormatBlock
+{
+    uint32_t extent;
+    // In bytes
+    uint32_t size;
+};
+
+// Only covers the formats textures are created with, zero size for the rest
+[[nodiscard]] constexpr FormatBlock
+get_format_block(vk::Format format) noexcept
+{
+    switch (format) {
+        case vk::Format::eR8Unorm:
+            return { 1, 1 };
+        case vk::Format::eR8G8Unorm:
+            return { 1, 2 };
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+            return { 1, 4 };
+        case vk::Format::eR16G16B16A16Sfloat:
+            return { 1, 8 };
+        case vk::Format::eR32G32B32A32Sfloat:
+            return { 1, 16 };
+
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbSrgbBlock:
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc1RgbaSrgbBlock:
+        case vk::Format::eBc4UnormBlock:
+        case vk::Format::eBc4SnormBlock:
+            return { 4, 8 };
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc3SrgbBlock:
+        case vk::Format::eBc5UnormBlock:
+        case vk::Format::eBc5SnormBlock:
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            return { 4, 16 };
+
+        default:
+            return { 1, 0 };
+    }
+}
+
+[[nodiscard]] constexpr bool
+is_block_compressed(vk::Format format) noexcept
+{
+    return get_format_block(format).extent > 1;
+}
+
+// Bytes a tightly packed mip level takes up
+[[nodiscard]] constexpr uint64_t
+get_level_size(vk::Format format, uint32_t width, uint32_t height) noexcept
+{
+    const auto block = get_format_block(format);
+    const uint64_t blocks_x = (width + block.extent - 1) / block.extent;
+    const uint64_t blocks_y = (height + block.extent - 1) / block.extent;
+    return blocks_x * blocks_y * block.size;
+}
+
+// Levels of a full mip chain down to 1x1
+[[nodiscard]] constexpr uint32_t
+get_full_level_count(uint32_t width, uint32_t height) noexcept
+{
+    return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+}
+} // namespace kovra
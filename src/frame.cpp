@@ -1,18 +1,24 @@
 #include "frame.hpp"
 #include "asset_loader.hpp"
+#include "bindless.hpp"
 #include "buffer.hpp"
 #include "camera.hpp"
 #include "cubemap.hpp"
 #include "descriptor.hpp"
 #include "device.hpp"
+#include "gbuffer.hpp"
 #include "gpu_data.hpp"
+#include "ibl.hpp"
 #include "image.hpp"
+#include "light.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
 #include "pbr_material.hpp"
 #include "render_object.hpp"
 #include "render_resources.hpp"
+#include "shadow.hpp"
 #include "swapchain.hpp"
+#include "taa.hpp"
 #include "utils.hpp"
 
 #include "imgui.h"
@@ -21,19 +27,28 @@
 #include "spdlog/spdlog.h"
 
 namespace kovra {
+// Queue families that read the buffers shared with async compute
+static std::vector<uint32_t>
+async_compute_queue_families(const Device &device)
+{
+    if (!device.has_async_compute()) {
+        return {};
+    }
+    return { device.get_graphics_family_index(),
+             device.get_compute_family_index() };
+}
+
 Frame::Frame(const Device &device)
   : present_semaphore{ device.get().createSemaphoreUnique({}) }
   , render_semaphore{ device.get().createSemaphoreUnique({}) }
-  , render_fence{ device.get().createFenceUnique(
-      { vk::FenceCreateFlagBits::eSignaled }
-    ) }
   , cmd_encoder{ std::make_unique<CommandEncoder>(device) }
   , desc_allocator{ std::make_unique<DescriptorAllocator>(device.get(), 1000) }
   , scene_buffer{ device.create_buffer(
       sizeof(GpuSceneData),
       vk::BufferUsageFlagBits::eUniformBuffer,
       VMA_MEMORY_USAGE_CPU_TO_GPU,
-      VMA_ALLOCATION_CREATE_MAPPED_BIT
+      VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      async_compute_queue_families(device)
     ) }
   , material_buffer{ device.create_buffer(
       sizeof(GpuPbrMaterialData),
@@ -41,18 +56,54 @@ Frame::Frame(const Device &device)
       VMA_MEMORY_USAGE_CPU_TO_GPU,
       VMA_ALLOCATION_CREATE_MAPPED_BIT
     ) }
+  , light_buffer{ device.create_buffer(
+      sizeof(GpuLight) * MAX_LIGHTS,
+      vk::BufferUsageFlagBits::eStorageBuffer,
+      VMA_MEMORY_USAGE_CPU_TO_GPU,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      async_compute_queue_families(device)
+    ) }
+  , cluster_light_buffer{ device.create_buffer(
+      sizeof(uint32_t) * CLUSTER_COUNT * CLUSTER_STRIDE,
+      vk::BufferUsageFlagBits::eStorageBuffer,
+      VMA_MEMORY_USAGE_GPU_ONLY,
+      0
+    ) }
+  , visibility_draw_buffer{ device.create_buffer(
+      sizeof(GpuVisibilityDraw) * MAX_VISIBILITY_DRAWS,
+      vk::BufferUsageFlagBits::eStorageBuffer,
+      VMA_MEMORY_USAGE_CPU_TO_GPU,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    ) }
+  , timestamp_pool{ device.get().createQueryPoolUnique(
+      vk::QueryPoolCreateInfo{}
+        .setQueryType(vk::QueryType::eTimestamp)
+        .setQueryCount(static_cast<uint32_t>(GpuTimestamp::Count))
+    ) }
 {
     spdlog::debug("Frame::Frame()");
+
+    if (device.has_async_compute()) {
+        compute_cmd_encoder = std::make_unique<CommandEncoder>(
+          device, device.get_compute_command_pool()
+        );
+        compute_semaphore = device.get().createSemaphoreUnique({});
+    }
 }
 
 Frame::~Frame()
 {
     spdlog::debug("Frame::~Frame()");
+    timestamp_pool.reset();
+    visibility_draw_buffer.reset();
+    cluster_light_buffer.reset();
+    light_buffer.reset();
     material_buffer.reset();
     scene_buffer.reset();
     desc_allocator.reset();
+    compute_semaphore.reset();
+    compute_cmd_encoder.reset();
     cmd_encoder.reset();
-    render_fence.reset();
     render_semaphore.reset();
     present_semaphore.reset();
 }
@@ -62,15 +113,28 @@ Frame::draw(const DrawContext &&ctx)
 {
     const vk::Device &device = ctx.device.get();
 
-    // Wait until the GPU has finished rendering the last frame (1 sec timeout)
-    std::vector<vk::Fence> fences = { render_fence.get() };
-    if (device.waitForFences(fences, vk::True, 1000000000) != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to wait for render fence");
+    // Wait until the GPU has finished the last submission of this frame
+    auto &timeline = ctx.device.get_frame_timeline();
+    const auto wait_start = std::chrono::system_clock::now();
+    timeline.wait(timeline_value);
+    const auto wait_end = std::chrono::system_clock::now();
+    ctx.stats.frame_wait_time =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+        wait_end - wait_start
+      )
+        .count() /
+      1000.0f;
+
+    // The GPU has finished the last submission of this frame, so its
+    // timestamps are ready to be read
+    if (timestamps_written) {
+        read_gpu_timings(ctx);
     }
 
-    // Request image from swapchain (1 sec timeout)
+    // Request image from swapchain
+    // The present semaphore is binary since WSI does not take timelines
     auto swapchain_image_index = device.acquireNextImageKHR(
-      ctx.swapchain.get(), 1000000000, present_semaphore.get(), nullptr
+      ctx.swapchain.get(), UINT64_MAX, present_semaphore.get(), nullptr
     );
     if (swapchain_image_index.result != vk::Result::eSuccess) {
         switch (swapchain_image_index.result) {
@@ -86,23 +150,7 @@ Frame::draw(const DrawContext &&ctx)
                 throw std::runtime_error("Failed to acquire swapchain image");
         }
     }
-    auto swapchain_image =
-      ctx.swapchain.get_images().at(swapchain_image_index.value);
-    auto swapchain_image_extent = ctx.swapchain.get_extent();
-
-    device.resetFences(render_fence.get());
-
-    // Set draw extent (determines resolution to draw at)
-    // This ensures that we don't draw at a higher resolution than the swapchain
-    auto draw_extent = ctx.draw_image.get_extent2d();
-    draw_extent.setWidth(
-      std::min(swapchain_image_extent.width, draw_extent.width) *
-      ctx.render_scale
-    );
-    draw_extent.setHeight(
-      std::min(swapchain_image_extent.height, draw_extent.height) *
-      ctx.render_scale
-    );
+    const auto swapchain_image_extent = ctx.swapchain.get_extent();
 
     // Clear descriptor pools
     desc_allocator.get()->clear_pools(device);
@@ -116,6 +164,19 @@ Frame::draw(const DrawContext &&ctx)
     // Update the scene buffer
     scene_buffer->write(&ctx.scene_data, sizeof(GpuSceneData));
 
+    // Update the light buffer
+    // The buffer stays mapped, so the lights are written into it directly
+    {
+        const size_t light_count =
+          std::min(ctx.lights.size(), static_cast<size_t>(MAX_LIGHTS));
+        auto *gpu_lights =
+          static_cast<GpuLight *>(light_buffer->get_mapped_data());
+        for (size_t i = 0; i < light_count; i++) {
+            gpu_lights[i] = ctx.lights[i].as_gpu_data();
+        }
+        ctx.stats.light_count = static_cast<int>(light_count);
+    }
+
     // Update the scene descriptor set with the updated scene buffer
     auto writer = DescriptorWriter{};
     writer.write_buffer(
@@ -125,171 +186,1150 @@ Frame::draw(const DrawContext &&ctx)
       0,
       vk::DescriptorType::eUniformBuffer
     );
+    writer.write_buffer(
+      1,
+      light_buffer->get(),
+      light_buffer->get_size(),
+      0,
+      vk::DescriptorType::eStorageBuffer
+    );
+    writer.write_buffer(
+      2,
+      cluster_light_buffer->get(),
+      cluster_light_buffer->get_size(),
+      0,
+      vk::DescriptorType::eStorageBuffer
+    );
+    writer.write_image(
+      3,
+      ctx.shadow_map.get_image().get_view(),
+      ctx.shadow_map.get_sampler(),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
+    writer.write_image(
+      4,
+      ctx.ibl.get_irradiance_map().get_view(),
+      ctx.ibl.get_sampler(),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
+    writer.write_image(
+      5,
+      ctx.ibl.get_prefiltered_map().get_view(),
+      ctx.ibl.get_sampler(),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
+    writer.write_image(
+      6,
+      ctx.ibl.get_brdf_lut().get_view(),
+      ctx.ibl.get_sampler(),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
     writer.update_set(device, scene_desc_set);
 
+    // Light assignment only depends on the scene and light buffers, so with a
+    // dedicated compute queue it overlaps the shadow and geometry passes
+    const bool async_compute = compute_cmd_encoder != nullptr;
+    ctx.stats.async_compute = async_compute;
+    if (async_compute) {
+        submit_async_compute(ctx, scene_desc_set);
+    }
+
     //--------------------------------------------------------------------------
     cmd_encoder->begin();
+    cmd_encoder->reset_query_pool(
+      timestamp_pool.get(), 0, static_cast<uint32_t>(GpuTimestamp::Count)
+    );
+    write_timestamp(GpuTimestamp::FrameBegin);
+
+    ctx.stats.draw_call_count = 0;
+    ctx.stats.triangle_count = 0;
+    ctx.stats.render_objects_draw_time = 0;
+    ctx.stats.shadow_cascades_rendered = 0;
+    ctx.stats.shadow_draw_call_count = 0;
+
+    // With async compute, only acquire the cluster light buffer that the
+    // compute queue has filled in the meantime
+    if (async_compute) {
+        cmd_encoder->buffer_barrier(
+          cluster_light_buffer->get(),
+          vk::PipelineStageFlagBits2::eNone,
+          vk::AccessFlagBits2::eNone,
+          vk::PipelineStageFlagBits2::eFragmentShader |
+            vk::PipelineStageFlagBits2::eComputeShader,
+          vk::AccessFlagBits2::eShaderStorageRead,
+          ctx.device.get_compute_family_index(),
+          ctx.device.get_graphics_family_index()
+        );
+        cmd_encoder->set_buffer_usage(
+          *cluster_light_buffer, ResourceUsage::StorageBufferRead
+        );
+    }
 
-    // Transition draw image layout to color attachment optimal for rendering
-    cmd_encoder->transition_image_layout(
-      ctx.draw_image,
-      vk::ImageLayout::eUndefined,
-      vk::ImageLayout::eColorAttachmentOptimal
-    );
-    if (ctx.draw_resolve_image != nullptr) {
-        cmd_encoder->transition_image_layout(
-          *ctx.draw_resolve_image,
-          vk::ImageLayout::eUndefined,
-          vk::ImageLayout::eColorAttachmentOptimal
+    RenderGraph graph{ ctx.transient_images };
+    // Transient images are as large as the swapchain and drawn to at the draw
+    // extent, so changing the render scale doesn't reallocate them
+    auto resources = FrameGraphResources{
+        .draw_image = graph.create_image(
+          "draw image",
+          TransientImageDesc{ .format = DRAW_IMAGE_FORMAT,
+                              .extent = swapchain_image_extent,
+                              .samples = ctx.sample_count }
+        ),
+        .draw_depth_image = graph.create_image(
+          "draw depth image",
+          TransientImageDesc{ .format = DRAW_DEPTH_FORMAT,
+                              .extent = swapchain_image_extent,
+                              .aspect = vk::ImageAspectFlagBits::eDepth,
+                              .samples = ctx.sample_count }
+        ),
+        .draw_resolve_image = {},
+        .motion_vectors = {},
+        // The shadow map is the only image that keeps its contents across
+        // frames
+        .shadow_map = graph.import_image(
+          "shadow map",
+          ctx.shadow_map.get_image(),
+          ImportedImageInfo{ .initial_usage = ResourceUsage::ShaderSampled,
+                             .final_usage = ResourceUsage::ShaderSampled }
+        ),
+        .cluster_lights =
+          graph.import_buffer("cluster lights", *cluster_light_buffer),
+    };
+    if (ctx.sample_count != vk::SampleCountFlagBits::e1) {
+        resources.draw_resolve_image = graph.create_image(
+          "draw resolve image",
+          TransientImageDesc{ .format = DRAW_IMAGE_FORMAT,
+                              .extent = swapchain_image_extent }
         );
     }
-    cmd_encoder->transition_image_layout(
-      ctx.draw_depth_image,
-      vk::ImageLayout::eUndefined,
-      vk::ImageLayout::eDepthStencilAttachmentOptimal
+    // The deferred and visibility paths reproject every pixel from depth
+    // instead
+    if (ctx.taa && ctx.render_path == RenderPath::Forward) {
+        resources.motion_vectors = graph.create_image(
+          "motion vectors",
+          TransientImageDesc{ .format = MOTION_VECTOR_FORMAT,
+                              .extent = swapchain_image_extent }
+        );
+    }
+    const auto swapchain_image = graph.import_image(
+      "swapchain image",
+      ctx.swapchain.get_images().at(swapchain_image_index.value),
+      ctx.swapchain.get_views().at(swapchain_image_index.value).get(),
+      ctx.swapchain.get_format(),
+      swapchain_image_extent,
+      ImportedImageInfo{ .final_usage = ResourceUsage::Present }
     );
 
-    // Render to the draw image
-    {
+    if (ctx.shadows_enabled) {
+        add_shadow_pass(graph, ctx, resources);
+    }
+    add_timestamp_pass(graph, GpuTimestamp::ShadowEnd);
+
+    // Assign lights to clusters before any shader reads them
+    if (!async_compute) {
+        add_cluster_light_pass(graph, ctx, scene_desc_set, resources);
+    }
+
+    switch (ctx.render_path) {
+        case RenderPath::Deferred:
+            add_deferred_passes(graph, ctx, scene_desc_set, resources);
+            break;
+        case RenderPath::Visibility:
+            add_visibility_passes(graph, ctx, scene_desc_set, resources);
+            break;
+        default:
+            add_forward_passes(graph, ctx, scene_desc_set, resources);
+            break;
+    }
+
+    // Upscale the (resolved or temporally anti-aliased) draw image to the
+    // swapchain image if it was drawn at a lower resolution, then sharpen it
+    // into the swapchain image and draw ImGui on top
+    auto present_source = resources.draw_resolve_image.is_valid()
+                            ? resources.draw_resolve_image
+                            : resources.draw_image;
+    if (ctx.taa) {
+        present_source = add_taa_pass(graph, ctx, scene_desc_set, resources);
+    }
+    const bool upscaled = ctx.draw_extent != swapchain_image_extent;
+    if (upscaled) {
+        const auto upscaled_image = graph.create_image(
+          "upscaled image",
+          TransientImageDesc{ .format = DRAW_IMAGE_FORMAT,
+                              .extent = swapchain_image_extent }
+        );
+        add_upscale_pass(graph, ctx, present_source, upscaled_image);
+        present_source = upscaled_image;
+    }
+    add_composite_pass(
+      graph,
+      ctx,
+      present_source,
+      swapchain_image,
+      upscaled ? ctx.sharpening : 0.0f
+    );
+
+    // Also leaves the swapchain image ready to present
+    graph.execute(*cmd_encoder);
+    if (ctx.taa) {
+        ctx.taa->end_frame();
+    }
+
+    write_timestamp(GpuTimestamp::FrameEnd);
+    timestamps_written = true;
+
+    // Finish recording commands
+    auto cmd = cmd_encoder->finish();
+    const auto barrier_stats = cmd_encoder->get_barrier_stats();
+    ctx.stats.barrier_count = static_cast<int>(barrier_stats.barrier_count);
+    ctx.stats.barrier_batch_count = static_cast<int>(barrier_stats.batch_count);
+    const auto graph_stats = graph.get_stats();
+    ctx.stats.render_pass_count = static_cast<int>(graph_stats.pass_count);
+    ctx.stats.culled_pass_count =
+      static_cast<int>(graph_stats.culled_pass_count);
+    const auto transient_stats = ctx.transient_images.get_stats();
+    ctx.stats.transient_megabytes =
+      static_cast<float>(transient_stats.allocated_bytes) / (1024.0f * 1024.0f);
+    ctx.stats.transient_unaliased_megabytes =
+      static_cast<float>(transient_stats.requested_bytes) / (1024.0f * 1024.0f);
+    //--------------------------------------------------------------------------
+
+    // Submit command buffer to the graphics queue
+    // Only the stages that read the cluster lights wait for async compute
+    auto wait_semaphores =
+      std::vector<vk::Semaphore>{ present_semaphore.get() };
+    auto wait_stages = std::vector<vk::PipelineStageFlags>{
+        vk::PipelineStageFlagBits::eColorAttachmentOutput
+    };
+    if (async_compute) {
+        wait_semaphores.emplace_back(compute_semaphore.get());
+        wait_stages.emplace_back(
+          vk::PipelineStageFlagBits::eFragmentShader |
+          vk::PipelineStageFlagBits::eComputeShader
+        );
+    }
+    // Meshes and textures that aren't loaded in the background may be drawn
+    // as soon as their uploads are submitted
+    // Binary semaphores ignore their values
+    auto wait_values = std::vector<uint64_t>(wait_semaphores.size(), 0);
+    if (ctx.upload_token != 0) {
+        wait_semaphores.emplace_back(
+          ctx.device.get_upload_queue().get_semaphore()
+        );
+        wait_stages.emplace_back(vk::PipelineStageFlagBits::eAllCommands);
+        wait_values.emplace_back(ctx.upload_token);
+    }
+
+    timeline_value = timeline.advance();
+    const auto signal_semaphores =
+      std::array{ render_semaphore.get(), timeline.get() };
+    const auto signal_values = std::array<uint64_t, 2>{ 0, timeline_value };
+    auto timeline_submit_info = vk::TimelineSemaphoreSubmitInfo{}
+                                  .setWaitSemaphoreValues(wait_values)
+                                  .setSignalSemaphoreValues(signal_values);
+    ctx.device.get_graphics_queue().submit(
+      vk::SubmitInfo{}
+        .setWaitDstStageMask(wait_stages)
+        .setWaitSemaphores(wait_semaphores)
+        .setSignalSemaphores(signal_semaphores)
+        .setCommandBuffers(cmd)
+        .setPNext(&timeline_submit_info)
+    );
+
+    present(swapchain_image_index.value, ctx);
+}
+
+void
+Frame::add_timestamp_pass(RenderGraph &graph, GpuTimestamp timestamp)
+{
+    graph
+      .add_pass(
+        "timestamp",
+        [this, timestamp](RenderGraphPassContext &) {
+            write_timestamp(timestamp);
+        }
+      )
+      .set_side_effects();
+}
+
+void
+Frame::add_shadow_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const FrameGraphResources &resources
+)
+{
+    auto &shadow_map = ctx.shadow_map;
+    bool any_cascade_dirty = false;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        any_cascade_dirty = any_cascade_dirty || shadow_map.needs_render(i);
+    }
+    if (!any_cascade_dirty) {
+        return;
+    }
+
+    // Every cascade is a render pass of its own, so the pass begins them
+    // itself
+    // Cached cascades keep their contents through the transition
+    graph
+      .add_pass(
+        "shadows",
+        [this, &ctx](RenderGraphPassContext &) { draw_shadows(ctx); }
+      )
+      .write(resources.shadow_map, ResourceUsage::DepthAttachment);
+}
+
+void
+Frame::draw_shadows(const DrawContext &ctx) const
+{
+    auto &shadow_map = ctx.shadow_map;
+    const auto shadow_material =
+      ctx.render_resources.get_material_owned("shadow");
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        if (!shadow_map.needs_render(i)) {
+            continue;
+        }
+
         const auto depth_attachment =
           vk::RenderingAttachmentInfo{}
-            .setImageView(ctx.draw_depth_image.get_view())
+            .setImageView(shadow_map.get_cascade_view(i))
             .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
             .setLoadOp(vk::AttachmentLoadOp::eClear)
             .setStoreOp(vk::AttachmentStoreOp::eStore)
             .setClearValue(vk::ClearValue{}.setDepthStencil({ 1.0f, 0 }));
-        auto color_attachment =
-          vk::RenderingAttachmentInfo{}
-            .setImageView(ctx.draw_image.get_view())
-            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setClearValue(vk::ClearValue{}.setColor({ 0.1f, 0.1f, 0.1f, 1.0f })
-            );
-        if (ctx.draw_resolve_image != nullptr) {
-            color_attachment.setResolveMode(vk::ResolveModeFlagBits::eAverage)
-              .setResolveImageView(ctx.draw_resolve_image->get_view())
-              .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
-        }
-        const auto render_area =
-          vk::Rect2D{}.setOffset({ 0, 0 }).setExtent(draw_extent);
+        const auto render_area = vk::Rect2D{}.setOffset({ 0, 0 }).setExtent(
+          { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE }
+        );
         RenderPass render_pass =
           cmd_encoder->begin_render_pass(RenderPassCreateInfo{
-            .color_attachments = { color_attachment },
+            .color_attachments = {},
             .depth_attachment = depth_attachment,
             .render_area = render_area,
           });
-        render_pass.set_viewport_scissor(draw_extent.width, draw_extent.height);
+        render_pass.set_viewport_scissor(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+        render_pass.set_material(shadow_material);
 
-        draw_render_objects(render_pass, ctx, scene_desc_set);
-        draw_skybox(render_pass, ctx);
-        draw_grid(render_pass, ctx, scene_desc_set);
+        // Only opaque objects cast shadows
+        const auto &light_viewproj = shadow_map.get_viewproj(i);
+        for (const auto &object : ctx.opaque_objects) {
+            if (!object.is_visible(light_viewproj)) {
+                continue;
+            }
+            render_pass.set_index_buffer(object.index_buffer);
+            render_pass.set_push_constants(
+              utils::cast_to_bytes(GpuShadowPushConstants{
+                .light_transform = light_viewproj * object.transform,
+                .vertex_buffer = object.vertex_buffer_address })
+            );
+            render_pass.draw_indexed(
+              object.index_count, 1, object.first_index, 0, 0
+            );
+            ctx.stats.shadow_draw_call_count++;
+        }
+
+        shadow_map.mark_rendered(i);
+        ctx.stats.shadow_cascades_rendered++;
     }
+}
 
-    // Clear swapchain image
-    cmd_encoder->transition_image_layout(
-      swapchain_image,
-      vk::ImageAspectFlagBits::eColor,
-      vk::ImageLayout::eUndefined,
-      vk::ImageLayout::eTransferDstOptimal
+void
+Frame::add_cluster_light_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources
+)
+{
+    graph
+      .add_pass(
+        "cluster lights",
+        [this, &ctx, scene_desc_set](RenderGraphPassContext &pass) {
+            assign_lights_to_clusters(pass.encoder, ctx, scene_desc_set, false);
+        }
+      )
+      .write(
+        resources.cluster_lights, ResourceUsage::ComputeStorageBufferWrite
+      );
+}
+
+void
+Frame::assign_lights_to_clusters(
+  CommandEncoder &encoder,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  bool async_compute
+) const
+{
+    {
+        ComputePass compute_pass = encoder.begin_compute_pass();
+        compute_pass.set_material(
+          ctx.render_resources.get_material_owned("cluster lights")
+        );
+        compute_pass.set_desc_sets(0, { scene_desc_set }, {});
+        // One invocation per cluster, 128 invocations per workgroup
+        compute_pass.dispatch_workgroups((CLUSTER_COUNT + 127) / 128, 1, 1);
+    }
+
+    if (async_compute) {
+        // Release half of the ownership transfer, the graphics queue acquires
+        // the buffer before reading it
+        encoder.buffer_barrier(
+          cluster_light_buffer->get(),
+          vk::PipelineStageFlagBits2::eComputeShader,
+          vk::AccessFlagBits2::eShaderStorageWrite,
+          vk::PipelineStageFlagBits2::eNone,
+          vk::AccessFlagBits2::eNone,
+          ctx.device.get_compute_family_index(),
+          ctx.device.get_graphics_family_index()
+        );
+    }
+}
+
+void
+Frame::submit_async_compute(
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set
+)
+{
+    // The cluster light buffer is rewritten from scratch every frame, so the
+    // compute queue can take it without the graphics queue releasing it
+    compute_cmd_encoder->begin();
+    compute_cmd_encoder->require(
+      *cluster_light_buffer, ResourceUsage::ComputeStorageBufferWrite
+    );
+    assign_lights_to_clusters(*compute_cmd_encoder, ctx, scene_desc_set, true);
+    auto cmd = compute_cmd_encoder->finish();
+
+    ctx.device.get_compute_queue().submit(
+      vk::SubmitInfo{}
+        .setCommandBuffers(cmd)
+        .setSignalSemaphores(compute_semaphore.get())
+    );
+}
+
+void
+Frame::read_gpu_timings(const DrawContext &ctx) const
+{
+    std::array<uint64_t, static_cast<size_t>(GpuTimestamp::Count)> timestamps;
+    const auto result = ctx.device.get().getQueryPoolResults(
+      timestamp_pool.get(),
+      0,
+      static_cast<uint32_t>(timestamps.size()),
+      sizeof(timestamps),
+      timestamps.data(),
+      sizeof(uint64_t),
+      vk::QueryResultFlagBits::e64
     );
-    cmd_encoder->clear_color_image(
-      swapchain_image, vk::ImageLayout::eTransferDstOptimal
+    if (result != vk::Result::eSuccess) {
+        return;
+    }
+
+    const float ns_per_tick =
+      ctx.device.get_physical_device().get_timestamp_period();
+    const auto elapsed_ms = [&](GpuTimestamp begin, GpuTimestamp end) {
+        const auto ticks = timestamps[static_cast<size_t>(end)] -
+                           timestamps[static_cast<size_t>(begin)];
+        return static_cast<float>(ticks) * ns_per_tick / 1000000.0f;
+    };
+    ctx.stats.gpu_frame_time =
+      elapsed_ms(GpuTimestamp::FrameBegin, GpuTimestamp::FrameEnd);
+    ctx.stats.gpu_shadow_time =
+      elapsed_ms(GpuTimestamp::FrameBegin, GpuTimestamp::ShadowEnd);
+    ctx.stats.gpu_opaque_time =
+      elapsed_ms(GpuTimestamp::ShadowEnd, GpuTimestamp::OpaqueEnd);
+    ctx.stats.gpu_lighting_time =
+      elapsed_ms(GpuTimestamp::OpaqueEnd, GpuTimestamp::LightingEnd);
+}
+
+void
+Frame::write_timestamp(GpuTimestamp timestamp) const
+{
+    cmd_encoder->write_timestamp(
+      timestamp_pool.get(), static_cast<uint32_t>(timestamp)
     );
+}
+
+void
+Frame::add_forward_passes(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources
+)
+{
+    // Only opaque objects write motion vectors, so everything else is drawn
+    // in a separate pass whose materials have a single color attachment
+    const bool write_motion_vectors = resources.motion_vectors.is_valid();
+    auto forward = graph.add_pass(
+      "forward",
+      [this, &ctx, scene_desc_set, write_motion_vectors](
+        RenderGraphPassContext &pass
+      ) {
+          auto &render_pass = *pass.render_pass;
+          render_pass.set_viewport_scissor(
+            ctx.draw_extent.width, ctx.draw_extent.height
+          );
+
+          draw_opaque_objects(
+            render_pass,
+            ctx,
+            scene_desc_set,
+            write_motion_vectors ? OpaqueMaterial::ForwardMotion
+                                 : OpaqueMaterial::Forward
+          );
+          // Opaque objects are lit while they are rasterized
+          write_timestamp(GpuTimestamp::OpaqueEnd);
+          write_timestamp(GpuTimestamp::LightingEnd);
 
-    // Resolve multisampled draw image
-    if (ctx.draw_resolve_image != nullptr) {
-        cmd_encoder->transition_image_layout(
-          *ctx.draw_resolve_image,
-          vk::ImageLayout::eColorAttachmentOptimal,
-          vk::ImageLayout::eTransferSrcOptimal
+          if (!write_motion_vectors) {
+              draw_transparent_objects(render_pass, ctx, scene_desc_set);
+              draw_skybox(render_pass, ctx);
+              draw_grid(render_pass, ctx, scene_desc_set);
+          }
+      }
+    );
+    forward.write_color(
+      resources.draw_image, vk::ClearColorValue{ BACKGROUND_COLOR }
+    );
+    if (write_motion_vectors) {
+        forward.write_color(
+          resources.motion_vectors,
+          vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 0.0f }
         );
+    }
+    // The multisampled draw image is never stored, only resolved
+    if (resources.draw_resolve_image.is_valid()) {
+        forward.resolve_color(resources.draw_resolve_image);
+    }
+    forward.write_depth(resources.draw_depth_image, 1.0f)
+      .set_render_area(ctx.draw_extent)
+      .read(resources.shadow_map, ResourceUsage::ShaderSampled)
+      .read(resources.cluster_lights, ResourceUsage::StorageBufferRead);
 
-        // Copy draw image resolve to swapchain image
-        cmd_encoder->copy_image_to_image(
-          ctx.draw_resolve_image->get(),
-          swapchain_image,
-          draw_extent,
-          swapchain_image_extent
+    if (write_motion_vectors) {
+        add_overlay_pass(graph, ctx, scene_desc_set, resources);
+    }
+}
+
+void
+Frame::add_deferred_passes(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources
+)
+{
+    if (ctx.sample_count != vk::SampleCountFlagBits::e1) {
+        throw std::runtime_error(
+          "Deferred rendering does not support multisampling"
         );
-    } else { // Multisampling is disabled
-        // Copy draw image to swapchain image
-        cmd_encoder->transition_image_layout(
-          ctx.draw_image,
-          vk::ImageLayout::eColorAttachmentOptimal,
-          vk::ImageLayout::eTransferSrcOptimal
+    }
+    const auto extent = graph.get_extent(resources.draw_image);
+    std::array<RenderGraphImage, GBuffer::ATTACHMENT_COUNT> gbuffer;
+    for (uint32_t i = 0; i < GBuffer::ATTACHMENT_COUNT; i++) {
+        gbuffer[i] = graph.create_image(
+          GBuffer::NAMES[i],
+          TransientImageDesc{ .format = GBuffer::FORMATS[i], .extent = extent }
         );
-        cmd_encoder->copy_image_to_image(
-          ctx.draw_image.get(),
-          swapchain_image,
-          draw_extent,
-          swapchain_image_extent
+    }
+
+    // Geometry pass: write surface attributes of opaque objects
+    auto geometry = graph.add_pass(
+      "gbuffer",
+      [this, &ctx, scene_desc_set](RenderGraphPassContext &pass) {
+          pass.render_pass->set_viewport_scissor(
+            ctx.draw_extent.width, ctx.draw_extent.height
+          );
+          draw_opaque_objects(
+            *pass.render_pass, ctx, scene_desc_set, OpaqueMaterial::GBuffer
+          );
+      }
+    );
+    for (const auto &attachment : gbuffer) {
+        geometry.write_color(
+          attachment, vk::ClearColorValue{ 0.0f, 0.0f, 0.0f, 0.0f }
         );
     }
+    geometry.write_depth(resources.draw_depth_image, 1.0f)
+      .set_render_area(ctx.draw_extent);
+    add_timestamp_pass(graph, GpuTimestamp::OpaqueEnd);
+
+    // Lighting pass: shade every pixel exactly once
+    auto lighting = graph.add_pass(
+      "deferred lighting",
+      [this, &ctx, scene_desc_set, gbuffer, resources](
+        RenderGraphPassContext &pass
+      ) {
+          draw_deferred_lighting(
+            pass, ctx, scene_desc_set, gbuffer, resources
+          );
+      }
+    );
+    for (const auto &attachment : gbuffer) {
+        lighting.read(attachment, ResourceUsage::ComputeSampled);
+    }
+    lighting.read(resources.draw_depth_image, ResourceUsage::ComputeSampled)
+      .write(resources.draw_image, ResourceUsage::ComputeStorageWrite)
+      .read(resources.shadow_map, ResourceUsage::ShaderSampled)
+      .read(resources.cluster_lights, ResourceUsage::StorageBufferRead);
+    add_timestamp_pass(graph, GpuTimestamp::LightingEnd);
 
-    // ImGui render commands (draw to swapchain image)
+    // Forward pass: transparent objects, skybox and grid on top of the lit
+    // image
+    add_overlay_pass(graph, ctx, scene_desc_set, resources);
+}
+
+void
+Frame::draw_deferred_lighting(
+  const RenderGraphPassContext &pass,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const std::array<RenderGraphImage, GBuffer::ATTACHMENT_COUNT> &gbuffer,
+  const FrameGraphResources &resources
+) const
+{
+    auto gbuffer_desc_set = desc_allocator->allocate(
+      ctx.render_resources.get_desc_set_layout("gbuffer"), ctx.device.get()
+    );
+    const auto sampler = ctx.render_resources.get_sampler(vk::Filter::eNearest);
+    auto inputs = std::array<RenderGraphImage, GBuffer::ATTACHMENT_COUNT + 1>{};
+    std::copy(gbuffer.begin(), gbuffer.end(), inputs.begin());
+    inputs.back() = resources.draw_depth_image;
+    DescriptorWriter writer{};
+    for (uint32_t i = 0; i < inputs.size(); i++) {
+        writer.write_image(
+          i,
+          pass.graph.get_view(inputs[i]),
+          sampler,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+    }
+    writer.write_image(
+      5,
+      pass.graph.get_view(resources.draw_image),
+      nullptr,
+      vk::ImageLayout::eGeneral,
+      vk::DescriptorType::eStorageImage
+    );
+    writer.update_set(ctx.device.get(), gbuffer_desc_set);
+
+    ComputePass compute_pass = pass.encoder.begin_compute_pass();
+    compute_pass.set_material(
+      ctx.render_resources.get_material_owned("deferred lighting")
+    );
+    compute_pass.set_desc_sets(0, { scene_desc_set, gbuffer_desc_set }, {});
+    // 8x8 invocations per workgroup
+    compute_pass.dispatch_workgroups(
+      (ctx.draw_extent.width + 7) / 8, (ctx.draw_extent.height + 7) / 8, 1
+    );
+}
+
+void
+Frame::add_visibility_passes(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources
+)
+{
+    if (ctx.sample_count != vk::SampleCountFlagBits::e1) {
+        throw std::runtime_error(
+          "Visibility buffer rendering does not support multisampling"
+        );
+    }
+    const auto visibility_image = graph.create_image(
+      "visibility image",
+      TransientImageDesc{ .format = VISIBILITY_FORMAT,
+                          .extent = graph.get_extent(resources.draw_image) }
+    );
+
+    auto draws_desc_set = desc_allocator->allocate(
+      ctx.render_resources.get_desc_set_layout("visibility draws"),
+      ctx.device.get()
+    );
     {
-        const auto depth_attachment =
-          vk::RenderingAttachmentInfo{}
-            .setImageView(ctx.swapchain.get_depth_image().get_view())
-            .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eClear)
-            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
-            .setClearValue(vk::ClearValue{}.setDepthStencil({ 1.0f, 0 }));
-        const auto color_attachment =
-          vk::RenderingAttachmentInfo{}
-            .setImageView(
-              ctx.swapchain.get_views().at(swapchain_image_index.value).get()
-            )
-            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
-            .setLoadOp(vk::AttachmentLoadOp::eLoad)
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
-            .setClearValue(vk::ClearValue{}.setColor({ 0.0f, 0.0f, 0.0f, 1.0f })
+        DescriptorWriter writer{};
+        writer.write_buffer(
+          0,
+          visibility_draw_buffer->get(),
+          visibility_draw_buffer->get_size(),
+          0,
+          vk::DescriptorType::eStorageBuffer
+        );
+        writer.update_set(ctx.device.get(), draws_desc_set);
+    }
+
+    auto visibility_draws = write_visibility_draws(ctx);
+
+    // Geometry pass: write triangle IDs of opaque objects
+    // 0 means no triangle
+    graph
+      .add_pass(
+        "visibility",
+        [this,
+         &ctx,
+         scene_desc_set,
+         draws_desc_set,
+         draw_objects = std::move(visibility_draws.objects)](
+          RenderGraphPassContext &pass
+        ) {
+            //------------------------------------------------------------------
+            const auto start = std::chrono::system_clock::now();
+            //------------------------------------------------------------------
+
+            auto &render_pass = *pass.render_pass;
+            render_pass.set_viewport_scissor(
+              ctx.draw_extent.width, ctx.draw_extent.height
             );
-        const auto render_area =
-          vk::Rect2D{}.setOffset({ 0, 0 }).setExtent(swapchain_image_extent);
-        RenderPass render_pass =
-          cmd_encoder->begin_render_pass(RenderPassCreateInfo{
-            .color_attachments = { color_attachment },
-            .depth_attachment = depth_attachment,
-            .render_area = render_area,
-          });
-        render_pass.set_viewport_scissor(
-          swapchain_image_extent.width, swapchain_image_extent.height
+            render_pass.set_material(
+              ctx.render_resources.get_material_owned("visibility")
+            );
+            render_pass.set_desc_sets(0, { scene_desc_set, draws_desc_set });
+            const auto *bindless_registry =
+              ctx.render_resources.get_bindless_registry();
+            render_pass.set_desc_sets(3, { bindless_registry->get_desc_set() });
+            bool alpha_mask = false;
+            for (uint32_t i = 0; i < draw_objects.size(); i++) {
+                const auto &object = *draw_objects[i];
+                // Masked objects come last, both pipelines share one layout
+                // so the bound sets stay valid
+                if (object.material_instance->alpha_mask && !alpha_mask) {
+                    render_pass.set_material(
+                      ctx.render_resources.get_material_owned(
+                        "visibility masked"
+                      )
+                    );
+                    alpha_mask = true;
+                }
+                render_pass.set_index_buffer(object.index_buffer);
+                render_pass.set_push_constants(utils::cast_to_bytes(i));
+                render_pass.draw_indexed(
+                  object.index_count, 1, object.first_index, 0, 0
+                );
+
+                ctx.stats.draw_call_count++;
+                ctx.stats.triangle_count += object.index_count / 3;
+            }
+
+            //------------------------------------------------------------------
+            const auto end = std::chrono::system_clock::now();
+            const auto elapsed =
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                end - start
+              );
+            ctx.stats.render_objects_draw_time += elapsed.count() / 1000.0f;
+            //------------------------------------------------------------------
+        }
+      )
+      .write_color(
+        visibility_image,
+        vk::ClearColorValue{ std::array<uint32_t, 4>{ 0, 0, 0, 0 } }
+      )
+      .write_depth(resources.draw_depth_image, 1.0f)
+      .set_render_area(ctx.draw_extent);
+    add_timestamp_pass(graph, GpuTimestamp::OpaqueEnd);
+
+    // Resolve pass: fetch the triangle of every pixel and shade it once
+    graph
+      .add_pass(
+        "visibility resolve",
+        [this,
+         &ctx,
+         scene_desc_set,
+         draws_desc_set,
+         visibility_image,
+         resources](RenderGraphPassContext &pass) {
+            resolve_visibility(
+              pass,
+              ctx,
+              scene_desc_set,
+              draws_desc_set,
+              visibility_image,
+              resources
+            );
+        }
+      )
+      .read(visibility_image, ResourceUsage::ComputeSampled)
+      .write(resources.draw_image, ResourceUsage::ComputeStorageWrite)
+      .read(resources.shadow_map, ResourceUsage::ShaderSampled)
+      .read(resources.cluster_lights, ResourceUsage::StorageBufferRead);
+    add_timestamp_pass(graph, GpuTimestamp::LightingEnd);
+
+    // Forward pass: opaque objects that didn't fit in the visibility buffer,
+    // then transparent objects, skybox and grid on top of the lit image
+    add_overlay_pass(
+      graph,
+      ctx,
+      scene_desc_set,
+      resources,
+      std::move(visibility_draws.overflow_objects)
+    );
+}
+
+VisibilityDraws
+Frame::write_visibility_draws(const DrawContext &ctx)
+{
+    // Gather visible opaque objects
+    // Alpha masked objects go last so the pipeline switches only once
+    std::vector<GpuVisibilityDraw> draws;
+    VisibilityDraws visibility_draws{};
+    const auto &viewproj = ctx.scene_data.viewproj;
+    std::vector<const RenderObject *> objects;
+    objects.reserve(ctx.opaque_objects.size());
+    for (const auto &object : ctx.opaque_objects) {
+        if (object.material_instance && !object.material_instance->alpha_mask &&
+            object.is_visible(viewproj)) {
+            objects.push_back(&object);
+        }
+    }
+    for (const auto &object : ctx.opaque_objects) {
+        if (object.material_instance && object.material_instance->alpha_mask &&
+            object.is_visible(viewproj)) {
+            objects.push_back(&object);
+        }
+    }
+    for (const auto *object_ptr : objects) {
+        const auto &object = *object_ptr;
+        if (draws.size() == MAX_VISIBILITY_DRAWS) {
+            visibility_draws.overflow_objects.push_back(&object);
+            continue;
+        }
+        draws.emplace_back(GpuVisibilityDraw{
+          .transform = object.transform,
+          .vertex_buffer = object.vertex_buffer_address,
+          .index_buffer = object.index_buffer_address,
+          .first_index = object.first_index,
+          .material_index = object.material_instance->bindless_material_index,
+          ._padding = {} });
+        visibility_draws.objects.push_back(&object);
+    }
+    visibility_draw_buffer->write(
+      draws.data(), sizeof(GpuVisibilityDraw) * draws.size()
+    );
+
+    if (visibility_draws.overflow_objects.empty()) {
+        visibility_overflow_warned = false;
+    } else if (!visibility_overflow_warned) {
+        spdlog::warn(
+          "Too many visibility buffer draws (max {}), drawing the rest forward",
+          MAX_VISIBILITY_DRAWS
         );
+        visibility_overflow_warned = true;
+    }
+    return visibility_draws;
+}
 
-        // ImGui
-        ImGui_ImplVulkan_RenderDrawData(
-          ImGui::GetDrawData(), render_pass.get_cmd()
+void
+Frame::resolve_visibility(
+  const RenderGraphPassContext &pass,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const vk::DescriptorSet &draws_desc_set,
+  RenderGraphImage visibility_image,
+  const FrameGraphResources &resources
+) const
+{
+    const auto *bindless_registry =
+      ctx.render_resources.get_bindless_registry();
+    if (bindless_registry == nullptr) {
+        throw std::runtime_error(
+          "Visibility buffer rendering requires bindless resources"
         );
     }
 
-    // Transition swapchain image layout to present src layout
-    cmd_encoder->transition_image_layout(
-      swapchain_image,
-      vk::ImageAspectFlagBits::eColor,
-      vk::ImageLayout::eTransferDstOptimal,
-      vk::ImageLayout::ePresentSrcKHR
+    auto visibility_desc_set = desc_allocator->allocate(
+      ctx.render_resources.get_desc_set_layout("visibility"), ctx.device.get()
+    );
+    DescriptorWriter writer{};
+    writer.write_image(
+      0,
+      pass.graph.get_view(visibility_image),
+      ctx.render_resources.get_sampler(vk::Filter::eNearest),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
+    writer.write_image(
+      1,
+      pass.graph.get_view(resources.draw_image),
+      nullptr,
+      vk::ImageLayout::eGeneral,
+      vk::DescriptorType::eStorageImage
     );
+    writer.update_set(ctx.device.get(), visibility_desc_set);
 
-    // Finish recording commands
-    auto cmd = cmd_encoder->finish();
-    //--------------------------------------------------------------------------
+    ComputePass compute_pass = pass.encoder.begin_compute_pass();
+    compute_pass.set_material(
+      ctx.render_resources.get_material_owned("visibility resolve")
+    );
+    compute_pass.set_desc_sets(
+      0,
+      { scene_desc_set,
+        draws_desc_set,
+        visibility_desc_set,
+        bindless_registry->get_desc_set() },
+      {}
+    );
+    // 8x8 invocations per workgroup
+    compute_pass.dispatch_workgroups(
+      (ctx.draw_extent.width + 7) / 8, (ctx.draw_extent.height + 7) / 8, 1
+    );
+}
 
-    // Submit command buffer to the graphics queue
-    auto wait_stages = std::array<vk::PipelineStageFlags, 1>{
-        vk::PipelineStageFlagBits::eColorAttachmentOutput
+void
+Frame::add_overlay_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources,
+  std::vector<const RenderObject *> &&opaque_objects
+)
+{
+    graph
+      .add_pass(
+        "overlay",
+        [this,
+         &ctx,
+         scene_desc_set,
+         opaque_objects = std::move(opaque_objects)](
+          RenderGraphPassContext &pass
+        ) {
+            auto &render_pass = *pass.render_pass;
+            render_pass.set_viewport_scissor(
+              ctx.draw_extent.width, ctx.draw_extent.height
+            );
+
+            for (const auto *object : opaque_objects) {
+                draw_render_object(
+                  render_pass,
+                  ctx,
+                  scene_desc_set,
+                  *object,
+                  object->material_instance->material
+                );
+            }
+            draw_transparent_objects(render_pass, ctx, scene_desc_set);
+            draw_skybox(render_pass, ctx);
+            draw_grid(render_pass, ctx, scene_desc_set);
+        }
+      )
+      .write_color(resources.draw_image)
+      .write_depth(resources.draw_depth_image)
+      .set_render_area(ctx.draw_extent)
+      .read(resources.shadow_map, ResourceUsage::ShaderSampled)
+      .read(resources.cluster_lights, ResourceUsage::StorageBufferRead);
+}
+
+RenderGraphImage
+Frame::add_taa_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  const FrameGraphResources &resources
+)
+{
+    auto &taa = *ctx.taa;
+    const auto push_constants = GpuTaaPushConstants{
+        .history_uv_scale = taa.get_history_uv_scale(),
+        .has_history = taa.has_history() ? 1u : 0u,
+        .has_motion_vectors = resources.motion_vectors.is_valid() ? 1u : 0u,
     };
-    ctx.device.get_graphics_queue().submit(
-      vk::SubmitInfo{}
-        .setPWaitDstStageMask(wait_stages.data())
-        .setWaitSemaphores(present_semaphore.get())
-        .setSignalSemaphores(render_semaphore.get())
-        .setCommandBuffers(cmd),
-      render_fence.get()
+
+    // The output is the history of the next frame, which picks it up in the
+    // usage it was left in
+    auto history_info = ImportedImageInfo{};
+    if (taa.has_history()) {
+        history_info.initial_usage = ResourceUsage::ComputeSampled;
+    }
+    const auto history =
+      graph.import_image("taa history", taa.get_history(), history_info);
+    const auto output = graph.import_image(
+      "taa output",
+      taa.get_output(),
+      ImportedImageInfo{ .final_usage = ResourceUsage::ComputeSampled }
     );
+    // Without motion vectors the depth image is bound in their place, and the
+    // shader never reads it as such
+    const auto motion_vectors = push_constants.has_motion_vectors
+                                  ? resources.motion_vectors
+                                  : resources.draw_depth_image;
 
-    present(swapchain_image_index.value, ctx);
+    auto taa_pass = graph.add_pass(
+      "taa resolve",
+      [this,
+       &ctx,
+       scene_desc_set,
+       resources,
+       motion_vectors,
+       history,
+       output,
+       push_constants](RenderGraphPassContext &pass) {
+          auto taa_desc_set = desc_allocator->allocate(
+            ctx.render_resources.get_desc_set_layout("taa"), ctx.device.get()
+          );
+          const auto inputs = std::array{ resources.draw_image,
+                                          resources.draw_depth_image,
+                                          motion_vectors,
+                                          history };
+          DescriptorWriter writer{};
+          for (uint32_t i = 0; i < inputs.size(); i++) {
+              // Only the history is sampled between texels
+              const auto filter =
+                inputs[i].index == history.index ? vk::Filter::eLinear
+                                                 : vk::Filter::eNearest;
+              writer.write_image(
+                i,
+                pass.graph.get_view(inputs[i]),
+                ctx.render_resources.get_sampler(filter),
+                vk::ImageLayout::eShaderReadOnlyOptimal,
+                vk::DescriptorType::eCombinedImageSampler
+              );
+          }
+          writer.write_image(
+            4,
+            pass.graph.get_view(output),
+            nullptr,
+            vk::ImageLayout::eGeneral,
+            vk::DescriptorType::eStorageImage
+          );
+          writer.update_set(ctx.device.get(), taa_desc_set);
+
+          ComputePass compute_pass = pass.encoder.begin_compute_pass();
+          compute_pass.set_material(
+            ctx.render_resources.get_material_owned("taa resolve")
+          );
+          compute_pass.set_desc_sets(0, { scene_desc_set, taa_desc_set }, {});
+          compute_pass.set_push_constants(
+            utils::cast_to_bytes(push_constants)
+          );
+          // 8x8 invocations per workgroup
+          compute_pass.dispatch_workgroups(
+            (ctx.draw_extent.width + 7) / 8,
+            (ctx.draw_extent.height + 7) / 8,
+            1
+          );
+      }
+    );
+    taa_pass.read(resources.draw_image, ResourceUsage::ComputeSampled)
+      .read(resources.draw_depth_image, ResourceUsage::ComputeSampled)
+      .read(history, ResourceUsage::ComputeSampled)
+      .write(output, ResourceUsage::ComputeStorageWrite);
+    if (push_constants.has_motion_vectors) {
+        taa_pass.read(resources.motion_vectors, ResourceUsage::ComputeSampled);
+    }
+    return output;
+}
+
+vk::DescriptorSet
+Frame::write_texture_desc_set(
+  const DrawContext &ctx,
+  vk::ImageView view,
+  vk::Sampler sampler
+) const
+{
+    auto desc_set = desc_allocator->allocate(
+      ctx.render_resources.get_desc_set_layout("texture"), ctx.device.get()
+    );
+    DescriptorWriter writer{};
+    writer.write_image(
+      0,
+      view,
+      sampler,
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::DescriptorType::eCombinedImageSampler
+    );
+    writer.update_set(ctx.device.get(), desc_set);
+    return desc_set;
+}
+
+void
+Frame::add_upscale_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  RenderGraphImage source,
+  RenderGraphImage target
+)
+{
+    graph
+      .add_pass(
+        "upscale",
+        [this, &ctx, source](RenderGraphPassContext &pass) {
+            const auto desc_set = write_texture_desc_set(
+              ctx,
+              pass.graph.get_view(source),
+              ctx.render_resources.get_sampler(vk::Filter::eNearest)
+            );
+            const auto output_extent = ctx.swapchain.get_extent();
+
+            auto &render_pass = *pass.render_pass;
+            render_pass.set_viewport_scissor(
+              output_extent.width, output_extent.height
+            );
+            render_pass.set_material(
+              ctx.render_resources.get_material_owned("upscale")
+            );
+            render_pass.set_desc_sets(0, { desc_set }, {});
+            render_pass.set_push_constants(
+              utils::cast_to_bytes(GpuUpscalePushConstants{
+                .input_size =
+                  glm::vec2(ctx.draw_extent.width, ctx.draw_extent.height),
+                .output_size =
+                  glm::vec2(output_extent.width, output_extent.height) })
+            );
+            render_pass.draw(3, 1, 0, 0);
+        }
+      )
+      .read(source, ResourceUsage::FragmentSampled)
+      .write_color(target);
+}
+
+void
+Frame::add_composite_pass(
+  RenderGraph &graph,
+  const DrawContext &ctx,
+  RenderGraphImage source,
+  RenderGraphImage swapchain_image,
+  float sharpening
+)
+{
+    // The composite covers every pixel, so the swapchain image is never
+    // cleared or loaded
+    graph
+      .add_pass(
+        "composite",
+        [this, &ctx, source, sharpening](RenderGraphPassContext &pass) {
+            const auto desc_set = write_texture_desc_set(
+              ctx,
+              pass.graph.get_view(source),
+              ctx.render_resources.get_sampler(vk::Filter::eNearest)
+            );
+            const auto swapchain_extent = ctx.swapchain.get_extent();
+
+            auto &render_pass = *pass.render_pass;
+            render_pass.set_viewport_scissor(
+              swapchain_extent.width, swapchain_extent.height
+            );
+            render_pass.set_material(
+              ctx.render_resources.get_material_owned("composite")
+            );
+            render_pass.set_desc_sets(0, { desc_set }, {});
+            render_pass.set_push_constants(utils::cast_to_bytes(
+              GpuCompositePushConstants{ .sharpening = sharpening }
+            ));
+            render_pass.draw(3, 1, 0, 0);
+
+            // ImGui
+            ImGui_ImplVulkan_RenderDrawData(
+              ImGui::GetDrawData(), render_pass.get_cmd()
+            );
+        }
+      )
+      .read(source, ResourceUsage::FragmentSampled)
+      .write_color(swapchain_image);
 }
 
 void
@@ -319,41 +1359,43 @@ Frame::draw_skybox(RenderPass &pass, const DrawContext &ctx) const
 }
 
 void
-Frame::draw_render_objects(
+Frame::draw_render_object(
   RenderPass &pass,
   const DrawContext &ctx,
-  const vk::DescriptorSet &scene_desc_set
+  const vk::DescriptorSet &scene_desc_set,
+  const RenderObject &object,
+  const std::shared_ptr<Material> &material
 ) const
 {
-    //--------------------------------------------------------------------------
-    ctx.stats.draw_call_count = 0;
-    ctx.stats.triangle_count = 0;
-    const auto start = std::chrono::system_clock::now();
-    //--------------------------------------------------------------------------
-
-    auto draw_render_object = [&](const RenderObject &object) {
-        if (!object.material_instance) {
-            spdlog::error("Material Instance is null");
-            return;
-        }
+    pass.set_material(material);
+    pass.set_desc_sets(
+      0, { scene_desc_set, object.material_instance->desc_set }
+    );
+    pass.set_index_buffer(object.index_buffer);
 
-        pass.set_material(object.material_instance->material);
-        pass.set_desc_sets(
-          0, { scene_desc_set, object.material_instance->desc_set }
-        );
-        pass.set_index_buffer(object.index_buffer);
+    // Update push constants
+    pass.set_push_constants(utils::cast_to_bytes(GpuPushConstants{
+      .object_transform = object.transform,
+      .vertex_buffer = object.vertex_buffer_address }));
 
-        // Update push constants
-        pass.set_push_constants(utils::cast_to_bytes(GpuPushConstants{
-          .object_transform = object.transform,
-          .vertex_buffer = object.vertex_buffer_address }));
+    // Draw
+    pass.draw_indexed(object.index_count, 1, object.first_index, 0, 0);
 
-        // Draw
-        pass.draw_indexed(object.index_count, 1, object.first_index, 0, 0);
+    ctx.stats.draw_call_count++;
+    ctx.stats.triangle_count += object.index_count / 3;
+}
 
-        ctx.stats.draw_call_count++;
-        ctx.stats.triangle_count += object.index_count / 3;
-    };
+void
+Frame::draw_opaque_objects(
+  RenderPass &pass,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set,
+  OpaqueMaterial opaque_material
+) const
+{
+    //--------------------------------------------------------------------------
+    const auto start = std::chrono::system_clock::now();
+    //--------------------------------------------------------------------------
 
     std::vector<uint32_t> opaque_draws;
     opaque_draws.reserve(ctx.opaque_objects.size());
@@ -381,14 +1423,61 @@ Frame::draw_render_objects(
     const auto &viewproj = ctx.scene_data.viewproj;
     for (const auto &object_index : opaque_draws) {
         const auto &object = ctx.opaque_objects[object_index];
+        if (!object.material_instance) {
+            spdlog::error("Material Instance is null");
+            continue;
+        }
+        const auto &material_instance = *object.material_instance;
+        const auto &material =
+          opaque_material == OpaqueMaterial::GBuffer
+            ? material_instance.gbuffer_material
+          : opaque_material == OpaqueMaterial::ForwardMotion
+            ? material_instance.motion_material
+            : material_instance.material;
+        if (!material) {
+            spdlog::error(
+              "Material Instance has no material for this opaque pass"
+            );
+            continue;
+        }
         if (object.is_visible(viewproj)) {
-            draw_render_object(object);
+            draw_render_object(pass, ctx, scene_desc_set, object, material);
         }
     }
 
+    //--------------------------------------------------------------------------
+    const auto end = std::chrono::system_clock::now();
+    const auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    ctx.stats.render_objects_draw_time += elapsed.count() / 1000.0f;
+    //--------------------------------------------------------------------------
+}
+
+void
+Frame::draw_transparent_objects(
+  RenderPass &pass,
+  const DrawContext &ctx,
+  const vk::DescriptorSet &scene_desc_set
+) const
+{
+    //--------------------------------------------------------------------------
+    const auto start = std::chrono::system_clock::now();
+    //--------------------------------------------------------------------------
+
+    const auto &viewproj = ctx.scene_data.viewproj;
     for (const auto &object : ctx.transparent_objects) {
+        if (!object.material_instance) {
+            spdlog::error("Material Instance is null");
+            continue;
+        }
         if (object.is_visible(viewproj)) {
-            draw_render_object(object);
+            draw_render_object(
+              pass,
+              ctx,
+              scene_desc_set,
+              object,
+              object.material_instance->material
+            );
         }
     }
 
@@ -396,7 +1485,7 @@ Frame::draw_render_objects(
     const auto end = std::chrono::system_clock::now();
     const auto elapsed =
       std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    ctx.stats.render_objects_draw_time = elapsed.count() / 1000.0f;
+    ctx.stats.render_objects_draw_time += elapsed.count() / 1000.0f;
     //--------------------------------------------------------------------------
 }
 
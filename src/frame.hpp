@@ -1,7 +1,12 @@
 #pragma once
 
 #include "draw_context.hpp"
+#include "gbuffer.hpp"
+#include "render_graph.hpp"
+
+#include <array>
 #include <memory>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
@@ -12,6 +17,66 @@ class CommandEncoder;
 class DescriptorAllocator;
 class ComputePass;
 class RenderPass;
+class Material;
+
+// Visibility buffer texels store (draw index + 1) in the upper bits and the
+// primitive ID in the lower bits
+// Must match the constants in shaders/visibility_data.glsl
+static constexpr uint32_t VISIBILITY_PRIMITIVE_BITS = 23;
+static constexpr uint32_t MAX_VISIBILITY_DRAWS =
+  (1u << (32 - VISIBILITY_PRIMITIVE_BITS)) - 1;
+static constexpr vk::Format VISIBILITY_FORMAT = vk::Format::eR32Uint;
+
+static constexpr vk::Format DRAW_IMAGE_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+static constexpr vk::Format DRAW_DEPTH_FORMAT = vk::Format::eD32Sfloat;
+// Pixels nothing was drawn to, before the skybox
+// Must match BACKGROUND_COLOR in shaders/scene_data.glsl
+static constexpr std::array<float, 4> BACKGROUND_COLOR = {
+    0.1f, 0.1f, 0.1f, 1.0f
+};
+
+// GPU timestamps written each frame
+enum class GpuTimestamp : uint32_t
+{
+    FrameBegin,
+    ShadowEnd,
+    OpaqueEnd,
+    LightingEnd,
+    FrameEnd,
+    Count
+};
+
+// Material of MaterialInstance that opaque objects are drawn with
+enum class OpaqueMaterial : uint8_t
+{
+    Forward,
+    // Also writes motion vectors
+    ForwardMotion,
+    // Writes to the G-buffer instead of shading
+    GBuffer,
+};
+
+// Images and buffers of the frame graph that the shading passes use
+struct FrameGraphResources
+{
+    RenderGraphImage draw_image;
+    RenderGraphImage draw_depth_image;
+    // Only valid with multisampling, the draw image is resolved to it
+    RenderGraphImage draw_resolve_image;
+    // Only valid with temporal anti-aliasing on the forward path
+    RenderGraphImage motion_vectors;
+    RenderGraphImage shadow_map;
+    RenderGraphBuffer cluster_lights;
+};
+
+// Opaque objects of the visibility path
+struct VisibilityDraws
+{
+    // In the order of their draw indices
+    std::vector<const RenderObject *> objects;
+    // Past MAX_VISIBILITY_DRAWS, drawn forward in the overlay pass instead
+    std::vector<const RenderObject *> overflow_objects;
+};
 
 class Frame
 {
@@ -21,9 +86,11 @@ class Frame
     Frame() = delete;
     Frame(const Frame &) = delete;
 
-    [[nodiscard]] vk::Fence get_render_fence() const noexcept
+    // Frame timeline value signaled when the last submission of this frame
+    // has finished (zero if it was never submitted)
+    [[nodiscard]] uint64_t get_timeline_value() const noexcept
     {
-        return render_fence.get();
+        return timeline_value;
     }
 
     void draw(const DrawContext &&ctx);
@@ -34,16 +101,162 @@ class Frame
     // Signals when rendering is done
     // This happens when the command buffer gets submitted to the graphics queue
     vk::UniqueSemaphore render_semaphore;
-    // Signals when render commands all finish execution
-    vk::UniqueFence render_fence;
+    // Frame timeline value of the last submission
+    uint64_t timeline_value = 0;
     std::unique_ptr<CommandEncoder> cmd_encoder;
+    // Only created if the device has a dedicated compute queue family
+    // Records compute work that runs next to the graphics work of the frame
+    std::unique_ptr<CommandEncoder> compute_cmd_encoder;
+    // Signals when the async compute work of the frame is done
+    vk::UniqueSemaphore compute_semaphore;
     std::unique_ptr<DescriptorAllocator> desc_allocator;
 
     std::unique_ptr<GpuBuffer> scene_buffer;
     std::unique_ptr<GpuBuffer> material_buffer;
+    // Stores GpuLight for every light in the scene
+    std::unique_ptr<GpuBuffer> light_buffer;
+    // Stores the light count and light indices of every cluster
+    std::unique_ptr<GpuBuffer> cluster_light_buffer;
+    // Stores GpuVisibilityDraw for every opaque object drawn to the
+    // visibility buffer
+    std::unique_ptr<GpuBuffer> visibility_draw_buffer;
+    // Set while the visible opaque objects don't fit in the visibility
+    // buffer, so the overflow is reported once each time it starts
+    bool visibility_overflow_warned = false;
+
+    // Timestamps used to measure the GPU time of each pass
+    vk::UniqueQueryPool timestamp_pool;
+    // Timestamps are only available after this frame has been submitted once
+    bool timestamps_written = false;
 
+    void read_gpu_timings(const DrawContext &ctx) const;
+    void write_timestamp(GpuTimestamp timestamp) const;
+
+    void add_timestamp_pass(RenderGraph &graph, GpuTimestamp timestamp);
+    // Re-render the shadow cascades that are not cached
+    void add_shadow_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const FrameGraphResources &resources
+    );
+    void draw_shadows(const DrawContext &ctx) const;
+    // Assign lights to clusters on the graphics queue
+    void add_cluster_light_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources
+    );
+    // Record cluster light assignment to the given encoder
+    // On the async compute queue, the cluster light buffer is released to the
+    // graphics queue afterwards
+    void assign_lights_to_clusters(
+      CommandEncoder &encoder,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      bool async_compute
+    ) const;
+    // Submit the compute work that doesn't depend on this frame's graphics
+    // work to the async compute queue
+    void submit_async_compute(
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set
+    );
+    // Shade opaque objects while rasterizing them
+    void add_forward_passes(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources
+    );
+    // Write opaque objects to the G-buffer, then shade each pixel once
+    void add_deferred_passes(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources
+    );
+    void draw_deferred_lighting(
+      const RenderGraphPassContext &pass,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const std::array<RenderGraphImage, GBuffer::ATTACHMENT_COUNT> &gbuffer,
+      const FrameGraphResources &resources
+    ) const;
+    // Write triangle IDs of opaque objects to the visibility buffer, then
+    // fetch the triangles and shade each pixel once
+    void add_visibility_passes(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources
+    );
+    [[nodiscard]] VisibilityDraws write_visibility_draws(const DrawContext &ctx
+    );
+    void resolve_visibility(
+      const RenderGraphPassContext &pass,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const vk::DescriptorSet &draws_desc_set,
+      RenderGraphImage visibility_image,
+      const FrameGraphResources &resources
+    ) const;
+    // Draw transparent objects, skybox and grid on top of the shaded draw
+    // image, depth tested against the opaque depth
+    // Opaque objects the shading pass couldn't draw are drawn forward first.
+    void add_overlay_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources,
+      std::vector<const RenderObject *> &&opaque_objects = {}
+    );
+    // Blend the draw image with the reprojected history into the output of
+    // the temporal anti-aliasing, and return the output
+    [[nodiscard]] RenderGraphImage add_taa_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const FrameGraphResources &resources
+    );
+    // Descriptor set of the "texture" layout
+    [[nodiscard]] vk::DescriptorSet write_texture_desc_set(
+      const DrawContext &ctx,
+      vk::ImageView view,
+      vk::Sampler sampler
+    ) const;
+    // Edge-adaptive spatial upscale of the drawn part of source to target,
+    // which is as large as the swapchain image
+    void add_upscale_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      RenderGraphImage source,
+      RenderGraphImage target
+    );
+    // Copy source, as large as the swapchain image, to the swapchain image
+    // with contrast-adaptive sharpening, then draw ImGui on top
+    void add_composite_pass(
+      RenderGraph &graph,
+      const DrawContext &ctx,
+      RenderGraphImage source,
+      RenderGraphImage swapchain_image,
+      float sharpening
+    );
     void draw_skybox(RenderPass &pass, const DrawContext &ctx) const;
-    void draw_render_objects(
+    void draw_render_object(
+      RenderPass &pass,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      const RenderObject &object,
+      const std::shared_ptr<Material> &material
+    ) const;
+    void draw_opaque_objects(
+      RenderPass &pass,
+      const DrawContext &ctx,
+      const vk::DescriptorSet &scene_desc_set,
+      OpaqueMaterial opaque_material
+    ) const;
+    void draw_transparent_objects(
       RenderPass &pass,
       const DrawContext &ctx,
       const vk::DescriptorSet &scene_desc_set
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Render path used to shade opaque objects
+enum class RenderPath : uint8_t
+{
+    Forward,
+    Deferred,
+    // Rasterize triangle IDs, then shade every pixel once from the IDs
+    Visibility
+};
+
+// Color attachments written by the deferred geometry pass
+// They are transient images of the render graph of each frame.
+// Must match the outputs of shaders/pbr-gbuffer.frag
+struct GBuffer
+{
+    static constexpr uint32_t ATTACHMENT_COUNT = 4;
+    // albedo, normal, metal/rough/AO, emissive
+    static constexpr std::array<vk::Format, ATTACHMENT_COUNT> FORMATS = {
+        vk::Format::eR8G8B8A8Unorm,
+        vk::Format::eR16G16B16A16Sfloat,
+        vk::Format::eR8G8B8A8Unorm,
+        vk::Format::eR8G8B8A8Unorm,
+    };
+    static constexpr std::array<const char *, ATTACHMENT_COUNT> NAMES = {
+        "gbuffer albedo",
+        "gbuffer normal",
+        "gbuffer material",
+        "gbuffer emissive",
+    };
+};
+} // namespace kovra
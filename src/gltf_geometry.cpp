@@ -0,0 +1,399 @@
+#include "gltf_geometry.hpp"
+
+#include "fastgltf/glm_element_traits.hpp"
+#include "fastgltf/tools.hpp"
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+namespace kovra {
+namespace {
+// Floats from the start of GpuVertexData to each of its members
+constexpr size_t VERTEX_STRIDE = sizeof(GpuVertexData) / sizeof(float);
+constexpr size_t POSITION_OFFSET = offsetof(GpuVertexData, position) / 4;
+constexpr size_t UV_X_OFFSET = offsetof(GpuVertexData, uv_x) / 4;
+constexpr size_t NORMAL_OFFSET = offsetof(GpuVertexData, normal) / 4;
+constexpr size_t UV_Y_OFFSET = offsetof(GpuVertexData, uv_y) / 4;
+constexpr size_t COLOR_OFFSET = offsetof(GpuVertexData, color) / 4;
+
+const auto DEFAULT_VERTEX =
+  GpuVertexData{ .position = glm::vec3(0.0f),
+                 .uv_x = 0.0f,
+                 .normal = glm::vec3(0.0f, 1.0f, 0.0f),
+                 .uv_y = 0.0f,
+                 .color = glm::vec4(1.0f) };
+
+// Copy the first N floats of count strided elements, dst_stride is in floats
+// A memcpy of a constant size compiles to plain vector loads and stores, and
+// doesn't care whether the elements are aligned in the buffer
+template<size_t N>
+void
+read_floats(
+  const std::byte *src,
+  size_t src_stride,
+  size_t count,
+  float *dst,
+  size_t dst_stride
+)
+{
+    for (size_t i = 0; i < count; i++) {
+        std::memcpy(
+          dst + i * dst_stride, src + i * src_stride, N * sizeof(float)
+        );
+    }
+}
+
+template<typename T>
+void
+read_indices(
+  const std::byte *src,
+  size_t src_stride,
+  size_t count,
+  uint32_t base,
+  uint32_t *dst
+)
+{
+    for (size_t i = 0; i < count; i++) {
+        T index;
+        std::memcpy(&index, src + i * src_stride, sizeof(T));
+        dst[i] = base + index;
+    }
+}
+} // namespace
+
+std::span<const std::byte>
+get_buffer_bytes(const fastgltf::Buffer &buffer)
+{
+    return std::visit(
+      [](const auto &source) -> std::span<const std::byte> {
+          if constexpr (requires {
+                            source.bytes.data();
+                            source.bytes.size();
+                        }) {
+              return std::as_bytes(
+                std::span{ source.bytes.data(), source.bytes.size() }
+              );
+          } else {
+              return {};
+          }
+      },
+      buffer.data
+    );
+}
+
+GltfMeshReader::GltfMeshReader(
+  const fastgltf::Asset &asset,
+  const fastgltf::Mesh &mesh,
+  bool normals_as_colors
+)
+  : asset{ asset }
+  , normals_as_colors{ normals_as_colors }
+{
+    primitives.reserve(mesh.primitives.size());
+    for (const auto &p : mesh.primitives) {
+        const auto position = p.findAttribute("POSITION");
+        if (position == p.attributes.end() || !p.indicesAccessor.has_value()) {
+            spdlog::error(
+              "Primitive without positions or indices in mesh: {}", mesh.name
+            );
+            throw std::runtime_error("Unsupported glTF primitive");
+        }
+
+        auto &primitive = primitives.emplace_back();
+        primitive.first_vertex = vertex_count;
+        primitive.first_index = index_count;
+        primitive.min_position = glm::vec3(std::numeric_limits<float>::max());
+        primitive.max_position =
+          glm::vec3(std::numeric_limits<float>::lowest());
+
+        const auto &position_accessor = asset.accessors[position->second];
+        primitive.vertex_count = position_accessor.count;
+        primitive.positions =
+          read_float_accessor<glm::vec3, 3>(position_accessor, primitive);
+
+        const auto &index_accessor =
+          asset.accessors[p.indicesAccessor.value()];
+        primitive.index_count = index_accessor.count;
+        primitive.indices = read_index_accessor(index_accessor, primitive);
+
+        // Missing attributes keep the values of DEFAULT_VERTEX
+        const auto find_attribute =
+          [&](std::string_view name) -> const fastgltf::Accessor * {
+            const auto attribute = p.findAttribute(name);
+            if (attribute == p.attributes.end()) {
+                spdlog::warn("No {} found in mesh: {}", name, mesh.name);
+                return nullptr;
+            }
+            const auto &accessor = asset.accessors[attribute->second];
+            if (accessor.count < primitive.vertex_count) {
+                spdlog::error(
+                  "{} of mesh {} has fewer elements than POSITION",
+                  name,
+                  mesh.name
+                );
+                throw std::runtime_error("Invalid glTF attribute");
+            }
+            return &accessor;
+        };
+        if (const auto *normals = find_attribute("NORMAL")) {
+            primitive.normals =
+              read_float_accessor<glm::vec3, 3>(*normals, primitive);
+        }
+        if (const auto *uvs = find_attribute("TEXCOORD_0")) {
+            primitive.uvs = read_float_accessor<glm::vec2, 2>(*uvs, primitive);
+        }
+        // Only RGB is kept, like in Vertex
+        if (const auto *colors = find_attribute("COLOR_0")) {
+            primitive.colors =
+              read_float_accessor<glm::vec4, 3>(*colors, primitive);
+        }
+
+        vertex_count += primitive.vertex_count;
+        index_count += primitive.index_count;
+    }
+}
+
+Bounds
+GltfMeshReader::get_bounds(size_t primitive) const
+{
+    const auto &p = primitives[primitive];
+    if (p.vertex_count == 0) {
+        return Bounds{};
+    }
+    auto bounds = Bounds{
+        .origin = (p.min_position + p.max_position) / 2.0f,
+        .extents = (p.max_position - p.min_position) / 2.0f,
+    };
+    // Use extents length as sphere radius
+    bounds.sphere_radius = glm::length(bounds.extents);
+    return bounds;
+}
+
+void
+GltfMeshReader::write_vertices(
+  std::span<std::byte> dst,
+  size_t first,
+  size_t count
+)
+{
+    auto *vertices = reinterpret_cast<GpuVertexData *>(dst.data());
+    for (auto &primitive : primitives) {
+        const size_t begin = std::max(first, primitive.first_vertex);
+        const size_t end = std::min(
+          first + count, primitive.first_vertex + primitive.vertex_count
+        );
+        for (size_t block = begin; block < end; block += VERTEX_BLOCK_SIZE) {
+            write_vertex_block(
+              primitive,
+              block - primitive.first_vertex,
+              std::min(VERTEX_BLOCK_SIZE, end - block),
+              vertices + (block - first)
+            );
+        }
+    }
+}
+
+void
+GltfMeshReader::write_indices(
+  std::span<std::byte> dst,
+  size_t first,
+  size_t count
+) const
+{
+    auto *indices = reinterpret_cast<uint32_t *>(dst.data());
+    for (const auto &primitive : primitives) {
+        const size_t begin = std::max(first, primitive.first_index);
+        const size_t end = std::min(
+          first + count, primitive.first_index + primitive.index_count
+        );
+        if (begin >= end) {
+            continue;
+        }
+
+        const auto &src = primitive.indices;
+        const auto *data =
+          src.data + (begin - primitive.first_index) * src.stride;
+        const auto base = static_cast<uint32_t>(primitive.first_vertex);
+        auto *out = indices + (begin - first);
+        switch (src.component_type) {
+            case fastgltf::ComponentType::UnsignedByte:
+                read_indices<uint8_t>(data, src.stride, end - begin, base, out);
+                break;
+            case fastgltf::ComponentType::UnsignedShort:
+                read_indices<uint16_t>(
+                  data, src.stride, end - begin, base, out
+                );
+                break;
+            default:
+                read_indices<uint32_t>(
+                  data, src.stride, end - begin, base, out
+                );
+                break;
+        }
+    }
+}
+
+template<typename T, size_t component_count>
+GltfMeshReader::AccessorSource
+GltfMeshReader::read_float_accessor(
+  const fastgltf::Accessor &accessor,
+  Primitive &primitive
+)
+{
+    if (auto source = find_accessor_source(accessor);
+        source.has_value() &&
+        accessor.componentType == fastgltf::ComponentType::Float &&
+        fastgltf::getNumComponents(accessor.type) >= component_count) {
+        return source.value();
+    }
+
+    auto &storage = primitive.decoded.emplace_back(sizeof(T) * accessor.count);
+    auto *elements = reinterpret_cast<T *>(storage.data());
+    fastgltf::iterateAccessorWithIndex<T>(
+      asset, accessor, [elements](T element, size_t i) {
+          elements[i] = element;
+      }
+    );
+    bytes_copied += storage.size();
+    return AccessorSource{ .data = storage.data(), .stride = sizeof(T) };
+}
+
+GltfMeshReader::AccessorSource
+GltfMeshReader::read_index_accessor(
+  const fastgltf::Accessor &accessor,
+  Primitive &primitive
+)
+{
+    if (auto source = find_accessor_source(accessor);
+        source.has_value() && accessor.type == fastgltf::AccessorType::Scalar &&
+        (accessor.componentType == fastgltf::ComponentType::UnsignedByte ||
+         accessor.componentType == fastgltf::ComponentType::UnsignedShort ||
+         accessor.componentType == fastgltf::ComponentType::UnsignedInt)) {
+        return source.value();
+    }
+
+    auto &storage =
+      primitive.decoded.emplace_back(sizeof(uint32_t) * accessor.count);
+    auto *elements = reinterpret_cast<uint32_t *>(storage.data());
+    fastgltf::iterateAccessorWithIndex<uint32_t>(
+      asset, accessor, [elements](uint32_t index, size_t i) {
+          elements[i] = index;
+      }
+    );
+    bytes_copied += storage.size();
+    return AccessorSource{
+        .data = storage.data(),
+        .stride = sizeof(uint32_t),
+        .component_type = fastgltf::ComponentType::UnsignedInt,
+    };
+}
+
+std::optional<GltfMeshReader::AccessorSource>
+GltfMeshReader::find_accessor_source(const fastgltf::Accessor &accessor) const
+{
+    if (!accessor.bufferViewIndex.has_value() || accessor.sparse.has_value() ||
+        accessor.normalized || accessor.count == 0) {
+        return std::nullopt;
+    }
+    const auto &view = asset.bufferViews[accessor.bufferViewIndex.value()];
+    const auto bytes = get_buffer_bytes(asset.buffers[view.bufferIndex]);
+    const size_t element_size =
+      fastgltf::getElementByteSize(accessor.type, accessor.componentType);
+    const size_t stride =
+      view.byteStride.has_value() ? view.byteStride.value() : element_size;
+
+    // Leave accessors that reach past their view or buffer to fastgltf
+    const size_t size = accessor.byteOffset +
+                        (accessor.count - 1) * stride + element_size;
+    if (bytes.empty() || view.byteOffset > bytes.size() ||
+        view.byteLength > bytes.size() - view.byteOffset ||
+        size > view.byteLength) {
+        return std::nullopt;
+    }
+    return AccessorSource{
+        .data = bytes.data() + view.byteOffset + accessor.byteOffset,
+        .stride = stride,
+        .component_type = accessor.componentType,
+    };
+}
+
+void
+GltfMeshReader::write_vertex_block(
+  Primitive &primitive,
+  size_t first,
+  size_t count,
+  GpuVertexData *vertices
+) const
+{
+    std::array<GpuVertexData, VERTEX_BLOCK_SIZE> block;
+    std::fill_n(block.begin(), count, DEFAULT_VERTEX);
+    auto *floats = reinterpret_cast<float *>(block.data());
+
+    // One pass per attribute, each a tight loop over strided elements
+    const auto source = [first](const AccessorSource &src) {
+        return src.data + first * src.stride;
+    };
+    const auto &positions = primitive.positions;
+    read_floats<3>(
+      source(positions),
+      positions.stride,
+      count,
+      floats + POSITION_OFFSET,
+      VERTEX_STRIDE
+    );
+    if (const auto &normals = primitive.normals; normals.has_value()) {
+        read_floats<3>(
+          source(normals.value()),
+          normals->stride,
+          count,
+          floats + NORMAL_OFFSET,
+          VERTEX_STRIDE
+        );
+    }
+    if (const auto &uvs = primitive.uvs; uvs.has_value()) {
+        // The two halves of a UV are stored apart to pad the vectors
+        read_floats<1>(
+          source(uvs.value()),
+          uvs->stride,
+          count,
+          floats + UV_X_OFFSET,
+          VERTEX_STRIDE
+        );
+        read_floats<1>(
+          source(uvs.value()) + sizeof(float),
+          uvs->stride,
+          count,
+          floats + UV_Y_OFFSET,
+          VERTEX_STRIDE
+        );
+    }
+    if (const auto &colors = primitive.colors; colors.has_value()) {
+        read_floats<3>(
+          source(colors.value()),
+          colors->stride,
+          count,
+          floats + COLOR_OFFSET,
+          VERTEX_STRIDE
+        );
+    }
+
+    // Bounds are taken while the block is still in the cache
+    for (size_t i = 0; i < count; i++) {
+        primitive.min_position =
+          glm::min(primitive.min_position, block[i].position);
+        primitive.max_position =
+          glm::max(primitive.max_position, block[i].position);
+    }
+    if (normals_as_colors) {
+        for (size_t i = 0; i < count; i++) {
+            block[i].color = glm::vec4(block[i].normal, 1.0f);
+        }
+    }
+
+    std::memcpy(vertices, block.data(), sizeof(GpuVertexData) * count);
+}
+} // namespace kovra
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "gpu_data.hpp"
+#include "render_object.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "fastgltf/types.hpp"
+
+namespace kovra {
+// Bytes of a buffer that the parser already has in memory, either mapped
+// from the file or loaded into a vector, empty otherwise
+[[nodiscard]] std::span<const std::byte> get_buffer_bytes(
+  const fastgltf::Buffer &buffer
+);
+
+// Reads the vertices and indices of one glTF mesh straight out of the
+// buffers of the asset, to write them to staging memory in place
+// Accessors in the common layouts (float attributes and unsigned indices
+// that are neither sparse nor normalized) are converted in tight loops over
+// their strided elements. Anything else is decoded by fastgltf into a copy
+// first, which shows up in get_bytes_copied.
+// The asset must outlive the reader.
+class GltfMeshReader
+{
+  public:
+    GltfMeshReader(
+      const fastgltf::Asset &asset,
+      const fastgltf::Mesh &mesh,
+      bool normals_as_colors = false
+    );
+    GltfMeshReader() = delete;
+    GltfMeshReader(const GltfMeshReader &) = delete;
+    GltfMeshReader &operator=(const GltfMeshReader &) = delete;
+
+    [[nodiscard]] size_t get_vertex_count() const noexcept
+    {
+        return vertex_count;
+    }
+    [[nodiscard]] size_t get_index_count() const noexcept
+    {
+        return index_count;
+    }
+    [[nodiscard]] size_t get_primitive_count() const noexcept
+    {
+        return primitives.size();
+    }
+    // Index of the first index of the primitive in the mesh
+    [[nodiscard]] uint32_t get_first_index(size_t primitive) const noexcept
+    {
+        return static_cast<uint32_t>(primitives[primitive].first_index);
+    }
+    [[nodiscard]] uint32_t get_index_count(size_t primitive) const noexcept
+    {
+        return static_cast<uint32_t>(primitives[primitive].index_count);
+    }
+    // Only valid once every vertex of the primitive has been written
+    [[nodiscard]] Bounds get_bounds(size_t primitive) const;
+    // Bytes of accessors that had to be decoded into a copy first
+    [[nodiscard]] uint64_t get_bytes_copied() const noexcept
+    {
+        return bytes_copied;
+    }
+
+    // Write GpuVertexData for count vertices starting at vertex first
+    // Matches StagingWriter, and must visit every vertex once in order
+    void write_vertices(std::span<std::byte> dst, size_t first, size_t count);
+    // Write uint32_t indices, relative to the first vertex of the mesh
+    void write_indices(std::span<std::byte> dst, size_t first, size_t count)
+      const;
+
+  private:
+    // Vertices are assembled this many at a time in a buffer that stays in
+    // the cache, then copied out in one go, so staging memory (which may be
+    // write-combined) is only ever written sequentially and never read
+    constexpr static size_t VERTEX_BLOCK_SIZE = 256;
+
+    // Strided elements of an accessor
+    struct AccessorSource
+    {
+        const std::byte *data = nullptr;
+        size_t stride = 0;
+        // Only used for indices
+        fastgltf::ComponentType component_type =
+          fastgltf::ComponentType::Float;
+    };
+
+    struct Primitive
+    {
+        size_t first_vertex;
+        size_t vertex_count;
+        size_t first_index;
+        size_t index_count;
+        AccessorSource positions;
+        std::optional<AccessorSource> normals;
+        std::optional<AccessorSource> uvs;
+        std::optional<AccessorSource> colors;
+        AccessorSource indices;
+        // Backing memory of the accessors that had to be decoded
+        std::vector<std::vector<std::byte>> decoded;
+        glm::vec3 min_position;
+        glm::vec3 max_position;
+    };
+
+    // Points into the buffer when the first component_count floats of each
+    // element can be read as they are, otherwise decodes the elements as T
+    template<typename T, size_t component_count>
+    [[nodiscard]] AccessorSource read_float_accessor(
+      const fastgltf::Accessor &accessor,
+      Primitive &primitive
+    );
+    [[nodiscard]] AccessorSource read_index_accessor(
+      const fastgltf::Accessor &accessor,
+      Primitive &primitive
+    );
+    // Bytes of the elements of the accessor in its buffer, or nullopt if
+    // they aren't in memory
+    [[nodiscard]] std::optional<AccessorSource> find_accessor_source(
+      const fastgltf::Accessor &accessor
+    ) const;
+    void write_vertex_block(
+      Primitive &primitive,
+      size_t first,
+      size_t count,
+      GpuVertexData *vertices
+    ) const;
+
+    const fastgltf::Asset &asset;
+    const bool normals_as_colors;
+    std::vector<Primitive> primitives;
+    size_t vertex_count = 0;
+    size_t index_count = 0;
+    uint64_t bytes_copied = 0;
+};
+} // namespace kovra
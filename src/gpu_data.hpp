@@ -2,9 +2,12 @@
 
 #include "glm/ext/matrix_transform.hpp"
 #include "glm/glm.hpp"
+#include <array>
 #include <vulkan/vulkan_core.h>
 
 namespace kovra {
+// Must match the constant in shaders/scene_data.glsl
+static constexpr uint32_t SHADOW_CASCADE_COUNT = 4;
 
 struct GpuVertexData
 {
@@ -29,9 +32,46 @@ struct GpuSceneData
     const glm::vec4 ambient_color;
     const glm::vec4 sunlight_direction; // w for sun power
     const glm::vec4 sunlight_color;
+
+    // Clustered lighting
+    const glm::mat4x4 view;
+    const glm::mat4x4 inv_proj;
+    // xyz: number of clusters along each axis, w: number of lights
+    const glm::uvec4 cluster_grid;
+    // xy: cluster tile size in pixels, z: depth slice scale, w: depth slice bias
+    const glm::vec4 cluster_params;
+    // xy: draw extent in pixels, z: light heat map enabled, w: heat map max
+    const glm::vec4 screen_params;
+
+    // Deferred shading
+    // Reconstructs world positions from the depth buffer
+    const glm::mat4x4 inv_viewproj;
+
+    // Sun shadows
+    // Light viewproj of each cascade (the one it was last rendered with)
+    const std::array<glm::mat4x4, SHADOW_CASCADE_COUNT> cascade_viewprojs;
+    // View-space depth where each cascade ends
+    const glm::vec4 cascade_splits;
+    // x: shadows enabled, y: normal offset in shadow map texels
+    const glm::vec4 shadow_params;
+
+    // Temporal anti-aliasing
+    // Viewproj of the previous frame, without jitter
+    const glm::mat4x4 prev_viewproj;
+    // xy: jitter of viewproj in NDC (zero without temporal anti-aliasing)
+    const glm::vec4 taa_jitter;
 };
 #pragma pack(pop)
 
+// Must match the GpuLight struct in shaders/scene_data.glsl
+struct GpuLight
+{
+    glm::vec4 position_range;  // xyz: world position, w: range
+    glm::vec4 color_intensity; // rgb: color, a: intensity
+    glm::vec4 direction_type;  // xyz: spot direction, w: LightType
+    glm::vec4 spot_angles;     // x: cos(inner cone), y: cos(outer cone)
+};
+
 struct GpuPushConstants
 {
     const glm::mat4x4 object_transform = glm::identity<glm::mat4x4>();
@@ -43,8 +83,64 @@ struct GpuPushConstants
 struct GpuPbrMaterialData
 {
     const glm::vec4 color_factors;
+    // x: metallic, y: roughness, z: alpha cutoff (alpha masked materials)
     const glm::vec4 metal_rough_factors;
     // Padding for uniform buffers
     const glm::vec4 _padding[14];
 };
+
+// Must match the push constants in shaders/shadow.vert
+struct GpuShadowPushConstants
+{
+    const glm::mat4x4 light_transform; // Cascade viewproj * object transform
+    const VkDeviceAddress vertex_buffer;
+};
+
+// Must match the push constants in shaders/easu.frag
+struct GpuUpscalePushConstants
+{
+    const glm::vec2 input_size;
+    const glm::vec2 output_size;
+};
+
+// Must match the push constants in shaders/composite.frag
+struct GpuCompositePushConstants
+{
+    const float sharpening;
+};
+
+// Must match the push constants in shaders/taa-resolve.comp
+struct GpuTaaPushConstants
+{
+    // Scales UVs of the previous frame to UVs of the history image, which
+    // was drawn at the draw extent of the previous frame
+    const glm::vec2 history_uv_scale;
+    const glm::uint has_history;
+    // Whether the opaque pass wrote motion vectors, otherwise every pixel is
+    // reprojected from depth with the camera motion
+    const glm::uint has_motion_vectors;
+};
+
+// Must match the BindlessMaterial struct in shaders/bindless.glsl
+struct GpuBindlessMaterial
+{
+    glm::vec4 color_factors;
+    // z: alpha cutoff, zero unless the material is alpha masked
+    glm::vec4 metal_rough_factors;
+    // Indices into the bindless texture array
+    // x: albedo, y: metal rough, z: ambient occlusion, w: emissive
+    // BINDLESS_TEXTURE_NONE for the textures the material doesn't have
+    glm::uvec4 texture_indices;
+};
+
+// Must match the VisibilityDraw struct in shaders/visibility_data.glsl
+struct GpuVisibilityDraw
+{
+    glm::mat4x4 transform;
+    VkDeviceAddress vertex_buffer;
+    VkDeviceAddress index_buffer;
+    glm::uint first_index;
+    glm::uint material_index;
+    glm::uint _padding[2];
+};
 } // namespace kovra
@@ -0,0 +1,510 @@
+#include "ibl.hpp"
+#include "buffer.hpp"
+#include "compute_pass.hpp"
+#include "cubemap.hpp"
+#include "descriptor.hpp"
+#include "device.hpp"
+#include "image.hpp"
+#include "render_resources.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace kovra {
+// Bytes per texel of IBL_FORMAT
+static constexpr vk::DeviceSize IBL_TEXEL_SIZE = 8;
+// Must match the local size of the IBL compute shaders
+static constexpr uint32_t IBL_WORKGROUP_SIZE = 8;
+static constexpr uint32_t IBL_CACHE_MAGIC = 0x4c42494b; // "KIBL"
+
+// Written at the start of every cache file, followed by the texels of the
+// three maps
+struct IblCacheHeader
+{
+    uint32_t magic = IBL_CACHE_MAGIC;
+    uint32_t version = IBL_CACHE_VERSION;
+    uint64_t source_hash = 0;
+    uint32_t irradiance_size = IRRADIANCE_MAP_SIZE;
+    uint32_t prefiltered_size = PREFILTERED_MAP_SIZE;
+    uint32_t brdf_lut_size = BRDF_LUT_SIZE;
+    uint32_t format = static_cast<uint32_t>(IBL_FORMAT);
+};
+
+static std::unique_ptr<GpuImage>
+create_ibl_cubemap(uint32_t size, bool mipmapped, const Device &device)
+{
+    return device.create_image(GpuImageCreateInfo{
+      .format = IBL_FORMAT,
+      .extent = vk::Extent3D{ size, size, 1 },
+      .usage = vk::ImageUsageFlagBits::eStorage |
+               vk::ImageUsageFlagBits::eSampled |
+               vk::ImageUsageFlagBits::eTransferSrc |
+               vk::ImageUsageFlagBits::eTransferDst,
+      .aspect = vk::ImageAspectFlagBits::eColor,
+      .view_type = vk::ImageViewType::eCube,
+      .mipmapped = mipmapped,
+      .sampler = std::nullopt,
+      .array_layers = 6,
+      .flags = vk::ImageCreateFlagBits::eCubeCompatible });
+}
+
+// Record one half of a queue family ownership transfer of a sampled image
+static void
+transfer_sampled_image(
+  vk::CommandBuffer cmd,
+  const GpuImage &image,
+  uint32_t src_queue_family,
+  uint32_t dst_queue_family
+)
+{
+    utils::transition_image_layout(
+      cmd,
+      image.get(),
+      image.get_aspect(),
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      vk::ImageLayout::eShaderReadOnlyOptimal,
+      image.get_layer_count(),
+      image.get_level_count(),
+      src_queue_family,
+      dst_queue_family
+    );
+}
+
+static uint32_t
+workgroup_count(uint32_t size)
+{
+    return (size + IBL_WORKGROUP_SIZE - 1) / IBL_WORKGROUP_SIZE;
+}
+
+ImageBasedLighting::ImageBasedLighting(
+  const Cubemap &source,
+  const RenderResources &resources,
+  const Device &device
+)
+  : irradiance_map{ create_ibl_cubemap(IRRADIANCE_MAP_SIZE, false, device) }
+  , prefiltered_map{ create_ibl_cubemap(PREFILTERED_MAP_SIZE, true, device) }
+  , brdf_lut{ device.create_image(GpuImageCreateInfo{
+      .format = IBL_FORMAT,
+      .extent = vk::Extent3D{ BRDF_LUT_SIZE, BRDF_LUT_SIZE, 1 },
+      .usage = vk::ImageUsageFlagBits::eStorage |
+               vk::ImageUsageFlagBits::eSampled |
+               vk::ImageUsageFlagBits::eTransferSrc |
+               vk::ImageUsageFlagBits::eTransferDst,
+      .aspect = vk::ImageAspectFlagBits::eColor,
+      .mipmapped = false,
+      .sampler = std::nullopt }) }
+  , sampler{ device.get().createSamplerUnique(
+      vk::SamplerCreateInfo{}
+        .setMagFilter(vk::Filter::eLinear)
+        .setMinFilter(vk::Filter::eLinear)
+        .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+        .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+        .setMinLod(0.0f)
+        .setMaxLod(vk::LodClampNone)
+    ) }
+{
+    spdlog::debug("ImageBasedLighting::ImageBasedLighting()");
+
+    const uint64_t source_hash = source.get_content_hash();
+    const auto cache_path = std::filesystem::path{ IBL_CACHE_DIR } /
+                            std::format("{:016x}.ibl", source_hash);
+    if (load_from_cache(cache_path, source_hash, device)) {
+        loaded_from_cache = true;
+        spdlog::info(
+          "Loaded image-based lighting from {}", cache_path.string()
+        );
+        return;
+    }
+
+    const auto start = std::chrono::system_clock::now();
+    generate(source, resources, device);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now() - start
+    );
+    spdlog::info("Generated image-based lighting in {} ms", elapsed.count());
+
+    save_to_cache(cache_path, source_hash, device);
+}
+
+ImageBasedLighting::~ImageBasedLighting()
+{
+    spdlog::debug("ImageBasedLighting::~ImageBasedLighting()");
+    sampler.reset();
+    brdf_lut.reset();
+    prefiltered_map.reset();
+    irradiance_map.reset();
+}
+
+vk::DeviceSize
+ImageBasedLighting::get_data_size() const noexcept
+{
+    vk::DeviceSize size = 0;
+    for_each_region(
+      [&](const GpuImage &image, const vk::BufferImageCopy &region) {
+          size = region.bufferOffset + region.imageExtent.width *
+                                         region.imageExtent.height *
+                                         image.get_layer_count() *
+                                         IBL_TEXEL_SIZE;
+      }
+    );
+    return size;
+}
+
+void
+ImageBasedLighting::for_each_region(
+  const std::function<void(const GpuImage &, const vk::BufferImageCopy &)>
+    &callback
+) const
+{
+    vk::DeviceSize offset = 0;
+    for (const GpuImage *image :
+         { irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() }) {
+        const vk::Extent3D extent = image->get_extent();
+        for (int mip = 0; mip < image->get_level_count(); mip++) {
+            const uint32_t width = std::max(extent.width >> mip, 1u);
+            const uint32_t height = std::max(extent.height >> mip, 1u);
+            const auto region =
+              vk::BufferImageCopy{}
+                .setBufferOffset(offset)
+                .setBufferRowLength(0)
+                .setBufferImageHeight(0)
+                .setImageSubresource(
+                  vk::ImageSubresourceLayers{}
+                    .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                    .setMipLevel(mip)
+                    .setBaseArrayLayer(0)
+                    .setLayerCount(image->get_layer_count())
+                )
+                .setImageExtent(vk::Extent3D{ width, height, 1 });
+            callback(*image, region);
+            offset += width * height * image->get_layer_count() *
+                      IBL_TEXEL_SIZE;
+        }
+    }
+}
+
+bool
+ImageBasedLighting::load_from_cache(
+  const std::filesystem::path &path,
+  uint64_t source_hash,
+  const Device &device
+)
+{
+    std::ifstream file{ path, std::ios::binary };
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Ignore cache files written by a different version or for another skybox
+    auto expected_header = IblCacheHeader{ .source_hash = source_hash };
+    IblCacheHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(IblCacheHeader));
+    if (!file || std::memcmp(&header, &expected_header, sizeof(header)) != 0) {
+        spdlog::warn("Ignoring outdated IBL cache file: {}", path.string());
+        return false;
+    }
+
+    const vk::DeviceSize data_size = get_data_size();
+    std::vector<char> data(data_size);
+    file.read(data.data(), static_cast<std::streamsize>(data_size));
+    if (static_cast<vk::DeviceSize>(file.gcount()) != data_size) {
+        spdlog::warn("Ignoring truncated IBL cache file: {}", path.string());
+        return false;
+    }
+
+    // Each map is packed one mip level after another, so it can be
+    // uploaded in one piece from the offset of its first region
+    std::vector<vk::DeviceSize> image_offsets;
+    const GpuImage *previous_image = nullptr;
+    for_each_region(
+      [&](const GpuImage &image, const vk::BufferImageCopy &region) {
+          if (&image != previous_image) {
+              image_offsets.emplace_back(region.bufferOffset);
+              previous_image = &image;
+          }
+      }
+    );
+    auto &upload_queue = device.get_upload_queue();
+    const auto images =
+      std::array{ irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() };
+    for (size_t i = 0; i < images.size(); i++) {
+        (void)upload_queue.enqueue_image(
+          data.data() + image_offsets[i],
+          *images[i],
+          false,
+          static_cast<uint32_t>(IBL_TEXEL_SIZE),
+          static_cast<uint32_t>(images[i]->get_level_count())
+        );
+    }
+
+    return true;
+}
+
+void
+ImageBasedLighting::generate(
+  const Cubemap &source,
+  const RenderResources &resources,
+  const Device &device
+)
+{
+    // The skybox has to be on the graphics queue before it can be baked
+    device.get_upload_queue().wait(source.get_upload_token());
+
+    const vk::Device &vk_device = device.get();
+    // Only a handful of sets that are no longer needed once the maps exist
+    DescriptorAllocator desc_allocator{ vk_device, 16 };
+
+    // Storage images can only be written one mip level at a time, so every
+    // level gets its own view of all six faces
+    const auto create_level_view = [&](const GpuImage &image, uint32_t mip) {
+        return vk_device.createImageViewUnique(
+          vk::ImageViewCreateInfo{}
+            .setImage(image.get())
+            .setViewType(vk::ImageViewType::e2DArray)
+            .setFormat(image.get_format())
+            .setSubresourceRange(
+              vk::ImageSubresourceRange{}
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseMipLevel(mip)
+                .setLevelCount(1)
+                .setBaseArrayLayer(0)
+                .setLayerCount(image.get_layer_count())
+            )
+        );
+    };
+    const auto create_filter_desc_set = [&](vk::ImageView target_view) {
+        auto desc_set = desc_allocator.allocate(
+          resources.get_desc_set_layout("ibl"), vk_device
+        );
+        auto writer = DescriptorWriter{};
+        writer.write_image(
+          0,
+          source.get_image().get_view(),
+          sampler.get(),
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+        writer.write_image(
+          1,
+          target_view,
+          VK_NULL_HANDLE,
+          vk::ImageLayout::eGeneral,
+          vk::DescriptorType::eStorageImage
+        );
+        writer.update_set(vk_device, desc_set);
+        return desc_set;
+    };
+
+    const auto irradiance_view = create_level_view(*irradiance_map, 0);
+    const auto irradiance_desc_set =
+      create_filter_desc_set(irradiance_view.get());
+
+    std::vector<vk::UniqueImageView> prefiltered_views;
+    std::vector<vk::DescriptorSet> prefiltered_desc_sets;
+    for (int mip = 0; mip < prefiltered_map->get_level_count(); mip++) {
+        prefiltered_views.emplace_back(
+          create_level_view(*prefiltered_map, mip)
+        );
+        prefiltered_desc_sets.emplace_back(
+          create_filter_desc_set(prefiltered_views.back().get())
+        );
+    }
+
+    auto brdf_lut_desc_set = desc_allocator.allocate(
+      resources.get_desc_set_layout("compute texture"), vk_device
+    );
+    {
+        auto writer = DescriptorWriter{};
+        writer.write_image(
+          0,
+          brdf_lut->get_view(),
+          VK_NULL_HANDLE,
+          vk::ImageLayout::eGeneral,
+          vk::DescriptorType::eStorageImage
+        );
+        writer.update_set(vk_device, brdf_lut_desc_set);
+    }
+
+    // The maps are baked on the compute queue. With a dedicated compute
+    // family, the skybox is borrowed from the graphics queue and the maps
+    // are handed over to it afterwards.
+    const bool async_compute = device.has_async_compute();
+    const GpuImage &skybox = source.get_image();
+    const uint32_t graphics_family = device.get_graphics_family_index();
+    const uint32_t compute_family = device.get_compute_family_index();
+    const auto finish_maps = [&](vk::CommandBuffer cmd) {
+        for (auto *image :
+             { irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() }) {
+            image->transition_layout(
+              cmd,
+              vk::ImageLayout::eGeneral,
+              vk::ImageLayout::eShaderReadOnlyOptimal,
+              async_compute ? compute_family : vk::QueueFamilyIgnored,
+              async_compute ? graphics_family : vk::QueueFamilyIgnored
+            );
+        }
+    };
+
+    if (async_compute) {
+        device.immediate_submit(
+          [&](vk::CommandBuffer cmd) {
+              transfer_sampled_image(
+                cmd, skybox, graphics_family, compute_family
+              );
+          },
+          QueueType::Graphics
+        );
+    }
+
+    const auto bake = [&](vk::CommandBuffer cmd) {
+        if (async_compute) {
+            transfer_sampled_image(
+              cmd, skybox, graphics_family, compute_family
+            );
+        }
+        for (auto *image :
+             { irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() }) {
+            image->transition_layout(
+              cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral
+            );
+        }
+
+        {
+            ComputePass compute_pass{ cmd };
+
+            // Diffuse irradiance, one workgroup layer per cube face
+            compute_pass.set_material(
+              resources.get_material_owned("ibl irradiance")
+            );
+            compute_pass.set_desc_sets(0, { irradiance_desc_set }, {});
+            compute_pass.dispatch_workgroups(
+              workgroup_count(IRRADIANCE_MAP_SIZE),
+              workgroup_count(IRRADIANCE_MAP_SIZE),
+              6
+            );
+
+            // Specular, roughness goes from 0 at mip 0 to 1 at the last mip
+            compute_pass.set_material(
+              resources.get_material_owned("ibl prefilter")
+            );
+            const int level_count = prefiltered_map->get_level_count();
+            for (int mip = 0; mip < level_count; mip++) {
+                const float roughness =
+                  static_cast<float>(mip) /
+                  static_cast<float>(std::max(level_count - 1, 1));
+                const uint32_t size =
+                  std::max(PREFILTERED_MAP_SIZE >> mip, 1u);
+                compute_pass.set_push_constants(utils::cast_to_bytes(roughness)
+                );
+                compute_pass.set_desc_sets(
+                  0, { prefiltered_desc_sets[mip] }, {}
+                );
+                compute_pass.dispatch_workgroups(
+                  workgroup_count(size), workgroup_count(size), 6
+                );
+            }
+
+            // BRDF integration LUT, independent of the skybox
+            compute_pass.set_material(
+              resources.get_material_owned("ibl brdf lut")
+            );
+            compute_pass.set_desc_sets(0, { brdf_lut_desc_set }, {});
+            compute_pass.dispatch_workgroups(
+              workgroup_count(BRDF_LUT_SIZE), workgroup_count(BRDF_LUT_SIZE), 1
+            );
+        }
+
+        // Release the maps and the skybox to the graphics queue
+        finish_maps(cmd);
+        if (async_compute) {
+            transfer_sampled_image(
+              cmd, skybox, compute_family, graphics_family
+            );
+        }
+    };
+    device.immediate_submit(bake, QueueType::Compute);
+
+    if (async_compute) {
+        device.immediate_submit(
+          [&](vk::CommandBuffer cmd) {
+              finish_maps(cmd);
+              transfer_sampled_image(
+                cmd, skybox, compute_family, graphics_family
+              );
+          },
+          QueueType::Graphics
+        );
+    }
+}
+
+void
+ImageBasedLighting::save_to_cache(
+  const std::filesystem::path &path,
+  uint64_t source_hash,
+  const Device &device
+) const
+{
+    // Read the maps back to the host
+    const vk::DeviceSize data_size = get_data_size();
+    auto readback_buffer = device.create_buffer(
+      data_size,
+      vk::BufferUsageFlagBits::eTransferDst,
+      VMA_MEMORY_USAGE_GPU_TO_CPU,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    );
+    device.immediate_submit([&](vk::CommandBuffer cmd) {
+        for (auto *image :
+             { irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() }) {
+            image->transition_layout(
+              cmd,
+              vk::ImageLayout::eShaderReadOnlyOptimal,
+              vk::ImageLayout::eTransferSrcOptimal
+            );
+        }
+        for_each_region(
+          [&](const GpuImage &image, const vk::BufferImageCopy &region) {
+              cmd.copyImageToBuffer(
+                image.get(),
+                vk::ImageLayout::eTransferSrcOptimal,
+                readback_buffer->get(),
+                region
+              );
+          }
+        );
+        for (auto *image :
+             { irradiance_map.get(), prefiltered_map.get(), brdf_lut.get() }) {
+            image->transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferSrcOptimal,
+              vk::ImageLayout::eShaderReadOnlyOptimal
+            );
+        }
+    });
+    std::vector<std::byte> file(sizeof(IblCacheHeader) + data_size);
+    const auto header = IblCacheHeader{ .source_hash = source_hash };
+    std::memcpy(file.data(), &header, sizeof(IblCacheHeader));
+    readback_buffer->read(file.data() + sizeof(IblCacheHeader), data_size);
+
+    // The cache is only an optimization, so failing to write it is not fatal
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        spdlog::warn(
+          "Failed to create IBL cache directory {}: {}",
+          path.parent_path().string(),
+          error.message()
+        );
+        return;
+    }
+
+    if (!utils::write_file_atomically(path, file)) {
+        spdlog::warn("Failed to save IBL cache: {}", path.string());
+    }
+}
+} // namespace kovra
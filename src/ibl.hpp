@@ -0,0 +1,98 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class Cubemap;
+class Device;
+class GpuImage;
+class RenderResources;
+
+static constexpr uint32_t IRRADIANCE_MAP_SIZE = 32;
+// Every mip level of the prefiltered map stores a higher roughness
+static constexpr uint32_t PREFILTERED_MAP_SIZE = 128;
+static constexpr uint32_t BRDF_LUT_SIZE = 256;
+static constexpr vk::Format IBL_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+static constexpr const char *IBL_CACHE_DIR = "./cache/ibl";
+// Bump whenever the cache file layout or the IBL shaders change
+static constexpr uint32_t IBL_CACHE_VERSION = 1;
+
+// Split-sum image-based lighting derived from the skybox
+// The maps are generated with compute shaders the first time a skybox is seen
+// and then cached on disk, keyed by the hash of the skybox pixels, so later
+// startups only have to upload them.
+class ImageBasedLighting
+{
+  public:
+    ImageBasedLighting(
+      const Cubemap &source,
+      const RenderResources &resources,
+      const Device &device
+    );
+    ~ImageBasedLighting();
+    ImageBasedLighting() = delete;
+    ImageBasedLighting(const ImageBasedLighting &) = delete;
+    ImageBasedLighting &operator=(const ImageBasedLighting &) = delete;
+    ImageBasedLighting(ImageBasedLighting &&) = delete;
+    ImageBasedLighting &operator=(ImageBasedLighting &&) = delete;
+
+    // Diffuse irradiance cubemap
+    [[nodiscard]] const GpuImage &get_irradiance_map() const noexcept
+    {
+        return *irradiance_map;
+    }
+    // Specular cubemap prefiltered for increasing roughness per mip level
+    [[nodiscard]] const GpuImage &get_prefiltered_map() const noexcept
+    {
+        return *prefiltered_map;
+    }
+    // Scale (r) and bias (g) applied to F0, indexed by (NdotV, roughness)
+    [[nodiscard]] const GpuImage &get_brdf_lut() const noexcept
+    {
+        return *brdf_lut;
+    }
+    // Trilinear clamp-to-edge sampler for all three maps
+    [[nodiscard]] vk::Sampler get_sampler() const noexcept
+    {
+        return sampler.get();
+    }
+    [[nodiscard]] bool is_loaded_from_cache() const noexcept
+    {
+        return loaded_from_cache;
+    }
+
+  private:
+    std::unique_ptr<GpuImage> irradiance_map;
+    std::unique_ptr<GpuImage> prefiltered_map;
+    std::unique_ptr<GpuImage> brdf_lut;
+    vk::UniqueSampler sampler;
+    bool loaded_from_cache = false;
+
+    // Total size of the three maps in bytes, as laid out in the cache file
+    [[nodiscard]] vk::DeviceSize get_data_size() const noexcept;
+    [[nodiscard]] bool load_from_cache(
+      const std::filesystem::path &path,
+      uint64_t source_hash,
+      const Device &device
+    );
+    void generate(
+      const Cubemap &source,
+      const RenderResources &resources,
+      const Device &device
+    );
+    void save_to_cache(
+      const std::filesystem::path &path,
+      uint64_t source_hash,
+      const Device &device
+    ) const;
+    // Buffer <-> image copy regions of the three maps, packed back to back
+    void for_each_region(
+      const std::function<void(const GpuImage &, const vk::BufferImageCopy &)>
+        &callback
+    ) const;
+};
+} // namespace kovra
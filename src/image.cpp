@@ -1,37 +1,27 @@
 #include "image.hpp"
 #include "device.hpp"
+#include "format.hpp"
 #include "spdlog/spdlog.h"
 #include "utils.hpp"
 
+#include <bit>
+
 namespace kovra {
-// TODO: Generate mipmaps using compute shader instead of using a chain of
-// vkCmdBlitImage calls
+// Chain of blits for formats the compute MipGenerator can't write
 void
 GpuImage::generate_mipmaps(const vk::CommandBuffer cmd) noexcept
 {
     spdlog::debug("Generating mipmaps ...");
 
     vk::Extent2D extent = get_extent2d();
-    int mip_levels =
-      static_cast<int>(
-        std::floor(std::log2(std::max(extent.width, extent.height)))
-      ) +
-      1;
-    for (int mip = 0; mip < mip_levels; mip++) {
-        vk::Extent2D half_extent = extent;
-        half_extent.width /= 2;
-        half_extent.height /= 2;
-
-        // Transition image layout at the beginning of each mip level
+    for (int mip = 0; mip < level_count; mip++) {
+        // Each level becomes a blit source once its copy or blit is done
         auto image_barrier =
           vk::ImageMemoryBarrier2{}
-            .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-            .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
-            .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-            .setDstAccessMask(
-              vk::AccessFlagBits2::eMemoryWrite |
-              vk::AccessFlagBits2::eMemoryRead
-            )
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
             .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
             .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
             .setSubresourceRange(vk::ImageSubresourceRange{}
@@ -45,7 +35,10 @@ GpuImage::generate_mipmaps(const vk::CommandBuffer cmd) noexcept
           vk::DependencyInfo{}.setImageMemoryBarriers(image_barrier);
         cmd.pipelineBarrier2(&dep_info);
 
-        if (mip < mip_levels - 1) {
+        if (mip < level_count - 1) {
+            // Non-square images reach a width or height of one first
+            const vk::Extent2D half_extent{ std::max(extent.width / 2, 1u),
+                                            std::max(extent.height / 2, 1u) };
             auto blit_region =
               vk::ImageBlit2{}
                 .setSrcOffsets({ vk::Offset3D{ 0, 0, 0 },
@@ -61,12 +54,12 @@ GpuImage::generate_mipmaps(const vk::CommandBuffer cmd) noexcept
                 .setSrcSubresource(vk::ImageSubresourceLayers{}
                                      .setAspectMask(aspect)
                                      .setBaseArrayLayer(0)
-                                     .setLayerCount(1)
+                                     .setLayerCount(layer_count)
                                      .setMipLevel(mip))
                 .setDstSubresource(vk::ImageSubresourceLayers{}
                                      .setAspectMask(aspect)
                                      .setBaseArrayLayer(0)
-                                     .setLayerCount(1)
+                                     .setLayerCount(layer_count)
                                      .setMipLevel(mip + 1));
             auto blit_info =
               vk::BlitImageInfo2{}
@@ -84,6 +77,37 @@ GpuImage::generate_mipmaps(const vk::CommandBuffer cmd) noexcept
     }
 }
 
+static int
+get_level_count(const GpuImageCreateInfo &info) noexcept
+{
+    if (info.mip_levels > 0) {
+        return info.mip_levels;
+    }
+    if (info.mipmapped) {
+        return static_cast<int>(
+          std::bit_width(std::max(info.extent.width, info.extent.height))
+        );
+    }
+    return 1;
+}
+
+static VkImageCreateInfo
+get_image_create_info(const GpuImageCreateInfo &info) noexcept
+{
+    VkImageCreateInfo image_ci{};
+    image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_ci.imageType = VK_IMAGE_TYPE_2D;
+    image_ci.format = static_cast<VkFormat>(info.format);
+    image_ci.extent = info.extent;
+    image_ci.mipLevels = get_level_count(info);
+    image_ci.flags = static_cast<VkImageCreateFlags>(info.flags);
+    image_ci.arrayLayers = info.array_layers;
+    image_ci.samples = static_cast<VkSampleCountFlagBits>(info.samples);
+    image_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_ci.usage = static_cast<VkImageUsageFlags>(info.usage);
+    return image_ci;
+}
+
 GpuImage::GpuImage(
   const GpuImageCreateInfo &info,
   const vk::Device &device,
@@ -92,31 +116,14 @@ GpuImage::GpuImage(
   : allocator{ allocator }
   , format{ info.format }
   , extent{ info.extent }
+  , usage{ info.usage }
   , aspect{ info.aspect }
   , sampler{ info.sampler }
   , layer_count{ info.array_layers }
-  , level_count{
-      info.mipmapped
-        ? static_cast<int>(
-            std::floor(std::log2(std::max(info.extent.width, info.extent.height)
-            )) +
-            1
-          )
-        : 1,
-  }
-  , sample_count{info.enable_multisampling ? vk::SampleCountFlagBits::e4 : vk::SampleCountFlagBits::e1}
+  , level_count{ get_level_count(info) }
+  , sample_count{ info.samples }
 {
-    VkImageCreateInfo image_ci{};
-    image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    image_ci.imageType = VK_IMAGE_TYPE_2D;
-    image_ci.format = static_cast<VkFormat>(info.format);
-    image_ci.extent = info.extent;
-    image_ci.mipLevels = level_count;
-    image_ci.flags = static_cast<VkImageCreateFlags>(info.flags);
-    image_ci.arrayLayers = info.array_layers;
-    image_ci.samples = static_cast<VkSampleCountFlagBits>(sample_count);
-    image_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_ci.usage = static_cast<VkImageUsageFlags>(info.usage);
+    const auto image_ci = get_image_create_info(info);
 
     // Always allocate images on dedicated GPU memory
     VmaAllocationCreateInfo alloc_ci{};
@@ -146,9 +153,55 @@ GpuImage::GpuImage(
         throw std::runtime_error("Failed to create image");
     }
 
-    // Create image view
+    create_view(info, device);
+}
+
+GpuImage::GpuImage(
+  const GpuImageCreateInfo &info,
+  const vk::Device &device,
+  std::shared_ptr<VmaAllocator> allocator,
+  VmaAllocation aliased_memory
+)
+  : allocator{ allocator }
+  , allocation{ VK_NULL_HANDLE }
+  , allocation_info{}
+  , format{ info.format }
+  , extent{ info.extent }
+  , usage{ info.usage }
+  , aspect{ info.aspect }
+  , sampler{ info.sampler }
+  , layer_count{ info.array_layers }
+  , level_count{ get_level_count(info) }
+  , sample_count{ info.samples }
+{
+    const auto image_ci = get_image_create_info(info);
+    if (VkResult result = vmaCreateAliasingImage(
+          *this->allocator, aliased_memory, &image_ci, &image
+        );
+        result != VK_SUCCESS) {
+        spdlog::error(
+          "Failed to create aliasing image: {}",
+          vk::to_string(static_cast<vk::Result>(result))
+        );
+        throw std::runtime_error("Failed to create image");
+    }
+
+    create_view(info, device);
+}
+
+void
+GpuImage::create_view(const GpuImageCreateInfo &info, const vk::Device &device)
+{
+    // Images with extended usage have usages their own format doesn't
+    // support, such as sRGB images written through UNORM storage views
+    const auto view_usage_ci = vk::ImageViewUsageCreateInfo{}.setUsage(
+      info.usage & ~vk::ImageUsageFlagBits::eStorage
+    );
+    const bool extended_usage =
+      static_cast<bool>(info.flags & vk::ImageCreateFlagBits::eExtendedUsage);
     view = device.createImageViewUnique(
       vk::ImageViewCreateInfo{}
+        .setPNext(extended_usage ? &view_usage_ci : nullptr)
         .setImage(image)
         .setViewType(info.view_type)
         .setFormat(info.format)
@@ -164,7 +217,29 @@ GpuImage::GpuImage(
 GpuImage::~GpuImage()
 {
     view.reset();
-    vmaDestroyImage(*allocator, image, allocation);
+    if (allocation != VK_NULL_HANDLE) {
+        vmaDestroyImage(*allocator, image, allocation);
+        return;
+    }
+    // The memory of aliasing images belongs to whoever allocated it
+    VmaAllocatorInfo allocator_info;
+    vmaGetAllocatorInfo(*allocator, &allocator_info);
+    vkDestroyImage(allocator_info.device, image, nullptr);
+}
+
+vk::MemoryRequirements
+GpuImage::get_memory_requirements(
+  const GpuImageCreateInfo &info,
+  const vk::Device &device
+)
+{
+    const auto image_ci = get_image_create_info(info);
+    const auto requirements_info =
+      vk::DeviceImageMemoryRequirements{}.setPCreateInfo(
+        reinterpret_cast<const vk::ImageCreateInfo *>(&image_ci)
+      );
+    return device.getImageMemoryRequirements(requirements_info)
+      .memoryRequirements;
 }
 
 // Create a 32-bit shader-readable image from a byte array
@@ -176,7 +251,8 @@ GpuImage::new_color_image(
   const Device &device,
   vk::Sampler sampler,
   vk::Format format,
-  bool mipmapped
+  bool mipmapped,
+  const MipGenerationInfo &mip_info
 )
 {
     if (width == 0 || height == 0) {
@@ -186,8 +262,13 @@ GpuImage::new_color_image(
 
     auto usage =
       vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
-    // Require eTransferSrc to generate mipmaps
-    if (mipmapped) {
+    vk::ImageCreateFlags flags = {};
+    // Mipmaps are generated by a compute shader where the format allows it,
+    // otherwise with blits
+    if (mipmapped && MipGenerator::supports(format)) {
+        usage |= vk::ImageUsageFlagBits::eStorage;
+        flags |= MipGenerator::get_image_flags(format);
+    } else if (mipmapped) {
         usage |= vk::ImageUsageFlagBits::eTransferSrc;
     }
 
@@ -196,11 +277,54 @@ GpuImage::new_color_image(
                                     .usage = usage,
                                     .aspect = vk::ImageAspectFlagBits::eColor,
                                     .mipmapped = mipmapped,
+                                    .sampler = sampler,
+                                    .flags = flags };
+    auto image = std::make_unique<GpuImage>(
+      desc, device.get(), device.get_allocator_owned()
+    );
+    image->upload(data, device, mipmapped, mip_info);
+    return image;
+}
+// Create a shader-readable image from prebuilt block-compressed mip levels
+std::unique_ptr<GpuImage>
+GpuImage::new_compressed_image(
+  const void *data,
+  uint32_t width,
+  uint32_t height,
+  uint32_t level_count,
+  const Device &device,
+  vk::Sampler sampler,
+  vk::Format format
+)
+{
+    const auto block = get_format_block(format);
+    if (width == 0 || height == 0 || level_count == 0 || block.size == 0) {
+        spdlog::error(
+          "Invalid compressed image: width={}, height={}, levels={}, format={}",
+          width,
+          height,
+          level_count,
+          vk::to_string(format)
+        );
+        throw std::runtime_error("Invalid compressed image");
+    }
+
+    // Blits can't write block-compressed formats, so every level is uploaded
+    const auto usage =
+      vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+    auto desc = GpuImageCreateInfo{ .format = format,
+                                    .extent = vk::Extent3D{ width, height, 1 },
+                                    .usage = usage,
+                                    .aspect = vk::ImageAspectFlagBits::eColor,
+                                    .mipmapped = level_count > 1,
+                                    .mip_levels = static_cast<int>(level_count),
                                     .sampler = sampler };
     auto image = std::make_unique<GpuImage>(
       desc, device.get(), device.get_allocator_owned()
     );
-    image->upload(data, device, mipmapped);
+    (void)device.get_upload_queue().enqueue_image(
+      data, *image, false, block.size, level_count
+    );
     return image;
 }
 // Create an image used for the depth buffer
@@ -210,7 +334,7 @@ GpuImage::new_depth_image(
   uint32_t height,
   std::optional<vk::Sampler> sampler,
   const Device &device,
-  bool enable_multisampling
+  vk::SampleCountFlagBits samples
 )
 {
     auto desc =
@@ -218,11 +342,13 @@ GpuImage::new_depth_image(
                           .extent = vk::Extent3D{ width, height, 1 },
                           .usage =
                             vk::ImageUsageFlagBits::eDepthStencilAttachment |
-                            vk::ImageUsageFlagBits::eTransferSrc,
+                            vk::ImageUsageFlagBits::eTransferSrc |
+                            // Read by deferred lighting
+                            vk::ImageUsageFlagBits::eSampled,
                           .aspect = vk::ImageAspectFlagBits::eDepth,
                           .mipmapped = false,
                           .sampler = sampler,
-                          .enable_multisampling = enable_multisampling };
+                          .samples = samples };
     return std::make_unique<GpuImage>(
       desc, device.get(), device.get_allocator_owned()
     );
@@ -254,11 +380,21 @@ void
 GpuImage::transition_layout(
   vk::CommandBuffer cmd,
   vk::ImageLayout old_layout,
-  vk::ImageLayout new_layout
+  vk::ImageLayout new_layout,
+  uint32_t src_queue_family,
+  uint32_t dst_queue_family
 ) noexcept
 {
     utils::transition_image_layout(
-      cmd, image, aspect, old_layout, new_layout, layer_count, level_count
+      cmd,
+      image,
+      aspect,
+      old_layout,
+      new_layout,
+      layer_count,
+      level_count,
+      src_queue_family,
+      dst_queue_family
     );
 }
 void
@@ -284,67 +420,16 @@ GpuImage::copy_to_vkimage(
     );
 }
 
-void
-GpuImage::upload(const void *data, const Device &device, bool mipmapped)
-{
-    vk::DeviceSize data_size = extent.depth * extent.width * extent.height * 4;
-    auto staging_buffer = device.create_buffer(
-      data_size,
-      vk::BufferUsageFlagBits::eTransferSrc,
-      VMA_MEMORY_USAGE_CPU_TO_GPU,
-      VMA_ALLOCATION_CREATE_MAPPED_BIT
-    );
-    staging_buffer->write(data, data_size);
-
-    upload(staging_buffer->get(), device, mipmapped);
-}
-
-void
+UploadToken
 GpuImage::upload(
-  const vk::Buffer &staging_buffer,
+  const void *data,
   const Device &device,
-  bool mipmapped
+  bool mipmapped,
+  const MipGenerationInfo &mip_info
 )
 {
-    device.immediate_submit([&](vk::CommandBuffer cmd) {
-        transition_layout(
-          cmd, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal
-        );
-
-        auto region = vk::BufferImageCopy{}
-                        .setBufferOffset(0)
-                        .setBufferRowLength(0)
-                        .setBufferImageHeight(0)
-                        .setImageSubresource(
-                          vk::ImageSubresourceLayers{}
-                            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-                            .setMipLevel(0)
-                            .setBaseArrayLayer(0)
-                            .setLayerCount(layer_count)
-                        )
-                        .setImageExtent(extent);
-        cmd.copyBufferToImage(
-          staging_buffer,
-          image,
-          vk::ImageLayout::eTransferDstOptimal,
-          1,
-          &region
-        );
-
-        if (mipmapped) {
-            generate_mipmaps(cmd);
-            transition_layout(
-              cmd,
-              vk::ImageLayout::eTransferSrcOptimal,
-              vk::ImageLayout::eShaderReadOnlyOptimal
-            );
-        } else {
-            transition_layout(
-              cmd,
-              vk::ImageLayout::eTransferDstOptimal,
-              vk::ImageLayout::eShaderReadOnlyOptimal
-            );
-        }
-    });
+    return device.get_upload_queue().enqueue_image(
+      data, *this, mipmapped, 4, 1, mip_info
+    );
 }
 } // namespace kovra
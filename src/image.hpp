@@ -1,6 +1,8 @@
 #pragma once
 
+#include "mip_generator.hpp"
 #include "spdlog/spdlog.h"
+#include "upload_queue.hpp"
 #include "vk_mem_alloc.h"
 #include <memory>
 #include <vulkan/vulkan.hpp>
@@ -17,10 +19,12 @@ struct GpuImageCreateInfo
     vk::ImageAspectFlags aspect;
     vk::ImageViewType view_type = vk::ImageViewType::e2D;
     bool mipmapped = false;
+    // Overrides the full mip chain of mipmapped images when non-zero
+    int mip_levels = 0;
     std::optional<vk::Sampler> sampler = std::nullopt;
     int array_layers = 1;
     vk::ImageCreateFlags flags = {};
-    bool enable_multisampling = false;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
 };
 
 class GpuImage
@@ -31,6 +35,14 @@ class GpuImage
       const vk::Device &device,
       std::shared_ptr<VmaAllocator> allocator
     );
+    // Create the image in memory allocated elsewhere, which it may share
+    // with images whose contents are never needed at the same time
+    GpuImage(
+      const GpuImageCreateInfo &info,
+      const vk::Device &device,
+      std::shared_ptr<VmaAllocator> allocator,
+      VmaAllocation aliased_memory
+    );
     ~GpuImage();
 
     GpuImage() = delete;
@@ -39,6 +51,12 @@ class GpuImage
     GpuImage(GpuImage &&) noexcept = delete;
     GpuImage &operator=(GpuImage &&) noexcept = delete;
 
+    // Memory an image created with the info needs
+    [[nodiscard]] static vk::MemoryRequirements get_memory_requirements(
+      const GpuImageCreateInfo &info,
+      const vk::Device &device
+    );
+
     // Create a 32-bit shader-readable image from a byte array
     [[nodiscard]] static std::unique_ptr<GpuImage> new_color_image(
       const void *data,
@@ -47,7 +65,19 @@ class GpuImage
       const Device &device,
       vk::Sampler sampler,
       vk::Format format = vk::Format::eR8G8B8A8Unorm,
-      bool mipmapped = false
+      bool mipmapped = false,
+      const MipGenerationInfo &mip_info = {}
+    );
+    // Create a shader-readable image from prebuilt mip levels of a
+    // block-compressed format, packed from the largest to the smallest
+    [[nodiscard]] static std::unique_ptr<GpuImage> new_compressed_image(
+      const void *data,
+      uint32_t width,
+      uint32_t height,
+      uint32_t level_count,
+      const Device &device,
+      vk::Sampler sampler,
+      vk::Format format
     );
     // Create an image used for the depth buffer
     [[nodiscard]] static std::unique_ptr<GpuImage> new_depth_image(
@@ -55,7 +85,7 @@ class GpuImage
       uint32_t height,
       std::optional<vk::Sampler> sampler,
       const Device &device,
-      bool enable_multisampling = false
+      vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1
     );
     // Create an image used by compute shaders
     [[nodiscard]] static std::unique_ptr<GpuImage> new_storage_image(
@@ -65,10 +95,13 @@ class GpuImage
       const Device &device
     );
 
+    // Set both queue families to record one half of an ownership transfer
     void transition_layout(
       vk::CommandBuffer cmd,
       vk::ImageLayout old_layout,
-      vk::ImageLayout new_layout
+      vk::ImageLayout new_layout,
+      uint32_t src_queue_family = vk::QueueFamilyIgnored,
+      uint32_t dst_queue_family = vk::QueueFamilyIgnored
     ) noexcept;
     void copy_to(vk::CommandBuffer cmd, const GpuImage &dst) const noexcept;
     void copy_to_vkimage(
@@ -87,6 +120,10 @@ class GpuImage
     }
     [[nodiscard]] vk::Format get_format() const noexcept { return format; }
     [[nodiscard]] vk::Extent3D get_extent() const noexcept { return extent; }
+    [[nodiscard]] vk::ImageUsageFlags get_usage() const noexcept
+    {
+        return usage;
+    }
     [[nodiscard]] vk::Extent2D get_extent2d() const noexcept
     {
         return vk::Extent2D{ extent.width, extent.height };
@@ -106,27 +143,35 @@ class GpuImage
         return sample_count;
     }
 
-    void upload(const void *data, const Device &device, bool mipmapped = false);
-    void upload(
-      const vk::Buffer &staging_buffer,
+    // Enqueue the pixels on the device's upload queue
+    // The image is ready to be sampled once the returned token is complete
+    UploadToken upload(
+      const void *data,
       const Device &device,
-      bool mipmapped = false
+      bool mipmapped = false,
+      const MipGenerationInfo &mip_info = {}
     );
+    // Expects every mip level in eTransferDstOptimal and leaves them in
+    // eTransferSrcOptimal
+    // Only used for formats the compute MipGenerator doesn't support
+    void generate_mipmaps(const vk::CommandBuffer cmd) noexcept;
 
   private:
     std::shared_ptr<VmaAllocator> allocator;
     VkImage image;
-    VmaAllocation allocation; // GPU-only memory allocation
+    // GPU-only memory allocation, null for aliasing images
+    VmaAllocation allocation;
     VmaAllocationInfo allocation_info;
     vk::UniqueImageView view;
     vk::Format format;
     vk::Extent3D extent;
+    vk::ImageUsageFlags usage;
     vk::ImageAspectFlags aspect;
     std::optional<vk::Sampler> sampler;
     int layer_count;
     int level_count;
     vk::SampleCountFlagBits sample_count;
 
-    void generate_mipmaps(const vk::CommandBuffer cmd) noexcept;
+    void create_view(const GpuImageCreateInfo &info, const vk::Device &device);
 };
 } // namespace kovra
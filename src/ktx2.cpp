@@ -0,0 +1,364 @@
+#include "ktx2.hpp"
+#include "format.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace kovra {
+static constexpr std::array<uint8_t, 12> KTX2_IDENTIFIER = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// Layout of the fixed part of the file, see the KTX 2.0 specification
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2LevelIndex
+{
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+static_assert(sizeof(Ktx2LevelIndex) == 24);
+
+bool
+is_ktx2(std::span<const std::byte> bytes) noexcept
+{
+    return bytes.size() >= KTX2_IDENTIFIER.size() &&
+           std::memcmp(
+             bytes.data(), KTX2_IDENTIFIER.data(), KTX2_IDENTIFIER.size()
+           ) == 0;
+}
+
+std::optional<Ktx2Image>
+read_ktx2(std::span<const std::byte> bytes)
+{
+    if (!is_ktx2(bytes) || bytes.size() < sizeof(Ktx2Header)) {
+        spdlog::error("Not a KTX2 file");
+        return std::nullopt;
+    }
+    Ktx2Header header;
+    std::memcpy(&header, bytes.data(), sizeof(Ktx2Header));
+
+    const auto format = static_cast<vk::Format>(header.vk_format);
+    if (header.supercompression_scheme != 0 ||
+        format == vk::Format::eUndefined) {
+        spdlog::error("Supercompressed and Basis Universal KTX2 files are not "
+                      "supported, transcode them to a BCn format first");
+        return std::nullopt;
+    }
+    if (get_format_block(format).size == 0) {
+        spdlog::error(
+          "Unsupported KTX2 texture format: {}", vk::to_string(format)
+        );
+        return std::nullopt;
+    }
+    if (header.pixel_depth > 1 || header.layer_count > 1 ||
+        header.face_count != 1 || header.pixel_width == 0 ||
+        header.pixel_height == 0) {
+        spdlog::error("Only 2D KTX2 textures are supported");
+        return std::nullopt;
+    }
+
+    auto image = Ktx2Image{ .format = format,
+                            .width = header.pixel_width,
+                            .height = header.pixel_height,
+                            // Zero asks for mipmaps to be generated, which
+                            // block-compressed formats can't be blitted for
+                            .level_count = std::max(header.level_count, 1u),
+                            .data = {} };
+    if (image.level_count >
+        get_full_level_count(image.width, image.height)) {
+        spdlog::error(
+          "KTX2 file has {} levels, more than a full mip chain",
+          image.level_count
+        );
+        return std::nullopt;
+    }
+    const auto level_index_size =
+      sizeof(Ktx2LevelIndex) * static_cast<size_t>(image.level_count);
+    if (bytes.size() < sizeof(Ktx2Header) + level_index_size) {
+        spdlog::error("KTX2 level index is truncated");
+        return std::nullopt;
+    }
+
+    for (uint32_t level = 0; level < image.level_count; level++) {
+        Ktx2LevelIndex index;
+        std::memcpy(
+          &index,
+          bytes.data() + sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * level,
+          sizeof(Ktx2LevelIndex)
+        );
+        const auto expected_size = get_level_size(
+          format,
+          std::max(image.width >> level, 1u),
+          std::max(image.height >> level, 1u)
+        );
+        if (index.byte_length != expected_size ||
+            index.byte_length > bytes.size() ||
+            index.byte_offset > bytes.size() - index.byte_length) {
+            spdlog::error("KTX2 level {} has an invalid size or offset", level);
+            return std::nullopt;
+        }
+
+        // Levels are stored smallest first, but packed largest first here
+        const auto level_bytes =
+          bytes.subspan(index.byte_offset, index.byte_length);
+        image.data.insert(
+          image.data.end(), level_bytes.begin(), level_bytes.end()
+        );
+    }
+
+    return image;
+}
+
+std::optional<Ktx2Image>
+read_ktx2(const std::filesystem::path &filepath)
+{
+    const auto bytes = utils::read_file(filepath);
+    if (!bytes.has_value()) {
+        spdlog::error("Failed to read KTX2 file: {}", filepath.string());
+        return std::nullopt;
+    }
+    return read_ktx2(bytes.value());
+}
+
+// Basic data format descriptor for the formats the texture encoder writes
+// See the Khronos Data Format Specification for the layout
+static std::optional<std::vector<uint32_t>>
+create_data_format_descriptor(vk::Format format)
+{
+    // Color models and channel IDs
+    constexpr uint32_t MODEL_RGBSDA = 1;
+    constexpr uint32_t MODEL_BC1A = 128;
+    constexpr uint32_t MODEL_BC3 = 130;
+    constexpr uint32_t MODEL_BC4 = 131;
+    constexpr uint32_t MODEL_BC5 = 132;
+    constexpr uint32_t MODEL_BC7 = 134;
+    constexpr uint32_t CHANNEL_ALPHA = 15;
+
+    struct Sample
+    {
+        uint32_t bit_offset;
+        uint32_t bit_length;
+        uint32_t channel;
+    };
+    uint32_t model = 0;
+    bool srgb = false;
+    std::vector<Sample> samples;
+    switch (format) {
+        case vk::Format::eR8G8B8A8Srgb:
+            srgb = true;
+            [[fallthrough]];
+        case vk::Format::eR8G8B8A8Unorm:
+            model = MODEL_RGBSDA;
+            samples = {
+                { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, CHANNEL_ALPHA }
+            };
+            break;
+        case vk::Format::eBc1RgbSrgbBlock:
+            srgb = true;
+            [[fallthrough]];
+        case vk::Format::eBc1RgbUnormBlock:
+            model = MODEL_BC1A;
+            samples = { { 0, 64, 0 } };
+            break;
+        case vk::Format::eBc1RgbaSrgbBlock:
+            srgb = true;
+            [[fallthrough]];
+        case vk::Format::eBc1RgbaUnormBlock:
+            // Channel 1 marks the punch-through alpha as present
+            model = MODEL_BC1A;
+            samples = { { 0, 64, 1 } };
+            break;
+        case vk::Format::eBc3SrgbBlock:
+            srgb = true;
+            [[fallthrough]];
+        case vk::Format::eBc3UnormBlock:
+            model = MODEL_BC3;
+            samples = { { 0, 64, CHANNEL_ALPHA }, { 64, 64, 0 } };
+            break;
+        case vk::Format::eBc4UnormBlock:
+            model = MODEL_BC4;
+            samples = { { 0, 64, 0 } };
+            break;
+        case vk::Format::eBc5UnormBlock:
+            model = MODEL_BC5;
+            samples = { { 0, 64, 0 }, { 64, 64, 1 } };
+            break;
+        case vk::Format::eBc7SrgbBlock:
+            srgb = true;
+            [[fallthrough]];
+        case vk::Format::eBc7UnormBlock:
+            model = MODEL_BC7;
+            samples = { { 0, 128, 0 } };
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    const auto block = get_format_block(format);
+    const auto block_size =
+      static_cast<uint32_t>(24 + 16 * samples.size());
+    const uint32_t block_dimension = block.extent - 1;
+    // Primaries are BT.709, transfer function is linear (1) or sRGB (2)
+    std::vector<uint32_t> words = {
+        4 + block_size,
+        0,
+        2 | (block_size << 16),
+        model | (1 << 8) | ((srgb ? 2u : 1u) << 16),
+        block_dimension | (block_dimension << 8),
+        block.size,
+        0,
+    };
+    for (const auto &sample : samples) {
+        // sRGB only applies to color, so alpha samples are flagged linear
+        const uint32_t linear =
+          srgb && sample.channel == CHANNEL_ALPHA ? 0x10 : 0;
+        words.push_back(
+          sample.bit_offset | ((sample.bit_length - 1) << 16) |
+          ((sample.channel | linear) << 24)
+        );
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(
+          sample.bit_length >= 32 ? UINT32_MAX
+                                  : (1u << sample.bit_length) - 1
+        );
+    }
+    return words;
+}
+
+std::optional<std::vector<std::byte>>
+encode_ktx2(const Ktx2Image &image)
+{
+    const auto dfd = create_data_format_descriptor(image.format);
+    if (!dfd.has_value()) {
+        spdlog::error(
+          "Cannot write KTX2 texture with format {}",
+          vk::to_string(image.format)
+        );
+        return std::nullopt;
+    }
+    const auto block = get_format_block(image.format);
+
+    // Levels follow the descriptor smallest first, each aligned to the
+    // block size and to 4 bytes
+    const uint64_t alignment = std::max(block.size, 4u);
+    const auto align = [alignment](uint64_t offset) {
+        return (offset + alignment - 1) / alignment * alignment;
+    };
+
+    auto header = Ktx2Header{};
+    std::memcpy(
+      header.identifier, KTX2_IDENTIFIER.data(), KTX2_IDENTIFIER.size()
+    );
+    header.vk_format = static_cast<uint32_t>(image.format);
+    header.type_size = 1;
+    header.pixel_width = image.width;
+    header.pixel_height = image.height;
+    header.face_count = 1;
+    header.level_count = image.level_count;
+    header.dfd_byte_offset = static_cast<uint32_t>(
+      sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * image.level_count
+    );
+    header.dfd_byte_length =
+      static_cast<uint32_t>(dfd.value().size() * sizeof(uint32_t));
+
+    // Offsets of each level in the packed data and in the file
+    std::vector<uint64_t> data_offsets(image.level_count);
+    std::vector<Ktx2LevelIndex> level_index(image.level_count);
+    uint64_t data_offset = 0;
+    for (uint32_t level = 0; level < image.level_count; level++) {
+        const auto size = get_level_size(
+          image.format,
+          std::max(image.width >> level, 1u),
+          std::max(image.height >> level, 1u)
+        );
+        data_offsets[level] = data_offset;
+        level_index[level].byte_length = size;
+        level_index[level].uncompressed_byte_length = size;
+        data_offset += size;
+    }
+    if (data_offset != image.data.size()) {
+        spdlog::error(
+          "KTX2 image data is {} bytes but its levels take up {}",
+          image.data.size(),
+          data_offset
+        );
+        return std::nullopt;
+    }
+    uint64_t file_offset =
+      header.dfd_byte_offset + static_cast<uint64_t>(header.dfd_byte_length);
+    for (uint32_t level = image.level_count; level-- > 0;) {
+        file_offset = align(file_offset);
+        level_index[level].byte_offset = file_offset;
+        file_offset += level_index[level].byte_length;
+    }
+
+    // Padding between the levels stays zeroed
+    std::vector<std::byte> bytes(file_offset);
+    const auto write = [&bytes](uint64_t offset, const void *src, size_t size) {
+        std::memcpy(bytes.data() + offset, src, size);
+    };
+    write(0, &header, sizeof(Ktx2Header));
+    write(
+      sizeof(Ktx2Header),
+      level_index.data(),
+      sizeof(Ktx2LevelIndex) * level_index.size()
+    );
+    write(header.dfd_byte_offset, dfd.value().data(), header.dfd_byte_length);
+    for (uint32_t level = 0; level < image.level_count; level++) {
+        write(
+          level_index[level].byte_offset,
+          image.data.data() + data_offsets[level],
+          level_index[level].byte_length
+        );
+    }
+    return bytes;
+}
+
+bool
+write_ktx2(const std::filesystem::path &filepath, const Ktx2Image &image)
+{
+    const auto bytes = encode_ktx2(image);
+    if (!bytes.has_value()) {
+        return false;
+    }
+    return utils::write_file_atomically(filepath, bytes.value());
+}
+
+std::filesystem::path
+get_compressed_texture_path(
+  const std::filesystem::path &gltf_filepath,
+  size_t image_index
+)
+{
+    auto dir = gltf_filepath.parent_path() /
+               (gltf_filepath.stem().string() + ".textures");
+    return dir / (std::to_string(image_index) + ".ktx2");
+}
+} // namespace kovra
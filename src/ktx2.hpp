@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// 2D texture stored in a KTX2 container
+// Only uncompressed containers whose vkFormat is set are supported, which
+// covers BCn payloads but not Basis Universal ones, since those would need
+// transcoding first
+struct Ktx2Image
+{
+    vk::Format format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    // Every mip level packed tightly, from the largest to the smallest
+    std::vector<std::byte> data;
+};
+
+[[nodiscard]] bool
+is_ktx2(std::span<const std::byte> bytes) noexcept;
+[[nodiscard]] std::optional<Ktx2Image>
+read_ktx2(std::span<const std::byte> bytes);
+[[nodiscard]] std::optional<Ktx2Image>
+read_ktx2(const std::filesystem::path &filepath);
+// Contents of a KTX2 file holding the image
+[[nodiscard]] std::optional<std::vector<std::byte>>
+encode_ktx2(const Ktx2Image &image);
+bool
+write_ktx2(const std::filesystem::path &filepath, const Ktx2Image &image);
+
+// Where the texture encoder writes the compressed version of an image of a
+// glTF file, and where the glTF loader looks for it
+[[nodiscard]] std::filesystem::path
+get_compressed_texture_path(
+  const std::filesystem::path &gltf_filepath,
+  size_t image_index
+);
+} // namespace kovra
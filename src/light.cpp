@@ -0,0 +1,40 @@
+#include "light.hpp"
+
+namespace kovra {
+[[nodiscard]] GpuLight
+Light::as_gpu_data() const noexcept
+{
+    return GpuLight{
+        .position_range = glm::vec4(position, range),
+        .color_intensity = glm::vec4(color, intensity),
+        .direction_type = glm::vec4(
+          glm::normalize(direction), static_cast<float>(type)
+        ),
+        .spot_angles = glm::vec4(
+          glm::cos(glm::radians(inner_cone_deg)),
+          glm::cos(glm::radians(outer_cone_deg)),
+          0.0f,
+          0.0f
+        ),
+    };
+}
+
+[[nodiscard]] glm::vec4
+compute_cluster_params(glm::uvec2 draw_extent, float near, float far) noexcept
+{
+    // Depth slices are distributed exponentially between the near and far
+    // planes so that each slice covers roughly the same screen-space volume:
+    // slice = log(view_depth) * scale + bias
+    const float log_depth_ratio = glm::log(far / near);
+    const float scale = static_cast<float>(CLUSTER_GRID_Z) / log_depth_ratio;
+    const float bias = -static_cast<float>(CLUSTER_GRID_Z) * glm::log(near) /
+                       log_depth_ratio;
+
+    return glm::vec4(
+      glm::ceil(static_cast<float>(draw_extent.x) / CLUSTER_GRID_X),
+      glm::ceil(static_cast<float>(draw_extent.y) / CLUSTER_GRID_Y),
+      scale,
+      bias
+    );
+}
+} // namespace kovra
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "gpu_data.hpp"
+
+namespace kovra {
+// Number of clusters the view frustum is divided into along each axis
+static constexpr uint32_t CLUSTER_GRID_X = 16;
+static constexpr uint32_t CLUSTER_GRID_Y = 9;
+static constexpr uint32_t CLUSTER_GRID_Z = 24;
+static constexpr uint32_t CLUSTER_COUNT =
+  CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// Must match the constants in shaders/scene_data.glsl
+static constexpr uint32_t MAX_LIGHTS = 4096;
+static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 127;
+// Each cluster stores its light count followed by its light indices
+static constexpr uint32_t CLUSTER_STRIDE = MAX_LIGHTS_PER_CLUSTER + 1;
+
+enum class LightType : uint32_t
+{
+    Point = 0,
+    Spot = 1,
+};
+
+struct Light
+{
+    LightType type = LightType::Point;
+    glm::vec3 position{ 0.0f };
+    glm::vec3 direction{ 0.0f, -1.0f, 0.0f }; // Only used by spot lights
+    glm::vec3 color{ 1.0f };
+    float intensity = 1.0f;
+    // Distance at which the light's contribution falls off to zero
+    float range = 10.0f;
+    float inner_cone_deg = 20.0f; // Only used by spot lights
+    float outer_cone_deg = 30.0f; // Only used by spot lights
+
+    [[nodiscard]] GpuLight as_gpu_data() const noexcept;
+};
+
+// Parameters used by the shaders to map a fragment to its cluster
+// xy: cluster tile size in pixels, z: depth slice scale, w: depth slice bias
+[[nodiscard]] glm::vec4
+compute_cluster_params(glm::uvec2 draw_extent, float near, float far) noexcept;
+} // namespace kovra
@@ -0,0 +1,119 @@
+#include "mapped_file.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace kovra {
+std::optional<MappedFile>
+MappedFile::open(const std::filesystem::path &filepath, size_t padding)
+{
+    const int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error(
+          "Failed to open file: {}; ERROR: {}",
+          filepath.string(),
+          std::strerror(errno)
+        );
+        return std::nullopt;
+    }
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        spdlog::error(
+          "Failed to stat file: {}; ERROR: {}",
+          filepath.string(),
+          std::strerror(errno)
+        );
+        ::close(fd);
+        return std::nullopt;
+    }
+    const auto size = static_cast<size_t>(file_stat.st_size);
+    if (size == 0) {
+        // Empty files can't be mapped
+        ::close(fd);
+        return MappedFile{ nullptr, 0, 0 };
+    }
+
+    const size_t capacity = size + padding;
+    void *data = nullptr;
+    if (padding == 0) {
+        data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    } else {
+        // Reserve zeroed memory for the file and its padding, then map the
+        // file over the start of it
+        // Pages past the end of the file stay anonymous, so reading or
+        // writing the padding can never fault
+        data = ::mmap(
+          nullptr,
+          capacity,
+          PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS,
+          -1,
+          0
+        );
+        if (data != MAP_FAILED &&
+            ::mmap(
+              data,
+              size,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_FIXED,
+              fd,
+              0
+            ) == MAP_FAILED) {
+            const int error = errno;
+            ::munmap(data, capacity);
+            data = MAP_FAILED;
+            errno = error;
+        }
+    }
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        spdlog::error(
+          "Failed to map file: {}; ERROR: {}",
+          filepath.string(),
+          std::strerror(errno)
+        );
+        return std::nullopt;
+    }
+    // The whole file is usually read front to back right away
+    (void)::madvise(data, size, MADV_WILLNEED);
+
+    return MappedFile{ static_cast<std::byte *>(data), size, capacity };
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr) {
+        ::munmap(data, capacity);
+    }
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+  : data{ std::exchange(other.data, nullptr) }
+  , size{ std::exchange(other.size, 0) }
+  , capacity{ std::exchange(other.capacity, 0) }
+{
+}
+
+MappedFile &
+MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other) {
+        if (data != nullptr) {
+            ::munmap(data, capacity);
+        }
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        capacity = std::exchange(other.capacity, 0);
+    }
+    return *this;
+}
+} // namespace kovra
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace kovra {
+// Read-only memory mapping of a whole file
+// Pages are faulted in by the kernel as they are read, so nothing is copied
+// until the bytes are actually used
+class MappedFile
+{
+  public:
+    // With padding, that many zeroed bytes follow the file and the mapping is
+    // writable, for parsers that read past the end of their input
+    // Writes only ever touch private copies of the pages, never the file
+    [[nodiscard]] static std::optional<MappedFile> open(
+      const std::filesystem::path &filepath,
+      size_t padding = 0
+    );
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    [[nodiscard]] std::span<const std::byte> get_bytes() const noexcept
+    {
+        return { data, size };
+    }
+    // Only writable if the file was opened with padding
+    [[nodiscard]] std::byte *get_data() noexcept { return data; }
+    // Size of the file plus the padding
+    [[nodiscard]] size_t get_capacity() const noexcept { return capacity; }
+
+  private:
+    MappedFile(std::byte *data, size_t size, size_t capacity) noexcept
+      : data{ data }
+      , size{ size }
+      , capacity{ capacity }
+    {
+    }
+
+    std::byte *data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+};
+} // namespace kovra
@@ -1,8 +1,17 @@
 #include "material.hpp"
+#include "pipeline_cache.hpp"
 #include "spdlog/spdlog.h"
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
+Material::~Material()
+{
+    // The build still uses the pipeline layout
+    if (pipeline.valid()) {
+        pipeline.wait();
+    }
+}
+
 void
 Material::update_push_constants(
   vk::CommandBuffer cmd,
@@ -21,7 +30,7 @@ Material::update_push_constants(
 void
 Material::bind_pipeline(vk::CommandBuffer cmd) const
 {
-    cmd.bindPipeline(pipeline_bind_point, pipeline.get());
+    cmd.bindPipeline(pipeline_bind_point, pipeline.get().get());
 }
 void
 Material::bind_desc_sets(
@@ -94,37 +103,77 @@ GraphicsMaterialBuilder::GraphicsMaterialBuilder()
 }
 
 Material
-GraphicsMaterialBuilder::build(const vk::Device &device)
+GraphicsMaterialBuilder::build(PipelineBuildQueue &build_queue)
 {
     if (!shader.has_value() || !pipeline_layout.has_value() ||
-        !color_attachment_format.has_value() ||
+        (color_attachment_formats.empty() && !depth_only) ||
         !depth_attachment_format.has_value()) {
         throw std::runtime_error(
           "GraphicsMaterialBuilder: missing required fields"
         );
     }
 
+    // The layout is needed right away to bind descriptor sets and push
+    // constants, the builder goes along with the task
+    auto layout = std::move(*pipeline_layout);
+    pipeline_layout.reset();
+    auto pipeline = build_queue.enqueue(PipelineBuildTask{
+      [builder = std::move(*this),
+       layout = layout.get()](PipelineCache &pipeline_cache) mutable {
+          return builder.create_pipeline(pipeline_cache, layout);
+      } });
+
+    return Material{ std::move(pipeline),
+                     std::move(layout),
+                     vk::PipelineBindPoint::eGraphics };
+}
+
+vk::UniquePipeline
+GraphicsMaterialBuilder::create_pipeline(
+  PipelineCache &pipeline_cache,
+  vk::PipelineLayout layout
+)
+{
     constexpr const char *shader_main_fn_name = "main";
+    const auto specialization_info =
+      vk::SpecializationInfo{}
+        .setMapEntries(specialization_map_entries)
+        .setDataSize(specialization_data.size())
+        .setPData(specialization_data.data());
     std::vector<vk::PipelineShaderStageCreateInfo> shader_stages = {
         vk::PipelineShaderStageCreateInfo{}
           .setStage(vk::ShaderStageFlagBits::eVertex)
           .setModule(shader->get()->get_vert_shader_mod())
           .setPName(shader_main_fn_name),
-        vk::PipelineShaderStageCreateInfo{}
-          .setStage(vk::ShaderStageFlagBits::eFragment)
-          .setModule(shader->get()->get_frag_shader_mod())
-          .setPName(shader_main_fn_name)
     };
+    // Depth-only shaders have no fragment stage
+    if (shader->get()->get_frag_shader_mod()) {
+        shader_stages.emplace_back(
+          vk::PipelineShaderStageCreateInfo{}
+            .setStage(vk::ShaderStageFlagBits::eFragment)
+            .setModule(shader->get()->get_frag_shader_mod())
+            .setPName(shader_main_fn_name)
+        );
+    }
+    if (!specialization_map_entries.empty()) {
+        for (auto &stage : shader_stages) {
+            stage.setPSpecializationInfo(&specialization_info);
+        }
+    }
 
     auto viewport_state_ci{ vk::PipelineViewportStateCreateInfo{}
                               .setViewportCount(1)
                               .setScissorCount(1) };
 
+    // Every color attachment shares the same blend state
+    const std::vector<vk::PipelineColorBlendAttachmentState>
+      color_blend_attachments(
+        color_attachment_formats.size(), color_blend_attachment
+      );
     auto color_blend_ci{ vk::PipelineColorBlendStateCreateInfo{}
                            .setLogicOp(vk::LogicOp::eCopy)
                            .setLogicOpEnable(vk::False)
-                           .setAttachmentCount(1)
-                           .setPAttachments(&color_blend_attachment) };
+                           .setAttachments(color_blend_attachments) };
 
     std::vector<vk::DynamicState> dynamic_states = {
         vk::DynamicState::eViewport, vk::DynamicState::eScissor
@@ -132,10 +181,16 @@ GraphicsMaterialBuilder::build(const vk::Device &device)
     auto dynamic_ci =
       vk::PipelineDynamicStateCreateInfo{}.setDynamicStates(dynamic_states);
 
+    // Point at the members of this builder, not the one it was moved from
+    rendering_ci.setColorAttachmentFormats(color_attachment_formats);
+    vertex_input_ci
+      .setVertexAttributeDescriptions(vertex_input_desc.attributes)
+      .setVertexBindingDescriptions(vertex_input_desc.bindings);
+
     auto pipeline_ci = vk::GraphicsPipelineCreateInfo{}
                          .setPNext(&rendering_ci)
                          .setStages(shader_stages)
-                         .setLayout(pipeline_layout->get())
+                         .setLayout(layout)
                          .setPVertexInputState(&vertex_input_ci)
                          .setPInputAssemblyState(&input_assembly_ci)
                          .setPViewportState(&viewport_state_ci)
@@ -145,17 +200,7 @@ GraphicsMaterialBuilder::build(const vk::Device &device)
                          .setPDepthStencilState(&depth_stencil_ci)
                          .setPDynamicState(&dynamic_ci);
 
-    auto pipeline = device.createGraphicsPipelineUnique(nullptr, pipeline_ci);
-    if (pipeline.result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create graphics pipeline");
-    }
-
-    // Destroy shader after pipeline creation
-    shader.reset();
-
-    return Material{ std::move(pipeline.value),
-                     std::move(*pipeline_layout),
-                     vk::PipelineBindPoint::eGraphics };
+    return pipeline_cache.create_graphics_pipeline(pipeline_ci);
 }
 
 GraphicsMaterialBuilder &
@@ -261,9 +306,15 @@ GraphicsMaterialBuilder::enable_additive_blending()
 GraphicsMaterialBuilder &
 GraphicsMaterialBuilder::set_color_attachment_format(vk::Format format)
 {
-    color_attachment_format = format;
-    rendering_ci.setColorAttachmentCount(1);
-    rendering_ci.setPColorAttachmentFormats(&color_attachment_format.value());
+    return set_color_attachment_formats(std::span{ &format, 1 });
+}
+GraphicsMaterialBuilder &
+GraphicsMaterialBuilder::set_color_attachment_formats(
+  std::span<const vk::Format> formats
+)
+{
+    color_attachment_formats.assign(formats.begin(), formats.end());
+    rendering_ci.setColorAttachmentFormats(color_attachment_formats);
     return *this;
 }
 GraphicsMaterialBuilder &
@@ -274,6 +325,14 @@ GraphicsMaterialBuilder::set_depth_attachment_format(vk::Format format)
     return *this;
 }
 GraphicsMaterialBuilder &
+GraphicsMaterialBuilder::disable_color_attachments()
+{
+    depth_only = true;
+    color_attachment_formats.clear();
+    rendering_ci.setColorAttachmentFormats(color_attachment_formats);
+    return *this;
+}
+GraphicsMaterialBuilder &
 GraphicsMaterialBuilder::set_depth_test(bool enable, vk::CompareOp op)
 {
     depth_stencil_ci.setDepthTestEnable(enable);
@@ -284,6 +343,17 @@ GraphicsMaterialBuilder::set_depth_test(bool enable, vk::CompareOp op)
     return *this;
 }
 GraphicsMaterialBuilder &
+GraphicsMaterialBuilder::set_depth_bias(
+  float constant_factor,
+  float slope_factor
+)
+{
+    rasterization_ci.setDepthBiasEnable(vk::True);
+    rasterization_ci.setDepthBiasConstantFactor(constant_factor);
+    rasterization_ci.setDepthBiasSlopeFactor(slope_factor);
+    return *this;
+}
+GraphicsMaterialBuilder &
 GraphicsMaterialBuilder::set_vertex_input_desc(
   const VertexInputDescription &&desc
 )
@@ -296,9 +366,19 @@ GraphicsMaterialBuilder::set_vertex_input_desc(
         .setFlags(vertex_input_desc.flags);
     return *this;
 }
+GraphicsMaterialBuilder &
+GraphicsMaterialBuilder::set_specialization_constants(
+  std::span<const vk::SpecializationMapEntry> map_entries,
+  std::span<const std::byte> data
+)
+{
+    specialization_map_entries.assign(map_entries.begin(), map_entries.end());
+    specialization_data.assign(data.begin(), data.end());
+    return *this;
+}
 
 Material
-ComputeMaterialBuilder::build(const vk::Device &device)
+ComputeMaterialBuilder::build(PipelineBuildQueue &build_queue)
 {
     if (!shader.has_value() || !pipeline_layout.has_value()) {
         throw std::runtime_error(
@@ -306,27 +386,35 @@ ComputeMaterialBuilder::build(const vk::Device &device)
         );
     }
 
+    auto layout = std::move(*pipeline_layout);
+    pipeline_layout.reset();
+    auto pipeline = build_queue.enqueue(PipelineBuildTask{
+      [builder = std::move(*this),
+       layout = layout.get()](PipelineCache &pipeline_cache) mutable {
+          return builder.create_pipeline(pipeline_cache, layout);
+      } });
+
+    return Material{ std::move(pipeline),
+                     std::move(layout),
+                     vk::PipelineBindPoint::eCompute };
+}
+
+vk::UniquePipeline
+ComputeMaterialBuilder::create_pipeline(
+  PipelineCache &pipeline_cache,
+  vk::PipelineLayout layout
+)
+{
     constexpr const char *shader_main_fn_name = "main";
     auto shader_stage = vk::PipelineShaderStageCreateInfo{}
                           .setStage(vk::ShaderStageFlagBits::eCompute)
                           .setModule((*shader)->get_shader_mod())
                           .setPName(shader_main_fn_name);
 
-    auto pipeline = device.createComputePipelineUnique(
-      nullptr,
-      vk::ComputePipelineCreateInfo{}
-        .setStage(shader_stage)
-        .setLayout(pipeline_layout->get())
-    );
-    if (pipeline.result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create compute pipeline");
-    }
-
-    shader.reset();
-
-    return Material{ std::move(pipeline.value),
-                     std::move(*pipeline_layout),
-                     vk::PipelineBindPoint::eCompute };
+    auto pipeline_ci = vk::ComputePipelineCreateInfo{}
+                         .setStage(shader_stage)
+                         .setLayout(layout);
+    return pipeline_cache.create_compute_pipeline(pipeline_ci);
 }
 
 ComputeMaterialBuilder &
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "pipeline_build_queue.hpp"
 #include "shader.hpp"
 #include "vertex.hpp"
 
@@ -12,6 +13,7 @@ namespace kovra {
 // Forward declarations
 class Device;
 class Material;
+class PipelineCache;
 
 enum class MaterialPass : uint8_t
 {
@@ -26,11 +28,22 @@ struct MaterialInstance
     const std::shared_ptr<Material> material;
     const vk::DescriptorSet desc_set;
     const MaterialPass pass;
+    // Material used by the deferred geometry pass (null if not supported)
+    const std::shared_ptr<Material> gbuffer_material = nullptr;
+    // Index into the bindless material buffer (used by the visibility buffer)
+    const uint32_t bindless_material_index = 0;
+    // Material used by the forward pass when it also writes motion vectors for
+    // temporal anti-aliasing (null if not supported)
+    const std::shared_ptr<Material> motion_material = nullptr;
+    // Whether fragments below the alpha cutoff are discarded, which the
+    // visibility buffer needs its own pipeline for
+    const bool alpha_mask = false;
 };
 
 class Material
 {
   public:
+    ~Material();
     Material(const Material &) = delete;
     Material &operator=(const Material &) = delete;
     Material(Material &&rhs) noexcept
@@ -42,6 +55,9 @@ class Material
     Material &operator=(Material &&rhs) noexcept
     {
         if (this != &rhs) {
+            if (pipeline.valid()) {
+                pipeline.wait();
+            }
             pipeline = std::move(rhs.pipeline);
             pipeline_layout = std::move(rhs.pipeline_layout);
             pipeline_bind_point = std::move(rhs.pipeline_bind_point);
@@ -54,6 +70,7 @@ class Material
       vk::ShaderStageFlags stages,
       const std::span<const std::byte> &data
     ) const;
+    // Blocks until the pipeline is built the first time it is bound
     void bind_pipeline(vk::CommandBuffer cmd) const;
     void bind_desc_sets(
       vk::CommandBuffer cmd,
@@ -64,7 +81,7 @@ class Material
 
   private:
     Material(
-      vk::UniquePipeline pipeline,
+      PipelineFuture pipeline,
       vk::UniquePipelineLayout pipeline_layout,
       const vk::PipelineBindPoint &&pipeline_bind_point
     )
@@ -74,7 +91,8 @@ class Material
     {
     }
 
-    vk::UniquePipeline pipeline;
+    // Built on the pipeline build queue, the layout is created right away
+    PipelineFuture pipeline;
     vk::UniquePipelineLayout pipeline_layout;
     vk::PipelineBindPoint pipeline_bind_point;
 
@@ -86,7 +104,8 @@ class GraphicsMaterialBuilder
 {
   public:
     GraphicsMaterialBuilder();
-    Material build(const vk::Device &device);
+    // Queues the pipeline to be built on a worker thread
+    Material build(PipelineBuildQueue &build_queue);
 
     GraphicsMaterialBuilder &set_shader(std::unique_ptr<GraphicsShader> shader);
     GraphicsMaterialBuilder &set_pipeline_layout(
@@ -103,12 +122,26 @@ class GraphicsMaterialBuilder
     GraphicsMaterialBuilder &enable_alpha_blending();
     GraphicsMaterialBuilder &enable_additive_blending();
     GraphicsMaterialBuilder &set_color_attachment_format(vk::Format format);
+    // Use when rendering to multiple color attachments (e.g. a G-buffer)
+    GraphicsMaterialBuilder &set_color_attachment_formats(
+      std::span<const vk::Format> formats
+    );
     GraphicsMaterialBuilder &set_depth_attachment_format(vk::Format format);
+    // Use when rendering to a depth attachment only (e.g. shadow maps)
+    GraphicsMaterialBuilder &disable_color_attachments();
     GraphicsMaterialBuilder &
     set_depth_test(bool enable, vk::CompareOp op = vk::CompareOp::eLess);
+    GraphicsMaterialBuilder &
+    set_depth_bias(float constant_factor, float slope_factor);
     GraphicsMaterialBuilder &set_vertex_input_desc(
       const VertexInputDescription &&desc
     );
+    // Specialization constants of every stage, stages ignore the ones they
+    // don't declare
+    GraphicsMaterialBuilder &set_specialization_constants(
+      std::span<const vk::SpecializationMapEntry> map_entries,
+      std::span<const std::byte> data
+    );
 
   private:
     VertexInputDescription vertex_input_desc;
@@ -119,19 +152,29 @@ class GraphicsMaterialBuilder
     vk::PipelineMultisampleStateCreateInfo multisample_ci;
     vk::PipelineDepthStencilStateCreateInfo depth_stencil_ci;
     vk::PipelineRenderingCreateInfo rendering_ci;
+    std::vector<vk::SpecializationMapEntry> specialization_map_entries;
+    std::vector<std::byte> specialization_data;
 
     // Required fields for building a graphics material
     std::optional<std::unique_ptr<GraphicsShader>> shader;
     std::optional<vk::UniquePipelineLayout> pipeline_layout;
-    std::optional<vk::Format> color_attachment_format;
+    std::vector<vk::Format> color_attachment_formats;
     std::optional<vk::Format> depth_attachment_format;
+    bool depth_only = false;
+
+    // Runs on the pipeline build queue, with the builder moved into the task
+    [[nodiscard]] vk::UniquePipeline create_pipeline(
+      PipelineCache &pipeline_cache,
+      vk::PipelineLayout layout
+    );
 };
 
 class ComputeMaterialBuilder
 {
   public:
     ComputeMaterialBuilder() = default;
-    Material build(const vk::Device &device);
+    // Queues the pipeline to be built on a worker thread
+    Material build(PipelineBuildQueue &build_queue);
 
     ComputeMaterialBuilder &set_shader(std::unique_ptr<ComputeShader> shader);
     ComputeMaterialBuilder &set_pipeline_layout(
@@ -142,5 +185,11 @@ class ComputeMaterialBuilder
     // Required fields for building a compute material
     std::optional<std::unique_ptr<ComputeShader>> shader;
     std::optional<vk::UniquePipelineLayout> pipeline_layout;
+
+    // Runs on the pipeline build queue, with the builder moved into the task
+    [[nodiscard]] vk::UniquePipeline create_pipeline(
+      PipelineCache &pipeline_cache,
+      vk::PipelineLayout layout
+    );
 };
 } // namespace kovra
@@ -2,26 +2,68 @@
 #include "device.hpp"
 #include "spdlog/spdlog.h"
 
+#include <cmath>
+
 namespace kovra {
-void
+UploadToken
 upload(
-  const std::span<GpuVertexData> &vertices,
-  const std::span<uint32_t> &indices,
+  std::span<const GpuVertexData> vertices,
+  std::span<const uint32_t> indices,
   const GpuBuffer &vertex_buffer,
   const GpuBuffer &index_buffer,
   const Device &device
 );
 
-uint32_t Mesh::MESH_ID_COUNTER = 0;
+std::atomic<uint32_t> Mesh::MESH_ID_COUNTER = 0;
 
 Mesh::Mesh(
   const std::span<Vertex> &vertices,
   const std::span<uint32_t> &indices,
   const Device &device
 )
+  : Mesh(
+      std::span<const GpuVertexData>(to_gpu_vertices(vertices)),
+      std::span<const uint32_t>(indices),
+      device
+    )
+{
+}
+
+Mesh::Mesh(
+  std::span<const GpuVertexData> vertices,
+  std::span<const uint32_t> indices,
+  const Device &device
+)
+  : Mesh(vertices.size(), indices.size(), device)
+{
+    // Upload vertices and indices to GPU
+    upload_token =
+      upload(vertices, indices, *vertex_buffer, *index_buffer, device);
+}
+
+Mesh::Mesh(
+  size_t vertex_count,
+  const StagingWriter &write_vertices,
+  size_t index_count,
+  const StagingWriter &write_indices,
+  const Device &device
+)
+  : Mesh(vertex_count, index_count, device)
+{
+    // Both copies land in the same batch, so the index token covers both
+    auto &upload_queue = device.get_upload_queue();
+    (void)upload_queue.enqueue_buffer(
+      vertex_count, sizeof(GpuVertexData), *vertex_buffer, write_vertices
+    );
+    upload_token = upload_queue.enqueue_buffer(
+      index_count, sizeof(uint32_t), *index_buffer, write_indices
+    );
+}
+
+Mesh::Mesh(size_t vertex_count, size_t index_count, const Device &device)
   : id{ MESH_ID_COUNTER++ }
   , vertex_buffer{ device.create_buffer(
-      sizeof(GpuVertexData) * vertices.size(),
+      sizeof(GpuVertexData) * vertex_count,
       vk::BufferUsageFlagBits::eStorageBuffer |
         vk::BufferUsageFlagBits::eTransferDst |
         vk::BufferUsageFlagBits::eShaderDeviceAddress,
@@ -29,15 +71,24 @@ Mesh::Mesh(
       VMA_ALLOCATION_CREATE_MAPPED_BIT
     ) }
   , index_buffer{ device.create_buffer(
-      sizeof(uint32_t) * indices.size(),
+      sizeof(uint32_t) * index_count,
       vk::BufferUsageFlagBits::eIndexBuffer |
-        vk::BufferUsageFlagBits::eTransferDst,
+        vk::BufferUsageFlagBits::eTransferDst |
+        vk::BufferUsageFlagBits::eShaderDeviceAddress,
       VMA_MEMORY_USAGE_GPU_ONLY,
       VMA_ALLOCATION_CREATE_MAPPED_BIT
     ) }
   , vertex_buffer_address{ device.get().getBufferAddress(
       vk::BufferDeviceAddressInfo{}.setBuffer(vertex_buffer->get())
     ) }
+  , index_buffer_address{ device.get().getBufferAddress(
+      vk::BufferDeviceAddressInfo{}.setBuffer(index_buffer->get())
+    ) }
+{
+}
+
+std::vector<GpuVertexData>
+Mesh::to_gpu_vertices(std::span<const Vertex> vertices)
 {
     // Convert each Vertex to GpuVertexData
     std::vector<GpuVertexData> gpu_vertices;
@@ -45,20 +96,19 @@ Mesh::Mesh(
     for (const Vertex &vertex : vertices) {
         gpu_vertices.emplace_back(vertex.as_gpu_data());
     }
-
-    // Upload vertices and indices to GPU
-    upload(gpu_vertices, indices, *vertex_buffer, *index_buffer, device);
+    return gpu_vertices;
 }
+
 Mesh::~Mesh()
 {
     index_buffer.reset();
     vertex_buffer.reset();
 }
 
-void
+UploadToken
 upload(
-  const std::span<GpuVertexData> &vertices,
-  const std::span<uint32_t> &indices,
+  std::span<const GpuVertexData> vertices,
+  std::span<const uint32_t> indices,
   const GpuBuffer &vertex_buffer,
   const GpuBuffer &index_buffer,
   const Device &device
@@ -67,34 +117,14 @@ upload(
     const size_t vertex_buffer_size = sizeof(GpuVertexData) * vertices.size();
     const size_t index_buffer_size = sizeof(uint32_t) * indices.size();
 
-    // Create staging buffer
-    auto staging_buffer = device.create_buffer(
-      vertex_buffer_size + index_buffer_size,
-      vk::BufferUsageFlagBits::eTransferSrc,
-      VMA_MEMORY_USAGE_CPU_ONLY,
-      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    // Both copies land in the same batch, so the index token covers both
+    auto &upload_queue = device.get_upload_queue();
+    (void)upload_queue.enqueue_buffer(
+      vertices.data(), vertex_buffer_size, vertex_buffer
     );
-
-    // Write to staging buffer
-    staging_buffer->write(vertices.data(), vertex_buffer_size, 0);
-    staging_buffer->write(
-      indices.data(), index_buffer_size, vertex_buffer_size
+    return upload_queue.enqueue_buffer(
+      indices.data(), index_buffer_size, index_buffer
     );
-
-    // Copy staging buffer to vertex and index buffers
-    device.immediate_submit([&](vk::CommandBuffer cmd) {
-        auto vertex_copy =
-          vk::BufferCopy{}.setSrcOffset(0).setDstOffset(0).setSize(
-            vertex_buffer_size
-          );
-        cmd.copyBuffer(staging_buffer->get(), vertex_buffer.get(), vertex_copy);
-
-        auto index_copy = vk::BufferCopy{}
-                            .setSrcOffset(vertex_buffer_size)
-                            .setDstOffset(0)
-                            .setSize(index_buffer_size);
-        cmd.copyBuffer(staging_buffer->get(), index_buffer.get(), index_copy);
-    });
 }
 
 [[nodiscard]] std::unique_ptr<Mesh>
@@ -142,4 +172,49 @@ Mesh::new_quad(const Device &device)
       std::span<Vertex>(vertices), std::span<uint32_t>(indices), device
     );
 }
+
+[[nodiscard]] std::unique_ptr<Mesh>
+Mesh::new_cube(const Device &device)
+{
+    // Each face gets its own four vertices so the normals stay flat
+    const auto normals = std::array{
+        glm::vec3{ 1.0f, 0.0f, 0.0f }, glm::vec3{ -1.0f, 0.0f, 0.0f },
+        glm::vec3{ 0.0f, 1.0f, 0.0f }, glm::vec3{ 0.0f, -1.0f, 0.0f },
+        glm::vec3{ 0.0f, 0.0f, 1.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f },
+    };
+    const auto uvs = std::array{ glm::vec2{ 0.0f, 0.0f },
+                                 glm::vec2{ 1.0f, 0.0f },
+                                 glm::vec2{ 1.0f, 1.0f },
+                                 glm::vec2{ 0.0f, 1.0f } };
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    vertices.reserve(normals.size() * 4);
+    indices.reserve(normals.size() * 6);
+    for (const auto &normal : normals) {
+        // Two axes spanning the face, ordered so the winding is
+        // counter-clockwise when seen from outside
+        const auto up = std::abs(normal.y) > 0.5f
+                          ? glm::vec3{ 0.0f, 0.0f, 1.0f }
+                          : glm::vec3{ 0.0f, 1.0f, 0.0f };
+        const auto tangent = glm::cross(up, normal);
+        const auto bitangent = glm::cross(normal, tangent);
+
+        const auto first = static_cast<uint32_t>(vertices.size());
+        for (const auto &uv : uvs) {
+            const auto corner = normal * 0.5f + tangent * (uv.x - 0.5f) +
+                                bitangent * (uv.y - 0.5f);
+            vertices.emplace_back(Vertex{ .position = corner,
+                                          .normal = normal,
+                                          .color = { 1.0f, 1.0f, 1.0f },
+                                          .uv = uv });
+        }
+        for (const uint32_t index : { 0u, 1u, 2u, 2u, 3u, 0u }) {
+            indices.emplace_back(first + index);
+        }
+    }
+    return std::make_unique<Mesh>(
+      std::span<Vertex>(vertices), std::span<uint32_t>(indices), device
+    );
+}
 } // namespace kovra
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "buffer.hpp"
+#include "upload_queue.hpp"
 #include "vertex.hpp"
 
+#include <atomic>
+
 namespace kovra {
 // Forward declarations
 class Device;
@@ -15,6 +18,22 @@ class Mesh
       const std::span<uint32_t> &indices,
       const Device &device
     );
+    // The vertices are already in the layout the shaders read, so they are
+    // copied to staging memory as they are
+    Mesh(
+      std::span<const GpuVertexData> vertices,
+      std::span<const uint32_t> indices,
+      const Device &device
+    );
+    // The writers produce the vertices and indices straight into staging
+    // memory, see UploadQueue::enqueue_buffer
+    Mesh(
+      size_t vertex_count,
+      const StagingWriter &write_vertices,
+      size_t index_count,
+      const StagingWriter &write_indices,
+      const Device &device
+    );
     ~Mesh();
     Mesh() = delete;
     Mesh(const Mesh &) = delete;
@@ -25,6 +44,8 @@ class Mesh
     [[nodiscard]] static std::unique_ptr<Mesh> new_triangle(const Device &device
     );
     [[nodiscard]] static std::unique_ptr<Mesh> new_quad(const Device &device);
+    // Unit cube centered on the origin with flat normals
+    [[nodiscard]] static std::unique_ptr<Mesh> new_cube(const Device &device);
 
     [[nodiscard]] uint32_t get_id() const noexcept { return id; }
     [[nodiscard]] const GpuBuffer &get_vertex_buffer() const noexcept
@@ -39,6 +60,15 @@ class Mesh
     {
         return vertex_buffer_address;
     }
+    [[nodiscard]] vk::DeviceAddress get_index_buffer_address() const noexcept
+    {
+        return index_buffer_address;
+    }
+    // Complete once the vertex and index buffers are ready to be drawn
+    [[nodiscard]] UploadToken get_upload_token() const noexcept
+    {
+        return upload_token;
+    }
     [[nodiscard]] uint32_t get_index_count() const noexcept
     {
         return static_cast<uint32_t>(
@@ -47,11 +77,22 @@ class Mesh
     }
 
   private:
-    static uint32_t MESH_ID_COUNTER;
+    // Creates the buffers without uploading anything to them
+    Mesh(size_t vertex_count, size_t index_count, const Device &device);
+
+    [[nodiscard]] static std::vector<GpuVertexData> to_gpu_vertices(
+      std::span<const Vertex> vertices
+    );
+
+    // Meshes are created on scene loading threads too
+    static std::atomic<uint32_t> MESH_ID_COUNTER;
     uint32_t id;
 
     std::unique_ptr<GpuBuffer> vertex_buffer;
     std::unique_ptr<GpuBuffer> index_buffer;
     vk::DeviceAddress vertex_buffer_address;
+    // Used by the visibility buffer to fetch triangles in compute shaders
+    vk::DeviceAddress index_buffer_address;
+    UploadToken upload_token = 0;
 };
 } // namespace kovra
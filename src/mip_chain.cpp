@@ -0,0 +1,199 @@
+#include "mip_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace kovra {
+namespace {
+using Texel = std::array<float, 4>;
+
+float
+srgb_to_linear(float c)
+{
+    return c > 0.04045f ? std::pow((c + 0.055f) / 1.055f, 2.4f) : c / 12.92f;
+}
+
+float
+linear_to_srgb(float c)
+{
+    return c > 0.0031308f ? 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f
+                          : c * 12.92f;
+}
+
+// Alpha-tested texels are averaged as the fraction that passes the test, and
+// stored as an alpha that passes exactly when at least half of them do
+float
+coverage_to_alpha(float coverage, float cutoff)
+{
+    if (coverage < 0.5f) {
+        return coverage * 2.0f * cutoff;
+    }
+    return cutoff + (1.0f - cutoff) * (coverage - 0.5f) * 2.0f;
+}
+
+float
+alpha_to_coverage(float alpha, float cutoff)
+{
+    if (alpha < cutoff) {
+        return 0.5f * alpha / cutoff;
+    }
+    return 0.5f + 0.5f * (alpha - cutoff) / std::max(1.0f - cutoff, 0.0001f);
+}
+
+// Stored texel to a value that can be averaged
+Texel
+decode(const uint8_t *texel, const MipGenerationInfo &info, uint32_t src_level)
+{
+    Texel value;
+    for (size_t c = 0; c < 4; c++) {
+        value[c] = texel[c] / 255.0f;
+    }
+    if (info.filter == MipFilter::Srgb) {
+        for (size_t c = 0; c < 3; c++) {
+            value[c] = srgb_to_linear(value[c]);
+        }
+    } else if (info.filter == MipFilter::Normal) {
+        for (size_t c = 0; c < 3; c++) {
+            value[c] = value[c] * 2.0f - 1.0f;
+        }
+    }
+    if (info.alpha_cutoff > 0.0f && src_level == 0) {
+        value[3] = value[3] >= info.alpha_cutoff ? 1.0f : 0.0f;
+    } else if (info.alpha_cutoff > 0.0f) {
+        value[3] = alpha_to_coverage(value[3], info.alpha_cutoff);
+    }
+    return value;
+}
+
+void
+encode(Texel value, const MipGenerationInfo &info, uint8_t *texel)
+{
+    if (info.filter == MipFilter::Srgb) {
+        for (size_t c = 0; c < 3; c++) {
+            value[c] = linear_to_srgb(value[c]);
+        }
+    } else if (info.filter == MipFilter::Normal) {
+        // Averaged normals are shorter than one, or zero where they cancel
+        const float len = std::sqrt(
+          value[0] * value[0] + value[1] * value[1] + value[2] * value[2]
+        );
+        const Texel normal = len > 0.0001f ? Texel{ value[0] / len,
+                                                    value[1] / len,
+                                                    value[2] / len,
+                                                    0.0f }
+                                           : Texel{ 0.0f, 0.0f, 1.0f, 0.0f };
+        for (size_t c = 0; c < 3; c++) {
+            value[c] = normal[c] * 0.5f + 0.5f;
+        }
+    }
+    if (info.alpha_cutoff > 0.0f) {
+        value[3] = coverage_to_alpha(value[3], info.alpha_cutoff);
+    }
+    for (size_t c = 0; c < 4; c++) {
+        texel[c] = static_cast<uint8_t>(
+          std::lround(std::clamp(value[c], 0.0f, 1.0f) * 255.0f)
+        );
+    }
+}
+
+// Weights of the source texels from 2 * x on that cover texel x of the next
+// level along one axis, returns how many there are
+// Odd sizes don't divide evenly, so each texel covers parts of three.
+uint32_t
+footprint(uint32_t x, uint32_t src_size, std::array<float, 3> &weights)
+{
+    if (src_size == 1) {
+        weights = { 1.0f, 0.0f, 0.0f };
+        return 1;
+    }
+    if (src_size % 2 == 0) {
+        weights = { 0.5f, 0.5f, 0.0f };
+        return 2;
+    }
+    const auto n = static_cast<float>(src_size / 2);
+    const auto size = static_cast<float>(src_size);
+    weights = { (n - x) / size, n / size, (x + 1.0f) / size };
+    return 3;
+}
+} // namespace
+
+std::vector<uint8_t>
+downsample_rgba8(
+  std::span<const uint8_t> texels,
+  uint32_t width,
+  uint32_t height,
+  const MipGenerationInfo &info,
+  uint32_t src_level
+)
+{
+    const uint32_t next_width = std::max(width / 2, 1u);
+    const uint32_t next_height = std::max(height / 2, 1u);
+    std::vector<uint8_t> next(
+      static_cast<size_t>(next_width) * next_height * 4
+    );
+    for (uint32_t y = 0; y < next_height; y++) {
+        std::array<float, 3> weights_y;
+        const uint32_t taps_y = footprint(y, height, weights_y);
+        for (uint32_t x = 0; x < next_width; x++) {
+            std::array<float, 3> weights_x;
+            const uint32_t taps_x = footprint(x, width, weights_x);
+
+            Texel sum{};
+            for (uint32_t j = 0; j < taps_y; j++) {
+                for (uint32_t i = 0; i < taps_x; i++) {
+                    const uint32_t src_x = std::min(x * 2 + i, width - 1);
+                    const uint32_t src_y = std::min(y * 2 + j, height - 1);
+                    const auto value = decode(
+                      &texels[(static_cast<size_t>(src_y) * width + src_x) * 4],
+                      info,
+                      src_level
+                    );
+                    for (size_t c = 0; c < 4; c++) {
+                        sum[c] += value[c] * weights_x[i] * weights_y[j];
+                    }
+                }
+            }
+            encode(
+              sum, info, &next[(static_cast<size_t>(y) * next_width + x) * 4]
+            );
+        }
+    }
+    return next;
+}
+
+Ktx2Image
+build_rgba8_mip_chain(
+  std::span<const uint8_t> texels,
+  uint32_t width,
+  uint32_t height,
+  const MipGenerationInfo &info
+)
+{
+    auto image = Ktx2Image{ .format = vk::Format::eR8G8B8A8Unorm,
+                            .width = width,
+                            .height = height,
+                            .level_count = 0,
+                            .data = {} };
+    std::vector<uint8_t> level;
+    std::span<const uint8_t> level_texels = texels;
+    while (true) {
+        const auto level_bytes = std::as_bytes(level_texels);
+        image.data.insert(
+          image.data.end(), level_bytes.begin(), level_bytes.end()
+        );
+        if (width == 1 && height == 1) {
+            image.level_count++;
+            break;
+        }
+        level = downsample_rgba8(
+          level_texels, width, height, info, image.level_count
+        );
+        image.level_count++;
+        level_texels = level;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    return image;
+}
+} // namespace kovra
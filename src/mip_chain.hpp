@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ktx2.hpp"
+#include "mip_generator.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace kovra {
+// Half the size of tightly packed RGBA8 texels, filtered like the compute
+// MipGenerator does (see shaders/mip-downsample.comp)
+// Odd sizes are filtered exactly with three taps per axis. Alpha-tested
+// coverage is measured against the first level, so src_level is needed to
+// tell it apart from the rest.
+[[nodiscard]] std::vector<uint8_t>
+downsample_rgba8(
+  std::span<const uint8_t> texels,
+  uint32_t width,
+  uint32_t height,
+  const MipGenerationInfo &info = {},
+  uint32_t src_level = 0
+);
+
+// Every level of an RGBA8 image down to 1x1, built on the CPU with the same
+// filters as the compute MipGenerator
+[[nodiscard]] Ktx2Image
+build_rgba8_mip_chain(
+  std::span<const uint8_t> texels,
+  uint32_t width,
+  uint32_t height,
+  const MipGenerationInfo &info = {}
+);
+} // namespace kovra
@@ -0,0 +1,257 @@
+#include "mip_generator.hpp"
+#include "compute_pass.hpp"
+#include "descriptor.hpp"
+#include "image.hpp"
+#include "material.hpp"
+#include "shader.hpp"
+
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace kovra {
+// Must match the local size of shaders/mip-downsample.comp, where each
+// workgroup writes a 32x32 block of the first level of its dispatch
+static constexpr uint32_t MIP_TILE_SIZE = 32;
+
+// Levels written by one dispatch, the level before them is its source
+struct MipDispatch
+{
+    uint32_t src_level;
+    uint32_t level_count;
+};
+
+static vk::Extent2D
+get_level_extent(vk::Extent2D extent, uint32_t level)
+{
+    return vk::Extent2D{ std::max(extent.width >> level, 1u),
+                         std::max(extent.height >> level, 1u) };
+}
+
+static bool
+is_even_or_one(uint32_t size)
+{
+    return size == 1 || size % 2 == 0;
+}
+
+static std::vector<MipDispatch>
+plan_dispatches(vk::Extent2D extent, uint32_t level_count)
+{
+    std::vector<MipDispatch> dispatches;
+    for (uint32_t src_level = 0; src_level + 1 < level_count;) {
+        auto dispatch = MipDispatch{ .src_level = src_level, .level_count = 1 };
+        // Later levels are reduced from the previous one in shared memory,
+        // which takes two whole texels per texel along each axis
+        auto size = get_level_extent(extent, src_level + 1);
+        while (dispatch.level_count < MipGenerator::LEVELS_PER_DISPATCH &&
+               src_level + dispatch.level_count + 1 < level_count &&
+               is_even_or_one(size.width) && is_even_or_one(size.height)) {
+            dispatch.level_count++;
+            size = get_level_extent(extent, src_level + dispatch.level_count);
+        }
+        dispatches.push_back(dispatch);
+        src_level += dispatch.level_count;
+    }
+    return dispatches;
+}
+
+MipGenerator::MipGenerator(
+  const vk::Device &device,
+  ShaderModuleCache &shader_modules,
+  PipelineBuildQueue &build_queue
+)
+  : device{ device }
+{
+    desc_set_layout =
+      DescriptorSetLayoutBuilder{}
+        .add_binding(
+          0,
+          vk::DescriptorType::eStorageImage,
+          vk::ShaderStageFlagBits::eCompute
+        )
+        .add_binding(
+          1,
+          vk::DescriptorType::eStorageImage,
+          vk::ShaderStageFlagBits::eCompute,
+          LEVELS_PER_DISPATCH
+        )
+        .build_unique(device);
+
+    const auto set_layouts = std::array{ desc_set_layout.get() };
+    const auto push_constant_range =
+      vk::PushConstantRange{}
+        .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+        .setOffset(0)
+        .setSize(sizeof(PushConstants));
+    material = std::make_shared<Material>(
+      ComputeMaterialBuilder{}
+        .set_pipeline_layout(device.createPipelineLayoutUnique(
+          vk::PipelineLayoutCreateInfo{}
+            .setSetLayouts(set_layouts)
+            .setPushConstantRanges(push_constant_range)
+        ))
+        .set_shader(std::make_unique<ComputeShader>(
+          ComputeShader{ "mip-downsample", shader_modules }
+        ))
+        .build(build_queue)
+    );
+}
+
+MipGenerator::~MipGenerator()
+{
+    material.reset();
+    desc_set_layout.reset();
+}
+
+bool
+MipGenerator::supports(vk::Format format) noexcept
+{
+    // The shader reads and writes rgba8 storage views
+    return format == vk::Format::eR8G8B8A8Unorm ||
+           format == vk::Format::eR8G8B8A8Srgb;
+}
+
+vk::ImageCreateFlags
+MipGenerator::get_image_flags(vk::Format format) noexcept
+{
+    // sRGB formats can't be storage images, so they are written through a
+    // UNORM view and filtered in linear space by the shader
+    if (format == vk::Format::eR8G8B8A8Srgb) {
+        return vk::ImageCreateFlagBits::eMutableFormat |
+               vk::ImageCreateFlagBits::eExtendedUsage;
+    }
+    return {};
+}
+
+uint32_t
+MipGenerator::get_dispatch_count(const GpuImage &image) noexcept
+{
+    return static_cast<uint32_t>(
+      plan_dispatches(
+        image.get_extent2d(), static_cast<uint32_t>(image.get_level_count())
+      )
+        .size()
+    );
+}
+
+void
+MipGenerator::record(
+  vk::CommandBuffer cmd,
+  const GpuImage &image,
+  const MipGenerationInfo &info,
+  DescriptorAllocator &desc_alloc,
+  std::vector<vk::UniqueImageView> &views
+) const
+{
+    const auto extent = image.get_extent2d();
+    const auto level_count = static_cast<uint32_t>(image.get_level_count());
+    const auto layer_count = static_cast<uint32_t>(image.get_layer_count());
+
+    // One storage view per level
+    const size_t first_view = views.size();
+    for (uint32_t level = 0; level < level_count; level++) {
+        views.push_back(device.createImageViewUnique(
+          vk::ImageViewCreateInfo{}
+            .setImage(image.get())
+            .setViewType(vk::ImageViewType::e2DArray)
+            .setFormat(vk::Format::eR8G8B8A8Unorm)
+            .setSubresourceRange(vk::ImageSubresourceRange{}
+                                   .setAspectMask(image.get_aspect())
+                                   .setBaseMipLevel(level)
+                                   .setLevelCount(1)
+                                   .setBaseArrayLayer(0)
+                                   .setLayerCount(layer_count))
+        ));
+    }
+    const auto get_level_view = [&](uint32_t level) {
+        return views[first_view + level].get();
+    };
+
+    // Texels of sRGB formats are always encoded, whatever the role
+    auto filter = info.filter;
+    if (image.get_format() == vk::Format::eR8G8B8A8Srgb &&
+        filter == MipFilter::Linear) {
+        filter = MipFilter::Srgb;
+    }
+
+    ComputePass compute_pass{ cmd };
+    compute_pass.set_material(material);
+    const auto dispatches = plan_dispatches(extent, level_count);
+    for (size_t i = 0; i < dispatches.size(); i++) {
+        const auto &dispatch = dispatches[i];
+        if (i > 0) {
+            // The source level was the last one written by the previous
+            // dispatch
+            const auto barrier =
+              vk::ImageMemoryBarrier2{}
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead)
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setSubresourceRange(vk::ImageSubresourceRange{}
+                                       .setAspectMask(image.get_aspect())
+                                       .setBaseMipLevel(dispatch.src_level)
+                                       .setLevelCount(1)
+                                       .setBaseArrayLayer(0)
+                                       .setLayerCount(layer_count))
+                .setImage(image.get());
+            cmd.pipelineBarrier2(
+              vk::DependencyInfo{}.setImageMemoryBarriers(barrier)
+            );
+        }
+
+        const auto desc_set = desc_alloc.allocate(*desc_set_layout, device);
+        DescriptorWriter writer;
+        writer.write_image(
+          0,
+          get_level_view(dispatch.src_level),
+          VK_NULL_HANDLE,
+          vk::ImageLayout::eGeneral,
+          vk::DescriptorType::eStorageImage
+        );
+        const uint32_t last_level = dispatch.src_level + dispatch.level_count;
+        for (uint32_t j = 0; j < LEVELS_PER_DISPATCH; j++) {
+            writer.write_image(
+              1,
+              get_level_view(std::min(dispatch.src_level + 1 + j, last_level)),
+              VK_NULL_HANDLE,
+              vk::ImageLayout::eGeneral,
+              vk::DescriptorType::eStorageImage,
+              j
+            );
+        }
+        writer.update_set(device, desc_set);
+        compute_pass.set_desc_sets(0, { desc_set }, {});
+
+        const auto src_extent = get_level_extent(extent, dispatch.src_level);
+        const auto push_constants = PushConstants{
+            .src_extent = { src_extent.width, src_extent.height },
+            .src_level_index = dispatch.src_level,
+            .level_count = dispatch.level_count,
+            .filter = filter,
+            .alpha_cutoff = info.alpha_cutoff,
+        };
+        compute_pass.set_push_constants(
+          std::as_bytes(std::span{ &push_constants, 1 })
+        );
+        const auto first_extent =
+          get_level_extent(extent, dispatch.src_level + 1);
+        compute_pass.dispatch_workgroups(
+          (first_extent.width + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE,
+          (first_extent.height + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE,
+          layer_count
+        );
+    }
+
+    spdlog::debug(
+      "Generated {} mip levels of a {}x{} image in {} dispatches",
+      level_count - 1,
+      extent.width,
+      extent.height,
+      dispatches.size()
+    );
+}
+} // namespace kovra
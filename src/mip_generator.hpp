@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class DescriptorAllocator;
+class GpuImage;
+class Material;
+class PipelineBuildQueue;
+class ShaderModuleCache;
+
+// How the texels of a mip level are averaged into the next one
+// Must match the FILTER_* defines in shaders/mip-downsample.comp
+enum class MipFilter : uint32_t
+{
+    // Data such as roughness or occlusion, averaged as it is
+    Linear = 0,
+    // sRGB-encoded color, averaged in linear space
+    Srgb = 1,
+    // Tangent-space normals, averaged as vectors and renormalized
+    Normal = 2,
+};
+
+struct MipGenerationInfo
+{
+    MipFilter filter = MipFilter::Linear;
+    // Alpha test threshold of the material, zero if it isn't alpha-tested
+    // Keeps the fraction of texels that pass the test the same at every
+    // level, so cutouts like foliage don't fade away in the distance
+    float alpha_cutoff = 0.0f;
+};
+
+// Generates the mip chain of an image from its first level with a compute
+// shader, on any queue that supports compute
+// Up to LEVELS_PER_DISPATCH levels are written per dispatch from shared
+// memory, so a 4096x4096 image takes two. Any size is filtered exactly,
+// levels after an odd size just start a new dispatch.
+class MipGenerator
+{
+  public:
+    // Must match LEVELS_PER_DISPATCH in shaders/mip-downsample.comp
+    constexpr static uint32_t LEVELS_PER_DISPATCH = 6;
+
+    MipGenerator(
+      const vk::Device &device,
+      ShaderModuleCache &shader_modules,
+      PipelineBuildQueue &build_queue
+    );
+    ~MipGenerator();
+    MipGenerator() = delete;
+    MipGenerator(const MipGenerator &) = delete;
+    MipGenerator &operator=(const MipGenerator &) = delete;
+
+    // Images of other formats fall back to blits
+    [[nodiscard]] static bool supports(vk::Format format) noexcept;
+    // Flags images that are mipmapped with compute must be created with
+    [[nodiscard]] static vk::ImageCreateFlags get_image_flags(
+      vk::Format format
+    ) noexcept;
+    // Number of descriptor sets record needs for the image
+    [[nodiscard]] static uint32_t get_dispatch_count(const GpuImage &image
+    ) noexcept;
+
+    // Expects every level of the image in eGeneral and leaves them there
+    // The descriptor sets come from desc_alloc and the views are appended to
+    // views, both must outlive the command buffer
+    void record(
+      vk::CommandBuffer cmd,
+      const GpuImage &image,
+      const MipGenerationInfo &info,
+      DescriptorAllocator &desc_alloc,
+      std::vector<vk::UniqueImageView> &views
+    ) const;
+
+  private:
+    struct PushConstants
+    {
+        uint32_t src_extent[2];
+        uint32_t src_level_index;
+        uint32_t level_count;
+        MipFilter filter;
+        float alpha_cutoff;
+    };
+
+    const vk::Device &device;
+    vk::UniqueDescriptorSetLayout desc_set_layout;
+    std::shared_ptr<Material> material;
+};
+} // namespace kovra
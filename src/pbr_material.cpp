@@ -1,28 +1,68 @@
 #include "pbr_material.hpp"
+#include "bindless.hpp"
 #include "descriptor.hpp"
+#include "gbuffer.hpp"
 #include "image.hpp"
 #include "material.hpp"
 #include "render_resources.hpp"
 #include "renderer.hpp"
+#include "taa.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
 
 namespace kovra {
+namespace {
+// Must match the specialization constants in shaders/pbr_material.glsl
+struct PbrSpecializationData
+{
+    vk::Bool32 has_metal_rough_texture;
+    vk::Bool32 has_ambient_occlusion_texture;
+    vk::Bool32 has_emissive_texture;
+    vk::Bool32 alpha_mask;
+};
+constexpr auto PBR_SPECIALIZATION_MAP_ENTRIES = std::array{
+    vk::SpecializationMapEntry{
+      0,
+      offsetof(PbrSpecializationData, has_metal_rough_texture),
+      sizeof(vk::Bool32) },
+    vk::SpecializationMapEntry{
+      1,
+      offsetof(PbrSpecializationData, has_ambient_occlusion_texture),
+      sizeof(vk::Bool32) },
+    vk::SpecializationMapEntry{
+      2,
+      offsetof(PbrSpecializationData, has_emissive_texture),
+      sizeof(vk::Bool32) },
+    vk::SpecializationMapEntry{ 3,
+                                offsetof(PbrSpecializationData, alpha_mask),
+                                sizeof(vk::Bool32) },
+};
+// Sits above the bits of PbrFeatures::get_mask
+constexpr uint32_t TRANSPARENT_VARIANT_BIT = 1u << 31;
+}
+
 PbrMaterial::PbrMaterial(
   const vk::Device &device,
+  ShaderModuleCache &shader_modules,
+  PipelineBuildQueue &build_queue,
   const vk::DescriptorSetLayout &scene_desc_layout,
   const vk::Format &color_attachment_format,
   const vk::Format &depth_attachment_format,
-  const vk::SampleCountFlagBits &sample_count
+  const vk::SampleCountFlagBits &sample_count,
+  const vk::Format &gbuffer_depth_format
 )
-  : desc_writer{ std::make_unique<DescriptorWriter>() }
+  : device{ device }
+  , shader_modules{ shader_modules }
+  , build_queue{ build_queue }
+  , scene_desc_layout{ scene_desc_layout }
+  , color_attachment_format{ color_attachment_format }
+  , depth_attachment_format{ depth_attachment_format }
+  , sample_count{ sample_count }
+  , gbuffer_depth_format{ gbuffer_depth_format }
+  , desc_writer{ std::make_unique<DescriptorWriter>() }
 {
-    auto push_constant_range =
-      vk::PushConstantRange{}
-        .setStageFlags(
-          vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
-        )
-        .setOffset(0)
-        .setSize(sizeof(GpuPushConstants));
-
     // Create/get descriptor set layouts
     const auto vert_frag_stages =
       vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
@@ -42,49 +82,126 @@ PbrMaterial::PbrMaterial(
           4, vk::DescriptorType::eCombinedImageSampler, vert_frag_stages
         )
         .build_unique(device);
+}
 
-    const auto layouts = std::array{ scene_desc_layout, material_layout.get() };
+PbrMaterial::~PbrMaterial()
+{
+    desc_writer.reset();
+    variants.clear();
+    material_layout.reset();
+}
 
-    opaque_material = std::make_shared<Material>(
-      GraphicsMaterialBuilder{}
-        .set_pipeline_layout(device.createPipelineLayoutUnique(
+const PbrMaterial::Variant &
+PbrMaterial::get_variant(const PbrFeatures &features, MaterialPass pass) const
+{
+    // Every pass but the opaque one blends like the transparent pass
+    const bool transparent = pass != MaterialPass::Opaque;
+    const uint32_t key =
+      features.get_mask() | (transparent ? TRANSPARENT_VARIANT_BIT : 0);
+
+    std::lock_guard lock{ variants_mutex };
+    if (const auto it = variants.find(key); it != variants.end()) {
+        return it->second;
+    }
+
+    const auto specialization_data = PbrSpecializationData{
+        .has_metal_rough_texture = features.metal_rough_texture,
+        .has_ambient_occlusion_texture = features.ambient_occlusion_texture,
+        .has_emissive_texture = features.emissive_texture,
+        .alpha_mask = features.alpha_mask,
+    };
+    const auto specialization_bytes = std::as_bytes(
+      std::span{ &specialization_data, 1 }
+    );
+
+    const auto push_constant_range =
+      vk::PushConstantRange{}
+        .setStageFlags(
+          vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
+        )
+        .setOffset(0)
+        .setSize(sizeof(GpuPushConstants));
+    const auto layouts = std::array{ scene_desc_layout, material_layout.get() };
+    const auto create_pipeline_layout = [&] {
+        return device.createPipelineLayoutUnique(
           vk::PipelineLayoutCreateInfo{}
             .setSetLayouts(layouts)
             .setPushConstantRanges(push_constant_range)
+        );
+    };
+
+    Variant variant{};
+    if (transparent) {
+        variant.material = std::make_shared<Material>(
+          GraphicsMaterialBuilder{}
+            .set_pipeline_layout(create_pipeline_layout())
+            .set_shader(std::make_unique<GraphicsShader>(
+              GraphicsShader{ "pbr", shader_modules }
+            ))
+            .set_specialization_constants(
+              PBR_SPECIALIZATION_MAP_ENTRIES, specialization_bytes
+            )
+            .set_color_attachment_format(color_attachment_format)
+            .set_depth_attachment_format(depth_attachment_format)
+            .enable_additive_blending()
+            .set_depth_test(true, vk::CompareOp::eLess)
+            .set_multisampling(sample_count)
+            .build(build_queue)
+        );
+        return variants.emplace(key, std::move(variant)).first->second;
+    }
+
+    variant.material = std::make_shared<Material>(
+      GraphicsMaterialBuilder{}
+        .set_pipeline_layout(create_pipeline_layout())
+        .set_shader(std::make_unique<GraphicsShader>(
+          GraphicsShader{ "pbr", shader_modules }
         ))
-        .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{ "pbr",
-                                                                     device }))
+        .set_specialization_constants(
+          PBR_SPECIALIZATION_MAP_ENTRIES, specialization_bytes
+        )
         .set_color_attachment_format(color_attachment_format)
         .set_depth_attachment_format(depth_attachment_format)
         .set_multisampling(sample_count)
         .disable_blending()
-        .build(device)
+        .build(build_queue)
     );
 
-    transparent_material = std::make_shared<Material>(
+    // The G-buffer is never multisampled (MSAA falls back to forward)
+    variant.gbuffer_material = std::make_shared<Material>(
       GraphicsMaterialBuilder{}
-        .set_pipeline_layout(device.createPipelineLayoutUnique(
-          vk::PipelineLayoutCreateInfo{}
-            .setSetLayouts(layouts)
-            .setPushConstantRanges(push_constant_range)
-        ))
-        .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{ "pbr",
-                                                                     device }))
-        .set_color_attachment_format(color_attachment_format)
+        .set_pipeline_layout(create_pipeline_layout())
+        .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+          "pbr", "pbr-gbuffer", shader_modules }))
+        .set_specialization_constants(
+          PBR_SPECIALIZATION_MAP_ENTRIES, specialization_bytes
+        )
+        .set_color_attachment_formats(GBuffer::FORMATS)
+        .set_depth_attachment_format(gbuffer_depth_format)
+        .set_multisampling(vk::SampleCountFlagBits::e1)
+        .disable_blending()
+        .build(build_queue)
+    );
+
+    // Temporal anti-aliasing is never combined with MSAA
+    const auto motion_formats =
+      std::array{ color_attachment_format, MOTION_VECTOR_FORMAT };
+    variant.motion_material = std::make_shared<Material>(
+      GraphicsMaterialBuilder{}
+        .set_pipeline_layout(create_pipeline_layout())
+        .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+          "pbr", "pbr-motion", shader_modules }))
+        .set_specialization_constants(
+          PBR_SPECIALIZATION_MAP_ENTRIES, specialization_bytes
+        )
+        .set_color_attachment_formats(motion_formats)
         .set_depth_attachment_format(depth_attachment_format)
-        .enable_additive_blending()
-        .set_depth_test(true, vk::CompareOp::eLess)
-        .set_multisampling(sample_count)
-        .build(device)
+        .set_multisampling(vk::SampleCountFlagBits::e1)
+        .disable_blending()
+        .build(build_queue)
     );
-}
 
-PbrMaterial::~PbrMaterial()
-{
-    desc_writer.reset();
-    material_layout.reset();
-    transparent_material.reset();
-    opaque_material.reset();
+    return variants.emplace(key, std::move(variant)).first->second;
 }
 
 MaterialInstance
@@ -96,48 +213,100 @@ PbrMaterial::create_material_instance(
 {
     auto desc_set =
       desc_allocator.allocate(material_layout.get(), device.get());
-    desc_writer->clear();
-    desc_writer->write_buffer(
-      0,
-      info.material_buffer,
-      sizeof(GpuPbrMaterialData),
-      info.material_buffer_offset,
-      vk::DescriptorType::eUniformBuffer
-    );
-    desc_writer->write_image(
-      1,
-      info.albedo_texture.get_view(),
-      info.albedo_sampler,
-      vk::ImageLayout::eShaderReadOnlyOptimal,
-      vk::DescriptorType::eCombinedImageSampler
-    );
-    desc_writer->write_image(
-      2,
-      info.metal_rough_texture.get_view(),
-      info.metal_rough_sampler,
-      vk::ImageLayout::eShaderReadOnlyOptimal,
-      vk::DescriptorType::eCombinedImageSampler
-    );
-    desc_writer->write_image(
-      3,
-      info.ambient_occlusion_texture.get_view(),
-      info.ambient_occlusion_sampler,
-      vk::ImageLayout::eShaderReadOnlyOptimal,
-      vk::DescriptorType::eCombinedImageSampler
-    );
-    desc_writer->write_image(
-      4,
-      info.emissive_texture.get_view(),
-      info.emissive_sampler,
-      vk::ImageLayout::eShaderReadOnlyOptimal,
-      vk::DescriptorType::eCombinedImageSampler
-    );
-    desc_writer->update_set(device.get(), desc_set);
+    {
+        std::lock_guard lock{ desc_writer_mutex };
+        desc_writer->clear();
+        desc_writer->write_buffer(
+          0,
+          info.material_buffer,
+          sizeof(GpuPbrMaterialData),
+          info.material_buffer_offset,
+          vk::DescriptorType::eUniformBuffer
+        );
+        desc_writer->write_image(
+          1,
+          info.albedo_texture.get_view(),
+          info.albedo_sampler,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+        desc_writer->write_image(
+          2,
+          info.metal_rough_texture.get_view(),
+          info.metal_rough_sampler,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+        desc_writer->write_image(
+          3,
+          info.ambient_occlusion_texture.get_view(),
+          info.ambient_occlusion_sampler,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+        desc_writer->write_image(
+          4,
+          info.emissive_texture.get_view(),
+          info.emissive_sampler,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          vk::DescriptorType::eCombinedImageSampler
+        );
+        desc_writer->update_set(device.get(), desc_set);
+    }
 
+    const Variant &variant = get_variant(info.features, info.pass);
     if (info.pass == MaterialPass::Opaque) {
-        return MaterialInstance{ opaque_material, desc_set, info.pass };
+        uint32_t bindless_material_index = 0;
+        if (info.bindless_registry && info.material_data) {
+            auto &registry = *info.bindless_registry;
+            // Textures of features that are off are left out, like the
+            // forward and deferred variants skip sampling them
+            const auto register_texture = [&](bool enabled,
+                                              const GpuImage &texture,
+                                              vk::Sampler sampler) {
+                return enabled ? registry.register_texture(texture, sampler)
+                               : BINDLESS_TEXTURE_NONE;
+            };
+            const auto &features = info.features;
+            const auto texture_indices = glm::uvec4{
+                registry.register_texture(
+                  info.albedo_texture, info.albedo_sampler
+                ),
+                register_texture(
+                  features.metal_rough_texture,
+                  info.metal_rough_texture,
+                  info.metal_rough_sampler
+                ),
+                register_texture(
+                  features.ambient_occlusion_texture,
+                  info.ambient_occlusion_texture,
+                  info.ambient_occlusion_sampler
+                ),
+                register_texture(
+                  features.emissive_texture,
+                  info.emissive_texture,
+                  info.emissive_sampler
+                ),
+            };
+            auto metal_rough_factors = info.material_data->metal_rough_factors;
+            if (!features.alpha_mask) {
+                metal_rough_factors.z = 0.0f;
+            }
+            bindless_material_index = registry.register_material(
+              { .color_factors = info.material_data->color_factors,
+                .metal_rough_factors = metal_rough_factors,
+                .texture_indices = texture_indices }
+            );
+        }
+        return MaterialInstance{ variant.material,
+                                 desc_set,
+                                 info.pass,
+                                 variant.gbuffer_material,
+                                 bindless_material_index,
+                                 variant.motion_material,
+                                 info.features.alpha_mask };
     } else {
-        return MaterialInstance{ transparent_material, desc_set, info.pass };
+        return MaterialInstance{ variant.material, desc_set, info.pass };
     }
 }
 }
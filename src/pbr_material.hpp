@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
@@ -8,11 +10,35 @@ namespace kovra {
 class Renderer;
 class GpuImage;
 class Material;
+class PipelineBuildQueue;
 class MaterialInstance;
+class ShaderModuleCache;
 enum class MaterialPass : uint8_t;
 class DescriptorWriter;
 class DescriptorAllocator;
 class Device;
+class BindlessRegistry;
+struct GpuPbrMaterialData;
+
+// Features a material uses, each picks a pipeline variant with specialization
+// constants (see shaders/pbr_material.glsl)
+// Textures of features that are off are never sampled.
+struct PbrFeatures
+{
+    bool metal_rough_texture = false;
+    bool ambient_occlusion_texture = false;
+    bool emissive_texture = false;
+    // Discard fragments whose alpha is below the cutoff
+    bool alpha_mask = false;
+
+    [[nodiscard]] uint32_t get_mask() const noexcept
+    {
+        return static_cast<uint32_t>(metal_rough_texture) |
+               static_cast<uint32_t>(ambient_occlusion_texture) << 1 |
+               static_cast<uint32_t>(emissive_texture) << 2 |
+               static_cast<uint32_t>(alpha_mask) << 3;
+    }
+};
 
 struct PbrMaterialInstanceCreateInfo
 {
@@ -28,6 +54,11 @@ struct PbrMaterialInstanceCreateInfo
     const vk::Buffer &material_buffer; // Buffer containing GpuPbrMaterialData
     const uint32_t material_buffer_offset;
     const MaterialPass pass;
+    const PbrFeatures features = {};
+
+    // Registers opaque materials for visibility buffer shading (optional)
+    BindlessRegistry *bindless_registry = nullptr;
+    const GpuPbrMaterialData *material_data = nullptr;
 };
 
 class PbrMaterial
@@ -35,10 +66,13 @@ class PbrMaterial
   public:
     explicit PbrMaterial(
       const vk::Device &device,
+      ShaderModuleCache &shader_modules,
+      PipelineBuildQueue &build_queue,
       const vk::DescriptorSetLayout &scene_desc_layout,
       const vk::Format &color_attachment_format,
       const vk::Format &depth_attachment_format,
-      const vk::SampleCountFlagBits &sample_count
+      const vk::SampleCountFlagBits &sample_count,
+      const vk::Format &gbuffer_depth_format
     );
     ~PbrMaterial();
 
@@ -55,9 +89,39 @@ class PbrMaterial
     ) const;
 
   private:
-    std::shared_ptr<Material> opaque_material;
-    std::shared_ptr<Material> transparent_material;
+    // Pipelines of one combination of features and pass
+    struct Variant
+    {
+        std::shared_ptr<Material> material;
+        // Writes surface attributes to the G-buffer instead of shading (opaque
+        // only)
+        std::shared_ptr<Material> gbuffer_material;
+        // Also writes motion vectors, only used without multisampling (opaque
+        // only)
+        std::shared_ptr<Material> motion_material;
+    };
+
+    const vk::Device device;
+    ShaderModuleCache &shader_modules;
+    PipelineBuildQueue &build_queue;
+    const vk::DescriptorSetLayout scene_desc_layout;
+    const vk::Format color_attachment_format;
+    const vk::Format depth_attachment_format;
+    const vk::SampleCountFlagBits sample_count;
+    const vk::Format gbuffer_depth_format;
+
+    // Built the first time a material instance needs them, keyed by the
+    // feature mask and whether the pass is transparent
+    mutable std::unordered_map<uint32_t, Variant> variants;
+    mutable std::mutex variants_mutex;
     vk::UniqueDescriptorSetLayout material_layout;
     std::unique_ptr<DescriptorWriter> desc_writer;
+    // Scenes loading on worker threads share the writer
+    mutable std::mutex desc_writer_mutex;
+
+    [[nodiscard]] const Variant &get_variant(
+      const PbrFeatures &features,
+      MaterialPass pass
+    ) const;
 };
 }
@@ -80,6 +80,14 @@ PhysicalDevice::get_transfer_queue_family() const
 [[nodiscard]] QueueFamily
 PhysicalDevice::get_compute_queue_family() const
 {
+    // Prefer a compute-only family so that compute work can run
+    // asynchronously next to the graphics queue
+    for (const auto &queue_family : queue_families) {
+        if (queue_family.has_compute_support() &&
+            !queue_family.has_graphics_support()) {
+            return queue_family;
+        }
+    }
     for (const auto &queue_family : queue_families) {
         if (queue_family.has_compute_support()) {
             return queue_family;
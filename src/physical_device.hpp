@@ -14,7 +14,13 @@ class DeviceFeatures
     bool dynamic_rendering;
     bool synchronization2;
     bool runtime_descriptor_array;
+    // Non-uniform, partially bound, update-after-bind sampled image arrays
+    bool descriptor_indexing;
     bool buffer_device_address;
+    // Required for frame pacing
+    bool timeline_semaphore;
+    // KTX2 textures with BCn payloads
+    bool texture_compression_bc;
     bool ray_tracing_pipeline;
     bool acceleration_structure;
 };
@@ -48,6 +54,11 @@ class PhysicalDevice
     {
         return limits.minStorageBufferOffsetAlignment;
     }
+    // Number of nanoseconds it takes for a timestamp query to increment by 1
+    [[nodiscard]] float get_timestamp_period() const noexcept
+    {
+        return limits.timestampPeriod;
+    }
     [[nodiscard]] vk::SampleCountFlags get_sample_counts() const noexcept
     {
         return limits.framebufferColorSampleCounts &
@@ -0,0 +1,91 @@
+#include "pipeline_build_queue.hpp"
+#include "pipeline_cache.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+namespace kovra {
+PipelineBuildQueue::PipelineBuildQueue(PipelineCache &pipeline_cache)
+  : pipeline_cache{ pipeline_cache }
+  // Leave a core to the thread that enqueues the pipelines
+  , worker_count{ std::max(2u, std::thread::hardware_concurrency()) - 1 }
+{
+    workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        workers.emplace_back(&PipelineBuildQueue::work, this);
+    }
+    spdlog::debug("Pipeline build queue using {} threads", worker_count);
+}
+
+PipelineBuildQueue::~PipelineBuildQueue()
+{
+    {
+        std::lock_guard lock{ mutex };
+        stopping = true;
+        // Nobody is going to bind them anymore
+        tasks.clear();
+    }
+    task_available.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+PipelineFuture
+PipelineBuildQueue::enqueue(PipelineBuildTask &&task)
+{
+    auto future = task.get_future().share();
+    {
+        std::lock_guard lock{ mutex };
+        if (busy_count == 0) {
+            burst_start = std::chrono::steady_clock::now();
+            burst_size = 0;
+        }
+        busy_count++;
+        burst_size++;
+        tasks.emplace_back(std::move(task));
+    }
+    task_available.notify_one();
+    return future;
+}
+
+void
+PipelineBuildQueue::work()
+{
+    while (true) {
+        PipelineBuildTask task;
+        {
+            std::unique_lock lock{ mutex };
+            task_available.wait(lock, [this] {
+                return stopping || !tasks.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        // Failures are stored in the future and rethrown where the pipeline
+        // is first needed
+        task(pipeline_cache);
+
+        std::lock_guard lock{ mutex };
+        busy_count--;
+        if (busy_count == 0) {
+            const auto end = std::chrono::steady_clock::now();
+            spdlog::debug(
+              "Built {} pipelines on {} threads in {:.2f} ms",
+              burst_size,
+              worker_count,
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                end - burst_start
+              )
+                  .count() /
+                1000.0f
+            );
+        }
+    }
+}
+} // namespace kovra
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class PipelineCache;
+
+// Pipeline that may still be compiling, get() blocks until it is done and
+// rethrows if it failed
+using PipelineFuture = std::shared_future<vk::UniquePipeline>;
+using PipelineBuildTask =
+  std::packaged_task<vk::UniquePipeline(PipelineCache &)>;
+
+// Compiles pipelines on worker threads, so the renderer can queue every
+// pipeline it knows about at startup and only waits for one the first time it
+// binds it (see Material::bind_pipeline)
+// Tasks must own everything their create info points to.
+// Pipelines may be enqueued from any thread. Tasks that haven't started when
+// the queue is destroyed are dropped.
+class PipelineBuildQueue
+{
+  public:
+    explicit PipelineBuildQueue(PipelineCache &pipeline_cache);
+    ~PipelineBuildQueue();
+    PipelineBuildQueue() = delete;
+    PipelineBuildQueue(const PipelineBuildQueue &) = delete;
+    PipelineBuildQueue &operator=(const PipelineBuildQueue &) = delete;
+
+    [[nodiscard]] PipelineFuture enqueue(PipelineBuildTask &&task);
+
+  private:
+    PipelineCache &pipeline_cache;
+    const uint32_t worker_count;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::deque<PipelineBuildTask> tasks;
+    bool stopping = false;
+    // Tasks that are queued or building, and when the queue last went from
+    // idle to busy, to log how long each burst of builds took
+    uint32_t busy_count = 0;
+    uint32_t burst_size = 0;
+    std::chrono::steady_clock::time_point burst_start;
+
+    void work();
+};
+} // namespace kovra
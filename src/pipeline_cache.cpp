@@ -0,0 +1,200 @@
+#include "pipeline_cache.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <cstring>
+#include <format>
+
+namespace kovra {
+PipelineCache::PipelineCache(
+  const vk::Device &device,
+  const vk::PhysicalDeviceProperties &properties,
+  std::filesystem::path directory
+)
+  : device{ device }
+{
+    std::string uuid;
+    for (const auto byte : properties.pipelineCacheUUID) {
+        uuid += std::format("{:02x}", byte);
+    }
+    path = directory / std::format(
+                         "{:04x}-{:04x}-{:08x}-{}.bin",
+                         properties.vendorID,
+                         properties.deviceID,
+                         properties.driverVersion,
+                         uuid
+                       );
+
+    const auto data = load(properties);
+    loaded_bytes = data.size();
+    cache = device.createPipelineCacheUnique(
+      vk::PipelineCacheCreateInfo{}
+        .setInitialDataSize(data.size())
+        .setPInitialData(data.data())
+    );
+    spdlog::debug(
+      "Pipeline cache seeded with {} bytes from {}",
+      loaded_bytes,
+      path.string()
+    );
+}
+
+PipelineCache::~PipelineCache()
+{
+    save();
+    const auto stats = get_stats();
+    spdlog::debug(
+      "Created {} pipelines in {:.2f} ms, {} from the pipeline cache",
+      stats.pipeline_count,
+      stats.creation_time,
+      stats.cache_hit_count
+    );
+}
+
+std::vector<std::byte>
+PipelineCache::load(const vk::PhysicalDeviceProperties &properties) const
+{
+    const auto file = utils::read_file(path);
+    if (!file.has_value()) {
+        return {};
+    }
+
+    FileHeader header;
+    if (file->size() < sizeof(header)) {
+        spdlog::warn("Ignoring truncated pipeline cache: {}", path.string());
+        return {};
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    const auto data =
+      std::span{ *file }.subspan(sizeof(header), file->size() - sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION ||
+        header.data_size != data.size() ||
+        header.data_hash != utils::hash_bytes(data)) {
+        spdlog::warn("Ignoring corrupt pipeline cache: {}", path.string());
+        return {};
+    }
+
+    // The driver checks its own header too, but not every driver checks it
+    // thoroughly
+    vk::PipelineCacheHeaderVersionOne driver_header;
+    if (data.size() < sizeof(driver_header)) {
+        return {};
+    }
+    std::memcpy(&driver_header, data.data(), sizeof(driver_header));
+    if (driver_header.headerVersion != vk::PipelineCacheHeaderVersion::eOne ||
+        driver_header.vendorID != properties.vendorID ||
+        driver_header.deviceID != properties.deviceID ||
+        driver_header.pipelineCacheUUID != properties.pipelineCacheUUID) {
+        spdlog::warn(
+          "Ignoring pipeline cache of another driver: {}", path.string()
+        );
+        return {};
+    }
+
+    return { data.begin(), data.end() };
+}
+
+void
+PipelineCache::save() const
+{
+    const auto data = device.getPipelineCacheData(cache.get());
+    const auto bytes = std::as_bytes(std::span{ data });
+    const FileHeader header{
+        .magic = FILE_MAGIC,
+        .version = FILE_VERSION,
+        .data_size = bytes.size(),
+        .data_hash = utils::hash_bytes(bytes),
+    };
+
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        spdlog::warn(
+          "Failed to save pipeline cache, failed to create {}: {}",
+          path.parent_path().string(),
+          error.message()
+        );
+        return;
+    }
+    std::vector<std::byte> file;
+    file.reserve(sizeof(header) + bytes.size());
+    const auto header_bytes = utils::cast_to_bytes(header);
+    file.insert(file.end(), header_bytes.begin(), header_bytes.end());
+    file.insert(file.end(), bytes.begin(), bytes.end());
+    if (!utils::write_file_atomically(path, file)) {
+        spdlog::warn("Failed to save pipeline cache: {}", path.string());
+        return;
+    }
+    spdlog::debug(
+      "Saved pipeline cache ({} bytes) to {}", bytes.size(), path.string()
+    );
+}
+
+PipelineCacheStats
+PipelineCache::get_stats() const noexcept
+{
+    return PipelineCacheStats{
+        .pipeline_count = pipeline_count.load(),
+        .creation_time = static_cast<float>(creation_time.load()) / 1000.0f,
+        .cache_hit_count = cache_hit_count.load(),
+        .loaded_bytes = loaded_bytes,
+    };
+}
+
+template<typename CreateInfo, typename Create>
+vk::UniquePipeline
+PipelineCache::create_pipeline(const CreateInfo &info, Create &&create)
+{
+    // Chain the feedback in front of whatever the caller chained
+    vk::PipelineCreationFeedback feedback;
+    auto feedback_info =
+      vk::PipelineCreationFeedbackCreateInfo{}
+        .setPPipelineCreationFeedback(&feedback)
+        .setPNext(info.pNext);
+    auto info_with_feedback = info;
+    info_with_feedback.setPNext(&feedback_info);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    auto result = create(info_with_feedback);
+    const auto end = std::chrono::high_resolution_clock::now();
+    if (result.result != vk::Result::eSuccess) {
+        spdlog::error(
+          "Failed to create pipeline: {}", vk::to_string(result.result)
+        );
+        throw std::runtime_error("Failed to create pipeline");
+    }
+
+    pipeline_count++;
+    creation_time += static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+    );
+    const auto hit_flags =
+      vk::PipelineCreationFeedbackFlagBits::eValid |
+      vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit;
+    if ((feedback.flags & hit_flags) == hit_flags) {
+        cache_hit_count++;
+    }
+    return std::move(result.value);
+}
+
+vk::UniquePipeline
+PipelineCache::create_graphics_pipeline(
+  const vk::GraphicsPipelineCreateInfo &info
+)
+{
+    return create_pipeline(info, [this](const auto &pipeline_ci) {
+        return device.createGraphicsPipelineUnique(cache.get(), pipeline_ci);
+    });
+}
+
+vk::UniquePipeline
+PipelineCache::create_compute_pipeline(const vk::ComputePipelineCreateInfo &info
+)
+{
+    return create_pipeline(info, [this](const auto &pipeline_ci) {
+        return device.createComputePipelineUnique(cache.get(), pipeline_ci);
+    });
+}
+} // namespace kovra
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+static constexpr const char *PIPELINE_CACHE_DIR = "./cache/pipelines";
+
+struct PipelineCacheStats
+{
+    // Pipelines created since startup and the time it took (in ms)
+    uint32_t pipeline_count;
+    float creation_time;
+    // Pipelines the driver found in the cache instead of compiling them
+    uint32_t cache_hit_count;
+    // Size of the cache data the device was seeded with, zero if there was no
+    // usable file
+    uint64_t loaded_bytes;
+};
+
+// Pipeline cache shared by every pipeline of the device
+// It is seeded from a file written by an earlier run with the same driver,
+// and written back when it is destroyed, so later runs only compile the
+// pipelines that changed. Files are keyed by the pipeline cache UUID, vendor,
+// device and driver version, so updating the driver starts from an empty
+// cache instead of handing it data it can't use.
+// Pipelines may be created from several threads.
+class PipelineCache
+{
+  public:
+    PipelineCache(
+      const vk::Device &device,
+      const vk::PhysicalDeviceProperties &properties,
+      std::filesystem::path directory
+    );
+    ~PipelineCache();
+    PipelineCache() = delete;
+    PipelineCache(const PipelineCache &) = delete;
+    PipelineCache &operator=(const PipelineCache &) = delete;
+
+    [[nodiscard]] vk::UniquePipeline create_graphics_pipeline(
+      const vk::GraphicsPipelineCreateInfo &info
+    );
+    [[nodiscard]] vk::UniquePipeline create_compute_pipeline(
+      const vk::ComputePipelineCreateInfo &info
+    );
+    // Write the cache to its file
+    void save() const;
+
+    [[nodiscard]] vk::PipelineCache get() const noexcept
+    {
+        return cache.get();
+    }
+    [[nodiscard]] PipelineCacheStats get_stats() const noexcept;
+
+  private:
+    // Prepended to the data of the driver, which is only handed back to it if
+    // the header matches
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t data_size;
+        uint64_t data_hash;
+    };
+    static constexpr uint32_t FILE_MAGIC = 0x4b505043; // "KPPC"
+    // Bump when the file layout changes
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    const vk::Device &device;
+    std::filesystem::path path;
+    vk::UniquePipelineCache cache;
+
+    std::atomic<uint32_t> pipeline_count = 0;
+    std::atomic<uint32_t> cache_hit_count = 0;
+    // In microseconds
+    std::atomic<uint64_t> creation_time = 0;
+    uint64_t loaded_bytes = 0;
+
+    // Driver data of the cache file, empty if it is missing, corrupt or was
+    // written by another driver
+    [[nodiscard]] std::vector<std::byte> load(
+      const vk::PhysicalDeviceProperties &properties
+    ) const;
+    // Create a pipeline with creation feedback and record it in the stats
+    template<typename CreateInfo, typename Create>
+    [[nodiscard]] vk::UniquePipeline create_pipeline(
+      const CreateInfo &info,
+      Create &&create
+    );
+};
+} // namespace kovra
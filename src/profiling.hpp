@@ -4,9 +4,58 @@ namespace kovra {
 struct RendererStats
 {
     float frame_time;
+    // Time the CPU blocked waiting for the GPU to finish an earlier frame
+    float frame_wait_time;
+    int frames_in_flight;
     int triangle_count;
     int draw_call_count;
     float scene_update_time;
     float render_objects_draw_time;
+    int light_count;
+    // Cascades re-rendered this frame (the rest were cached)
+    int shadow_cascades_rendered;
+    int shadow_draw_call_count;
+    // Cluster light assignment ran on a dedicated compute queue
+    bool async_compute;
+    // Barriers of the graphics command buffer and the pipelineBarrier2 calls
+    // they were batched into
+    int barrier_count;
+    int barrier_batch_count;
+    // Passes of the frame graph and how many of them were culled
+    int render_pass_count;
+    int culled_pass_count;
+    // Memory of the transient images of the frame graph, with and without
+    // aliasing
+    float transient_megabytes;
+    float transient_unaliased_megabytes;
+    // Totals since startup
+    int upload_submit_count;
+    int upload_copy_count;
+    // Uploads that waited for staging memory to be given back
+    int upload_stall_count;
+    float uploaded_megabytes;
+    // Scenes that are parsing or uploading in the background
+    int loading_scene_count;
+    // Geometry of the last scene that finished loading, written straight to
+    // staging memory and copied to intermediate memory first
+    float last_load_staged_megabytes;
+    float last_load_copied_megabytes;
+    // Lookups of processed assets in the derived data cache since startup
+    float derived_data_hit_rate;
+    float derived_data_saved_megabytes;
+    // Pipelines created since startup, the time (in ms) it took and how many
+    // of them were found in the pipeline cache
+    int pipeline_count;
+    float pipeline_creation_time;
+    int pipeline_cache_hit_count;
+
+    // GPU times (in ms) measured with timestamp queries
+    float gpu_frame_time;
+    // Sun shadow cascades
+    float gpu_shadow_time;
+    // Forward: opaque geometry and shading, Deferred: G-buffer geometry pass
+    float gpu_opaque_time;
+    // Deferred lighting pass (zero for the forward path)
+    float gpu_lighting_time;
 };
 }
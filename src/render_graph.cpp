@@ -0,0 +1,762 @@
+#include "render_graph.hpp"
+#include "buffer.hpp"
+#include "command.hpp"
+#include "device.hpp"
+#include "image.hpp"
+
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <numeric>
+
+namespace kovra {
+// Whether a use of a resource depends on what was in it before
+static bool
+reads_contents(ResourceUsage usage, bool write) noexcept
+{
+    if (!write) {
+        return true;
+    }
+    constexpr vk::AccessFlags2 READ_ACCESS =
+      vk::AccessFlagBits2::eShaderStorageRead |
+      vk::AccessFlagBits2::eColorAttachmentRead |
+      vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+      vk::AccessFlagBits2::eTransferRead;
+    return static_cast<bool>(get_usage_info(usage).access & READ_ACCESS);
+}
+
+static bool
+lifetimes_overlap(
+  const TransientImageRequest &a,
+  const TransientImageRequest &b
+) noexcept
+{
+    return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+}
+
+TransientImagePool::Allocation::~Allocation()
+{
+    images.clear();
+    for (auto &block : blocks) {
+        vmaFreeMemory(*allocator, block);
+    }
+    blocks.clear();
+}
+
+TransientImagePool::TransientImagePool(const Device &device)
+  : device{ device }
+{
+    spdlog::debug("TransientImagePool::TransientImagePool()");
+}
+
+TransientImagePool::~TransientImagePool()
+{
+    spdlog::debug("TransientImagePool::~TransientImagePool()");
+    allocation.reset();
+}
+
+const std::vector<std::unique_ptr<GpuImage>> &
+TransientImagePool::acquire(const std::vector<TransientImageRequest> &requests)
+{
+    if (!can_reuse(requests)) {
+        allocate(requests);
+    }
+    this->requests = requests;
+    return allocation->images;
+}
+
+bool
+TransientImagePool::can_reuse(
+  const std::vector<TransientImageRequest> &new_requests
+) const noexcept
+{
+    if (!allocation || new_requests.size() != requests.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < new_requests.size(); i++) {
+        if (new_requests[i].desc != requests[i].desc ||
+            new_requests[i].usage != requests[i].usage) {
+            return false;
+        }
+    }
+    // Passes may have been added or culled since, but images that share a
+    // block must still never be used by the same passes
+    for (size_t i = 0; i < new_requests.size(); i++) {
+        for (size_t j = i + 1; j < new_requests.size(); j++) {
+            if (allocation->image_blocks[i] == allocation->image_blocks[j] &&
+                lifetimes_overlap(new_requests[i], new_requests[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+TransientImagePool::allocate(
+  const std::vector<TransientImageRequest> &new_requests
+)
+{
+    // The previous images may still be used by frames in flight
+    if (allocation) {
+        device.get_frame_timeline().defer_destroy(
+          [old = std::move(allocation)]() mutable { old.reset(); }
+        );
+    }
+    allocation = std::make_shared<Allocation>();
+    allocation->allocator = device.get_allocator_owned();
+
+    std::vector<GpuImageCreateInfo> image_infos;
+    std::vector<vk::MemoryRequirements> image_requirements;
+    for (const auto &request : new_requests) {
+        const auto &image_info = image_infos.emplace_back(GpuImageCreateInfo{
+          .format = request.desc.format,
+          .extent = vk::Extent3D{ request.desc.extent.width,
+                                  request.desc.extent.height,
+                                  1 },
+          .usage = request.usage,
+          .aspect = request.desc.aspect,
+          .mipmapped = false,
+          .samples = request.desc.samples });
+        image_requirements.emplace_back(
+          GpuImage::get_memory_requirements(image_info, device.get())
+        );
+    }
+
+    // Largest images first, each into the first block of a compatible memory
+    // type whose images are never used by the same passes
+    std::vector<size_t> order(new_requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return image_requirements[a].size > image_requirements[b].size;
+    });
+    struct Block
+    {
+        vk::MemoryRequirements requirements;
+        std::vector<size_t> images;
+    };
+    std::vector<Block> blocks;
+    allocation->image_blocks.resize(new_requests.size());
+    for (const size_t i : order) {
+        const auto &requirements = image_requirements[i];
+        auto block = std::find_if(
+          blocks.begin(),
+          blocks.end(),
+          [&](const Block &block) {
+              return (block.requirements.memoryTypeBits &
+                      requirements.memoryTypeBits) != 0 &&
+                     std::none_of(
+                       block.images.begin(),
+                       block.images.end(),
+                       [&](size_t j) {
+                           return lifetimes_overlap(
+                             new_requests[i], new_requests[j]
+                           );
+                       }
+                     );
+          }
+        );
+        if (block == blocks.end()) {
+            blocks.emplace_back(Block{ .requirements = requirements });
+            block = std::prev(blocks.end());
+        }
+        block->requirements.size =
+          std::max(block->requirements.size, requirements.size);
+        block->requirements.alignment =
+          std::max(block->requirements.alignment, requirements.alignment);
+        block->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+        block->images.push_back(i);
+        allocation->image_blocks[i] =
+          static_cast<size_t>(std::distance(blocks.begin(), block));
+    }
+
+    stats = TransientImageStats{
+        .image_count = static_cast<uint32_t>(new_requests.size()),
+        .block_count = static_cast<uint32_t>(blocks.size()),
+        .allocated_bytes = 0,
+        .requested_bytes = 0,
+    };
+    for (const auto &requirements : image_requirements) {
+        stats.requested_bytes += requirements.size;
+    }
+
+    VmaAllocationCreateInfo alloc_ci{};
+    alloc_ci.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_ci.requiredFlags =
+      VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    for (const auto &block : blocks) {
+        const VkMemoryRequirements requirements = block.requirements;
+        VmaAllocation memory;
+        if (VkResult result = vmaAllocateMemory(
+              *allocation->allocator, &requirements, &alloc_ci, &memory, nullptr
+            );
+            result != VK_SUCCESS) {
+            spdlog::error(
+              "Failed to allocate {} bytes of transient image memory: {}",
+              requirements.size,
+              vk::to_string(static_cast<vk::Result>(result))
+            );
+            throw std::runtime_error("Failed to allocate transient images");
+        }
+        allocation->blocks.push_back(memory);
+        stats.allocated_bytes += requirements.size;
+    }
+
+    for (size_t i = 0; i < new_requests.size(); i++) {
+        allocation->images.emplace_back(std::make_unique<GpuImage>(
+          image_infos[i],
+          device.get(),
+          allocation->allocator,
+          allocation->blocks[allocation->image_blocks[i]]
+        ));
+    }
+
+    spdlog::debug(
+      "Allocated {} transient images in {} blocks ({:.2f} MB, {:.2f} MB "
+      "without aliasing)",
+      stats.image_count,
+      stats.block_count,
+      static_cast<double>(stats.allocated_bytes) / (1024.0 * 1024.0),
+      static_cast<double>(stats.requested_bytes) / (1024.0 * 1024.0)
+    );
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::write_color(
+  RenderGraphImage image,
+  std::optional<vk::ClearColorValue> clear
+)
+{
+    (void)graph.get_image_resource(image);
+    auto attachment = RenderGraph::Attachment{ .image = image.index };
+    if (clear.has_value()) {
+        attachment.clear = vk::ClearValue{}.setColor(clear.value());
+    }
+    graph.passes.at(pass).color_attachments.emplace_back(attachment);
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::resolve_color(RenderGraphImage image)
+{
+    (void)graph.get_image_resource(image);
+    auto &color_attachments = graph.passes.at(pass).color_attachments;
+    if (color_attachments.empty()) {
+        spdlog::error(
+          "Pass {} resolves to {} without a color attachment",
+          graph.passes.at(pass).name,
+          graph.get_image_resource(image).name
+        );
+        throw std::runtime_error("Resolve without a color attachment");
+    }
+    color_attachments.back().resolve_image = image.index;
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::write_depth(
+  RenderGraphImage image,
+  std::optional<float> clear
+)
+{
+    (void)graph.get_image_resource(image);
+    auto attachment = RenderGraph::Attachment{ .image = image.index };
+    if (clear.has_value()) {
+        attachment.clear =
+          vk::ClearValue{}.setDepthStencil({ clear.value(), 0 });
+    }
+    graph.passes.at(pass).depth_attachment = attachment;
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::set_render_area(vk::Extent2D extent)
+{
+    graph.passes.at(pass).render_area = extent;
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::read(RenderGraphImage image, ResourceUsage usage)
+{
+    (void)graph.get_image_resource(image);
+    graph.passes.at(pass).image_accesses.emplace_back(RenderGraph::ImageAccess{
+      .image = image.index, .usage = usage, .write = false });
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::write(RenderGraphImage image, ResourceUsage usage)
+{
+    (void)graph.get_image_resource(image);
+    graph.passes.at(pass).image_accesses.emplace_back(RenderGraph::ImageAccess{
+      .image = image.index, .usage = usage, .write = true });
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::read(RenderGraphBuffer buffer, ResourceUsage usage)
+{
+    (void)graph.get_buffer(buffer);
+    graph.passes.at(pass).buffer_accesses.emplace_back(
+      RenderGraph::BufferAccess{
+        .buffer = buffer.index, .usage = usage, .write = false }
+    );
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::write(RenderGraphBuffer buffer, ResourceUsage usage)
+{
+    (void)graph.get_buffer(buffer);
+    graph.passes.at(pass).buffer_accesses.emplace_back(
+      RenderGraph::BufferAccess{
+        .buffer = buffer.index, .usage = usage, .write = true }
+    );
+    return *this;
+}
+
+RenderGraphPassBuilder &
+RenderGraphPassBuilder::set_side_effects()
+{
+    graph.passes.at(pass).side_effects = true;
+    return *this;
+}
+
+RenderGraph::RenderGraph(TransientImagePool &transient_images)
+  : transient_images{ transient_images }
+{
+}
+
+RenderGraphImage
+RenderGraph::create_image(std::string name, const TransientImageDesc &desc)
+{
+    if (desc.extent.width == 0 || desc.extent.height == 0) {
+        spdlog::error(
+          "Transient image {} has an invalid size: {}x{}",
+          name,
+          desc.extent.width,
+          desc.extent.height
+        );
+        throw std::runtime_error("Invalid transient image size");
+    }
+    images.emplace_back(ImageResource{ .name = std::move(name),
+                                       .desc = desc,
+                                       .imported = false,
+                                       .import_info = {},
+                                       .gpu_image = nullptr,
+                                       .image = nullptr,
+                                       .view = nullptr,
+                                       .layer_count = 1,
+                                       .level_count = 1,
+                                       .usage = {},
+                                       .first_pass = std::nullopt,
+                                       .last_pass = 0 });
+    return RenderGraphImage{ static_cast<uint32_t>(images.size() - 1) };
+}
+
+RenderGraphImage
+RenderGraph::import_image(
+  std::string name,
+  const GpuImage &image,
+  const ImportedImageInfo &info
+)
+{
+    images.emplace_back(ImageResource{
+      .name = std::move(name),
+      .desc = TransientImageDesc{ .format = image.get_format(),
+                                  .extent = image.get_extent2d(),
+                                  .aspect = image.get_aspect(),
+                                  .samples = image.get_sample_count() },
+      .imported = true,
+      .import_info = info,
+      .gpu_image = &image,
+      .image = image.get(),
+      .view = image.get_view(),
+      .layer_count = static_cast<uint32_t>(image.get_layer_count()),
+      .level_count = static_cast<uint32_t>(image.get_level_count()),
+      .usage = image.get_usage(),
+      .first_pass = std::nullopt,
+      .last_pass = 0 });
+    return RenderGraphImage{ static_cast<uint32_t>(images.size() - 1) };
+}
+
+RenderGraphImage
+RenderGraph::import_image(
+  std::string name,
+  vk::Image image,
+  vk::ImageView view,
+  vk::Format format,
+  vk::Extent2D extent,
+  const ImportedImageInfo &info
+)
+{
+    images.emplace_back(ImageResource{
+      .name = std::move(name),
+      .desc = TransientImageDesc{ .format = format, .extent = extent },
+      .imported = true,
+      .import_info = info,
+      .gpu_image = nullptr,
+      .image = image,
+      .view = view,
+      .layer_count = 1,
+      .level_count = 1,
+      .usage = {},
+      .first_pass = std::nullopt,
+      .last_pass = 0 });
+    return RenderGraphImage{ static_cast<uint32_t>(images.size() - 1) };
+}
+
+RenderGraphBuffer
+RenderGraph::import_buffer(std::string name, const GpuBuffer &buffer)
+{
+    buffers.emplace_back(
+      BufferResource{ .name = std::move(name), .buffer = &buffer }
+    );
+    return RenderGraphBuffer{ static_cast<uint32_t>(buffers.size() - 1) };
+}
+
+RenderGraphPassBuilder
+RenderGraph::add_pass(std::string name, RenderGraphExecute &&execute)
+{
+    passes.emplace_back(
+      Pass{ .name = std::move(name), .execute = std::move(execute) }
+    );
+    return RenderGraphPassBuilder{ *this,
+                                   static_cast<uint32_t>(passes.size() - 1) };
+}
+
+void
+RenderGraph::execute(CommandEncoder &encoder)
+{
+    cull_passes();
+    compute_lifetimes();
+    allocate_transient_images();
+    choose_attachment_ops();
+
+    for (const auto &image : images) {
+        if (image.imported && image.import_info.initial_usage.has_value()) {
+            encoder.set_image_usage(
+              image.image, image.import_info.initial_usage.value()
+            );
+        }
+    }
+    for (auto &pass : passes) {
+        if (!pass.culled) {
+            execute_pass(encoder, pass);
+        }
+    }
+    // Leave imported images ready for whatever uses them next
+    for (uint32_t i = 0; i < images.size(); i++) {
+        const auto &final_usage = images[i].import_info.final_usage;
+        if (images[i].imported && final_usage.has_value()) {
+            require(encoder, i, final_usage.value());
+        }
+    }
+    encoder.flush_barriers();
+}
+
+vk::Image
+RenderGraph::get_image(RenderGraphImage image) const
+{
+    const auto &resource = get_image_resource(image);
+    if (!resource.image) {
+        spdlog::error("Image {} is not used by any pass", resource.name);
+        throw std::runtime_error("Render graph image is not allocated");
+    }
+    return resource.image;
+}
+
+vk::ImageView
+RenderGraph::get_view(RenderGraphImage image) const
+{
+    const auto &resource = get_image_resource(image);
+    if (!resource.view) {
+        spdlog::error("Image {} is not used by any pass", resource.name);
+        throw std::runtime_error("Render graph image is not allocated");
+    }
+    return resource.view;
+}
+
+vk::Extent2D
+RenderGraph::get_extent(RenderGraphImage image) const
+{
+    return get_image_resource(image).desc.extent;
+}
+
+const GpuBuffer &
+RenderGraph::get_buffer(RenderGraphBuffer buffer) const
+{
+    if (buffer.index >= buffers.size()) {
+        spdlog::error("Invalid render graph buffer: {}", buffer.index);
+        throw std::runtime_error("Invalid render graph buffer");
+    }
+    return *buffers[buffer.index].buffer;
+}
+
+const RenderGraph::ImageResource &
+RenderGraph::get_image_resource(RenderGraphImage image) const
+{
+    if (image.index >= images.size()) {
+        spdlog::error("Invalid render graph image: {}", image.index);
+        throw std::runtime_error("Invalid render graph image");
+    }
+    return images[image.index];
+}
+
+std::vector<RenderGraph::ImageAccess>
+RenderGraph::get_image_accesses(const Pass &pass) const
+{
+    auto accesses = pass.image_accesses;
+    for (const auto &attachment : pass.color_attachments) {
+        accesses.emplace_back(ImageAccess{ .image = attachment.image,
+                                           .usage =
+                                             ResourceUsage::ColorAttachment,
+                                           .write = true });
+        if (attachment.resolve_image.has_value()) {
+            accesses.emplace_back(
+              ImageAccess{ .image = attachment.resolve_image.value(),
+                           .usage = ResourceUsage::ColorAttachment,
+                           .write = true }
+            );
+        }
+    }
+    if (pass.depth_attachment.has_value()) {
+        accesses.emplace_back(
+          ImageAccess{ .image = pass.depth_attachment->image,
+                       .usage = ResourceUsage::DepthAttachment,
+                       .write = true }
+        );
+    }
+    return accesses;
+}
+
+void
+RenderGraph::cull_passes()
+{
+    // Walk back from the images that outlive the graph, keeping the passes
+    // that write anything a kept pass reads
+    std::vector<bool> image_needed(images.size(), false);
+    std::vector<bool> buffer_needed(buffers.size(), false);
+    for (size_t i = 0; i < images.size(); i++) {
+        image_needed[i] =
+          images[i].imported && images[i].import_info.final_usage.has_value();
+    }
+
+    stats = RenderGraphStats{
+        .pass_count = static_cast<uint32_t>(passes.size()),
+        .culled_pass_count = 0,
+    };
+    for (auto pass = passes.rbegin(); pass != passes.rend(); pass++) {
+        bool needed = pass->side_effects;
+        for (const auto &access : get_image_accesses(*pass)) {
+            needed = needed || (access.write && image_needed[access.image]);
+        }
+        for (const auto &access : pass->buffer_accesses) {
+            needed = needed || (access.write && buffer_needed[access.buffer]);
+        }
+        pass->culled = !needed;
+        if (pass->culled) {
+            spdlog::debug("Culled render graph pass {}", pass->name);
+            stats.culled_pass_count++;
+            continue;
+        }
+
+        for (const auto &access : pass->image_accesses) {
+            if (reads_contents(access.usage, access.write)) {
+                image_needed[access.image] = true;
+            }
+        }
+        // Attachments that aren't cleared keep what earlier passes wrote
+        for (const auto &attachment : pass->color_attachments) {
+            if (!attachment.clear.has_value()) {
+                image_needed[attachment.image] = true;
+            }
+        }
+        if (pass->depth_attachment.has_value() &&
+            !pass->depth_attachment->clear.has_value()) {
+            image_needed[pass->depth_attachment->image] = true;
+        }
+        for (const auto &access : pass->buffer_accesses) {
+            if (reads_contents(access.usage, access.write)) {
+                buffer_needed[access.buffer] = true;
+            }
+        }
+    }
+}
+
+void
+RenderGraph::compute_lifetimes()
+{
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (const auto &access : get_image_accesses(passes[i])) {
+            auto &image = images[access.image];
+            image.first_pass = image.first_pass.value_or(i);
+            image.last_pass = i;
+            if (!image.imported) {
+                image.usage |=
+                  get_required_image_usage(access.usage).value_or(
+                    vk::ImageUsageFlags{}
+                  );
+            }
+        }
+    }
+}
+
+void
+RenderGraph::allocate_transient_images()
+{
+    std::vector<TransientImageRequest> requests;
+    std::vector<uint32_t> request_images;
+    for (uint32_t i = 0; i < images.size(); i++) {
+        const auto &image = images[i];
+        if (image.imported || !image.first_pass.has_value()) {
+            continue;
+        }
+        requests.emplace_back(
+          TransientImageRequest{ .desc = image.desc,
+                                 .usage = image.usage,
+                                 .first_pass = image.first_pass.value(),
+                                 .last_pass = image.last_pass }
+        );
+        request_images.push_back(i);
+    }
+
+    const auto &allocated = transient_images.acquire(requests);
+    for (size_t i = 0; i < request_images.size(); i++) {
+        auto &image = images[request_images[i]];
+        image.gpu_image = allocated[i].get();
+        image.image = allocated[i]->get();
+        image.view = allocated[i]->get_view();
+    }
+}
+
+void
+RenderGraph::choose_attachment_ops()
+{
+    // Whether the image holds anything a later pass may want
+    std::vector<bool> has_contents(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        has_contents[i] =
+          images[i].imported && images[i].import_info.initial_usage.has_value();
+    }
+
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        auto &pass = passes[i];
+        if (pass.culled) {
+            continue;
+        }
+        const auto choose_ops = [&](Attachment &attachment) {
+            const auto &image = images[attachment.image];
+            if (attachment.clear.has_value()) {
+                attachment.load_op = vk::AttachmentLoadOp::eClear;
+            } else if (has_contents[attachment.image]) {
+                attachment.load_op = vk::AttachmentLoadOp::eLoad;
+            } else {
+                attachment.load_op = vk::AttachmentLoadOp::eDontCare;
+            }
+            // Multisampled attachments that are only resolved never have to
+            // be written back
+            attachment.store_op = image.imported || image.last_pass > i
+                                    ? vk::AttachmentStoreOp::eStore
+                                    : vk::AttachmentStoreOp::eDontCare;
+        };
+        for (auto &attachment : pass.color_attachments) {
+            choose_ops(attachment);
+        }
+        if (pass.depth_attachment.has_value()) {
+            choose_ops(pass.depth_attachment.value());
+        }
+
+        for (const auto &access : get_image_accesses(pass)) {
+            if (access.write) {
+                has_contents[access.image] = true;
+            }
+        }
+    }
+}
+
+void
+RenderGraph::require(
+  CommandEncoder &encoder,
+  uint32_t image,
+  ResourceUsage usage
+) const
+{
+    const auto &resource = images[image];
+    if (resource.gpu_image != nullptr) {
+        encoder.require(*resource.gpu_image, usage);
+    } else {
+        encoder.require(
+          resource.image,
+          resource.desc.aspect,
+          usage,
+          resource.layer_count,
+          resource.level_count
+        );
+    }
+}
+
+void
+RenderGraph::execute_pass(CommandEncoder &encoder, Pass &pass) const
+{
+    for (const auto &access : get_image_accesses(pass)) {
+        require(encoder, access.image, access.usage);
+    }
+    for (const auto &access : pass.buffer_accesses) {
+        encoder.require(*buffers[access.buffer].buffer, access.usage);
+    }
+
+    auto pass_ctx = RenderGraphPassContext{ .graph = *this,
+                                            .encoder = encoder,
+                                            .render_pass = nullptr };
+    if (pass.color_attachments.empty() && !pass.depth_attachment.has_value()) {
+        pass.execute(pass_ctx);
+        return;
+    }
+
+    const auto get_attachment_info = [&](const Attachment &attachment,
+                                         vk::ImageLayout layout) {
+        auto info = vk::RenderingAttachmentInfo{}
+                      .setImageView(images[attachment.image].view)
+                      .setImageLayout(layout)
+                      .setLoadOp(attachment.load_op)
+                      .setStoreOp(attachment.store_op);
+        if (attachment.clear.has_value()) {
+            info.setClearValue(attachment.clear.value());
+        }
+        if (attachment.resolve_image.has_value()) {
+            const auto resolve_image = attachment.resolve_image.value();
+            info.setResolveMode(vk::ResolveModeFlagBits::eAverage)
+              .setResolveImageView(images[resolve_image].view)
+              .setResolveImageLayout(layout);
+        }
+        return info;
+    };
+    auto render_pass_info = RenderPassCreateInfo{};
+    for (const auto &attachment : pass.color_attachments) {
+        render_pass_info.color_attachments.emplace_back(get_attachment_info(
+          attachment, vk::ImageLayout::eColorAttachmentOptimal
+        ));
+    }
+    if (pass.depth_attachment.has_value()) {
+        render_pass_info.depth_attachment = get_attachment_info(
+          pass.depth_attachment.value(),
+          vk::ImageLayout::eDepthStencilAttachmentOptimal
+        );
+    }
+    const auto &first_attachment = !pass.color_attachments.empty()
+                                     ? pass.color_attachments.front()
+                                     : pass.depth_attachment.value();
+    render_pass_info.render_area =
+      vk::Rect2D{}.setOffset({ 0, 0 }).setExtent(pass.render_area.value_or(
+        images[first_attachment.image].desc.extent
+      ));
+
+    RenderPass render_pass = encoder.begin_render_pass(render_pass_info);
+    pass_ctx.render_pass = &render_pass;
+    pass.execute(pass_ctx);
+}
+} // namespace kovra
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "resource_state.hpp"
+#include "vk_mem_alloc.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class CommandEncoder;
+class Device;
+class GpuBuffer;
+class GpuImage;
+class RenderGraph;
+class RenderPass;
+
+// Handles to the resources of a render graph
+struct RenderGraphImage
+{
+    uint32_t index = UINT32_MAX;
+
+    [[nodiscard]] bool is_valid() const noexcept { return index != UINT32_MAX; }
+};
+struct RenderGraphBuffer
+{
+    uint32_t index = UINT32_MAX;
+
+    [[nodiscard]] bool is_valid() const noexcept { return index != UINT32_MAX; }
+};
+
+// Image that only lives while the graph executes
+// Its usage flags are inferred from the passes that use it
+struct TransientImageDesc
+{
+    vk::Format format;
+    vk::Extent2D extent;
+    vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+    bool operator==(const TransientImageDesc &) const = default;
+};
+
+// Image that outlives the graph, such as the swapchain image
+struct ImportedImageInfo
+{
+    // Usage the image was left in by earlier submissions, its contents are
+    // discarded if there is none
+    std::optional<ResourceUsage> initial_usage = std::nullopt;
+    // Usage the image is left in for later submissions
+    // Passes that write images with a final usage are never culled
+    std::optional<ResourceUsage> final_usage = std::nullopt;
+};
+
+// Transient image and the passes that use it, in execution order
+struct TransientImageRequest
+{
+    TransientImageDesc desc;
+    vk::ImageUsageFlags usage;
+    uint32_t first_pass;
+    uint32_t last_pass;
+};
+
+struct TransientImageStats
+{
+    uint32_t image_count;
+    // Memory blocks the images are aliased into
+    uint32_t block_count;
+    vk::DeviceSize allocated_bytes;
+    // What the images would take without aliasing
+    vk::DeviceSize requested_bytes;
+};
+
+// Allocates the transient images of render graphs, and keeps them from one
+// graph to the next as long as the requests don't change
+// Images that are never used by the same passes share memory.
+class TransientImagePool
+{
+  public:
+    explicit TransientImagePool(const Device &device);
+    ~TransientImagePool();
+    TransientImagePool() = delete;
+    TransientImagePool(const TransientImagePool &) = delete;
+    TransientImagePool &operator=(const TransientImagePool &) = delete;
+
+    // Images for the requests, in the same order
+    // If any desc or usage changed, e.g. on resize, the previous images are
+    // destroyed once the GPU is done with them and new ones are allocated
+    [[nodiscard]] const std::vector<std::unique_ptr<GpuImage>> &acquire(
+      const std::vector<TransientImageRequest> &requests
+    );
+    [[nodiscard]] TransientImageStats get_stats() const noexcept
+    {
+        return stats;
+    }
+
+  private:
+    // Images and the memory they alias, destroyed together
+    struct Allocation
+    {
+        std::shared_ptr<VmaAllocator> allocator;
+        std::vector<std::unique_ptr<GpuImage>> images;
+        std::vector<VmaAllocation> blocks;
+        // Block each image is bound to
+        std::vector<size_t> image_blocks;
+
+        ~Allocation();
+    };
+
+    const Device &device;
+    std::vector<TransientImageRequest> requests;
+    std::shared_ptr<Allocation> allocation;
+    TransientImageStats stats{};
+
+    // Whether the images can be used for the requests as they are
+    [[nodiscard]] bool can_reuse(
+      const std::vector<TransientImageRequest> &new_requests
+    ) const noexcept;
+    void allocate(const std::vector<TransientImageRequest> &new_requests);
+};
+
+// What a pass records its commands with
+struct RenderGraphPassContext
+{
+    const RenderGraph &graph;
+    CommandEncoder &encoder;
+    // Render pass over the attachments of the pass, null if it has none
+    RenderPass *render_pass;
+};
+using RenderGraphExecute = std::function<void(RenderGraphPassContext &)>;
+
+// Declares the resources a pass uses, returned by RenderGraph::add_pass
+class RenderGraphPassBuilder
+{
+  public:
+    RenderGraphPassBuilder(RenderGraph &graph, uint32_t pass)
+      : graph{ graph }
+      , pass{ pass }
+    {
+    }
+
+    // Attachments of a render pass the graph begins before the pass executes
+    // Without a clear value they keep what earlier passes wrote to them
+    RenderGraphPassBuilder &write_color(
+      RenderGraphImage image,
+      std::optional<vk::ClearColorValue> clear = std::nullopt
+    );
+    // The multisampled color attachment written before is resolved to image
+    RenderGraphPassBuilder &resolve_color(RenderGraphImage image);
+    RenderGraphPassBuilder &write_depth(
+      RenderGraphImage image,
+      std::optional<float> clear = std::nullopt
+    );
+    // Defaults to the extent of the first attachment
+    RenderGraphPassBuilder &set_render_area(vk::Extent2D extent);
+
+    // Any other use, including render passes the pass begins itself
+    RenderGraphPassBuilder &read(RenderGraphImage image, ResourceUsage usage);
+    RenderGraphPassBuilder &write(RenderGraphImage image, ResourceUsage usage);
+    RenderGraphPassBuilder &read(RenderGraphBuffer buffer, ResourceUsage usage);
+    RenderGraphPassBuilder &write(
+      RenderGraphBuffer buffer,
+      ResourceUsage usage
+    );
+    // Never cull the pass, for work nothing in the graph reads, like
+    // timestamps
+    RenderGraphPassBuilder &set_side_effects();
+
+  private:
+    RenderGraph &graph;
+    const uint32_t pass;
+};
+
+struct RenderGraphStats
+{
+    uint32_t pass_count;
+    uint32_t culled_pass_count;
+};
+
+// Passes declare the resources they read and write, and the graph works out
+// the rest when it executes them in the order they were added:
+// - passes whose results are never used are culled
+// - barriers and layout transitions are inserted with the resource state
+//   tracker of the encoder
+// - attachments are only loaded and stored when their contents are needed
+// - transient images come from a TransientImagePool, aliased in memory with
+//   images whose passes don't overlap
+// Dependencies are tracked per resource, not per write, so a pass is kept if
+// any later pass reads the resource it writes.
+// Built anew every frame, handles and the callbacks of its passes only need
+// to stay valid until execute() returns.
+class RenderGraph
+{
+  public:
+    explicit RenderGraph(TransientImagePool &transient_images);
+    RenderGraph() = delete;
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    [[nodiscard]] RenderGraphImage create_image(
+      std::string name,
+      const TransientImageDesc &desc
+    );
+    [[nodiscard]] RenderGraphImage import_image(
+      std::string name,
+      const GpuImage &image,
+      const ImportedImageInfo &info = {}
+    );
+    // For images that aren't GpuImages, such as swapchain images
+    [[nodiscard]] RenderGraphImage import_image(
+      std::string name,
+      vk::Image image,
+      vk::ImageView view,
+      vk::Format format,
+      vk::Extent2D extent,
+      const ImportedImageInfo &info = {}
+    );
+    [[nodiscard]] RenderGraphBuffer import_buffer(
+      std::string name,
+      const GpuBuffer &buffer
+    );
+
+    // Passes execute in the order they are added
+    [[nodiscard]] RenderGraphPassBuilder add_pass(
+      std::string name,
+      RenderGraphExecute &&execute
+    );
+
+    // Cull the passes, allocate the transient images and record every pass
+    void execute(CommandEncoder &encoder);
+
+    // Only valid while the graph executes, for the images a pass declared
+    [[nodiscard]] vk::Image get_image(RenderGraphImage image) const;
+    [[nodiscard]] vk::ImageView get_view(RenderGraphImage image) const;
+    [[nodiscard]] vk::Extent2D get_extent(RenderGraphImage image) const;
+    [[nodiscard]] const GpuBuffer &get_buffer(RenderGraphBuffer buffer) const;
+
+    [[nodiscard]] RenderGraphStats get_stats() const noexcept
+    {
+        return stats;
+    }
+
+  private:
+    friend class RenderGraphPassBuilder;
+
+    struct ImageResource
+    {
+        std::string name;
+        TransientImageDesc desc;
+        bool imported;
+        ImportedImageInfo import_info;
+        // Set for GpuImages, including transient images once allocated
+        const GpuImage *gpu_image;
+        vk::Image image;
+        vk::ImageView view;
+        uint32_t layer_count;
+        uint32_t level_count;
+        // Inferred from the passes for transient images
+        vk::ImageUsageFlags usage;
+        // First and last pass that isn't culled and uses the image
+        std::optional<uint32_t> first_pass;
+        uint32_t last_pass;
+    };
+    struct BufferResource
+    {
+        std::string name;
+        const GpuBuffer *buffer;
+    };
+
+    struct Attachment
+    {
+        uint32_t image;
+        std::optional<vk::ClearValue> clear;
+        std::optional<uint32_t> resolve_image;
+        vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eDontCare;
+        vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eDontCare;
+    };
+    struct ImageAccess
+    {
+        uint32_t image;
+        ResourceUsage usage;
+        bool write;
+    };
+    struct BufferAccess
+    {
+        uint32_t buffer;
+        ResourceUsage usage;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        RenderGraphExecute execute;
+        std::vector<Attachment> color_attachments;
+        std::optional<Attachment> depth_attachment;
+        std::optional<vk::Extent2D> render_area;
+        std::vector<ImageAccess> image_accesses;
+        std::vector<BufferAccess> buffer_accesses;
+        bool side_effects = false;
+        bool culled = false;
+    };
+
+    TransientImagePool &transient_images;
+    std::vector<ImageResource> images;
+    std::vector<BufferResource> buffers;
+    std::vector<Pass> passes;
+    RenderGraphStats stats{};
+
+    [[nodiscard]] const ImageResource &get_image_resource(
+      RenderGraphImage image
+    ) const;
+    // Every image the pass uses and how, attachments included
+    [[nodiscard]] std::vector<ImageAccess> get_image_accesses(
+      const Pass &pass
+    ) const;
+
+    void cull_passes();
+    void compute_lifetimes();
+    void allocate_transient_images();
+    void choose_attachment_ops();
+    void require(CommandEncoder &encoder, uint32_t image, ResourceUsage usage)
+      const;
+    void execute_pass(CommandEncoder &encoder, Pass &pass) const;
+};
+} // namespace kovra
@@ -71,7 +71,9 @@ MeshNode::queue_draw(const glm::mat4 &root_transform, DrawContext &ctx) const
                         .bounds = surface.bounds,
                         .transform = node_transform,
                         .vertex_buffer_address =
-                          mesh_asset->mesh->get_vertex_buffer_address() };
+                          mesh_asset->mesh->get_vertex_buffer_address(),
+                        .index_buffer_address =
+                          mesh_asset->mesh->get_index_buffer_address() };
 
         if (surface.material_instance->pass == MaterialPass::Opaque) {
             ctx.opaque_objects.emplace_back(std::move(render_object));
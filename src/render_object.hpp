@@ -32,6 +32,7 @@ struct RenderObject
 
     const glm::mat4 transform;
     const vk::DeviceAddress vertex_buffer_address;
+    const vk::DeviceAddress index_buffer_address;
 
     [[nodiscard]] bool is_visible(const glm::mat4 &viewproj) const noexcept;
 };
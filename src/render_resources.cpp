@@ -1,6 +1,8 @@
 #include "render_resources.hpp"
 #include "asset_loader.hpp"
+#include "bindless.hpp"
 #include "buffer.hpp"
+#include "derived_data_cache.hpp"
 #include "descriptor.hpp"
 #include "device.hpp"
 #include "image.hpp"
@@ -10,6 +12,11 @@
 #include "render_object.hpp"
 
 namespace kovra {
+static const auto DEFAULT_MATERIAL_DATA =
+  GpuPbrMaterialData{ .color_factors = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+                      .metal_rough_factors = glm::vec4(1.0f, 0.5f, 0.0f, 0.0f),
+                      ._padding = {} };
+
 RenderResources::RenderResources(std::shared_ptr<Device> device)
   : device{ device }
   , material_buffer{ std::make_unique<GpuBuffer>(
@@ -19,13 +26,20 @@ RenderResources::RenderResources(std::shared_ptr<Device> device)
       VMA_MEMORY_USAGE_CPU_TO_GPU,
       VMA_ALLOCATION_CREATE_MAPPED_BIT
     ) }
+  , derived_data_cache{ std::make_unique<DerivedDataCache>(
+      DERIVED_DATA_CACHE_DIR,
+      DERIVED_DATA_CACHE_MAX_SIZE
+    ) }
 {
-    auto default_material_data =
-      GpuPbrMaterialData{ .color_factors = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
-                          .metal_rough_factors =
-                            glm::vec4(1.0f, 0.5f, 0.0f, 0.0f),
-                          ._padding = {} };
-    material_buffer->write(&default_material_data, sizeof(GpuPbrMaterialData));
+    material_buffer->write(
+      &DEFAULT_MATERIAL_DATA, sizeof(GpuPbrMaterialData)
+    );
+
+    if (device->supports_bindless()) {
+        bindless_registry = std::make_unique<BindlessRegistry>(*device);
+    } else {
+        spdlog::warn("Descriptor indexing not supported, bindless disabled");
+    }
 }
 RenderResources::~RenderResources()
 {
@@ -42,6 +56,7 @@ RenderResources::~RenderResources()
     samplers.clear();
 
     materials.clear();
+    bindless_registry.reset();
 }
 
 void
@@ -119,7 +134,9 @@ RenderResources::set_pbr_material(
           .emissive_sampler = get_sampler(vk::Filter::eLinear),
           .material_buffer = material_buffer->get(),
           .material_buffer_offset = 0,
-          .pass = MaterialPass::Opaque },
+          .pass = MaterialPass::Opaque,
+          .bindless_registry = bindless_registry.get(),
+          .material_data = &DEFAULT_MATERIAL_DATA },
         device,
         global_desc_allocator
       ));
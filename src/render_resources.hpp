@@ -17,6 +17,8 @@ class DescriptorAllocator;
 class GpuBuffer;
 class LoadedGltfScene;
 class IRenderable;
+class BindlessRegistry;
+class DerivedDataCache;
 
 class RenderResources
 {
@@ -66,10 +68,22 @@ class RenderResources
     [[nodiscard]] const PbrMaterial &get_pbr_material() const;
     [[nodiscard]] std::optional<std::reference_wrapper<const IRenderable>>
     get_renderable(const std::string &name) const noexcept;
+    // Null if the device doesn't support descriptor indexing
+    [[nodiscard]] BindlessRegistry *get_bindless_registry() const noexcept
+    {
+        return bindless_registry.get();
+    }
+    // Shared by every asset load, including the ones on worker threads
+    [[nodiscard]] DerivedDataCache &get_derived_data_cache() const noexcept
+    {
+        return *derived_data_cache;
+    }
 
   private:
     std::shared_ptr<Device> device;
     std::unique_ptr<GpuBuffer> material_buffer;
+    std::unique_ptr<BindlessRegistry> bindless_registry;
+    std::unique_ptr<DerivedDataCache> derived_data_cache;
 
     std::unordered_map<std::string, std::shared_ptr<Material>> materials;
     std::unordered_map<vk::Filter, vk::Sampler> samplers;
@@ -2,14 +2,20 @@
 #include "vk_mem_alloc.h"
 
 #include "asset_loader.hpp"
+#include "bindless.hpp"
 #include "cubemap.hpp"
+#include "derived_data_cache.hpp"
 #include "descriptor.hpp"
+#include "ibl.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
 #include "pbr_material.hpp"
 #include "render_object.hpp"
 #include "render_resources.hpp"
 #include "renderer.hpp"
+#include "shadow.hpp"
+#include "taa.hpp"
+#include "upload_queue.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
@@ -17,14 +23,20 @@
 
 #include "spdlog/spdlog.h"
 
+#include <algorithm>
+
 namespace kovra {
+// Drawn in place of scenes that are still loading
+static constexpr std::string_view PROXY_BOX_NAME = "proxy_box";
+
 void
 init_desc_set_layouts(const vk::Device &device, RenderResources &resources);
 void
 init_materials(
   const vk::Device &device,
+  ShaderModuleCache &shader_modules,
+  PipelineBuildQueue &build_queue,
   const Swapchain &swapchain,
-  const GpuImage &draw_image,
   RenderResources &resources,
   const vk::SampleCountFlagBits sample_count
 );
@@ -33,8 +45,43 @@ create_sampler(vk::Filter filter, const vk::Device &device);
 void
 init_default_textures(const Device &device, RenderResources &resources);
 
-Renderer::Renderer(SDL_Window *window, bool enable_multisampling)
-  : context{ std::make_unique<Context>(window, enable_multisampling) }
+// Highest sample count up to the requested one that the device supports
+static vk::SampleCountFlagBits
+pick_sample_count(const Device &device, vk::SampleCountFlagBits requested)
+{
+    constexpr auto sample_counts = std::array{
+        vk::SampleCountFlagBits::e8,
+        vk::SampleCountFlagBits::e4,
+        vk::SampleCountFlagBits::e2,
+        vk::SampleCountFlagBits::e1,
+    };
+    if (std::find(sample_counts.begin(), sample_counts.end(), requested) ==
+        sample_counts.end()) {
+        spdlog::error(
+          "Unsupported MSAA sample count: {}", vk::to_string(requested)
+        );
+        throw std::runtime_error("Unsupported MSAA sample count");
+    }
+    for (const auto count : sample_counts) {
+        if (count <= requested && device.supports_sample_count(count)) {
+            if (count != requested) {
+                spdlog::warn(
+                  "MSAA sample count {} is not supported, falling back to {}",
+                  vk::to_string(requested),
+                  vk::to_string(count)
+                );
+            }
+            return count;
+        }
+    }
+    return vk::SampleCountFlagBits::e1;
+}
+
+Renderer::Renderer(
+  SDL_Window *window,
+  vk::SampleCountFlagBits requested_sample_count
+)
+  : context{ std::make_unique<Context>(window) }
   , global_desc_allocator{ std::make_unique<DescriptorAllocator>(
       context->get_device().get(),
       100
@@ -43,16 +90,15 @@ Renderer::Renderer(SDL_Window *window, bool enable_multisampling)
   , render_resources{ std::make_shared<RenderResources>(
       context->get_device_owned()
     ) }
-  , enable_multisampling{ enable_multisampling }
+  , sample_count{ pick_sample_count(
+      context->get_device(),
+      requested_sample_count
+    ) }
 {
     spdlog::debug("Renderer::Renderer()");
 
     // Create frames
-    frames.reserve(FRAME_OVERLAP);
-    for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
-        frames.emplace_back(std::make_unique<Frame>(*context->get_device_owned()
-        ));
-    }
+    resize_frames();
 
     // Create descriptor set layouts
     init_desc_set_layouts(context->get_device().get(), *render_resources);
@@ -67,53 +113,36 @@ Renderer::Renderer(SDL_Window *window, bool enable_multisampling)
       create_sampler(vk::Filter::eLinear, context->get_device().get())
     );
 
-    // Create draw image
-    {
-        auto swapchain_extent = context->get_swapchain().get_extent();
-        draw_image = context->get_device().create_image(GpuImageCreateInfo{
-          .format = vk::Format::eR16G16B16A16Sfloat,
-          .extent =
-            vk::Extent3D{ swapchain_extent.width, swapchain_extent.height, 1 },
-          .usage = vk::ImageUsageFlagBits::eTransferSrc |
-                   vk::ImageUsageFlagBits::eTransferDst |
-                   vk::ImageUsageFlagBits::eColorAttachment,
-          .aspect = vk::ImageAspectFlagBits::eColor,
-          .mipmapped = false,
-          .sampler = render_resources->get_sampler(vk::Filter::eNearest),
-          .enable_multisampling = enable_multisampling });
-        if (enable_multisampling) {
-            draw_resolve_image =
-              context->get_device().create_image(GpuImageCreateInfo{
-                .format = vk::Format::eR16G16B16A16Sfloat,
-                .extent = vk::Extent3D{ swapchain_extent.width,
-                                        swapchain_extent.height,
-                                        1 },
-                .usage = vk::ImageUsageFlagBits::eTransferSrc |
-                         vk::ImageUsageFlagBits::eTransferDst |
-                         vk::ImageUsageFlagBits::eColorAttachment,
-                .aspect = vk::ImageAspectFlagBits::eColor,
-                .mipmapped = false,
-                .sampler = render_resources->get_sampler(vk::Filter::eNearest),
-                .enable_multisampling = false });
-        }
-    }
+    // Images that only live while a frame is drawn
+    transient_images =
+      std::make_unique<TransientImagePool>(context->get_device());
 
-    // Create depth image for the draw image
-    {
-        const vk::Extent2D extent = draw_image->get_extent2d();
-        draw_depth_image = context->get_device().create_depth_image(
-          extent.width, extent.height, std::nullopt, enable_multisampling
-        );
-    }
+    // Create cascaded shadow map for the sun
+    shadow_map = std::make_unique<ShadowMap>(context->get_device());
+
+    // History of temporal anti-aliasing, allocated with the first frame
+    taa = std::make_unique<TemporalAntiAliasing>(context->get_device());
 
     // Create materials
+    // Their pipelines compile on worker threads while the rest is set up, and
+    // each is only waited for the first time it is bound
     init_materials(
       context->get_device().get(),
+      context->get_device().get_shader_modules(),
+      context->get_device().get_pipeline_build_queue(),
       context->get_swapchain(),
-      *draw_image,
       *render_resources,
-      enable_multisampling ? vk::SampleCountFlagBits::e4
-                           : vk::SampleCountFlagBits::e1
+      sample_count
+    );
+    auto pbr_material = std::make_unique<PbrMaterial>(
+      context->get_device().get(),
+      context->get_device().get_shader_modules(),
+      context->get_device().get_pipeline_build_queue(),
+      render_resources->get_desc_set_layout("scene"),
+      DRAW_IMAGE_FORMAT,
+      DRAW_DEPTH_FORMAT,
+      sample_count,
+      DRAW_DEPTH_FORMAT
     );
 
     // Create textures
@@ -121,18 +150,26 @@ Renderer::Renderer(SDL_Window *window, bool enable_multisampling)
 
     // Create PBR material
     render_resources->set_pbr_material(
-      std::make_unique<PbrMaterial>(
-        context->get_device().get(),
-        render_resources->get_desc_set_layout("scene"),
-        draw_image->get_format(),
-        context->get_swapchain().get_depth_image().get_format(),
-        enable_multisampling ? vk::SampleCountFlagBits::e4
-                             : vk::SampleCountFlagBits::e1
-      ),
+      std::move(pbr_material),
       context->get_device(),
       *global_desc_allocator
     );
 
+    // Create proxy box
+    {
+        auto mesh = Mesh::new_cube(context->get_device());
+        const auto index_count = mesh->get_index_count();
+        render_resources->add_mesh_asset(MeshAsset{
+          .name = std::string{ PROXY_BOX_NAME },
+          .surfaces = { GeometrySurface{
+            .start_index = 0,
+            .count = index_count,
+            .bounds = { .origin = glm::vec3(0.0f),
+                        .sphere_radius = glm::length(glm::vec3(0.5f)),
+                        .extents = glm::vec3(0.5f) } } },
+          .mesh = std::move(mesh) });
+    }
+
     init_imgui(window);
 
     // Create skybox
@@ -164,23 +201,37 @@ Renderer::Renderer(SDL_Window *window, bool enable_multisampling)
           std::move(cubemap_ci), context->get_device()
         );
     }
+
+    // Derive image-based lighting from the skybox (cached on disk)
+    ibl = std::make_unique<ImageBasedLighting>(
+      *skybox, *render_resources, context->get_device()
+    );
+
+    synchronous_upload_token =
+      context->get_device().get_upload_queue().get_pending_token();
 }
 
 Renderer::~Renderer()
 {
     spdlog::debug("Renderer::~Renderer()");
-    // Wait until all frames have finished rendering
-    for (const auto &frame : frames) {
-        auto render_fence = frame->get_render_fence();
-        if (const auto result = context->get_device().get().waitForFences(
-              1, &render_fence, VK_TRUE, UINT64_MAX
-            );
-            result != vk::Result::eSuccess) {
-            spdlog::error(
-              "Failed to wait for render fence: {}", vk::to_string(result)
-            );
+    // Drop scenes that haven't started loading, let the one that is loading
+    // finish, flushing the uploads it might be waiting on, then wait for
+    // those uploads before dropping them
+    scene_loads.clear();
+    auto &upload_queue = context->get_device().get_upload_queue();
+    for (auto &pending : pending_scenes) {
+        while (pending.future.valid() &&
+               pending.future.wait_for(std::chrono::milliseconds(1)) !=
+                 std::future_status::ready) {
+            upload_queue.flush();
         }
     }
+    upload_queue.wait(upload_queue.flush());
+    pending_scenes.clear();
+
+    // Wait until all frames have finished rendering and destroy whatever was
+    // waiting for them
+    context->get_device().get_frame_timeline().flush();
 
     // Destroy ImGui
     ImGui_ImplVulkan_Shutdown();
@@ -188,10 +239,11 @@ Renderer::~Renderer()
       get_context().get_device().get(), imgui_pool, nullptr
     );
 
+    ibl.reset();
     skybox.reset();
-    draw_image.reset();
-    draw_depth_image.reset();
-    draw_resolve_image.reset();
+    taa.reset();
+    shadow_map.reset();
+    transient_images.reset();
     render_resources.reset();
 
     // Destroy frames
@@ -214,17 +266,108 @@ Renderer::update_scene(
     const auto start = std::chrono::system_clock::now();
 
     auto swapchain_image_extent = context->get_swapchain().get_extent();
-    GpuSceneData scene_data{
-        .viewproj = camera.get_viewproj_mat(
-          swapchain_image_extent.width, swapchain_image_extent.height
+
+    // Set draw extent (determines resolution to draw at)
+    // The draw images are as large as the swapchain, and render_scale never
+    // exceeds one
+    const auto draw_extent = vk::Extent2D{
+        std::max(
+          static_cast<uint32_t>(swapchain_image_extent.width * render_scale), 1u
         ),
+        std::max(
+          static_cast<uint32_t>(swapchain_image_extent.height * render_scale),
+          1u
+        ),
+    };
+
+    const auto light_count = static_cast<uint32_t>(
+      std::min(lights.size(), static_cast<size_t>(MAX_LIGHTS))
+    );
+    // With temporal anti-aliasing, every frame is drawn with a different
+    // sub-pixel jitter
+    const bool taa_active = is_taa_active();
+    auto jitter = glm::vec2(0.0f);
+    if (taa_active) {
+        taa->begin_frame(
+          swapchain_image_extent,
+          draw_extent,
+          frame_number,
+          camera.get_viewproj_mat(
+            swapchain_image_extent.width, swapchain_image_extent.height
+          )
+        );
+        jitter = taa->get_jitter();
+    }
+    const auto viewproj = camera.get_viewproj_mat(
+      swapchain_image_extent.width, swapchain_image_extent.height, jitter
+    );
+
+    // Anything that changes what gets drawn invalidates cached shadow cascades
+    if (shadows_enabled) {
+        size_t scene_hash = 0;
+        const auto hash_combine = [&scene_hash](size_t hash) {
+            scene_hash ^= hash + 0x9e3779b9 + (scene_hash << 6) +
+                          (scene_hash >> 2);
+        };
+        for (const auto &[name, transform] : objects_to_render) {
+            hash_combine(std::hash<std::string>{}(name));
+            // Scenes that finish loading change what gets drawn too
+            hash_combine(render_resources->get_renderable(name).has_value());
+            for (glm::length_t i = 0; i < 4; i++) {
+                for (glm::length_t j = 0; j < 4; j++) {
+                    hash_combine(std::hash<float>{}(transform[i][j]));
+                }
+            }
+        }
+        shadow_map->update(
+          camera,
+          static_cast<float>(swapchain_image_extent.width) /
+            static_cast<float>(swapchain_image_extent.height),
+          sun_direction,
+          scene_hash,
+          frame_number
+        );
+    }
+
+    GpuSceneData scene_data{
+        .viewproj = viewproj,
         .cam_world_pos = glm::vec4(camera.get_position(), 1.0f),
         .near = camera.get_near(),
         .far = camera.get_far(),
 
         .ambient_color = glm::vec4{ 0.1f, 0.1f, 0.1f, 0.1f },
-        .sunlight_direction = glm::vec4(0.0f, -1.0f, 0.0f, 1.0f),
+        .sunlight_direction = glm::vec4(sun_direction, 1.0f),
         .sunlight_color = glm::vec4(1.0f),
+
+        .view = camera.get_view_mat(),
+        .inv_proj = glm::inverse(camera.get_proj_mat(
+          swapchain_image_extent.width, swapchain_image_extent.height, jitter
+        )),
+        .cluster_grid = glm::uvec4(
+          CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, light_count
+        ),
+        .cluster_params = compute_cluster_params(
+          glm::uvec2(draw_extent.width, draw_extent.height),
+          camera.get_near(),
+          camera.get_far()
+        ),
+        .screen_params = glm::vec4(
+          draw_extent.width,
+          draw_extent.height,
+          light_heat_map_enabled ? 1.0f : 0.0f,
+          // Number of lights in a cluster that maps to the hottest color
+          32.0f
+        ),
+
+        .inv_viewproj = glm::inverse(viewproj),
+
+        .cascade_viewprojs = shadow_map->get_viewprojs(),
+        .cascade_splits = shadow_map->get_splits(),
+        // Normal offset of 1.5 texels
+        .shadow_params = glm::vec4(shadows_enabled ? 1.0f : 0.0f, 1.5f, 0, 0),
+
+        .prev_viewproj = taa_active ? taa->get_prev_viewproj() : viewproj,
+        .taa_jitter = glm::vec4(jitter, 0.0f, 0.0f),
     };
 
     auto draw_ctx = DrawContext{ .device = context->get_device(),
@@ -232,15 +375,24 @@ Renderer::update_scene(
                                  .camera = camera,
 
                                  .swapchain = context->get_swapchain_mut(),
-                                 .draw_image = *draw_image,
-                                 .draw_depth_image = *draw_depth_image,
-                                 .draw_resolve_image = draw_resolve_image.get(),
+                                 .transient_images = *transient_images,
                                  .skybox = *skybox,
+                                 .ibl = *ibl,
+                                 .shadow_map = *shadow_map,
+                                 .taa = taa_active ? taa.get() : nullptr,
 
                                  .opaque_objects = {},
 
+                                 .lights = lights,
+                                 .shadows_enabled = shadows_enabled,
+
                                  .frame_number = frame_number,
+                                 .sample_count = sample_count,
                                  .render_scale = render_scale,
+                                 .sharpening = sharpening,
+                                 .render_path = get_render_path(),
+                                 .draw_extent = draw_extent,
+                                 .upload_token = synchronous_upload_token,
 
                                  .scene_data = std::move(scene_data),
 
@@ -252,6 +404,11 @@ Renderer::update_scene(
         if (renderable.has_value()) {
             renderable.value().get().queue_draw(transform, draw_ctx);
 
+        } else if (is_scene_loading(name)) {
+            render_resources->get_renderable(std::string{ PROXY_BOX_NAME })
+              .value()
+              .get()
+              .queue_draw(transform, draw_ctx);
         } else {
             spdlog::warn("Could not find renderable: {}", name);
         }
@@ -272,6 +429,18 @@ Renderer::draw_frame(
   const std::span<std::pair<std::string, glm::mat4>> &objects_to_render
 )
 {
+    resize_frames();
+    context->get_device().get_frame_timeline().collect();
+    // Everything enqueued since the last frame goes out in one batch
+    context->get_device().get_upload_queue().flush();
+    publish_loaded_scenes();
+
+    // The GPU frame time is the one of the last frame that finished
+    if (dynamic_resolution_enabled) {
+        render_scale =
+          dynamic_resolution.update(stats.gpu_frame_time, render_scale);
+    }
+
     auto draw_ctx = update_scene(camera, objects_to_render);
 
     //--------------------------------------------------------------------------
@@ -279,6 +448,26 @@ Renderer::draw_frame(
 
     get_current_frame().draw(std::move(draw_ctx));
     frame_number++;
+    stats.frames_in_flight = static_cast<int>(frames.size());
+    stats.loading_scene_count = static_cast<int>(pending_scenes.size());
+    const auto upload_stats =
+      context->get_device().get_upload_queue().get_stats();
+    stats.upload_submit_count = static_cast<int>(upload_stats.submit_count);
+    stats.upload_copy_count = static_cast<int>(upload_stats.copy_count);
+    stats.upload_stall_count = static_cast<int>(upload_stats.stall_count);
+    stats.uploaded_megabytes =
+      static_cast<float>(upload_stats.bytes_uploaded) / (1024.0f * 1024.0f);
+    const auto cache_stats =
+      render_resources->get_derived_data_cache().get_stats();
+    stats.derived_data_hit_rate = cache_stats.get_hit_rate();
+    stats.derived_data_saved_megabytes =
+      static_cast<float>(cache_stats.bytes_saved) / (1024.0f * 1024.0f);
+    const auto pipeline_stats =
+      context->get_device().get_pipeline_cache().get_stats();
+    stats.pipeline_count = static_cast<int>(pipeline_stats.pipeline_count);
+    stats.pipeline_creation_time = pipeline_stats.creation_time;
+    stats.pipeline_cache_hit_count =
+      static_cast<int>(pipeline_stats.cache_hit_count);
 
     const auto end = std::chrono::system_clock::now();
     const auto elapsed =
@@ -302,12 +491,219 @@ Renderer::load_gltf(
     }
     std::shared_ptr<LoadedGltfScene> scene = std::move(result.value());
     render_resources->add_scene(name, scene);
+    synchronous_upload_token =
+      context->get_device().get_upload_queue().get_pending_token();
+}
+
+std::shared_ptr<const SceneLoad>
+Renderer::load_gltf_async(
+  const std::filesystem::path &filepath,
+  const std::string &name
+)
+{
+    auto load = std::make_shared<SceneLoad>(name);
+    auto future = scene_loads.enqueue(SceneLoadTask{
+      [filepath, resources = render_resources, &device = context->get_device()](
+      ) -> SceneLoadResult {
+          auto result = AssetLoader::load_gltf(filepath, device, *resources);
+          if (!result.has_value()) {
+              spdlog::error("Failed to load GLTF file: {}", filepath.string());
+              return { nullptr, 0 };
+          }
+          // Every upload of the scene has been enqueued by now
+          return { std::move(result.value()),
+                   device.get_upload_queue().get_pending_token() };
+      } });
+    pending_scenes.emplace_back(
+      PendingScene{ .load = load, .future = std::move(future) }
+    );
+    return load;
+}
+
+void
+Renderer::publish_loaded_scenes()
+{
+    const auto &upload_queue = context->get_device().get_upload_queue();
+    for (auto &pending : pending_scenes) {
+        if (pending.future.valid() &&
+            pending.future.wait_for(std::chrono::seconds(0)) ==
+              std::future_status::ready) {
+            try {
+                std::tie(pending.scene, pending.upload_token) =
+                  pending.future.get();
+            } catch (const std::exception &e) {
+                spdlog::error(
+                  "Failed to load scene {}: {}", pending.load->name, e.what()
+                );
+            }
+            if (!pending.scene) {
+                pending.load->state = SceneLoadState::Failed;
+                continue;
+            }
+        }
+        if (pending.scene && upload_queue.is_complete(pending.upload_token)) {
+            std::shared_ptr<LoadedGltfScene> scene = std::move(pending.scene);
+            const auto &load_stats = scene->get_load_stats();
+            stats.last_load_staged_megabytes =
+              static_cast<float>(load_stats.bytes_staged) / (1024.0f * 1024.0f);
+            stats.last_load_copied_megabytes =
+              static_cast<float>(load_stats.bytes_copied) / (1024.0f * 1024.0f);
+            render_resources->add_scene(pending.load->name, scene);
+            pending.load->state = SceneLoadState::Ready;
+        }
+    }
+    std::erase_if(pending_scenes, [](const PendingScene &pending) {
+        return pending.load->state != SceneLoadState::Loading;
+    });
+}
+
+bool
+Renderer::is_scene_loading(const std::string &name) const noexcept
+{
+    return std::any_of(
+      pending_scenes.begin(),
+      pending_scenes.end(),
+      [&name](const PendingScene &pending) {
+          return pending.load->name == name;
+      }
+    );
 }
 
 void
 Renderer::set_render_scale(float scale) noexcept
 {
-    render_scale = scale;
+    if (!dynamic_resolution_enabled) {
+        render_scale = scale;
+    }
+}
+
+void
+Renderer::set_dynamic_resolution(bool enabled, float target_frame_time) noexcept
+{
+    if (enabled && !dynamic_resolution_enabled) {
+        dynamic_resolution.reset();
+    }
+    dynamic_resolution_enabled = enabled;
+    dynamic_resolution.get_settings().target_frame_time = target_frame_time;
+}
+
+void
+Renderer::set_sharpening(float sharpening) noexcept
+{
+    this->sharpening = std::clamp(sharpening, 0.0f, 1.0f);
+}
+
+void
+Renderer::set_lights(std::span<const Light> lights)
+{
+    if (lights.size() > MAX_LIGHTS) {
+        spdlog::warn(
+          "Too many lights: {} (only the first {} will be drawn)",
+          lights.size(),
+          MAX_LIGHTS
+        );
+    }
+    this->lights.assign(lights.begin(), lights.end());
+}
+
+void
+Renderer::set_light_heat_map_enabled(bool enabled) noexcept
+{
+    light_heat_map_enabled = enabled;
+}
+
+void
+Renderer::set_sun_direction(const glm::vec3 &direction) noexcept
+{
+    sun_direction = glm::normalize(direction);
+}
+
+void
+Renderer::set_shadows_enabled(bool enabled) noexcept
+{
+    // Cascades are not kept up to date while shadows are disabled
+    if (enabled && !shadows_enabled) {
+        shadow_map->invalidate();
+    }
+    shadows_enabled = enabled;
+}
+
+void
+Renderer::set_render_path(RenderPath path) noexcept
+{
+    const bool multisampled = sample_count != vk::SampleCountFlagBits::e1;
+    if (path == RenderPath::Deferred && multisampled) {
+        spdlog::warn("Deferred rendering does not support multisampling, "
+                     "falling back to forward rendering");
+    }
+    if (path == RenderPath::Visibility &&
+        (multisampled || !render_resources->get_bindless_registry())) {
+        spdlog::warn("Visibility buffer rendering requires bindless support "
+                     "and no multisampling, falling back to forward rendering");
+    }
+    render_path = path;
+}
+
+void
+Renderer::set_taa_enabled(bool enabled) noexcept
+{
+    if (enabled && sample_count != vk::SampleCountFlagBits::e1) {
+        spdlog::warn("Temporal anti-aliasing is not used with MSAA");
+    }
+    // The history is not kept up to date while TAA is disabled
+    if (enabled && !taa_enabled) {
+        taa->reset();
+    }
+    taa_enabled = enabled;
+}
+
+void
+Renderer::set_frames_in_flight(uint32_t count) noexcept
+{
+    frames_in_flight =
+      std::clamp(count, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+}
+
+void
+Renderer::resize_frames()
+{
+    if (frames.size() == frames_in_flight) {
+        return;
+    }
+
+    // Removed frames may still be in flight, so they are destroyed once the
+    // GPU is done with everything submitted so far
+    auto &timeline = context->get_device().get_frame_timeline();
+    while (frames.size() > frames_in_flight) {
+        timeline.defer_destroy(
+          [frame = std::shared_ptr<Frame>(std::move(frames.back()))]() mutable {
+              frame.reset();
+          }
+        );
+        frames.pop_back();
+    }
+    // New frames start out idle
+    frames.reserve(frames_in_flight);
+    while (frames.size() < frames_in_flight) {
+        frames.emplace_back(std::make_unique<Frame>(context->get_device()));
+    }
+}
+
+RenderPath
+Renderer::get_render_path() const noexcept
+{
+    // Neither the G-buffer nor the visibility buffer are multisampled
+    if (sample_count != vk::SampleCountFlagBits::e1) {
+        return RenderPath::Forward;
+    }
+    if (render_path == RenderPath::Deferred) {
+        return RenderPath::Deferred;
+    }
+    if (render_path == RenderPath::Visibility &&
+        render_resources->get_bindless_registry()) {
+        return RenderPath::Visibility;
+    }
+    return RenderPath::Forward;
 }
 
 vk::Sampler
@@ -337,12 +733,29 @@ init_desc_set_layouts(const vk::Device &device, RenderResources &resources)
       "compute texture", std::move(compute_texture)
     );
 
+    const auto scene_stages = vk::ShaderStageFlagBits::eVertex |
+                              vk::ShaderStageFlagBits::eFragment |
+                              vk::ShaderStageFlagBits::eCompute;
     auto scene =
       DescriptorSetLayoutBuilder{}
+        .add_binding(0, vk::DescriptorType::eUniformBuffer, scene_stages)
+        // Lights
+        .add_binding(1, vk::DescriptorType::eStorageBuffer, scene_stages)
+        // Light indices of each cluster
+        .add_binding(2, vk::DescriptorType::eStorageBuffer, scene_stages)
+        // Sun shadow map
         .add_binding(
-          0,
-          vk::DescriptorType::eUniformBuffer,
-          vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
+          3, vk::DescriptorType::eCombinedImageSampler, scene_stages
+        )
+        // Irradiance map, prefiltered specular map and BRDF LUT
+        .add_binding(
+          4, vk::DescriptorType::eCombinedImageSampler, scene_stages
+        )
+        .add_binding(
+          5, vk::DescriptorType::eCombinedImageSampler, scene_stages
+        )
+        .add_binding(
+          6, vk::DescriptorType::eCombinedImageSampler, scene_stages
         )
         .build(device);
     resources.add_desc_set_layout("scene", std::move(scene));
@@ -355,13 +768,84 @@ init_desc_set_layouts(const vk::Device &device, RenderResources &resources)
                      )
                      .build(device);
     resources.add_desc_set_layout("texture", std::move(texture));
+
+    // G-buffer inputs and output image of the deferred lighting pass
+    const auto sampled_image = vk::DescriptorType::eCombinedImageSampler;
+    auto gbuffer =
+      DescriptorSetLayoutBuilder{}
+        // Albedo, normal, metal/rough/AO, emissive and depth
+        .add_binding(0, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(1, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(2, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(3, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(4, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        // Lit output
+        .add_binding(
+          5, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute
+        )
+        .build(device);
+    resources.add_desc_set_layout("gbuffer", std::move(gbuffer));
+
+    // Per-draw data of the visibility buffer
+    auto visibility_draws = DescriptorSetLayoutBuilder{}
+                              .add_binding(
+                                0,
+                                vk::DescriptorType::eStorageBuffer,
+                                vk::ShaderStageFlagBits::eVertex |
+                                  vk::ShaderStageFlagBits::eFragment |
+                                  vk::ShaderStageFlagBits::eCompute
+                              )
+                              .build(device);
+    resources.add_desc_set_layout(
+      "visibility draws", std::move(visibility_draws)
+    );
+
+    // Visibility buffer input and output image of the resolve pass
+    auto visibility =
+      DescriptorSetLayoutBuilder{}
+        .add_binding(0, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(
+          1, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute
+        )
+        .build(device);
+    resources.add_desc_set_layout("visibility", std::move(visibility));
+
+    // Inputs and output image of the temporal anti-aliasing resolve pass
+    auto taa =
+      DescriptorSetLayoutBuilder{}
+        // Draw image, depth, motion vectors and history
+        .add_binding(0, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(1, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(2, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        .add_binding(3, sampled_image, vk::ShaderStageFlagBits::eCompute)
+        // Anti-aliased output
+        .add_binding(
+          4, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute
+        )
+        .build(device);
+    resources.add_desc_set_layout("taa", std::move(taa));
+
+    // Skybox input and cubemap output of the IBL precomputation passes
+    auto ibl =
+      DescriptorSetLayoutBuilder{}
+        .add_binding(
+          0,
+          vk::DescriptorType::eCombinedImageSampler,
+          vk::ShaderStageFlagBits::eCompute
+        )
+        .add_binding(
+          1, vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute
+        )
+        .build(device);
+    resources.add_desc_set_layout("ibl", std::move(ibl));
 }
 
 void
 init_materials(
   const vk::Device &device,
+  ShaderModuleCache &shader_modules,
+  PipelineBuildQueue &build_queue,
   const Swapchain &swapchain,
-  const GpuImage &draw_image,
   RenderResources &resources,
   const vk::SampleCountFlagBits sample_count
 )
@@ -378,12 +862,205 @@ init_materials(
             ComputeMaterialBuilder{}
               .set_pipeline_layout(std::move(pipeline_layout))
               .set_shader(std::make_unique<ComputeShader>(ComputeShader{
-                "solid-background", device }))
-              .build(device);
+                "solid-background", shader_modules }))
+              .build(build_queue);
           resources.add_material("background", std::move(background));
       }
       */
 
+    // Clustered light assignment
+    {
+        auto desc_set_layouts =
+          std::array{ resources.get_desc_set_layout("scene") };
+        auto pipeline_layout = device.createPipelineLayoutUnique(
+          vk::PipelineLayoutCreateInfo{}.setSetLayouts(desc_set_layouts)
+        );
+        auto cluster_lights =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(std::move(pipeline_layout))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "cluster-lights", shader_modules }))
+            .build(build_queue);
+        resources.add_material("cluster lights", std::move(cluster_lights));
+    }
+
+    // Deferred lighting
+    {
+        auto desc_set_layouts =
+          std::array{ resources.get_desc_set_layout("scene"),
+                      resources.get_desc_set_layout("gbuffer") };
+        auto pipeline_layout = device.createPipelineLayoutUnique(
+          vk::PipelineLayoutCreateInfo{}.setSetLayouts(desc_set_layouts)
+        );
+        auto deferred_lighting =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(std::move(pipeline_layout))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "deferred-lighting", shader_modules }))
+            .build(build_queue);
+        resources.add_material(
+          "deferred lighting", std::move(deferred_lighting)
+        );
+    }
+
+    // Temporal anti-aliasing resolve
+    {
+        auto desc_set_layouts =
+          std::array{ resources.get_desc_set_layout("scene"),
+                      resources.get_desc_set_layout("taa") };
+        const auto push_constant_range =
+          vk::PushConstantRange{}
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(GpuTaaPushConstants));
+        auto taa_resolve =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}
+                .setSetLayouts(desc_set_layouts)
+                .setPushConstantRanges(push_constant_range)
+            ))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "taa-resolve", shader_modules }))
+            .build(build_queue);
+        resources.add_material("taa resolve", std::move(taa_resolve));
+    }
+
+    // Visibility buffer
+    if (const auto *bindless_registry = resources.get_bindless_registry()) {
+        const auto push_constant_range =
+          vk::PushConstantRange{}
+            .setStageFlags(
+              vk::ShaderStageFlagBits::eVertex |
+              vk::ShaderStageFlagBits::eFragment
+            )
+            .setOffset(0)
+            .setSize(sizeof(uint32_t)); // Draw index
+        // Same sets as the resolve pass, alpha masked materials look up
+        // their base color in the bindless set (the "visibility" set is
+        // never bound)
+        auto geometry_layouts =
+          std::array{ resources.get_desc_set_layout("scene"),
+                      resources.get_desc_set_layout("visibility draws"),
+                      resources.get_desc_set_layout("visibility"),
+                      bindless_registry->get_desc_set_layout() };
+        // Alpha masking is a specialization constant of visibility.frag
+        const auto alpha_mask_entry =
+          vk::SpecializationMapEntry{ 0, 0, sizeof(vk::Bool32) };
+        for (const vk::Bool32 alpha_mask : { vk::False, vk::True }) {
+            auto visibility =
+              GraphicsMaterialBuilder{}
+                .set_pipeline_layout(device.createPipelineLayoutUnique(
+                  vk::PipelineLayoutCreateInfo{}
+                    .setSetLayouts(geometry_layouts)
+                    .setPushConstantRanges(push_constant_range)
+                ))
+                .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+                  "visibility", shader_modules }))
+                .set_specialization_constants(
+                  std::span{ &alpha_mask_entry, 1 },
+                  std::as_bytes(std::span{ &alpha_mask, 1 })
+                )
+                .set_color_attachment_format(VISIBILITY_FORMAT)
+                .set_depth_attachment_format(DRAW_DEPTH_FORMAT)
+                .set_multisampling(vk::SampleCountFlagBits::e1)
+                .disable_blending()
+                .build(build_queue);
+            resources.add_material(
+              alpha_mask ? "visibility masked" : "visibility",
+              std::move(visibility)
+            );
+        }
+
+        auto resolve_layouts =
+          std::array{ resources.get_desc_set_layout("scene"),
+                      resources.get_desc_set_layout("visibility draws"),
+                      resources.get_desc_set_layout("visibility"),
+                      bindless_registry->get_desc_set_layout() };
+        auto visibility_resolve =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}.setSetLayouts(resolve_layouts)
+            ))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "visibility-resolve", shader_modules }))
+            .build(build_queue);
+        resources.add_material(
+          "visibility resolve", std::move(visibility_resolve)
+        );
+    }
+
+    // Image-based lighting precomputation
+    {
+        auto filter_layouts =
+          std::array{ resources.get_desc_set_layout("ibl") };
+        auto irradiance =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}.setSetLayouts(filter_layouts)
+            ))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "ibl-irradiance", shader_modules }))
+            .build(build_queue);
+        resources.add_material("ibl irradiance", std::move(irradiance));
+
+        const auto push_constant_range =
+          vk::PushConstantRange{}
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(float)); // Roughness
+        auto prefilter =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}
+                .setSetLayouts(filter_layouts)
+                .setPushConstantRanges(push_constant_range)
+            ))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "ibl-prefilter", shader_modules }))
+            .build(build_queue);
+        resources.add_material("ibl prefilter", std::move(prefilter));
+
+        auto lut_layouts =
+          std::array{ resources.get_desc_set_layout("compute texture") };
+        auto brdf_lut =
+          ComputeMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}.setSetLayouts(lut_layouts)
+            ))
+            .set_shader(std::make_unique<ComputeShader>(ComputeShader{
+              "ibl-brdf-lut", shader_modules }))
+            .build(build_queue);
+        resources.add_material("ibl brdf lut", std::move(brdf_lut));
+    }
+
+    // Shadow map (depth only)
+    {
+        const auto push_constant_range =
+          vk::PushConstantRange{}
+            .setStageFlags(
+              vk::ShaderStageFlagBits::eVertex |
+              vk::ShaderStageFlagBits::eFragment
+            )
+            .setOffset(0)
+            .setSize(sizeof(GpuShadowPushConstants));
+        auto shadow =
+          GraphicsMaterialBuilder{}
+            .set_pipeline_layout(device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}.setPushConstantRanges(
+                push_constant_range
+              )
+            ))
+            .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+              "shadow", std::nullopt, shader_modules }))
+            .disable_color_attachments()
+            .set_depth_attachment_format(SHADOW_MAP_FORMAT)
+            .set_depth_bias(1.25f, 1.75f)
+            .set_multisampling(vk::SampleCountFlagBits::e1)
+            .build(build_queue);
+        resources.add_material("shadow", std::move(shadow));
+    }
+
     // Grid
     {
         auto desc_set_layouts =
@@ -395,12 +1072,11 @@ init_materials(
           GraphicsMaterialBuilder{}
             .set_pipeline_layout(std::move(pipeline_layout))
             .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
-              "grid", device }))
-            .set_color_attachment_format(draw_image.get_format())
-            .set_depth_attachment_format(swapchain.get_depth_image().get_format(
-            ))
+              "grid", shader_modules }))
+            .set_color_attachment_format(DRAW_IMAGE_FORMAT)
+            .set_depth_attachment_format(DRAW_DEPTH_FORMAT)
             .set_multisampling(sample_count)
-            .build(device);
+            .build(build_queue);
         resources.add_material("grid", std::move(grid));
     }
 
@@ -427,18 +1103,70 @@ init_materials(
           GraphicsMaterialBuilder{}
             .set_pipeline_layout(std::move(pipeline_layout))
             .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
-              "skybox", device }))
-            .set_color_attachment_format(draw_image.get_format())
-            .set_depth_attachment_format(swapchain.get_depth_image().get_format(
-            ))
+              "skybox", shader_modules }))
+            .set_color_attachment_format(DRAW_IMAGE_FORMAT)
+            .set_depth_attachment_format(DRAW_DEPTH_FORMAT)
             .set_cull_mode(
               vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise
             )
             .set_depth_test(true, vk::CompareOp::eLessOrEqual)
             .set_multisampling(sample_count)
-            .build(device);
+            .build(build_queue);
         resources.add_material("skybox", std::move(skybox));
     }
+
+    // Upscale and composite
+    // The draw image is upscaled to the size of the swapchain image, then
+    // sharpened into it, and ImGui draws on top without a depth attachment
+    {
+        auto desc_set_layouts =
+          std::array{ resources.get_desc_set_layout("texture") };
+        const auto create_pipeline_layout = [&](uint32_t push_constant_size) {
+            const auto push_constant_range =
+              vk::PushConstantRange{}
+                .setStageFlags(
+                  vk::ShaderStageFlagBits::eVertex |
+                  vk::ShaderStageFlagBits::eFragment
+                )
+                .setOffset(0)
+                .setSize(push_constant_size);
+            return device.createPipelineLayoutUnique(
+              vk::PipelineLayoutCreateInfo{}
+                .setSetLayouts(desc_set_layouts)
+                .setPushConstantRanges(push_constant_range)
+            );
+        };
+
+        auto upscale =
+          GraphicsMaterialBuilder{}
+            .set_pipeline_layout(
+              create_pipeline_layout(sizeof(GpuUpscalePushConstants))
+            )
+            .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+              "fullscreen", "easu", shader_modules }))
+            .set_color_attachment_format(DRAW_IMAGE_FORMAT)
+            .set_depth_attachment_format(vk::Format::eUndefined)
+            .set_depth_test(false)
+            .set_multisampling(vk::SampleCountFlagBits::e1)
+            .disable_blending()
+            .build(build_queue);
+        resources.add_material("upscale", std::move(upscale));
+
+        auto composite =
+          GraphicsMaterialBuilder{}
+            .set_pipeline_layout(
+              create_pipeline_layout(sizeof(GpuCompositePushConstants))
+            )
+            .set_shader(std::make_unique<GraphicsShader>(GraphicsShader{
+              "fullscreen", "composite", shader_modules }))
+            .set_color_attachment_format(swapchain.get_format())
+            .set_depth_attachment_format(vk::Format::eUndefined)
+            .set_depth_test(false)
+            .set_multisampling(vk::SampleCountFlagBits::e1)
+            .disable_blending()
+            .build(build_queue);
+        resources.add_material("composite", std::move(composite));
+    }
 }
 
 void
@@ -546,10 +1274,7 @@ Renderer::init_imgui(SDL_Window *window)
     auto color_formats = std::array{ ctx.get_swapchain().get_format() };
     init_info.PipelineRenderingCreateInfo =
       vk::PipelineRenderingCreateInfo{}
-        .setColorAttachmentFormats(color_formats)
-        .setDepthAttachmentFormat(
-          ctx.get_swapchain().get_depth_image().get_format()
-        );
+        .setColorAttachmentFormats(color_formats);
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
     ImGui_ImplVulkan_Init(&init_info);
 }
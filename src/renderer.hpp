@@ -4,21 +4,56 @@
 
 #include "asset_loader.hpp"
 #include "context.hpp"
+#include "dynamic_resolution.hpp"
 #include "frame.hpp"
+#include "gbuffer.hpp"
 #include "image.hpp"
+#include "light.hpp"
 #include "profiling.hpp"
 #include "render_object.hpp"
+#include "scene_load_queue.hpp"
+#include "upload_queue.hpp"
+
+#include <atomic>
+#include <future>
 
 namespace kovra {
 // Forward declarations
 class RenderResources;
 class PbrMaterial;
 class Cubemap;
+class ImageBasedLighting;
+class ShadowMap;
+class TemporalAntiAliasing;
+
+// More frames in flight raise throughput at the cost of input latency
+static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+enum class SceneLoadState : uint8_t
+{
+    Loading,
+    Ready,
+    Failed,
+};
+
+// Progress of a scene that is loading in the background
+struct SceneLoad
+{
+    const std::string name;
+    std::atomic<SceneLoadState> state = SceneLoadState::Loading;
+};
 
 class Renderer
 {
   public:
-    explicit Renderer(SDL_Window *window, bool enable_multisampling);
+    // The draw image has requested_sample_count MSAA samples (1, 2, 4 or 8),
+    // or the highest count below it that the device supports
+    explicit Renderer(
+      SDL_Window *window,
+      vk::SampleCountFlagBits requested_sample_count
+    );
     ~Renderer();
     Renderer() = delete;
     Renderer(const Renderer &) = delete;
@@ -35,7 +70,34 @@ class Renderer
       const std::filesystem::path &filepath,
       const std::string &name
     ) noexcept;
+    // Parses the file and decodes its images on the scene load worker and
+    // returns right away, scenes load one after another
+    // The scene is published once its uploads are complete, and objects that
+    // refer to it are drawn as a proxy box until then
+    std::shared_ptr<const SceneLoad> load_gltf_async(
+      const std::filesystem::path &filepath,
+      const std::string &name
+    );
+    // Ignored while dynamic resolution is enabled
     void set_render_scale(float scale) noexcept;
+    // Adjust the render scale every frame to keep the GPU frame time close to
+    // target_frame_time (in ms)
+    void set_dynamic_resolution(bool enabled, float target_frame_time) noexcept;
+    // Strength of the sharpening applied after upscaling, from 0 to 1
+    void set_sharpening(float sharpening) noexcept;
+    void set_lights(std::span<const Light> lights);
+    void set_light_heat_map_enabled(bool enabled) noexcept;
+    // Direction the sunlight travels in
+    void set_sun_direction(const glm::vec3 &direction) noexcept;
+    void set_shadows_enabled(bool enabled) noexcept;
+    // Falls back to forward rendering if deferred or visibility buffer
+    // rendering is requested with MSAA or without bindless support
+    void set_render_path(RenderPath path) noexcept;
+    // Temporal anti-aliasing, ignored with MSAA
+    void set_taa_enabled(bool enabled) noexcept;
+    // Clamped to [MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT]
+    // Takes effect at the start of the next frame
+    void set_frames_in_flight(uint32_t count) noexcept;
 
     [[nodiscard]] const Context &get_context() const noexcept
     {
@@ -46,14 +108,29 @@ class Renderer
     {
         return frame_number;
     }
+    [[nodiscard]] uint32_t get_frames_in_flight() const noexcept
+    {
+        return frames_in_flight;
+    }
     [[nodiscard]] const RenderResources &get_render_resources() const noexcept
     {
         return *render_resources;
     }
-    [[nodiscard]] const GpuImage &get_draw_image() const noexcept
+    [[nodiscard]] float get_render_scale() const noexcept
     {
-        return *draw_image;
+        return render_scale;
     }
+    [[nodiscard]] vk::SampleCountFlagBits get_sample_count() const noexcept
+    {
+        return sample_count;
+    }
+    // Whether temporal anti-aliasing is used to draw the next frame
+    [[nodiscard]] bool is_taa_active() const noexcept
+    {
+        return taa_enabled && sample_count == vk::SampleCountFlagBits::e1;
+    }
+    // Render path that is actually used to draw the next frame
+    [[nodiscard]] RenderPath get_render_path() const noexcept;
     [[nodiscard]] const RendererStats &get_stats() const noexcept
     {
         return stats;
@@ -66,22 +143,50 @@ class Renderer
     std::unique_ptr<DescriptorAllocator> global_desc_allocator;
 
     // Frames
-    static constexpr const uint32_t FRAME_OVERLAP = 2;
     uint32_t frame_number;
+    uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
     std::vector<std::unique_ptr<Frame>> frames;
 
     // Resources
     std::shared_ptr<RenderResources> render_resources;
-    std::unique_ptr<GpuImage> draw_image;
-    std::unique_ptr<GpuImage> draw_depth_image;
-    std::unique_ptr<GpuImage> draw_resolve_image;
+    // Draw, depth, G-buffer and visibility images of the frame graphs
+    std::unique_ptr<TransientImagePool> transient_images;
     std::unique_ptr<Cubemap> skybox;
+    std::unique_ptr<ImageBasedLighting> ibl;
+    std::unique_ptr<ShadowMap> shadow_map;
+    std::unique_ptr<TemporalAntiAliasing> taa;
 
     // ImGui
     VkDescriptorPool imgui_pool;
 
     float render_scale = 1.0f;
-    const bool enable_multisampling;
+    bool dynamic_resolution_enabled = false;
+    DynamicResolution dynamic_resolution;
+    float sharpening = 0.8f;
+    const vk::SampleCountFlagBits sample_count;
+    bool taa_enabled = false;
+    RenderPath render_path = RenderPath::Forward;
+
+    // Lighting
+    std::vector<Light> lights;
+    bool light_heat_map_enabled = false;
+    glm::vec3 sun_direction = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+    bool shadows_enabled = true;
+
+    // Scenes loading in the background
+    SceneLoadQueue scene_loads;
+    struct PendingScene
+    {
+        std::shared_ptr<SceneLoad> load;
+        std::future<SceneLoadResult> future;
+        // Set once the worker is done, then held until its uploads complete
+        std::unique_ptr<LoadedGltfScene> scene;
+        UploadToken upload_token = 0;
+    };
+    std::vector<PendingScene> pending_scenes;
+    // Newest uploads that are drawn as soon as they are submitted (default
+    // textures, skybox and scenes loaded with load_gltf)
+    UploadToken synchronous_upload_token = 0;
 
     // Profiling
     RendererStats stats;
@@ -92,6 +197,11 @@ class Renderer
     }
 
     void init_imgui(SDL_Window *window);
+    // Add or remove frames to match frames_in_flight
+    void resize_frames();
+    // Hand scenes whose uploads are complete to the render resources
+    void publish_loaded_scenes();
+    [[nodiscard]] bool is_scene_loading(const std::string &name) const noexcept;
 
     auto update_scene(
       const Camera &camera,
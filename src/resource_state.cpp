@@ -0,0 +1,363 @@
+#include "resource_state.hpp"
+#include "buffer.hpp"
+#include "image.hpp"
+
+#include "spdlog/spdlog.h"
+
+namespace kovra {
+static constexpr vk::AccessFlags2 WRITE_ACCESS =
+  vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+  vk::AccessFlagBits2::eColorAttachmentWrite |
+  vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+  vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite |
+  vk::AccessFlagBits2::eMemoryWrite;
+
+ResourceUsageInfo
+get_usage_info(ResourceUsage usage) noexcept
+{
+    using Stage = vk::PipelineStageFlagBits2;
+    using Access = vk::AccessFlagBits2;
+    using Layout = vk::ImageLayout;
+    switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            // Attachments may be loaded and blended
+            return { Layout::eColorAttachmentOptimal,
+                     Stage::eColorAttachmentOutput,
+                     Access::eColorAttachmentRead |
+                       Access::eColorAttachmentWrite };
+        case ResourceUsage::DepthAttachment:
+            return { Layout::eDepthStencilAttachmentOptimal,
+                     Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                     Access::eDepthStencilAttachmentRead |
+                       Access::eDepthStencilAttachmentWrite };
+        case ResourceUsage::DepthAttachmentRead:
+            return { Layout::eDepthStencilReadOnlyOptimal,
+                     Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                     Access::eDepthStencilAttachmentRead };
+        case ResourceUsage::FragmentSampled:
+            return { Layout::eShaderReadOnlyOptimal,
+                     Stage::eFragmentShader,
+                     Access::eShaderSampledRead };
+        case ResourceUsage::ComputeSampled:
+            return { Layout::eShaderReadOnlyOptimal,
+                     Stage::eComputeShader,
+                     Access::eShaderSampledRead };
+        case ResourceUsage::ShaderSampled:
+            return { Layout::eShaderReadOnlyOptimal,
+                     Stage::eFragmentShader | Stage::eComputeShader,
+                     Access::eShaderSampledRead };
+        case ResourceUsage::ComputeStorageWrite:
+            return { Layout::eGeneral,
+                     Stage::eComputeShader,
+                     Access::eShaderStorageWrite };
+        case ResourceUsage::ComputeStorageReadWrite:
+            return { Layout::eGeneral,
+                     Stage::eComputeShader,
+                     Access::eShaderStorageRead | Access::eShaderStorageWrite };
+        case ResourceUsage::TransferSrc:
+            return { Layout::eTransferSrcOptimal,
+                     Stage::eAllTransfer,
+                     Access::eTransferRead };
+        case ResourceUsage::TransferDst:
+            return { Layout::eTransferDstOptimal,
+                     Stage::eAllTransfer,
+                     Access::eTransferWrite };
+        case ResourceUsage::Present:
+            // Presentation waits on a semaphore signaled after every stage
+            return { Layout::ePresentSrcKHR, Stage::eNone, Access::eNone };
+        case ResourceUsage::ComputeStorageBufferWrite:
+            return { Layout::eUndefined,
+                     Stage::eComputeShader,
+                     Access::eShaderStorageWrite };
+        case ResourceUsage::StorageBufferRead:
+            return { Layout::eUndefined,
+                     Stage::eFragmentShader | Stage::eComputeShader,
+                     Access::eShaderStorageRead };
+    }
+    return { Layout::eGeneral, Stage::eAllCommands, Access::eMemoryRead };
+}
+
+std::optional<vk::ImageUsageFlags>
+get_required_image_usage(ResourceUsage usage) noexcept
+{
+    using Usage = vk::ImageUsageFlagBits;
+    switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            return Usage::eColorAttachment;
+        case ResourceUsage::DepthAttachment:
+        case ResourceUsage::DepthAttachmentRead:
+            return Usage::eDepthStencilAttachment;
+        case ResourceUsage::FragmentSampled:
+        case ResourceUsage::ComputeSampled:
+        case ResourceUsage::ShaderSampled:
+            return Usage::eSampled;
+        case ResourceUsage::ComputeStorageWrite:
+        case ResourceUsage::ComputeStorageReadWrite:
+            return Usage::eStorage;
+        case ResourceUsage::TransferSrc:
+            return Usage::eTransferSrc;
+        case ResourceUsage::TransferDst:
+            return Usage::eTransferDst;
+        case ResourceUsage::Present:
+            return vk::ImageUsageFlags{};
+        default:
+            return std::nullopt;
+    }
+}
+
+#ifndef NDEBUG
+// Usage flags the buffer must have been created with
+static std::optional<vk::BufferUsageFlags>
+get_required_buffer_usage(ResourceUsage usage) noexcept
+{
+    switch (usage) {
+        case ResourceUsage::ComputeStorageBufferWrite:
+        case ResourceUsage::StorageBufferRead:
+            return vk::BufferUsageFlagBits::eStorageBuffer;
+        default:
+            return std::nullopt;
+    }
+}
+#endif
+
+void
+ResourceStateTracker::reset() noexcept
+{
+    image_states.clear();
+    buffer_states.clear();
+    image_barriers.clear();
+    buffer_barriers.clear();
+    stats = {};
+}
+
+ResourceStateTracker::ResourceState
+ResourceStateTracker::get_settled_state(
+  const ResourceUsageInfo &info
+) noexcept
+{
+    return ResourceState{
+        .layout = info.layout,
+        .write_stages = {},
+        .write_access = {},
+        .read_stages = info.stages ? info.stages
+                                   : vk::PipelineStageFlagBits2::eAllCommands,
+        .visible_stages = info.stages,
+        .visible_access = info.access,
+    };
+}
+
+void
+ResourceStateTracker::set_image_usage(vk::Image image, ResourceUsage usage)
+{
+    image_states[image] = get_settled_state(get_usage_info(usage));
+}
+
+void
+ResourceStateTracker::set_buffer_usage(
+  const GpuBuffer &buffer,
+  ResourceUsage usage
+)
+{
+    buffer_states[buffer.get()] = get_settled_state(get_usage_info(usage));
+}
+
+void
+ResourceStateTracker::require(const GpuImage &image, ResourceUsage usage)
+{
+#ifndef NDEBUG
+    const auto required_usage = get_required_image_usage(usage);
+    if (!required_usage.has_value() ||
+        (image.get_usage() & required_usage.value()) != required_usage.value()
+    ) {
+        spdlog::error(
+          "Image with usage {} can't be used as resource usage {}",
+          vk::to_string(image.get_usage()),
+          static_cast<int>(usage)
+        );
+        throw std::runtime_error("Invalid image usage");
+    }
+#endif
+    require(
+      image.get(),
+      image.get_aspect(),
+      usage,
+      static_cast<uint32_t>(image.get_layer_count()),
+      static_cast<uint32_t>(image.get_level_count())
+    );
+}
+
+void
+ResourceStateTracker::require(
+  vk::Image image,
+  vk::ImageAspectFlags aspect,
+  ResourceUsage usage,
+  uint32_t layer_count,
+  uint32_t level_count
+)
+{
+    const auto info = get_usage_info(usage);
+    auto &state = image_states[image];
+    if (state.pending_barrier.has_value()) {
+        auto &barrier = image_barriers[state.pending_barrier.value()];
+        barrier.setDstStageMask(barrier.dstStageMask | info.stages)
+          .setDstAccessMask(barrier.dstAccessMask | info.access)
+          .setNewLayout(info.layout);
+        merge(state, info);
+        return;
+    }
+
+    const auto old_layout = state.layout;
+    const auto masks = transition(state, info, true);
+    if (!masks.has_value()) {
+        return;
+    }
+    state.pending_barrier = image_barriers.size();
+    image_barriers.emplace_back(
+      vk::ImageMemoryBarrier2{}
+        .setSrcStageMask(masks->src_stages)
+        .setSrcAccessMask(masks->src_access)
+        .setDstStageMask(masks->dst_stages)
+        .setDstAccessMask(masks->dst_access)
+        .setOldLayout(old_layout)
+        .setNewLayout(info.layout)
+        .setSubresourceRange(vk::ImageSubresourceRange{}
+                               .setAspectMask(aspect)
+                               .setBaseMipLevel(0)
+                               .setLevelCount(level_count)
+                               .setBaseArrayLayer(0)
+                               .setLayerCount(layer_count))
+        .setImage(image)
+    );
+}
+
+void
+ResourceStateTracker::require(const GpuBuffer &buffer, ResourceUsage usage)
+{
+#ifndef NDEBUG
+    const auto required_usage = get_required_buffer_usage(usage);
+    if (!required_usage.has_value() ||
+        (buffer.get_usage() & required_usage.value()) != required_usage.value()
+    ) {
+        spdlog::error(
+          "Buffer with usage {} can't be used as resource usage {}",
+          vk::to_string(buffer.get_usage()),
+          static_cast<int>(usage)
+        );
+        throw std::runtime_error("Invalid buffer usage");
+    }
+#endif
+    const auto info = get_usage_info(usage);
+    auto &state = buffer_states[buffer.get()];
+    if (state.pending_barrier.has_value()) {
+        auto &barrier = buffer_barriers[state.pending_barrier.value()];
+        barrier.setDstStageMask(barrier.dstStageMask | info.stages)
+          .setDstAccessMask(barrier.dstAccessMask | info.access);
+        merge(state, info);
+        return;
+    }
+
+    const auto masks = transition(state, info, false);
+    if (!masks.has_value()) {
+        return;
+    }
+    state.pending_barrier = buffer_barriers.size();
+    buffer_barriers.emplace_back(vk::BufferMemoryBarrier2{}
+                                   .setSrcStageMask(masks->src_stages)
+                                   .setSrcAccessMask(masks->src_access)
+                                   .setDstStageMask(masks->dst_stages)
+                                   .setDstAccessMask(masks->dst_access)
+                                   .setBuffer(buffer.get())
+                                   .setOffset(0)
+                                   .setSize(vk::WholeSize));
+}
+
+void
+ResourceStateTracker::flush(vk::CommandBuffer cmd)
+{
+    if (!has_pending_barriers()) {
+        return;
+    }
+    cmd.pipelineBarrier2(vk::DependencyInfo{}
+                           .setImageMemoryBarriers(image_barriers)
+                           .setBufferMemoryBarriers(buffer_barriers));
+    stats.barrier_count +=
+      static_cast<uint32_t>(image_barriers.size() + buffer_barriers.size());
+    stats.batch_count++;
+
+    image_barriers.clear();
+    buffer_barriers.clear();
+    for (auto &[image, state] : image_states) {
+        state.pending_barrier.reset();
+    }
+    for (auto &[buffer, state] : buffer_states) {
+        state.pending_barrier.reset();
+    }
+}
+
+std::optional<ResourceStateTracker::BarrierMasks>
+ResourceStateTracker::transition(
+  ResourceState &state,
+  const ResourceUsageInfo &info,
+  bool is_image
+) noexcept
+{
+    const auto write_access = info.access & WRITE_ACCESS;
+    const bool layout_change = is_image && state.layout != info.layout;
+    if (write_access || layout_change) {
+        // Wait for every access since the last barrier, only writes have to
+        // be made available
+        const auto masks = BarrierMasks{
+            .src_stages = state.write_stages | state.read_stages,
+            .src_access = state.write_access,
+            .dst_stages = info.stages,
+            .dst_access = info.access,
+        };
+        // A layout transition is a write as well, visible to the usage
+        state = ResourceState{
+            .layout = info.layout,
+            .write_stages = info.stages,
+            .write_access = write_access,
+            .read_stages = write_access ? vk::PipelineStageFlags2{}
+                                        : info.stages,
+            .visible_stages = info.stages,
+            .visible_access = info.access,
+        };
+        return masks;
+    }
+
+    // Reads after reads only have to wait for the last write, and only once
+    // per stage and access
+    state.read_stages |= info.stages;
+    const bool visible = !(info.stages & ~state.visible_stages) &&
+                         !(info.access & ~state.visible_access);
+    if (!state.write_stages || visible) {
+        return std::nullopt;
+    }
+    state.visible_stages |= info.stages;
+    state.visible_access |= info.access;
+    return BarrierMasks{
+        .src_stages = state.write_stages,
+        .src_access = state.write_access,
+        .dst_stages = info.stages,
+        .dst_access = info.access,
+    };
+}
+
+void
+ResourceStateTracker::merge(
+  ResourceState &state,
+  const ResourceUsageInfo &info
+) noexcept
+{
+    const auto write_access = info.access & WRITE_ACCESS;
+    state.layout = info.layout;
+    if (write_access) {
+        state.write_stages |= info.stages;
+        state.write_access |= write_access;
+    } else {
+        state.read_stages |= info.stages;
+    }
+    state.visible_stages |= info.stages;
+    state.visible_access |= info.access;
+}
+} // namespace kovra
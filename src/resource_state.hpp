@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class GpuBuffer;
+class GpuImage;
+
+// What the next commands do with a resource
+enum class ResourceUsage : uint8_t
+{
+    // Images
+    ColorAttachment,
+    DepthAttachment,
+    // Depth tested against without being written
+    DepthAttachmentRead,
+    FragmentSampled,
+    ComputeSampled,
+    // Sampled by fragment and compute shaders
+    ShaderSampled,
+    ComputeStorageWrite,
+    ComputeStorageReadWrite,
+    TransferSrc,
+    TransferDst,
+    Present,
+    // Buffers
+    ComputeStorageBufferWrite,
+    // Read by fragment and compute shaders
+    StorageBufferRead,
+};
+
+// Layout, stages and access masks a usage needs
+struct ResourceUsageInfo
+{
+    vk::ImageLayout layout;
+    vk::PipelineStageFlags2 stages;
+    vk::AccessFlags2 access;
+};
+
+[[nodiscard]] ResourceUsageInfo get_usage_info(ResourceUsage usage) noexcept;
+// Usage flags an image must be created with for the usage, none if it is a
+// buffer usage
+[[nodiscard]] std::optional<vk::ImageUsageFlags> get_required_image_usage(
+  ResourceUsage usage
+) noexcept;
+
+struct ResourceStateStats
+{
+    // Image and buffer barriers recorded
+    uint32_t barrier_count;
+    // pipelineBarrier2 calls they were batched into
+    uint32_t batch_count;
+};
+
+// Tracks the layout and the last accesses of every image and buffer used by
+// a command buffer, and turns the usages declared with require() into the
+// barriers they need
+// Reads after reads in the same layout need no barrier, writes only wait for
+// the stages that accessed the resource since the last barrier, and reads
+// only wait for the last write. Barriers are queued until flush(), which
+// records all of them with a single pipelineBarrier2.
+// Resources that weren't declared start in eUndefined, and their first
+// barrier waits for all earlier commands on the queue, since they may still
+// be used by the previous frame.
+class ResourceStateTracker
+{
+  public:
+    ResourceStateTracker() = default;
+    ResourceStateTracker(const ResourceStateTracker &) = delete;
+    ResourceStateTracker &operator=(const ResourceStateTracker &) = delete;
+
+    // Forget every resource, for a new command buffer
+    void reset() noexcept;
+    // Declare the usage an earlier submission or an explicit barrier left a
+    // resource in, for resources that keep their contents across frames or
+    // are acquired from another queue family
+    void set_image_usage(vk::Image image, ResourceUsage usage);
+    void set_buffer_usage(const GpuBuffer &buffer, ResourceUsage usage);
+
+    void require(const GpuImage &image, ResourceUsage usage);
+    // For images that aren't GpuImages, such as swapchain images
+    void require(
+      vk::Image image,
+      vk::ImageAspectFlags aspect,
+      ResourceUsage usage,
+      uint32_t layer_count = 1,
+      uint32_t level_count = 1
+    );
+    void require(const GpuBuffer &buffer, ResourceUsage usage);
+
+    // Record the queued barriers
+    void flush(vk::CommandBuffer cmd);
+    [[nodiscard]] bool has_pending_barriers() const noexcept
+    {
+        return !image_barriers.empty() || !buffer_barriers.empty();
+    }
+    [[nodiscard]] ResourceStateStats get_stats() const noexcept
+    {
+        return stats;
+    }
+
+  private:
+    struct ResourceState
+    {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        // Stages and access of the last write, or of the last layout
+        // transition, anything before the command buffer if unknown
+        vk::PipelineStageFlags2 write_stages =
+          vk::PipelineStageFlagBits2::eAllCommands;
+        vk::AccessFlags2 write_access = vk::AccessFlagBits2::eMemoryWrite;
+        // Stages that read the resource since then
+        vk::PipelineStageFlags2 read_stages =
+          vk::PipelineStageFlagBits2::eAllCommands;
+        // Stages and access the last write is visible to
+        vk::PipelineStageFlags2 visible_stages = {};
+        vk::AccessFlags2 visible_access = {};
+        // Index of its queued barrier, which a later usage is merged into
+        // as long as no command ran in between
+        std::optional<size_t> pending_barrier;
+    };
+
+    struct BarrierMasks
+    {
+        vk::PipelineStageFlags2 src_stages;
+        vk::AccessFlags2 src_access;
+        vk::PipelineStageFlags2 dst_stages;
+        vk::AccessFlags2 dst_access;
+    };
+
+    // State of a resource some barrier left in the usage, which made it
+    // visible to the stages of the usage for every later command on the queue
+    [[nodiscard]] static ResourceState get_settled_state(
+      const ResourceUsageInfo &info
+    ) noexcept;
+    // Update the state for the usage and return the barrier it needs
+    [[nodiscard]] static std::optional<BarrierMasks> transition(
+      ResourceState &state,
+      const ResourceUsageInfo &info,
+      bool is_image
+    ) noexcept;
+    // Widen the queued barrier of the resource to the usage as well
+    static void merge(ResourceState &state, const ResourceUsageInfo &info)
+      noexcept;
+
+    std::unordered_map<VkImage, ResourceState> image_states;
+    std::unordered_map<VkBuffer, ResourceState> buffer_states;
+    std::vector<vk::ImageMemoryBarrier2> image_barriers;
+    std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+    ResourceStateStats stats{};
+};
+} // namespace kovra
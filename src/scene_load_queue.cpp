@@ -0,0 +1,62 @@
+#include "scene_load_queue.hpp"
+#include "asset_loader.hpp"
+
+namespace kovra {
+SceneLoadQueue::SceneLoadQueue()
+  : worker{ &SceneLoadQueue::work, this }
+{
+}
+
+SceneLoadQueue::~SceneLoadQueue()
+{
+    {
+        std::lock_guard lock{ mutex };
+        stopping = true;
+        tasks.clear();
+    }
+    task_available.notify_all();
+    worker.join();
+}
+
+std::future<SceneLoadResult>
+SceneLoadQueue::enqueue(SceneLoadTask &&task)
+{
+    auto future = task.get_future();
+    {
+        std::lock_guard lock{ mutex };
+        tasks.emplace_back(std::move(task));
+    }
+    task_available.notify_one();
+    return future;
+}
+
+void
+SceneLoadQueue::clear()
+{
+    std::lock_guard lock{ mutex };
+    tasks.clear();
+}
+
+void
+SceneLoadQueue::work()
+{
+    while (true) {
+        SceneLoadTask task;
+        {
+            std::unique_lock lock{ mutex };
+            task_available.wait(lock, [this] {
+                return stopping || !tasks.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        // Failures are stored in the future and rethrown when the scene is
+        // published
+        task();
+    }
+}
+} // namespace kovra
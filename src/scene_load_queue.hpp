@@ -0,0 +1,49 @@
+#pragma once
+
+#include "upload_queue.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace kovra {
+// Forward declarations
+class LoadedGltfScene;
+
+// Scene and the token of its last upload, null if the load failed
+using SceneLoadResult =
+  std::pair<std::unique_ptr<LoadedGltfScene>, UploadToken>;
+using SceneLoadTask = std::packaged_task<SceneLoadResult()>;
+
+// Loads scenes one at a time on a single worker thread
+// Each load already decodes its images on every core (see AssetLoader), so
+// running several at once would only oversubscribe the CPU.
+// Tasks that haven't started when the queue is cleared or destroyed are
+// dropped, their futures throw std::future_error.
+class SceneLoadQueue
+{
+  public:
+    SceneLoadQueue();
+    ~SceneLoadQueue();
+    SceneLoadQueue(const SceneLoadQueue &) = delete;
+    SceneLoadQueue &operator=(const SceneLoadQueue &) = delete;
+
+    [[nodiscard]] std::future<SceneLoadResult> enqueue(SceneLoadTask &&task);
+    // Drop the tasks that haven't started, the running one finishes
+    void clear();
+
+  private:
+    std::thread worker;
+
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::deque<SceneLoadTask> tasks;
+    bool stopping = false;
+
+    void work();
+};
+} // namespace kovra
@@ -0,0 +1,326 @@
+#include "scene_pack.hpp"
+
+#include "format.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace kovra {
+namespace {
+struct SectionSource
+{
+    PackSection section;
+    uint32_t record_size;
+    const void *data;
+    uint64_t size;
+};
+
+template<typename T>
+SectionSource
+get_section_source(PackSection section, const std::vector<T> &records)
+{
+    return SectionSource{ .section = section,
+                          .record_size = sizeof(T),
+                          .data = records.data(),
+                          .size = sizeof(T) * records.size() };
+}
+
+uint64_t
+align_offset(uint64_t offset)
+{
+    return (offset + SCENE_PACK_ALIGNMENT - 1) / SCENE_PACK_ALIGNMENT *
+           SCENE_PACK_ALIGNMENT;
+}
+
+bool
+is_range_valid(uint64_t first, uint64_t count, uint64_t size)
+{
+    return first <= size && count <= size - first;
+}
+} // namespace
+
+bool
+write_scene_pack(
+  const std::filesystem::path &filepath,
+  const ScenePackContents &contents
+)
+{
+    const auto sections = std::array{
+        SectionSource{ .section = PackSection::Strings,
+                       .record_size = 1,
+                       .data = contents.strings.data(),
+                       .size = contents.strings.size() },
+        get_section_source(PackSection::Samplers, contents.samplers),
+        get_section_source(PackSection::Textures, contents.textures),
+        get_section_source(PackSection::TextureData, contents.texture_data),
+        get_section_source(PackSection::Materials, contents.materials),
+        get_section_source(PackSection::MaterialData, contents.material_data),
+        get_section_source(PackSection::Meshes, contents.meshes),
+        get_section_source(PackSection::Surfaces, contents.surfaces),
+        get_section_source(PackSection::Vertices, contents.vertices),
+        get_section_source(PackSection::Indices, contents.indices),
+        get_section_source(PackSection::Nodes, contents.nodes),
+        get_section_source(PackSection::NodeChildren, contents.node_children),
+    };
+    static_assert(sections.size() == static_cast<size_t>(PackSection::Count));
+
+    const auto header =
+      PackHeader{ .magic = SCENE_PACK_MAGIC,
+                  .version = SCENE_PACK_VERSION,
+                  .section_count = static_cast<uint32_t>(sections.size()) };
+    std::vector<PackSectionEntry> entries;
+    entries.reserve(sections.size());
+    uint64_t offset =
+      sizeof(PackHeader) + sizeof(PackSectionEntry) * sections.size();
+    for (const auto &section : sections) {
+        offset = align_offset(offset);
+        entries.emplace_back(PackSectionEntry{ .section = section.section,
+                                               .record_size =
+                                                 section.record_size,
+                                               .offset = offset,
+                                               .size = section.size });
+        offset += section.size;
+    }
+
+    // Sections are padded up to their offset with zeros
+    std::vector<std::byte> bytes(offset);
+    std::memcpy(bytes.data(), &header, sizeof(PackHeader));
+    std::memcpy(
+      bytes.data() + sizeof(PackHeader),
+      entries.data(),
+      sizeof(PackSectionEntry) * entries.size()
+    );
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (sections[i].size > 0) {
+            std::memcpy(
+              bytes.data() + entries[i].offset,
+              sections[i].data,
+              sections[i].size
+            );
+        }
+    }
+    if (!utils::write_file_atomically(filepath, bytes)) {
+        spdlog::error("Failed to write scene pack: {}", filepath.string());
+        return false;
+    }
+    return true;
+}
+
+std::optional<ScenePack>
+ScenePack::open(const std::filesystem::path &filepath)
+{
+    auto file = MappedFile::open(filepath);
+    if (!file.has_value()) {
+        return std::nullopt;
+    }
+    const auto bytes = file->get_bytes();
+
+    PackHeader header;
+    if (bytes.size() < sizeof(PackHeader)) {
+        spdlog::error("Not a scene pack: {}", filepath.string());
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(PackHeader));
+    if (header.magic != SCENE_PACK_MAGIC) {
+        spdlog::error("Not a scene pack: {}", filepath.string());
+        return std::nullopt;
+    }
+    if (header.version != SCENE_PACK_VERSION) {
+        spdlog::error(
+          "Scene pack {} is version {} but version {} is required, cook it "
+          "again with kovra-cook",
+          filepath.string(),
+          header.version,
+          SCENE_PACK_VERSION
+        );
+        return std::nullopt;
+    }
+    if (!is_range_valid(
+          sizeof(PackHeader),
+          sizeof(PackSectionEntry) *
+            static_cast<uint64_t>(header.section_count),
+          bytes.size()
+        )) {
+        spdlog::error("Scene pack section table is truncated");
+        return std::nullopt;
+    }
+
+    auto pack = ScenePack{ std::move(file.value()) };
+    std::array<bool, static_cast<size_t>(PackSection::Count)> found{};
+    for (uint32_t i = 0; i < header.section_count; i++) {
+        PackSectionEntry entry;
+        std::memcpy(
+          &entry,
+          bytes.data() + sizeof(PackHeader) + sizeof(PackSectionEntry) * i,
+          sizeof(PackSectionEntry)
+        );
+        if (entry.section >= PackSection::Count ||
+            !is_range_valid(entry.offset, entry.size, bytes.size()) ||
+            entry.offset % SCENE_PACK_ALIGNMENT != 0 ||
+            entry.record_size == 0 || entry.size % entry.record_size != 0) {
+            spdlog::error("Scene pack section {} is invalid", i);
+            return std::nullopt;
+        }
+        found[static_cast<size_t>(entry.section)] = true;
+
+        // Views the records of the section in place, if they have the size
+        // this build expects
+        const auto *data = bytes.data() + entry.offset;
+        const auto view = [&entry, data]<typename T>(std::span<const T> &span) {
+            if (entry.record_size != sizeof(T)) {
+                return false;
+            }
+            span = { reinterpret_cast<const T *>(data),
+                     entry.size / sizeof(T) };
+            return true;
+        };
+        bool valid = true;
+        switch (entry.section) {
+            case PackSection::Strings:
+                pack.strings = { reinterpret_cast<const char *>(data),
+                                 entry.size };
+                break;
+            case PackSection::Samplers:
+                valid = view(pack.samplers);
+                break;
+            case PackSection::Textures:
+                valid = view(pack.textures);
+                break;
+            case PackSection::TextureData:
+                valid = view(pack.texture_data);
+                break;
+            case PackSection::Materials:
+                valid = view(pack.materials);
+                break;
+            case PackSection::MaterialData:
+                valid = view(pack.material_data);
+                break;
+            case PackSection::Meshes:
+                valid = view(pack.meshes);
+                break;
+            case PackSection::Surfaces:
+                valid = view(pack.surfaces);
+                break;
+            case PackSection::Vertices:
+                valid = view(pack.vertices);
+                break;
+            case PackSection::Indices:
+                valid = view(pack.indices);
+                break;
+            case PackSection::Nodes:
+                valid = view(pack.nodes);
+                break;
+            case PackSection::NodeChildren:
+                valid = view(pack.node_children);
+                break;
+            case PackSection::Count:
+                valid = false;
+                break;
+        }
+        if (!valid) {
+            spdlog::error(
+              "Scene pack section {} has records of {} bytes, which this "
+              "build does not read",
+              i,
+              entry.record_size
+            );
+            return std::nullopt;
+        }
+    }
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+        spdlog::error("Scene pack is missing sections: {}", filepath.string());
+        return std::nullopt;
+    }
+
+    if (!pack.validate()) {
+        spdlog::error("Scene pack is corrupt: {}", filepath.string());
+        return std::nullopt;
+    }
+    return pack;
+}
+
+bool
+ScenePack::validate() const
+{
+    for (const auto &texture : textures) {
+        if (get_format_block(texture.format).size == 0 ||
+            texture.width == 0 || texture.height == 0 ||
+            texture.level_count == 0 ||
+            texture.level_count >
+              get_full_level_count(texture.width, texture.height) ||
+            !is_range_valid(
+              texture.data_offset, texture.data_size, texture_data.size()
+            )) {
+            return false;
+        }
+        uint64_t size = 0;
+        for (uint32_t level = 0; level < texture.level_count; level++) {
+            size += get_level_size(
+              texture.format,
+              std::max(texture.width >> level, 1u),
+              std::max(texture.height >> level, 1u)
+            );
+        }
+        if (size != texture.data_size) {
+            return false;
+        }
+    }
+
+    const auto is_ref_valid = [this](const PackTextureRef &ref) {
+        return ref.texture < static_cast<int64_t>(textures.size()) &&
+               ref.sampler < static_cast<int64_t>(samplers.size());
+    };
+    if (materials.size() != material_data.size()) {
+        return false;
+    }
+    for (const auto &material : materials) {
+        if (!is_ref_valid(material.albedo) ||
+            !is_ref_valid(material.metal_rough) ||
+            !is_ref_valid(material.ambient_occlusion) ||
+            !is_ref_valid(material.emissive)) {
+            return false;
+        }
+    }
+
+    for (const auto &mesh : meshes) {
+        if (!is_range_valid(mesh.name_offset, mesh.name_size, strings.size()) ||
+            !is_range_valid(
+              mesh.first_surface, mesh.surface_count, surfaces.size()
+            ) ||
+            !is_range_valid(
+              mesh.first_vertex, mesh.vertex_count, vertices.size()
+            ) ||
+            !is_range_valid(mesh.first_index, mesh.index_count, indices.size()
+            )) {
+            return false;
+        }
+        for (const auto &surface : get_surfaces(mesh)) {
+            if (!is_range_valid(
+                  surface.start_index, surface.count, mesh.index_count
+                ) ||
+                surface.material >= materials.size()) {
+                return false;
+            }
+        }
+    }
+
+    for (const auto &node : nodes) {
+        if (node.mesh >= static_cast<int64_t>(meshes.size()) ||
+            !is_range_valid(
+              node.first_child, node.child_count, node_children.size()
+            )) {
+            return false;
+        }
+    }
+    for (const uint32_t child : node_children) {
+        if (child >= nodes.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace kovra
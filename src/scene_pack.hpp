@@ -0,0 +1,284 @@
+#pragma once
+
+#include "gpu_data.hpp"
+#include "mapped_file.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Scene packs are glTF scenes cooked by kovra-cook into the layout the
+// renderer uploads, so loading one is a matter of mapping the file and
+// copying each section to staging memory
+//
+// The file starts with a PackHeader and a table of PackSectionEntry, followed
+// by the sections. Every section is an array of one of the records below and
+// starts on a SCENE_PACK_ALIGNMENT boundary, so the records can be read in
+// place. All values are little-endian.
+constexpr std::array<char, 8> SCENE_PACK_MAGIC = { 'K', 'O', 'V', 'R',
+                                                   'A', 'P', 'K', '\0' };
+// Bump whenever the layout of a record changes, packs are not converted
+constexpr uint32_t SCENE_PACK_VERSION = 2;
+constexpr uint64_t SCENE_PACK_ALIGNMENT = 16;
+constexpr std::string_view SCENE_PACK_EXTENSION = ".kpack";
+
+enum class PackSection : uint32_t
+{
+    // Mesh names, referenced by offset and size
+    Strings,
+    Samplers,
+    Textures,
+    // Mip chains of every texture
+    TextureData,
+    Materials,
+    // GpuPbrMaterialData of every material, copied to the material buffer as
+    // is
+    MaterialData,
+    Meshes,
+    Surfaces,
+    // GpuVertexData of every mesh
+    Vertices,
+    // Indices of every mesh, relative to the first vertex of the mesh
+    Indices,
+    Nodes,
+    // Node indices, referenced by each node's child range
+    NodeChildren,
+    Count,
+};
+
+struct PackHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t section_count;
+};
+static_assert(sizeof(PackHeader) == 16);
+
+struct PackSectionEntry
+{
+    PackSection section;
+    // Size of one record, checked against the size the reader expects
+    uint32_t record_size;
+    uint64_t offset;
+    uint64_t size;
+};
+static_assert(sizeof(PackSectionEntry) == 24);
+
+struct PackSampler
+{
+    vk::Filter mag_filter;
+    vk::Filter min_filter;
+    vk::SamplerMipmapMode mipmap_mode;
+    uint32_t _padding;
+};
+static_assert(sizeof(PackSampler) == 16);
+
+struct PackTexture
+{
+    vk::Format format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    // Range in the TextureData section, levels packed from the largest to
+    // the smallest
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+static_assert(sizeof(PackTexture) == 32);
+
+// Negative indices fall back to the renderer's defaults
+struct PackTextureRef
+{
+    int32_t texture;
+    int32_t sampler;
+};
+
+enum class PackMaterialPass : uint32_t
+{
+    Opaque,
+    Transparent,
+};
+
+struct PackMaterial
+{
+    PackMaterialPass pass;
+    PackTextureRef albedo;
+    PackTextureRef metal_rough;
+    PackTextureRef ambient_occlusion;
+    PackTextureRef emissive;
+    // Nonzero for alpha tested materials, the cutoff is in the z component
+    // of the material's metal_rough_factors
+    uint32_t alpha_mask;
+};
+static_assert(sizeof(PackMaterial) == 40);
+
+struct PackMesh
+{
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t first_surface;
+    uint32_t surface_count;
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t first_index;
+    uint32_t index_count;
+};
+static_assert(sizeof(PackMesh) == 32);
+
+struct PackSurface
+{
+    // Relative to the first index of the mesh
+    uint32_t start_index;
+    uint32_t count;
+    uint32_t material;
+    uint32_t _padding;
+    glm::vec3 origin;
+    float sphere_radius;
+    glm::vec3 extents;
+    float _padding2;
+};
+static_assert(sizeof(PackSurface) == 48);
+
+struct PackNode
+{
+    glm::mat4 local_transform;
+    // Negative for nodes without a mesh
+    int32_t mesh;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint32_t _padding;
+};
+static_assert(sizeof(PackNode) == 80);
+
+// Everything kovra-cook writes to a pack
+struct ScenePackContents
+{
+    std::string strings;
+    std::vector<PackSampler> samplers;
+    std::vector<PackTexture> textures;
+    std::vector<std::byte> texture_data;
+    std::vector<PackMaterial> materials;
+    std::vector<GpuPbrMaterialData> material_data;
+    std::vector<PackMesh> meshes;
+    std::vector<PackSurface> surfaces;
+    std::vector<GpuVertexData> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<PackNode> nodes;
+    std::vector<uint32_t> node_children;
+};
+
+bool
+write_scene_pack(
+  const std::filesystem::path &filepath,
+  const ScenePackContents &contents
+);
+
+// Mapped scene pack whose sections are read in place
+// Every range and index in the records is checked when the pack is opened,
+// but the vertex indices themselves are not
+class ScenePack
+{
+  public:
+    [[nodiscard]] static std::optional<ScenePack> open(
+      const std::filesystem::path &filepath
+    );
+
+    [[nodiscard]] static bool is_scene_pack(
+      const std::filesystem::path &filepath
+    )
+    {
+        return filepath.extension() == SCENE_PACK_EXTENSION;
+    }
+
+    [[nodiscard]] std::span<const PackSampler> get_samplers() const noexcept
+    {
+        return samplers;
+    }
+    [[nodiscard]] std::span<const PackTexture> get_textures() const noexcept
+    {
+        return textures;
+    }
+    [[nodiscard]] std::span<const std::byte> get_texture_data(
+      const PackTexture &texture
+    ) const noexcept
+    {
+        return texture_data.subspan(texture.data_offset, texture.data_size);
+    }
+    [[nodiscard]] std::span<const PackMaterial> get_materials() const noexcept
+    {
+        return materials;
+    }
+    [[nodiscard]] std::span<const GpuPbrMaterialData> get_material_data(
+    ) const noexcept
+    {
+        return material_data;
+    }
+    [[nodiscard]] std::span<const PackMesh> get_meshes() const noexcept
+    {
+        return meshes;
+    }
+    [[nodiscard]] std::string_view get_name(const PackMesh &mesh
+    ) const noexcept
+    {
+        return strings.substr(mesh.name_offset, mesh.name_size);
+    }
+    [[nodiscard]] std::span<const PackSurface> get_surfaces(
+      const PackMesh &mesh
+    ) const noexcept
+    {
+        return surfaces.subspan(mesh.first_surface, mesh.surface_count);
+    }
+    [[nodiscard]] std::span<const GpuVertexData> get_vertices(
+      const PackMesh &mesh
+    ) const noexcept
+    {
+        return vertices.subspan(mesh.first_vertex, mesh.vertex_count);
+    }
+    [[nodiscard]] std::span<const uint32_t> get_indices(const PackMesh &mesh
+    ) const noexcept
+    {
+        return indices.subspan(mesh.first_index, mesh.index_count);
+    }
+    [[nodiscard]] std::span<const PackNode> get_nodes() const noexcept
+    {
+        return nodes;
+    }
+    [[nodiscard]] std::span<const uint32_t> get_children(const PackNode &node
+    ) const noexcept
+    {
+        return node_children.subspan(node.first_child, node.child_count);
+    }
+
+  private:
+    explicit ScenePack(MappedFile &&file) noexcept
+      : file{ std::move(file) }
+    {
+    }
+
+    [[nodiscard]] bool validate() const;
+
+    MappedFile file;
+
+    std::string_view strings;
+    std::span<const PackSampler> samplers;
+    std::span<const PackTexture> textures;
+    std::span<const std::byte> texture_data;
+    std::span<const PackMaterial> materials;
+    std::span<const GpuPbrMaterialData> material_data;
+    std::span<const PackMesh> meshes;
+    std::span<const PackSurface> surfaces;
+    std::span<const GpuVertexData> vertices;
+    std::span<const uint32_t> indices;
+    std::span<const PackNode> nodes;
+    std::span<const uint32_t> node_children;
+};
+} // namespace kovra
@@ -1,81 +1,115 @@
 #include "shader.hpp"
+#include "embedded_shaders.hpp"
+#include "utils.hpp"
 #include "spdlog/spdlog.h"
-#include <filesystem>
-#include <fstream>
+#include <cstring>
 
 namespace kovra {
-GraphicsShader::GraphicsShader(
-  const std::string &name,
-  const vk::Device &device
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+ShaderModuleCache::ShaderModuleCache(
+  const vk::Device &device,
+  std::optional<std::filesystem::path> override_dir
 )
+  : device{ device }
+  , override_dir{ std::move(override_dir) }
 {
-    // Construct files paths for the vertex and fragment shaders
-    std::filesystem::path vert_filepath{ SHADERBUILD_DIR };
-    vert_filepath.append(name + ".vert.spv");
-    std::filesystem::path frag_filepath{ SHADERBUILD_DIR };
-    frag_filepath.append(name + ".frag.spv");
-
-    // Read vertex shader SPIR-V
-    std::vector<char> vert_spv;
-    std::ifstream vert_file{ vert_filepath, std::ios::binary };
-    if (!vert_file.is_open()) {
-        spdlog::error(
-          "Failed to open vertex shader file: {}", vert_filepath.string()
+    if (this->override_dir.has_value()) {
+        spdlog::info(
+          "Loading shaders from {} before the embedded ones",
+          this->override_dir->string()
         );
-        throw std::runtime_error("Failed to open vertex shader file");
     }
-    vert_spv.assign(
-      std::istreambuf_iterator<char>(vert_file),
-      std::istreambuf_iterator<char>()
-    );
+}
+
+vk::ShaderModule
+ShaderModuleCache::get(const std::string &name)
+{
+    std::lock_guard lock{ mutex };
+    if (const auto it = modules_by_name.find(name);
+        it != modules_by_name.end()) {
+        return it->second;
+    }
 
-    // Read fragment shader SPIR-V
-    std::vector<char> frag_spv;
-    std::ifstream frag_file{ frag_filepath, std::ios::binary };
-    if (!frag_file.is_open()) {
-        spdlog::error(
-          "Failed to open fragment shader file: {}", frag_filepath.string()
+    const auto override_spv = read_override(name);
+    std::span<const uint32_t> spv = override_spv;
+    if (spv.empty()) {
+        const auto embedded_spv = find_embedded_shader(name);
+        if (!embedded_spv.has_value()) {
+            spdlog::error("Shader not found: {}", name);
+            throw std::runtime_error("Shader not found");
+        }
+        spv = embedded_spv.value();
+    }
+
+    const uint64_t hash = utils::hash_bytes(std::as_bytes(spv));
+    auto it = modules.find(hash);
+    if (it == modules.end()) {
+        auto module = device.createShaderModuleUnique(
+          vk::ShaderModuleCreateInfo{}
+            .setCodeSize(spv.size_bytes())
+            .setPCode(spv.data())
         );
-        throw std::runtime_error("Failed to open fragment shader file");
+        it = modules.emplace(hash, std::move(module)).first;
+    }
+    modules_by_name.emplace(name, it->second.get());
+    return it->second.get();
+}
+
+std::vector<uint32_t>
+ShaderModuleCache::read_override(const std::string &name) const
+{
+    if (!override_dir.has_value()) {
+        return {};
+    }
+    const auto filepath = *override_dir / (name + ".spv");
+    if (!std::filesystem::exists(filepath)) {
+        return {};
     }
-    frag_spv.assign(
-      std::istreambuf_iterator<char>(frag_file),
-      std::istreambuf_iterator<char>()
-    );
 
-    // Create shader modules
-    vert_shader_mod =
-      device.createShaderModuleUnique(vk::ShaderModuleCreateInfo(
-        vk::ShaderModuleCreateFlags(),
-        vert_spv.size(),
-        reinterpret_cast<const uint32_t *>(vert_spv.data())
-      ));
-    frag_shader_mod =
-      device.createShaderModuleUnique(vk::ShaderModuleCreateInfo(
-        vk::ShaderModuleCreateFlags(),
-        frag_spv.size(),
-        reinterpret_cast<const uint32_t *>(frag_spv.data())
-      ));
+    const auto bytes = utils::read_file(filepath);
+    std::vector<uint32_t> spv;
+    if (bytes.has_value() && bytes->size() % sizeof(uint32_t) == 0) {
+        spv.resize(bytes->size() / sizeof(uint32_t));
+        std::memcpy(spv.data(), bytes->data(), bytes->size());
+    }
+    if (spv.empty() || spv[0] != SPIRV_MAGIC) {
+        spdlog::warn(
+          "Ignoring invalid SPIR-V, using the embedded shader: {}",
+          filepath.string()
+        );
+        return {};
+    }
+    spdlog::debug("Loaded shader {} from {}", name, filepath.string());
+    return spv;
 }
 
-ComputeShader::ComputeShader(const std::string &name, const vk::Device &device)
+GraphicsShader::GraphicsShader(
+  const std::string &name,
+  ShaderModuleCache &modules
+)
+  : GraphicsShader{ name, name, modules }
 {
-    // Construct file path for the compute shader
-    std::filesystem::path filepath{ SHADERBUILD_DIR };
-    filepath.append(name + ".comp.spv");
+}
 
-    // Read compute shader SPIR-V
-    std::vector<char> spv;
-    std::ifstream file{ filepath, std::ios::binary };
-    spv.assign(
-      std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
-    );
+GraphicsShader::GraphicsShader(
+  const std::string &vert_name,
+  const std::optional<std::string> &frag_name,
+  ShaderModuleCache &modules
+)
+  : vert_shader_mod{ modules.get(vert_name + ".vert") }
+{
+    // Depth-only shaders have no fragment shader
+    if (frag_name.has_value()) {
+        frag_shader_mod = modules.get(frag_name.value() + ".frag");
+    }
+}
 
-    // Create shader module
-    shader_mod = device.createShaderModuleUnique(vk::ShaderModuleCreateInfo(
-      vk::ShaderModuleCreateFlags(),
-      spv.size(),
-      reinterpret_cast<const uint32_t *>(spv.data())
-    ));
+ComputeShader::ComputeShader(
+  const std::string &name,
+  ShaderModuleCache &modules
+)
+  : shader_mod{ modules.get(name + ".comp") }
+{
 }
 } // namespace kovra
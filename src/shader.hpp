@@ -1,39 +1,90 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
-static constexpr const char *SHADERBUILD_DIR = "./shaderbuild";
+// Set to a directory of SPIR-V files (e.g. ./shaderbuild) to load shaders from
+// there instead of the ones embedded in the executable, so shaders can be
+// recompiled without rebuilding
+// Shaders that aren't in the directory fall back to the embedded ones.
+static constexpr const char *SHADER_DIR_ENV_VAR = "KOVRA_SHADER_DIR";
+
+// Shader modules of the device, created the first time a shader is requested
+// Shaders with the same SPIR-V share a module. Modules live as long as the
+// cache. Safe to use from several threads.
+class ShaderModuleCache
+{
+  public:
+    ShaderModuleCache(
+      const vk::Device &device,
+      std::optional<std::filesystem::path> override_dir = std::nullopt
+    );
+    ShaderModuleCache() = delete;
+    ShaderModuleCache(const ShaderModuleCache &) = delete;
+    ShaderModuleCache &operator=(const ShaderModuleCache &) = delete;
+
+    // Module of a shader by the name of its source file, e.g. "pbr.frag"
+    [[nodiscard]] vk::ShaderModule get(const std::string &name);
+
+  private:
+    const vk::Device &device;
+    const std::optional<std::filesystem::path> override_dir;
+    std::mutex mutex;
+    std::unordered_map<std::string, vk::ShaderModule> modules_by_name;
+    // By the hash of the SPIR-V
+    std::unordered_map<uint64_t, vk::UniqueShaderModule> modules;
+
+    // SPIR-V of the shader in the override directory, empty if there is none
+    [[nodiscard]] std::vector<uint32_t> read_override(const std::string &name
+    ) const;
+};
 
 class GraphicsShader
 {
   public:
-    GraphicsShader(const std::string &name, const vk::Device &device);
+    GraphicsShader(const std::string &name, ShaderModuleCache &modules);
+    // Pair a vertex shader with a fragment shader of a different name
+    // Depth-only shaders have no fragment shader (frag_name is std::nullopt)
+    GraphicsShader(
+      const std::string &vert_name,
+      const std::optional<std::string> &frag_name,
+      ShaderModuleCache &modules
+    );
 
     [[nodiscard]] vk::ShaderModule get_vert_shader_mod() const
     {
-        return vert_shader_mod.get();
+        return vert_shader_mod;
     }
+    // Null if the shader is depth-only
     [[nodiscard]] vk::ShaderModule get_frag_shader_mod() const
     {
-        return frag_shader_mod.get();
+        return frag_shader_mod;
     }
 
   private:
-    vk::UniqueShaderModule vert_shader_mod;
-    vk::UniqueShaderModule frag_shader_mod;
+    // Owned by the module cache
+    vk::ShaderModule vert_shader_mod;
+    vk::ShaderModule frag_shader_mod;
 };
 
 class ComputeShader
 {
   public:
-    ComputeShader(const std::string &name, const vk::Device &device);
+    ComputeShader(const std::string &name, ShaderModuleCache &modules);
     [[nodiscard]] vk::ShaderModule get_shader_mod() const
     {
-        return shader_mod.get();
+        return shader_mod;
     }
 
   private:
-    vk::UniqueShaderModule shader_mod;
+    // Owned by the module cache
+    vk::ShaderModule shader_mod;
 };
 } // namespace kovra
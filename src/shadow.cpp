@@ -0,0 +1,239 @@
+#include "shadow.hpp"
+#include "camera.hpp"
+#include "device.hpp"
+#include "image.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "spdlog/spdlog.h"
+
+namespace kovra {
+// Blend between logarithmic (1.0) and uniform (0.0) cascade splits
+static constexpr float CASCADE_SPLIT_LAMBDA = 0.75f;
+// Cached cascades cover this much more than they need to, so the camera can
+// move a bit before they have to be re-rendered
+static constexpr float CACHED_CASCADE_MARGIN = 0.2f;
+// Distance behind a cascade that still casts shadows into it
+static constexpr float SHADOW_CASTER_DISTANCE = 50.0f;
+
+// Bounding sphere of the part of the view frustum between near and far
+static std::pair<glm::vec3, float>
+frustum_slice_bounds(
+  const Camera &camera,
+  float aspect_ratio,
+  float near,
+  float far
+)
+{
+    const glm::mat4 inv_view = glm::inverse(camera.get_view_mat());
+    const float tan_half_fov =
+      std::tan(glm::radians(camera.get_fov_y_deg()) / 2.0f);
+
+    std::array<glm::vec3, 8> corners;
+    size_t corner_count = 0;
+    for (const float depth : { near, far }) {
+        const float half_height = depth * tan_half_fov;
+        const float half_width = half_height * aspect_ratio;
+        for (const float x : { -half_width, half_width }) {
+            for (const float y : { -half_height, half_height }) {
+                corners[corner_count++] =
+                  glm::vec3(inv_view * glm::vec4(x, y, -depth, 1.0f));
+            }
+        }
+    }
+
+    glm::vec3 center{ 0.0f };
+    for (const auto &corner : corners) {
+        center += corner;
+    }
+    center /= static_cast<float>(corners.size());
+
+    float radius = 0.0f;
+    for (const auto &corner : corners) {
+        radius = std::max(radius, glm::length(corner - center));
+    }
+    // Keep the radius stable across frames so the cascade doesn't shimmer
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    return { center, radius };
+}
+
+// Orthographic light matrix that covers the given bounding sphere
+static glm::mat4
+cascade_viewproj(
+  const glm::vec3 &center,
+  float radius,
+  const glm::vec3 &sun_direction
+)
+{
+    const glm::vec3 up = std::abs(sun_direction.y) > 0.99f
+                           ? glm::vec3(0.0f, 0.0f, 1.0f)
+                           : glm::vec3(0.0f, 1.0f, 0.0f);
+    const float eye_distance = radius + SHADOW_CASTER_DISTANCE;
+    const glm::mat4 view =
+      glm::lookAt(center - sun_direction * eye_distance, center, up);
+    glm::mat4 proj =
+      glm::ortho(-radius, radius, -radius, radius, 0.0f, eye_distance + radius);
+
+    // Snap the cascade to whole texels so it doesn't shimmer when the camera
+    // moves
+    const glm::vec4 origin = proj * view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    const glm::vec2 origin_texels =
+      glm::vec2(origin) * (static_cast<float>(SHADOW_MAP_SIZE) / 2.0f);
+    const glm::vec2 offset = (glm::round(origin_texels) - origin_texels) *
+                             (2.0f / static_cast<float>(SHADOW_MAP_SIZE));
+    proj[3][0] += offset.x;
+    proj[3][1] += offset.y;
+
+    return proj * view;
+}
+
+ShadowMap::ShadowMap(const Device &device)
+  : image{ device.create_image(GpuImageCreateInfo{
+      .format = SHADOW_MAP_FORMAT,
+      .extent = vk::Extent3D{ SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1 },
+      .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment |
+               vk::ImageUsageFlagBits::eSampled,
+      .aspect = vk::ImageAspectFlagBits::eDepth,
+      .view_type = vk::ImageViewType::e2DArray,
+      .mipmapped = false,
+      .sampler = std::nullopt,
+      .array_layers = SHADOW_CASCADE_COUNT }) }
+  , sampler{ device.get().createSamplerUnique(
+      vk::SamplerCreateInfo{}
+        .setMagFilter(vk::Filter::eLinear)
+        .setMinFilter(vk::Filter::eLinear)
+        .setAddressModeU(vk::SamplerAddressMode::eClampToBorder)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToBorder)
+        .setAddressModeW(vk::SamplerAddressMode::eClampToBorder)
+        .setBorderColor(vk::BorderColor::eFloatOpaqueWhite)
+        .setCompareEnable(vk::True)
+        .setCompareOp(vk::CompareOp::eLessOrEqual)
+    ) }
+{
+    spdlog::debug("ShadowMap::ShadowMap()");
+
+    // Each cascade is rendered through its own view
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        cascade_views[i] = device.get().createImageViewUnique(
+          vk::ImageViewCreateInfo{}
+            .setImage(image->get())
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(image->get_format())
+            .setSubresourceRange(
+              vk::ImageSubresourceRange{}
+                .setAspectMask(vk::ImageAspectFlagBits::eDepth)
+                .setBaseMipLevel(0)
+                .setLevelCount(1)
+                .setBaseArrayLayer(i)
+                .setLayerCount(1)
+            )
+        );
+    }
+
+    // The shadow map is always bound to the scene descriptor set, even
+    // before any cascade has been rendered
+    device.immediate_submit([&](vk::CommandBuffer cmd) {
+        image->transition_layout(
+          cmd,
+          vk::ImageLayout::eUndefined,
+          vk::ImageLayout::eShaderReadOnlyOptimal
+        );
+    });
+}
+
+ShadowMap::~ShadowMap()
+{
+    spdlog::debug("ShadowMap::~ShadowMap()");
+    sampler.reset();
+    for (auto &view : cascade_views) {
+        view.reset();
+    }
+    image.reset();
+}
+
+void
+ShadowMap::update(
+  const Camera &camera,
+  float aspect_ratio,
+  const glm::vec3 &sun_direction,
+  size_t scene_hash,
+  uint32_t frame_number
+)
+{
+    const glm::vec3 direction = glm::normalize(sun_direction);
+    if (direction != this->sun_direction) {
+        invalidate();
+        this->sun_direction = direction;
+    }
+    const bool scene_changed = scene_hash != this->scene_hash;
+    this->scene_hash = scene_hash;
+
+    // Split the view frustum between the near plane and the max shadow
+    // distance
+    const float near = camera.get_near();
+    const float far = std::min(camera.get_far(), MAX_SHADOW_DISTANCE);
+    float cascade_near = near;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        const float t = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+        const float log_split = near * std::pow(far / near, t);
+        const float uniform_split = near + (far - near) * t;
+        const float cascade_far = CASCADE_SPLIT_LAMBDA * log_split +
+                                  (1.0f - CASCADE_SPLIT_LAMBDA) * uniform_split;
+        splits[i] = cascade_far;
+
+        auto [center, radius] =
+          frustum_slice_bounds(camera, aspect_ratio, cascade_near, cascade_far);
+        cascade_near = cascade_far;
+
+        auto &cascade = cascades[i];
+        if (i < FIRST_CACHED_CASCADE) {
+            cascade.dirty = true;
+        } else {
+            cascade.scene_changed = cascade.scene_changed || scene_changed;
+            // The slice must stay inside the area the cached cascade covers
+            const bool camera_left =
+              glm::length(center - cascade.center) + radius > cascade.radius;
+            // Stagger refreshes so cached cascades don't all render on the
+            // same frame
+            const bool refresh_due =
+              cascade.scene_changed &&
+              (frame_number + i) % CACHED_CASCADE_REFRESH_INTERVAL == 0;
+            if (camera_left || refresh_due) {
+                cascade.dirty = true;
+            }
+            radius *= 1.0f + CACHED_CASCADE_MARGIN;
+        }
+
+        if (cascade.dirty) {
+            cascade.center = center;
+            cascade.radius = radius;
+            cascade.viewproj = cascade_viewproj(center, radius, direction);
+        }
+    }
+}
+
+void
+ShadowMap::invalidate() noexcept
+{
+    for (auto &cascade : cascades) {
+        cascade.dirty = true;
+    }
+}
+
+void
+ShadowMap::mark_rendered(uint32_t cascade) noexcept
+{
+    cascades.at(cascade).dirty = false;
+    cascades.at(cascade).scene_changed = false;
+}
+
+std::array<glm::mat4, SHADOW_CASCADE_COUNT>
+ShadowMap::get_viewprojs() const noexcept
+{
+    std::array<glm::mat4, SHADOW_CASCADE_COUNT> viewprojs;
+    for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+        viewprojs[i] = cascades[i].viewproj;
+    }
+    return viewprojs;
+}
+} // namespace kovra
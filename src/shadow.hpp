@@ -0,0 +1,103 @@
+#pragma once
+
+#include "gpu_data.hpp"
+
+#include <array>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class Camera;
+class Device;
+class GpuImage;
+
+// Resolution of each cascade
+static constexpr uint32_t SHADOW_MAP_SIZE = 2048;
+static constexpr vk::Format SHADOW_MAP_FORMAT = vk::Format::eD32Sfloat;
+// Shadows are not drawn past this view-space depth
+static constexpr float MAX_SHADOW_DISTANCE = 100.0f;
+// Cascades from this index on are cached
+static constexpr uint32_t FIRST_CACHED_CASCADE = 2;
+// Cached cascades pick up scene changes at most once every N frames
+static constexpr uint32_t CACHED_CASCADE_REFRESH_INTERVAL = 8;
+
+// Cascaded shadow map of the sun, one array layer per cascade
+// The near cascades are re-rendered every frame. The far cascades keep the
+// light matrix they were last rendered with, and are only re-rendered when the
+// sun moves, when the camera leaves the area they cover, or (at most every
+// CACHED_CASCADE_REFRESH_INTERVAL frames) when the scene changes.
+class ShadowMap
+{
+  public:
+    explicit ShadowMap(const Device &device);
+    ~ShadowMap();
+    ShadowMap() = delete;
+    ShadowMap(const ShadowMap &) = delete;
+    ShadowMap &operator=(const ShadowMap &) = delete;
+    ShadowMap(ShadowMap &&) = delete;
+    ShadowMap &operator=(ShadowMap &&) = delete;
+
+    // Decide which cascades to render this frame and update their matrices
+    // scene_hash should change whenever anything that casts shadows changes
+    void update(
+      const Camera &camera,
+      float aspect_ratio,
+      const glm::vec3 &sun_direction,
+      size_t scene_hash,
+      uint32_t frame_number
+    );
+    // Re-render every cascade on the next update
+    void invalidate() noexcept;
+    void mark_rendered(uint32_t cascade) noexcept;
+
+    [[nodiscard]] bool needs_render(uint32_t cascade) const noexcept
+    {
+        return cascades.at(cascade).dirty;
+    }
+    [[nodiscard]] const GpuImage &get_image() const noexcept
+    {
+        return *image;
+    }
+    [[nodiscard]] GpuImage &get_image_mut() noexcept { return *image; }
+    [[nodiscard]] vk::ImageView get_cascade_view(uint32_t cascade
+    ) const noexcept
+    {
+        return cascade_views.at(cascade).get();
+    }
+    // Depth comparison sampler
+    [[nodiscard]] vk::Sampler get_sampler() const noexcept
+    {
+        return sampler.get();
+    }
+    [[nodiscard]] const glm::mat4 &get_viewproj(uint32_t cascade
+    ) const noexcept
+    {
+        return cascades.at(cascade).viewproj;
+    }
+    [[nodiscard]] std::array<glm::mat4, SHADOW_CASCADE_COUNT> get_viewprojs(
+    ) const noexcept;
+    [[nodiscard]] glm::vec4 get_splits() const noexcept { return splits; }
+
+  private:
+    struct Cascade
+    {
+        glm::mat4 viewproj = glm::mat4(1.0f);
+        // Bounding sphere of the area covered by the cascade
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        bool dirty = true;
+        // Set when the scene changed since the cascade was last rendered
+        bool scene_changed = false;
+    };
+
+    std::unique_ptr<GpuImage> image;
+    std::array<vk::UniqueImageView, SHADOW_CASCADE_COUNT> cascade_views;
+    vk::UniqueSampler sampler;
+
+    std::array<Cascade, SHADOW_CASCADE_COUNT> cascades;
+    glm::vec4 splits = glm::vec4(0.0f);
+    glm::vec3 sun_direction = glm::vec3(0.0f);
+    size_t scene_hash = 0;
+};
+} // namespace kovra
@@ -0,0 +1,113 @@
+#include "staging_ring.hpp"
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+
+namespace kovra {
+// Keeps every copy source aligned for any texel size
+static constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(vk::DeviceSize capacity, const Device &device)
+  : buffer{ device.create_buffer(
+      capacity,
+      vk::BufferUsageFlagBits::eTransferSrc,
+      VMA_MEMORY_USAGE_CPU_ONLY,
+      VMA_ALLOCATION_CREATE_MAPPED_BIT
+    ) }
+  , capacity{ capacity }
+{
+    spdlog::debug("StagingRing::StagingRing()");
+}
+
+StagingRing::~StagingRing()
+{
+    spdlog::debug("StagingRing::~StagingRing()");
+    buffer.reset();
+}
+
+std::optional<vk::DeviceSize>
+StagingRing::allocate(vk::DeviceSize size, uint64_t token)
+{
+    if (size == 0 || size > capacity) {
+        return std::nullopt;
+    }
+    if (allocations.empty()) {
+        head = 0;
+        tail = 0;
+    }
+
+    const auto aligned_head =
+      (head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    std::optional<vk::DeviceSize> offset;
+    if (allocations.empty() || head > tail) {
+        // Free space runs from the head to the end, then from the start to
+        // the tail
+        if (aligned_head + size <= capacity) {
+            offset = aligned_head;
+        } else if (size <= tail) {
+            offset = 0;
+        }
+    } else if (aligned_head + size <= tail) {
+        // Wrapped around, so the only free space is between head and tail
+        offset = aligned_head;
+    }
+    if (!offset.has_value()) {
+        return std::nullopt;
+    }
+
+    allocations.emplace_back(Allocation{
+      .begin = offset.value(), .end = offset.value() + size, .token = token });
+    head = offset.value() + size;
+    return offset;
+}
+
+void
+StagingRing::write(vk::DeviceSize offset, const void *data, vk::DeviceSize size)
+{
+    buffer->write(data, size, offset);
+}
+
+std::span<std::byte>
+StagingRing::get_memory(vk::DeviceSize offset, vk::DeviceSize size) const
+{
+    return { static_cast<std::byte *>(buffer->get_mapped_data()) + offset,
+             static_cast<size_t>(size) };
+}
+
+void
+StagingRing::set_token(vk::DeviceSize offset, uint64_t token)
+{
+    // Usually one of the newest allocations
+    const auto it = std::find_if(
+      allocations.rbegin(),
+      allocations.rend(),
+      [offset](const Allocation &allocation) {
+          return allocation.begin == offset;
+      }
+    );
+    if (it == allocations.rend()) {
+        spdlog::error("No staging allocation at offset {}", offset);
+        throw std::runtime_error("Invalid staging allocation");
+    }
+    it->token = token;
+}
+
+void
+StagingRing::release(uint64_t completed_token)
+{
+    while (!allocations.empty() &&
+           allocations.front().token <= completed_token) {
+        allocations.pop_front();
+    }
+    tail = allocations.empty() ? head : allocations.front().begin;
+}
+
+vk::Buffer
+StagingRing::get_buffer() const noexcept
+{
+    return buffer->get();
+}
+} // namespace kovra
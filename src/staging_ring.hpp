@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class Device;
+class GpuBuffer;
+
+// Persistently mapped host-visible buffer that staging memory is carved out
+// of in FIFO order
+// Every allocation is tagged with the upload token of the batch that reads
+// it, and is given back once that token is complete.
+class StagingRing
+{
+  public:
+    StagingRing(vk::DeviceSize capacity, const Device &device);
+    ~StagingRing();
+    StagingRing() = delete;
+    StagingRing(const StagingRing &) = delete;
+    StagingRing &operator=(const StagingRing &) = delete;
+
+    // Offset of size free bytes, or nullopt if the ring is too full
+    [[nodiscard]] std::optional<vk::DeviceSize> allocate(
+      vk::DeviceSize size,
+      uint64_t token
+    );
+    void write(vk::DeviceSize offset, const void *data, vk::DeviceSize size);
+    // Mapped memory of an allocation, to fill it in place
+    [[nodiscard]] std::span<std::byte> get_memory(
+      vk::DeviceSize offset,
+      vk::DeviceSize size
+    ) const;
+    // Move the allocation at offset to the batch of another token
+    void set_token(vk::DeviceSize offset, uint64_t token);
+    // Give back the allocations of every token up to completed_token
+    void release(uint64_t completed_token);
+
+    [[nodiscard]] vk::Buffer get_buffer() const noexcept;
+    [[nodiscard]] vk::DeviceSize get_capacity() const noexcept
+    {
+        return capacity;
+    }
+    [[nodiscard]] bool is_empty() const noexcept
+    {
+        return allocations.empty();
+    }
+
+  private:
+    std::unique_ptr<GpuBuffer> buffer;
+    const vk::DeviceSize capacity;
+    // Next free byte
+    vk::DeviceSize head = 0;
+    // First byte still in use (equal to head when the ring is empty)
+    vk::DeviceSize tail = 0;
+
+    struct Allocation
+    {
+        vk::DeviceSize begin;
+        vk::DeviceSize end;
+        uint64_t token;
+    };
+    // Oldest first
+    std::deque<Allocation> allocations;
+};
+} // namespace kovra
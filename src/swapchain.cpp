@@ -1,5 +1,4 @@
 #include "swapchain.hpp"
-#include "image.hpp"
 #include "spdlog/spdlog.h"
 
 namespace kovra {
@@ -71,10 +70,8 @@ Swapchain::Swapchain(
         .setImageColorSpace(color_space)
         .setImageExtent(extent)
         .setImageArrayLayers(1)
-        .setImageUsage(
-          vk::ImageUsageFlagBits::eColorAttachment |
-          vk::ImageUsageFlagBits::eTransferDst
-        )
+        // Only written by the composite pass and ImGui
+        .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
         .setImageSharingMode(sharing_mode)
         .setQueueFamilyIndices(queue_family_indices)
         .setQueueFamilyIndexCount(
@@ -107,17 +104,11 @@ Swapchain::Swapchain(
             )
         ));
     }
-
-    // Depth image
-    depth_image = device.create_depth_image(
-      extent.width, extent.height, std::nullopt, false
-    );
 }
 
 Swapchain::~Swapchain()
 {
     spdlog::debug("Swapchain::~Swapchain()");
-    depth_image.reset();
     views.clear();
     images.clear();
     swapchain.reset();
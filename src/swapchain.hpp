@@ -39,10 +39,6 @@ class Swapchain
     {
         return present_mode;
     }
-    [[nodiscard]] const GpuImage &get_depth_image() const
-    {
-        return *depth_image;
-    }
 
     void request_resize() noexcept { dirty = true; }
     bool is_dirty() const noexcept { return dirty; }
@@ -56,8 +52,6 @@ class Swapchain
     vk::ColorSpaceKHR color_space;
     vk::PresentModeKHR present_mode;
 
-    std::unique_ptr<GpuImage> depth_image;
-
     bool dirty = false;
 };
 } // namespace kovra
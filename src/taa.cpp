@@ -0,0 +1,87 @@
+#include "taa.hpp"
+#include "camera.hpp"
+#include "device.hpp"
+#include "frame.hpp"
+#include "image.hpp"
+
+#include "spdlog/spdlog.h"
+
+namespace kovra {
+TemporalAntiAliasing::TemporalAntiAliasing(const Device &device)
+  : device{ device }
+{
+    spdlog::debug("TemporalAntiAliasing::TemporalAntiAliasing()");
+}
+
+TemporalAntiAliasing::~TemporalAntiAliasing()
+{
+    spdlog::debug("TemporalAntiAliasing::~TemporalAntiAliasing()");
+    for (auto &image : images) {
+        image.reset();
+    }
+}
+
+void
+TemporalAntiAliasing::begin_frame(
+  vk::Extent2D image_extent,
+  vk::Extent2D draw_extent,
+  uint32_t frame_number,
+  const glm::mat4 &viewproj
+)
+{
+    if (image_extent != this->image_extent) {
+        this->image_extent = image_extent;
+        allocate_images();
+    }
+    this->draw_extent = draw_extent;
+    this->viewproj = viewproj;
+    jitter = Camera::get_jitter(
+      frame_number,
+      TAA_JITTER_PHASE_COUNT,
+      static_cast<float>(draw_extent.width),
+      static_cast<float>(draw_extent.height)
+    );
+}
+
+void
+TemporalAntiAliasing::end_frame() noexcept
+{
+    prev_viewproj = viewproj;
+    history_draw_extent = draw_extent;
+    history_valid = true;
+    output_index = 1 - output_index;
+}
+
+glm::vec2
+TemporalAntiAliasing::get_history_uv_scale() const noexcept
+{
+    return glm::vec2(history_draw_extent.width, history_draw_extent.height) /
+           glm::vec2(image_extent.width, image_extent.height);
+}
+
+void
+TemporalAntiAliasing::allocate_images()
+{
+    // The previous frames may still read the old images
+    auto &timeline = device.get_frame_timeline();
+    for (auto &image : images) {
+        if (image) {
+            timeline.defer_destroy(
+              [old = std::shared_ptr<GpuImage>(std::move(image))]() mutable {
+                  old.reset();
+              }
+            );
+        }
+        image = device.create_image(GpuImageCreateInfo{
+          .format = DRAW_IMAGE_FORMAT,
+          .extent =
+            vk::Extent3D{ image_extent.width, image_extent.height, 1 },
+          .usage = vk::ImageUsageFlagBits::eStorage |
+                   vk::ImageUsageFlagBits::eSampled,
+          .aspect = vk::ImageAspectFlagBits::eColor,
+          .mipmapped = false,
+          .sampler = std::nullopt });
+    }
+    history_valid = false;
+}
+} // namespace kovra
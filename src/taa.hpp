@@ -0,0 +1,92 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <memory>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Forward declarations
+class Device;
+class GpuImage;
+
+// UV offset of every pixel since the previous frame, written by the forward
+// opaque pass
+// Must match the motion output of shaders/pbr-motion.frag
+static constexpr vk::Format MOTION_VECTOR_FORMAT = vk::Format::eR16G16Sfloat;
+// Jitter offsets cycled through before the pattern repeats
+static constexpr uint32_t TAA_JITTER_PHASE_COUNT = 8;
+
+// History of temporal anti-aliasing
+// Every frame is drawn with its projection jittered by a different sub-pixel
+// offset, then blended with the history of earlier frames, reprojected with
+// motion vectors, so edges converge to a supersampled result over a few
+// frames at the cost of a single sample per pixel.
+// Two images take turns: each frame reads the history from one and writes
+// its result to the other, which is also what gets presented. They are as
+// large as the swapchain, and the history keeps the draw extent it was drawn
+// at, so changing the render scale doesn't discard it.
+class TemporalAntiAliasing
+{
+  public:
+    explicit TemporalAntiAliasing(const Device &device);
+    ~TemporalAntiAliasing();
+    TemporalAntiAliasing() = delete;
+    TemporalAntiAliasing(const TemporalAntiAliasing &) = delete;
+    TemporalAntiAliasing &operator=(const TemporalAntiAliasing &) = delete;
+    TemporalAntiAliasing(TemporalAntiAliasing &&) = delete;
+    TemporalAntiAliasing &operator=(TemporalAntiAliasing &&) = delete;
+
+    // Pick the jitter of a frame drawn at draw_extent, and remember its
+    // viewproj (without jitter) for the next frame
+    // The images are reallocated and the history discarded if image_extent
+    // changed.
+    void begin_frame(
+      vk::Extent2D image_extent,
+      vk::Extent2D draw_extent,
+      uint32_t frame_number,
+      const glm::mat4 &viewproj
+    );
+    // The output of the frame has been written and becomes the history of
+    // the next frame
+    void end_frame() noexcept;
+    // Discard the history, e.g. when it wasn't kept up to date
+    void reset() noexcept { history_valid = false; }
+
+    // Jitter of the current frame in NDC
+    [[nodiscard]] glm::vec2 get_jitter() const noexcept { return jitter; }
+    // Viewproj (without jitter) the history was drawn with
+    [[nodiscard]] const glm::mat4 &get_prev_viewproj() const noexcept
+    {
+        return history_valid ? prev_viewproj : viewproj;
+    }
+    [[nodiscard]] bool has_history() const noexcept { return history_valid; }
+    // Scales UVs of the previous frame to UVs of the history image
+    [[nodiscard]] glm::vec2 get_history_uv_scale() const noexcept;
+    [[nodiscard]] const GpuImage &get_history() const noexcept
+    {
+        return *images.at(1 - output_index);
+    }
+    [[nodiscard]] const GpuImage &get_output() const noexcept
+    {
+        return *images.at(output_index);
+    }
+
+  private:
+    const Device &device;
+    std::array<std::unique_ptr<GpuImage>, 2> images;
+    // Image the current frame writes to
+    uint32_t output_index = 0;
+    bool history_valid = false;
+
+    vk::Extent2D image_extent{ 0, 0 };
+    vk::Extent2D draw_extent{ 0, 0 };
+    vk::Extent2D history_draw_extent{ 0, 0 };
+    glm::vec2 jitter = glm::vec2(0.0f);
+    glm::mat4 viewproj = glm::mat4(1.0f);
+    glm::mat4 prev_viewproj = glm::mat4(1.0f);
+
+    void allocate_images();
+};
+} // namespace kovra
@@ -0,0 +1,103 @@
+#include "timeline.hpp"
+
+#include "spdlog/spdlog.h"
+
+namespace kovra {
+FrameTimeline::FrameTimeline(const vk::Device &device)
+  : device{ device }
+{
+    spdlog::debug("FrameTimeline::FrameTimeline()");
+
+    auto type_ci = vk::SemaphoreTypeCreateInfo{}
+                     .setSemaphoreType(vk::SemaphoreType::eTimeline)
+                     .setInitialValue(0);
+    semaphore =
+      device.createSemaphoreUnique(vk::SemaphoreCreateInfo{}.setPNext(&type_ci)
+      );
+}
+
+FrameTimeline::~FrameTimeline()
+{
+    spdlog::debug("FrameTimeline::~FrameTimeline()");
+    if (!deferred_destroys.empty()) {
+        spdlog::warn(
+          "{} deferred destructions were never collected",
+          deferred_destroys.size()
+        );
+    }
+    semaphore.reset();
+}
+
+uint64_t
+FrameTimeline::get_completed_value() const
+{
+    return device.getSemaphoreCounterValue(semaphore.get());
+}
+
+uint64_t
+FrameTimeline::advance() noexcept
+{
+    return ++pending_value;
+}
+
+void
+FrameTimeline::wait(uint64_t value) const
+{
+    // Nothing to wait for before the first submission
+    if (value == 0) {
+        return;
+    }
+    const auto semaphores = std::array{ semaphore.get() };
+    const auto values = std::array{ value };
+    const auto result = device.waitSemaphores(
+      vk::SemaphoreWaitInfo{}.setSemaphores(semaphores).setValues(values),
+      UINT64_MAX
+    );
+    if (result != vk::Result::eSuccess) {
+        spdlog::error(
+          "Failed to wait for frame timeline value {}: {}",
+          value,
+          vk::to_string(result)
+        );
+        throw std::runtime_error("Failed to wait for frame timeline");
+    }
+}
+
+void
+FrameTimeline::defer_destroy(std::function<void()> &&destroy)
+{
+    std::lock_guard lock{ deferred_mutex };
+    deferred_destroys.emplace_back(
+      DeferredDestroy{ pending_value.load(), std::move(destroy) }
+    );
+}
+
+void
+FrameTimeline::collect()
+{
+    // Run outside the lock in case a destructor defers more work
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard lock{ deferred_mutex };
+        if (deferred_destroys.empty()) {
+            return;
+        }
+        const auto completed_value = get_completed_value();
+        while (!deferred_destroys.empty() &&
+               deferred_destroys.front().value <= completed_value) {
+            ready.emplace_back(std::move(deferred_destroys.front().destroy));
+            deferred_destroys.pop_front();
+        }
+    }
+    for (auto &destroy : ready) {
+        destroy();
+    }
+}
+
+void
+FrameTimeline::flush()
+{
+    wait(pending_value.load());
+    collect();
+}
+} // namespace kovra
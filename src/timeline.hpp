@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra {
+// Timeline semaphore signaled by every frame submitted to the graphics queue
+// Each submission signals the next value, so a single number tells how far
+// the GPU has come. Frames wait on the value of their previous submission,
+// and resources that may still be in use can be queued for destruction until
+// all work submitted so far has finished.
+class FrameTimeline
+{
+  public:
+    explicit FrameTimeline(const vk::Device &device);
+    ~FrameTimeline();
+    FrameTimeline() = delete;
+    FrameTimeline(const FrameTimeline &) = delete;
+    FrameTimeline &operator=(const FrameTimeline &) = delete;
+
+    [[nodiscard]] vk::Semaphore get() const noexcept
+    {
+        return semaphore.get();
+    }
+    // Value signaled by the last submission handed out by advance()
+    [[nodiscard]] uint64_t get_pending_value() const noexcept
+    {
+        return pending_value.load();
+    }
+    // Value the GPU has finished signaling
+    [[nodiscard]] uint64_t get_completed_value() const;
+
+    // Reserve the value the next submission must signal
+    // Submissions must be made in the order their values were handed out
+    [[nodiscard]] uint64_t advance() noexcept;
+    // Block until the GPU has signaled the given value
+    void wait(uint64_t value) const;
+    // Destroy a resource once all work submitted so far has finished
+    void defer_destroy(std::function<void()> &&destroy);
+    // Run the deferred destructions whose submissions have finished
+    void collect();
+    // Wait for all submitted work, then run every deferred destruction
+    void flush();
+
+  private:
+    const vk::Device device;
+    vk::UniqueSemaphore semaphore;
+    std::atomic<uint64_t> pending_value = 0;
+
+    struct DeferredDestroy
+    {
+        uint64_t value;
+        std::function<void()> destroy;
+    };
+    // Ordered by value since values only increase
+    std::deque<DeferredDestroy> deferred_destroys;
+    std::mutex deferred_mutex;
+};
+} // namespace kovra
@@ -0,0 +1,783 @@
+#include "upload_queue.hpp"
+#include "buffer.hpp"
+#include "descriptor.hpp"
+#include "device.hpp"
+#include "format.hpp"
+#include "image.hpp"
+#include "staging_ring.hpp"
+#include "utils.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <limits>
+
+namespace kovra {
+static vk::UniqueSemaphore
+create_timeline_semaphore(const vk::Device &device)
+{
+    auto type_ci = vk::SemaphoreTypeCreateInfo{}
+                     .setSemaphoreType(vk::SemaphoreType::eTimeline)
+                     .setInitialValue(0);
+    return device.createSemaphoreUnique(
+      vk::SemaphoreCreateInfo{}.setPNext(&type_ci)
+    );
+}
+
+UploadQueue::UploadQueue(
+  const Device &device,
+  vk::DeviceSize staging_ring_size
+)
+  : device{ device }
+  , transfer_semaphore{ create_timeline_semaphore(device.get()) }
+  , compute_semaphore{ create_timeline_semaphore(device.get()) }
+  , graphics_semaphore{ create_timeline_semaphore(device.get()) }
+  , transfer_command_pool{ device.get().createCommandPoolUnique(
+      vk::CommandPoolCreateInfo{}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(device.get_transfer_family_index())
+    ) }
+  , compute_command_pool{ device.get().createCommandPoolUnique(
+      vk::CommandPoolCreateInfo{}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(device.get_compute_family_index())
+    ) }
+  , graphics_command_pool{ device.get().createCommandPoolUnique(
+      vk::CommandPoolCreateInfo{}
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(device.get_graphics_family_index())
+    ) }
+  , staging_ring{ std::make_unique<StagingRing>(staging_ring_size, device) }
+  , mip_generator{ std::make_unique<MipGenerator>(
+      device.get(),
+      device.get_shader_modules(),
+      device.get_pipeline_build_queue()
+    ) }
+{
+    spdlog::debug("UploadQueue::UploadQueue()");
+}
+
+UploadQueue::~UploadQueue()
+{
+    spdlog::debug("UploadQueue::~UploadQueue()");
+    if (!pending_buffers.empty() || !pending_images.empty()) {
+        spdlog::warn("Destroying upload queue with pending uploads");
+    }
+    // The staging ring and command buffers must outlive their batches
+    wait(submitted_token.load());
+    in_flight_batches.clear();
+    mip_generator.reset();
+    staging_ring.reset();
+    graphics_command_pool.reset();
+    compute_command_pool.reset();
+    transfer_command_pool.reset();
+    graphics_semaphore.reset();
+    compute_semaphore.reset();
+    transfer_semaphore.reset();
+}
+
+UploadToken
+UploadQueue::enqueue_buffer(
+  const void *data,
+  vk::DeviceSize size,
+  const GpuBuffer &dst,
+  vk::DeviceSize dst_offset
+)
+{
+    std::unique_lock lock{ mutex };
+    const auto *bytes = static_cast<const std::byte *>(data);
+    UploadToken token = 0;
+    for (vk::DeviceSize copied = 0; copied < size;) {
+        const auto chunk_size = std::min(size - copied, get_max_chunk_size());
+        const auto src_offset = stage(lock, bytes + copied, chunk_size);
+        pending_buffers.emplace_back(BufferUpload{
+          .dst = dst.get(),
+          .region = vk::BufferCopy{}
+                      .setSrcOffset(src_offset)
+                      .setDstOffset(dst_offset + copied)
+                      .setSize(chunk_size),
+          .last = copied + chunk_size == size });
+        copied += chunk_size;
+        token = flush_if_full();
+    }
+    return token;
+}
+
+UploadToken
+UploadQueue::enqueue_buffer(
+  size_t element_count,
+  size_t element_size,
+  const GpuBuffer &dst,
+  const StagingWriter &write,
+  vk::DeviceSize dst_offset
+)
+{
+    // Staging memory that is still being written must not be released by
+    // batches that complete in the meantime
+    constexpr auto WRITING_TOKEN = std::numeric_limits<UploadToken>::max();
+    const size_t chunk_element_count =
+      std::max<size_t>(get_max_chunk_size() / element_size, 1);
+
+    std::unique_lock lock{ mutex };
+    UploadToken token = 0;
+    for (size_t first = 0; first < element_count;) {
+        const size_t count =
+          std::min(element_count - first, chunk_element_count);
+        const vk::DeviceSize chunk_size = count * element_size;
+        const auto src_offset = allocate_staging(lock, chunk_size);
+        staging_ring->set_token(src_offset, WRITING_TOKEN);
+        open_write_count++;
+
+        lock.unlock();
+        try {
+            write(
+              staging_ring->get_memory(src_offset, chunk_size), first, count
+            );
+        } catch (...) {
+            // Token zero is always complete, so the memory is given back
+            lock.lock();
+            staging_ring->set_token(src_offset, 0);
+            open_write_count--;
+            write_finished.notify_all();
+            throw;
+        }
+        lock.lock();
+        open_write_count--;
+        write_finished.notify_all();
+
+        // Goes out with whichever batch is pending now
+        staging_ring->set_token(src_offset, submitted_token.load() + 1);
+        pending_size += chunk_size;
+        stats.bytes_written_in_place += chunk_size;
+        pending_buffers.emplace_back(BufferUpload{
+          .dst = dst.get(),
+          .region = vk::BufferCopy{}
+                      .setSrcOffset(src_offset)
+                      .setDstOffset(dst_offset + first * element_size)
+                      .setSize(chunk_size),
+          .last = first + count == element_count });
+        first += count;
+        token = flush_if_full();
+    }
+    return token;
+}
+
+UploadToken
+UploadQueue::enqueue_image(
+  const void *data,
+  GpuImage &dst,
+  bool mipmapped,
+  uint32_t texel_size,
+  uint32_t level_count,
+  const MipGenerationInfo &mip_info
+)
+{
+    std::unique_lock lock{ mutex };
+    const auto *bytes = static_cast<const std::byte *>(data);
+    const auto extent = dst.get_extent();
+    const auto layer_count = static_cast<uint32_t>(dst.get_layer_count());
+    const auto max_chunk_size = get_max_chunk_size();
+
+    // Block-compressed formats are copied in rows of 4x4 blocks
+    const uint32_t block_extent = get_format_block(dst.get_format()).extent;
+    const bool compute_mips =
+      mipmapped && dst.get_level_count() > 1 &&
+      MipGenerator::supports(dst.get_format()) &&
+      static_cast<bool>(dst.get_usage() & vk::ImageUsageFlagBits::eStorage);
+
+    // Whole levels are copied at once if they fit in a chunk, otherwise every
+    // layer is copied a few rows at a time
+    std::vector<std::pair<vk::DeviceSize, vk::BufferImageCopy>> chunks;
+    for (uint32_t mip = 0; mip < level_count; mip++) {
+        const uint32_t width = std::max(extent.width >> mip, 1u);
+        const uint32_t height = std::max(extent.height >> mip, 1u);
+        const uint32_t block_rows = (height + block_extent - 1) / block_extent;
+        const vk::DeviceSize row_size =
+          static_cast<vk::DeviceSize>((width + block_extent - 1) / block_extent
+          ) *
+          texel_size;
+        const vk::DeviceSize layer_size = row_size * block_rows;
+        if (row_size > max_chunk_size) {
+            spdlog::error(
+              "Image row of {} bytes does not fit in the staging ring",
+              row_size
+            );
+            throw std::runtime_error("Image too large to upload");
+        }
+
+        const auto region = vk::BufferImageCopy{}.setImageSubresource(
+          vk::ImageSubresourceLayers{}
+            .setAspectMask(dst.get_aspect())
+            .setMipLevel(mip)
+            .setBaseArrayLayer(0)
+            .setLayerCount(layer_count)
+        );
+        if (layer_size * layer_count <= max_chunk_size) {
+            chunks.emplace_back(
+              layer_size * layer_count,
+              vk::BufferImageCopy{ region }.setImageExtent(
+                vk::Extent3D{ width, height, 1 }
+              )
+            );
+            continue;
+        }
+
+        const auto rows_per_chunk =
+          static_cast<uint32_t>(max_chunk_size / row_size);
+        for (uint32_t layer = 0; layer < layer_count; layer++) {
+            for (uint32_t row = 0; row < block_rows; row += rows_per_chunk) {
+                const uint32_t rows =
+                  std::min(rows_per_chunk, block_rows - row);
+                // The last chunk of a level may end in a partial block
+                const uint32_t y = row * block_extent;
+                const uint32_t chunk_height =
+                  std::min(rows * block_extent, height - y);
+                auto chunk =
+                  vk::BufferImageCopy{ region }
+                    .setImageOffset(
+                      vk::Offset3D{ 0, static_cast<int32_t>(y), 0 }
+                    )
+                    .setImageExtent(vk::Extent3D{ width, chunk_height, 1 });
+                chunk.imageSubresource.setBaseArrayLayer(layer).setLayerCount(
+                  1
+                );
+                chunks.emplace_back(row_size * rows, chunk);
+            }
+        }
+    }
+
+    UploadToken token = 0;
+    vk::DeviceSize src_offset = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const auto &[chunk_size, region] = chunks[i];
+        const auto staged_offset =
+          stage(lock, bytes + src_offset, chunk_size);
+        pending_images.emplace_back(ImageUpload{
+          .dst = &dst,
+          .region = vk::BufferImageCopy{ region }.setBufferOffset(staged_offset
+          ),
+          .first = i == 0,
+          .last = i == chunks.size() - 1,
+          .mipmapped = mipmapped,
+          .compute_mips = compute_mips,
+          .mip_info = mip_info });
+        src_offset += chunk_size;
+        token = flush_if_full();
+    }
+    return token;
+}
+
+UploadToken
+UploadQueue::flush()
+{
+    std::lock_guard lock{ mutex };
+    if (!is_submit_thread()) {
+        return submitted_token.load();
+    }
+    return flush_locked();
+}
+
+bool
+UploadQueue::is_complete(UploadToken token) const
+{
+    return token <=
+           device.get().getSemaphoreCounterValue(graphics_semaphore.get());
+}
+
+void
+UploadQueue::wait(UploadToken token)
+{
+    if (token > submitted_token.load()) {
+        if (is_submit_thread()) {
+            flush();
+        } else {
+            std::unique_lock lock{ mutex };
+            batch_submitted.wait(lock, [&] {
+                return submitted_token.load() >= token;
+            });
+        }
+    }
+    wait_for_token(token);
+}
+
+UploadToken
+UploadQueue::get_pending_token() const
+{
+    std::lock_guard lock{ mutex };
+    const bool has_pending =
+      !pending_buffers.empty() || !pending_images.empty();
+    return submitted_token.load() + (has_pending ? 1 : 0);
+}
+
+void
+UploadQueue::wait_for_token(UploadToken token) const
+{
+    if (token == 0) {
+        return;
+    }
+
+    const auto semaphores = std::array{ graphics_semaphore.get() };
+    const auto values = std::array{ token };
+    const auto result = device.get().waitSemaphores(
+      vk::SemaphoreWaitInfo{}.setSemaphores(semaphores).setValues(values),
+      UINT64_MAX
+    );
+    if (result != vk::Result::eSuccess) {
+        spdlog::error(
+          "Failed to wait for upload {}: {}", token, vk::to_string(result)
+        );
+        throw std::runtime_error("Failed to wait for upload");
+    }
+}
+
+UploadStats
+UploadQueue::get_stats() const
+{
+    std::lock_guard lock{ mutex };
+    return stats;
+}
+
+vk::DeviceSize
+UploadQueue::get_max_chunk_size() const noexcept
+{
+    // Leaves room for other batches while a large upload streams through
+    return staging_ring->get_capacity() / 4;
+}
+
+vk::DeviceSize
+UploadQueue::allocate_staging(
+  std::unique_lock<std::mutex> &lock,
+  vk::DeviceSize size
+)
+{
+    for (;;) {
+        retire_batches();
+        const auto offset =
+          staging_ring->allocate(size, submitted_token.load() + 1);
+        if (offset.has_value()) {
+            return offset.value();
+        }
+
+        // Submit what is pending so its memory can be given back, then wait
+        // for the oldest batch
+        const bool has_pending =
+          !pending_buffers.empty() || !pending_images.empty();
+        if (has_pending && is_submit_thread()) {
+            flush_locked();
+            continue;
+        }
+        if (!in_flight_batches.empty()) {
+            // Unlocked so other threads can keep enqueuing and flushing
+            stats.stall_count++;
+            const auto token = in_flight_batches.front().token;
+            lock.unlock();
+            wait_for_token(token);
+            lock.lock();
+            continue;
+        }
+        if (has_pending) {
+            // Only the submit thread can hand the pending batch to the GPU
+            stats.stall_count++;
+            const auto token = submitted_token.load();
+            batch_submitted.wait(lock, [&] {
+                return submitted_token.load() > token;
+            });
+            continue;
+        }
+        if (open_write_count > 0) {
+            // Woken up for every chunk, the loop tries again each time
+            stats.stall_count++;
+            write_finished.wait(lock);
+            continue;
+        }
+        spdlog::error("Staging ring cannot fit {} bytes", size);
+        throw std::runtime_error("Staging ring too small");
+    }
+}
+
+vk::DeviceSize
+UploadQueue::stage(
+  std::unique_lock<std::mutex> &lock,
+  const void *data,
+  vk::DeviceSize size
+)
+{
+    const auto offset = allocate_staging(lock, size);
+    staging_ring->write(offset, data, size);
+    pending_size += size;
+    return offset;
+}
+
+UploadToken
+UploadQueue::flush_if_full()
+{
+    const auto token = submitted_token.load() + 1;
+    if (pending_size >= UPLOAD_BATCH_SIZE && is_submit_thread()) {
+        flush_locked();
+    }
+    return token;
+}
+
+UploadToken
+UploadQueue::flush_locked()
+{
+    retire_batches();
+    if (pending_buffers.empty() && pending_images.empty()) {
+        return submitted_token.load();
+    }
+
+    auto batch = Batch{ .token = submitted_token.load() + 1 };
+    uint32_t mip_dispatch_count = 0;
+    for (const auto &upload : pending_images) {
+        if (upload.last && upload.compute_mips) {
+            mip_dispatch_count +=
+              MipGenerator::get_dispatch_count(*upload.dst);
+        }
+    }
+    if (mip_dispatch_count > 0) {
+        batch.mip_desc_alloc = std::make_unique<DescriptorAllocator>(
+          device.get(),
+          mip_dispatch_count,
+          std::vector{ DescriptorPoolSizeRatio{
+            vk::DescriptorType::eStorageImage,
+            1.0f + MipGenerator::LEVELS_PER_DISPATCH } }
+        );
+    }
+    const bool async_mips =
+      mip_dispatch_count > 0 && device.has_async_compute();
+
+    batch.transfer_cmd = allocate_command_buffer(transfer_command_pool.get());
+    record_transfer(batch.transfer_cmd.get());
+    if (async_mips) {
+        batch.compute_cmd =
+          allocate_command_buffer(compute_command_pool.get());
+        record_compute(batch.compute_cmd.get(), batch);
+    }
+    batch.graphics_cmd = allocate_command_buffer(graphics_command_pool.get());
+    record_graphics(batch.graphics_cmd.get(), batch);
+
+    // Copy on the transfer queue
+    const auto transfer_cmds = std::array{ batch.transfer_cmd.get() };
+    const auto transfer_semaphores = std::array{ transfer_semaphore.get() };
+    const auto transfer_values = std::array{ batch.token };
+    auto transfer_timeline_info =
+      vk::TimelineSemaphoreSubmitInfo{}.setSignalSemaphoreValues(
+        transfer_values
+      );
+    device.get_transfer_queue().submit(
+      vk::SubmitInfo{}
+        .setCommandBuffers(transfer_cmds)
+        .setSignalSemaphores(transfer_semaphores)
+        .setPNext(&transfer_timeline_info)
+    );
+
+    // Generate mipmaps on the async compute queue once the copies are done
+    const auto compute_semaphores = std::array{ compute_semaphore.get() };
+    const auto wait_stages = std::array<vk::PipelineStageFlags, 2>{
+        vk::PipelineStageFlagBits::eAllCommands,
+        vk::PipelineStageFlagBits::eAllCommands
+    };
+    if (async_mips) {
+        const auto compute_cmds = std::array{ batch.compute_cmd.get() };
+        auto compute_timeline_info =
+          vk::TimelineSemaphoreSubmitInfo{}
+            .setWaitSemaphoreValues(transfer_values)
+            .setSignalSemaphoreValues(transfer_values);
+        device.get_compute_queue().submit(
+          vk::SubmitInfo{}
+            .setWaitSemaphores(transfer_semaphores)
+            .setWaitDstStageMask(wait_stages[0])
+            .setCommandBuffers(compute_cmds)
+            .setSignalSemaphores(compute_semaphores)
+            .setPNext(&compute_timeline_info)
+        );
+    }
+
+    // Acquire on the graphics queue once the copies and mipmaps are done
+    const auto graphics_cmds = std::array{ batch.graphics_cmd.get() };
+    const auto graphics_semaphores = std::array{ graphics_semaphore.get() };
+    const auto graphics_wait_semaphores =
+      std::array{ transfer_semaphore.get(), compute_semaphore.get() };
+    const auto graphics_wait_values = std::array{ batch.token, batch.token };
+    // The compute semaphore is only waited on when it gets signaled
+    const uint32_t graphics_wait_count = async_mips ? 2 : 1;
+    auto graphics_timeline_info =
+      vk::TimelineSemaphoreSubmitInfo{}
+        .setWaitSemaphoreValueCount(graphics_wait_count)
+        .setPWaitSemaphoreValues(graphics_wait_values.data())
+        .setSignalSemaphoreValues(transfer_values);
+    device.get_graphics_queue().submit(
+      vk::SubmitInfo{}
+        .setWaitSemaphoreCount(graphics_wait_count)
+        .setPWaitSemaphores(graphics_wait_semaphores.data())
+        .setPWaitDstStageMask(wait_stages.data())
+        .setCommandBuffers(graphics_cmds)
+        .setSignalSemaphores(graphics_semaphores)
+        .setPNext(&graphics_timeline_info)
+    );
+
+    stats.submit_count++;
+    stats.copy_count += pending_buffers.size() + pending_images.size();
+    stats.bytes_uploaded += pending_size;
+
+    pending_size = 0;
+    pending_buffers.clear();
+    pending_images.clear();
+    submitted_token = batch.token;
+    in_flight_batches.emplace_back(std::move(batch));
+    batch_submitted.notify_all();
+    return submitted_token.load();
+}
+
+uint32_t
+UploadQueue::get_mip_family_index() const noexcept
+{
+    return device.has_async_compute() ? device.get_compute_family_index()
+                                      : device.get_graphics_family_index();
+}
+
+void
+UploadQueue::record_transfer(vk::CommandBuffer cmd) const
+{
+    // Without a dedicated transfer family the graphics queue already owns
+    // every destination
+    const bool transfer_ownership =
+      device.get_transfer_family_index() != device.get_graphics_family_index();
+    const auto src_family = transfer_ownership
+                              ? device.get_transfer_family_index()
+                              : vk::QueueFamilyIgnored;
+    const auto dst_family = transfer_ownership
+                              ? device.get_graphics_family_index()
+                              : vk::QueueFamilyIgnored;
+    const bool mip_ownership =
+      device.get_transfer_family_index() != get_mip_family_index();
+    const auto staging_buffer = staging_ring->get_buffer();
+
+    cmd.begin(vk::CommandBufferBeginInfo{}.setFlags(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    ));
+
+    for (const auto &upload : pending_buffers) {
+        cmd.copyBuffer(staging_buffer, upload.dst, upload.region);
+        if (transfer_ownership && upload.last) {
+            utils::buffer_barrier(
+              cmd,
+              upload.dst,
+              vk::PipelineStageFlagBits2::eTransfer,
+              vk::AccessFlagBits2::eTransferWrite,
+              vk::PipelineStageFlagBits2::eNone,
+              vk::AccessFlagBits2::eNone,
+              src_family,
+              dst_family
+            );
+        }
+    }
+
+    for (const auto &upload : pending_images) {
+        auto &image = *upload.dst;
+        if (upload.first) {
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eUndefined,
+              vk::ImageLayout::eTransferDstOptimal
+            );
+        }
+        cmd.copyBufferToImage(
+          staging_buffer,
+          image.get(),
+          vk::ImageLayout::eTransferDstOptimal,
+          upload.region
+        );
+        // Mipmaps are written through storage views by whichever queue
+        // generates them
+        if (upload.last && upload.compute_mips) {
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferDstOptimal,
+              vk::ImageLayout::eGeneral,
+              mip_ownership ? device.get_transfer_family_index()
+                            : vk::QueueFamilyIgnored,
+              mip_ownership ? get_mip_family_index() : vk::QueueFamilyIgnored
+            );
+        } else if (upload.last) {
+            // Blits for mipmaps need the graphics queue, so mipmapped images
+            // stay in eTransferDstOptimal until then
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferDstOptimal,
+              upload.mipmapped ? vk::ImageLayout::eTransferDstOptimal
+                               : vk::ImageLayout::eShaderReadOnlyOptimal,
+              src_family,
+              dst_family
+            );
+        }
+    }
+
+    cmd.end();
+}
+
+void
+UploadQueue::record_compute(vk::CommandBuffer cmd, Batch &batch) const
+{
+    const auto transfer_family = device.get_transfer_family_index();
+    const auto compute_family = device.get_compute_family_index();
+    const auto graphics_family = device.get_graphics_family_index();
+
+    cmd.begin(vk::CommandBufferBeginInfo{}.setFlags(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    ));
+
+    for (const auto &upload : pending_images) {
+        if (!upload.last || !upload.compute_mips) {
+            continue;
+        }
+        auto &image = *upload.dst;
+        // Must match the release recorded on the transfer queue
+        if (transfer_family != compute_family) {
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferDstOptimal,
+              vk::ImageLayout::eGeneral,
+              transfer_family,
+              compute_family
+            );
+        }
+        mip_generator->record(
+          cmd, image, upload.mip_info, *batch.mip_desc_alloc, batch.mip_views
+        );
+        image.transition_layout(
+          cmd,
+          vk::ImageLayout::eGeneral,
+          vk::ImageLayout::eShaderReadOnlyOptimal,
+          compute_family,
+          graphics_family
+        );
+    }
+
+    cmd.end();
+}
+
+void
+UploadQueue::record_graphics(vk::CommandBuffer cmd, Batch &batch) const
+{
+    const bool transfer_ownership =
+      device.get_transfer_family_index() != device.get_graphics_family_index();
+    const auto src_family = transfer_ownership
+                              ? device.get_transfer_family_index()
+                              : vk::QueueFamilyIgnored;
+    const auto dst_family = transfer_ownership
+                              ? device.get_graphics_family_index()
+                              : vk::QueueFamilyIgnored;
+    const bool async_mips = static_cast<bool>(batch.compute_cmd);
+
+    cmd.begin(vk::CommandBufferBeginInfo{}.setFlags(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+    ));
+
+    if (transfer_ownership) {
+        for (const auto &upload : pending_buffers) {
+            if (!upload.last) {
+                continue;
+            }
+            utils::buffer_barrier(
+              cmd,
+              upload.dst,
+              vk::PipelineStageFlagBits2::eNone,
+              vk::AccessFlagBits2::eNone,
+              vk::PipelineStageFlagBits2::eAllCommands,
+              vk::AccessFlagBits2::eMemoryRead,
+              src_family,
+              dst_family
+            );
+        }
+    }
+
+    for (const auto &upload : pending_images) {
+        if (!upload.last) {
+            continue;
+        }
+        auto &image = *upload.dst;
+        if (upload.compute_mips && async_mips) {
+            // Must match the release recorded on the compute queue
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eGeneral,
+              vk::ImageLayout::eShaderReadOnlyOptimal,
+              device.get_compute_family_index(),
+              device.get_graphics_family_index()
+            );
+            continue;
+        }
+        if (upload.compute_mips) {
+            if (transfer_ownership) {
+                image.transition_layout(
+                  cmd,
+                  vk::ImageLayout::eTransferDstOptimal,
+                  vk::ImageLayout::eGeneral,
+                  src_family,
+                  dst_family
+                );
+            }
+            mip_generator->record(
+              cmd,
+              image,
+              upload.mip_info,
+              *batch.mip_desc_alloc,
+              batch.mip_views
+            );
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eGeneral,
+              vk::ImageLayout::eShaderReadOnlyOptimal
+            );
+            continue;
+        }
+        // Must match the release recorded on the transfer queue
+        if (transfer_ownership) {
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferDstOptimal,
+              upload.mipmapped ? vk::ImageLayout::eTransferDstOptimal
+                               : vk::ImageLayout::eShaderReadOnlyOptimal,
+              src_family,
+              dst_family
+            );
+        }
+        if (upload.mipmapped) {
+            image.generate_mipmaps(cmd);
+            image.transition_layout(
+              cmd,
+              vk::ImageLayout::eTransferSrcOptimal,
+              vk::ImageLayout::eShaderReadOnlyOptimal
+            );
+        }
+    }
+
+    cmd.end();
+}
+
+void
+UploadQueue::retire_batches()
+{
+    if (in_flight_batches.empty()) {
+        return;
+    }
+    const auto completed_token =
+      device.get().getSemaphoreCounterValue(graphics_semaphore.get());
+    while (!in_flight_batches.empty() &&
+           in_flight_batches.front().token <= completed_token) {
+        in_flight_batches.pop_front();
+    }
+    staging_ring->release(completed_token);
+}
+
+vk::UniqueCommandBuffer
+UploadQueue::allocate_command_buffer(vk::CommandPool pool) const
+{
+    return std::move(device.get().allocateCommandBuffersUnique(
+      vk::CommandBufferAllocateInfo{}
+        .setCommandPool(pool)
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1)
+    )[0]);
+}
+} // namespace kovra
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "mip_generator.hpp"
+
+namespace kovra {
+// Forward declarations
+class DescriptorAllocator;
+class Device;
+class GpuBuffer;
+class GpuImage;
+class StagingRing;
+
+// Identifies the batch an upload was recorded to
+// Batches complete in order, and token zero is always complete
+using UploadToken = uint64_t;
+
+// Writes count elements of an upload, starting at element first, to the
+// staging memory in dst
+using StagingWriter = std::function<
+  void(std::span<std::byte> dst, size_t first, size_t count)>;
+
+// Default size of the staging ring all uploads are copied through
+static constexpr vk::DeviceSize DEFAULT_STAGING_RING_SIZE = 128 * 1024 * 1024;
+// Pending uploads are submitted as soon as they need this much staging memory
+static constexpr vk::DeviceSize UPLOAD_BATCH_SIZE = 32 * 1024 * 1024;
+
+struct UploadStats
+{
+    uint64_t submit_count;
+    uint64_t copy_count;
+    uint64_t bytes_uploaded;
+    // Part of bytes_uploaded that was written to staging memory in place
+    // instead of being copied there from the caller's memory
+    uint64_t bytes_written_in_place;
+    // Times an upload had to wait for the GPU to free staging memory
+    uint64_t stall_count;
+};
+
+// Batches buffer and image uploads into few submissions to the transfer queue
+// Uploads are copied, or written in place, to a persistently mapped staging
+// ring when they are enqueued and recorded together when the batch is
+// flushed. Uploads larger
+// than a quarter of the ring are split into chunks. The graphics queue then
+// takes ownership of the destinations and moves images to
+// eShaderReadOnlyOptimal before the batch token is signaled. Mipmaps are
+// generated on the async compute queue in between when the device has one,
+// and on the graphics queue otherwise.
+// Destinations must stay alive until their token is complete.
+// Uploads can be enqueued from any thread, but only the thread that created
+// the queue submits batches, since it also submits frames to the graphics
+// queue. Other threads that run out of staging memory wait for it to flush.
+class UploadQueue
+{
+  public:
+    UploadQueue(
+      const Device &device,
+      vk::DeviceSize staging_ring_size = DEFAULT_STAGING_RING_SIZE
+    );
+    ~UploadQueue();
+    UploadQueue() = delete;
+    UploadQueue(const UploadQueue &) = delete;
+    UploadQueue &operator=(const UploadQueue &) = delete;
+
+    [[nodiscard]] UploadToken enqueue_buffer(
+      const void *data,
+      vk::DeviceSize size,
+      const GpuBuffer &dst,
+      vk::DeviceSize dst_offset = 0
+    );
+    // Lets write produce the data straight into staging memory, one chunk of
+    // whole elements at a time, so it never has to be stored anywhere else
+    // write runs without the queue locked, so other threads can keep
+    // enqueuing while it converts
+    [[nodiscard]] UploadToken enqueue_buffer(
+      size_t element_count,
+      size_t element_size,
+      const GpuBuffer &dst,
+      const StagingWriter &write,
+      vk::DeviceSize dst_offset = 0
+    );
+    // Expects tightly packed texels for every array layer of each of the
+    // first level_count mip levels, one level after another
+    // For block-compressed formats texel_size is the size of a 4x4 block
+    // Set mipmapped to generate the remaining levels, with the compute
+    // MipGenerator if the image supports it and with blits otherwise
+    [[nodiscard]] UploadToken enqueue_image(
+      const void *data,
+      GpuImage &dst,
+      bool mipmapped = false,
+      uint32_t texel_size = 4,
+      uint32_t level_count = 1,
+      const MipGenerationInfo &mip_info = {}
+    );
+
+    // Submit all pending uploads as one batch
+    // Does nothing when called from a thread other than the submit thread
+    UploadToken flush();
+    [[nodiscard]] bool is_complete(UploadToken token) const;
+    // Block until the token is complete, flushing first if needed
+    void wait(UploadToken token);
+    // Token that completes once everything enqueued so far is uploaded
+    [[nodiscard]] UploadToken get_pending_token() const;
+
+    // Signaled with the token of each batch once its uploads are usable by
+    // the graphics queue
+    [[nodiscard]] vk::Semaphore get_semaphore() const noexcept
+    {
+        return graphics_semaphore.get();
+    }
+    [[nodiscard]] UploadToken get_submitted_token() const noexcept
+    {
+        return submitted_token.load();
+    }
+    [[nodiscard]] UploadStats get_stats() const;
+
+  private:
+    const Device &device;
+    // Signaled when the copies of a batch are done
+    vk::UniqueSemaphore transfer_semaphore;
+    // Signaled when the mipmaps of a batch are generated on the async
+    // compute queue, skips the batches without any
+    vk::UniqueSemaphore compute_semaphore;
+    // Signaled when the graphics queue has acquired the batch
+    vk::UniqueSemaphore graphics_semaphore;
+    vk::UniqueCommandPool transfer_command_pool;
+    vk::UniqueCommandPool compute_command_pool;
+    vk::UniqueCommandPool graphics_command_pool;
+
+    std::unique_ptr<StagingRing> staging_ring;
+    std::unique_ptr<MipGenerator> mip_generator;
+
+    // One chunk of an upload
+    // Ownership is only handed to the graphics queue after the last chunk
+    struct BufferUpload
+    {
+        vk::Buffer dst;
+        vk::BufferCopy region;
+        bool last;
+    };
+    struct ImageUpload
+    {
+        GpuImage *dst;
+        vk::BufferImageCopy region;
+        bool first;
+        bool last;
+        bool mipmapped;
+        // Mipmaps are generated by the MipGenerator instead of blits
+        bool compute_mips;
+        MipGenerationInfo mip_info;
+    };
+    struct Batch
+    {
+        UploadToken token;
+        vk::UniqueCommandBuffer transfer_cmd;
+        // Only allocated for batches that generate mipmaps on the async
+        // compute queue
+        vk::UniqueCommandBuffer compute_cmd;
+        vk::UniqueCommandBuffer graphics_cmd;
+        // Used by the mipmap dispatches until the batch completes
+        std::unique_ptr<DescriptorAllocator> mip_desc_alloc;
+        std::vector<vk::UniqueImageView> mip_views;
+    };
+
+    std::vector<BufferUpload> pending_buffers;
+    std::vector<ImageUpload> pending_images;
+    vk::DeviceSize pending_size = 0;
+    // Submitted batches whose command buffers are still in use
+    std::deque<Batch> in_flight_batches;
+    std::atomic<UploadToken> submitted_token = 0;
+    UploadStats stats{};
+    mutable std::mutex mutex;
+    // Notified whenever a batch is submitted
+    std::condition_variable batch_submitted;
+    // Staging memory that is being written in place holds back the release
+    // of everything allocated after it, so waiting for its writer to finish
+    // may be the only way to make room
+    size_t open_write_count = 0;
+    // Notified whenever a writer finishes its chunk
+    std::condition_variable write_finished;
+    const std::thread::id submit_thread = std::this_thread::get_id();
+
+    [[nodiscard]] vk::DeviceSize get_max_chunk_size() const noexcept;
+    // Allocate staging memory for the next batch, flushing and waiting for
+    // earlier batches if the ring is full
+    [[nodiscard]] vk::DeviceSize allocate_staging(
+      std::unique_lock<std::mutex> &lock,
+      vk::DeviceSize size
+    );
+    // Copy data to the staging ring and return its offset
+    [[nodiscard]] vk::DeviceSize stage(
+      std::unique_lock<std::mutex> &lock,
+      const void *data,
+      vk::DeviceSize size
+    );
+    [[nodiscard]] bool is_submit_thread() const noexcept
+    {
+        return std::this_thread::get_id() == submit_thread;
+    }
+    // Token of the batch the last staged chunk goes out with
+    UploadToken flush_if_full();
+    UploadToken flush_locked();
+    // Queue family that generates mipmaps with compute
+    [[nodiscard]] uint32_t get_mip_family_index() const noexcept;
+    void record_transfer(vk::CommandBuffer cmd) const;
+    void record_compute(vk::CommandBuffer cmd, Batch &batch) const;
+    void record_graphics(vk::CommandBuffer cmd, Batch &batch) const;
+    void wait_for_token(UploadToken token) const;
+    // Give back the staging memory of completed batches
+    void retire_batches();
+    [[nodiscard]] vk::UniqueCommandBuffer allocate_command_buffer(
+      vk::CommandPool pool
+    ) const;
+};
+} // namespace kovra
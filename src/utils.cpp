@@ -1,5 +1,9 @@
 #include "utils.hpp"
 
+#include "spdlog/spdlog.h"
+
+#include <fstream>
+
 namespace kovra {
 namespace utils {
 void
@@ -10,10 +14,12 @@ transition_image_layout(
   vk::ImageLayout old_layout,
   vk::ImageLayout new_layout,
   int layer_count,
-  int level_count
+  int level_count,
+  uint32_t src_queue_family,
+  uint32_t dst_queue_family
 )
 {
-    if (old_layout == new_layout) {
+    if (old_layout == new_layout && src_queue_family == dst_queue_family) {
         return;
     }
 
@@ -27,6 +33,8 @@ transition_image_layout(
         )
         .setOldLayout(old_layout)
         .setNewLayout(new_layout)
+        .setSrcQueueFamilyIndex(src_queue_family)
+        .setDstQueueFamilyIndex(dst_queue_family)
         .setSubresourceRange(vk::ImageSubresourceRange{}
                                .setAspectMask(aspect)
                                .setBaseArrayLayer(0)
@@ -40,6 +48,34 @@ transition_image_layout(
     cmd.pipelineBarrier2(dep_info);
 }
 void
+buffer_barrier(
+  vk::CommandBuffer cmd,
+  vk::Buffer buffer,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access,
+  uint32_t src_queue_family,
+  uint32_t dst_queue_family
+)
+{
+    auto buffer_barrier = vk::BufferMemoryBarrier2{}
+                            .setSrcStageMask(src_stage)
+                            .setSrcAccessMask(src_access)
+                            .setDstStageMask(dst_stage)
+                            .setDstAccessMask(dst_access)
+                            .setSrcQueueFamilyIndex(src_queue_family)
+                            .setDstQueueFamilyIndex(dst_queue_family)
+                            .setBuffer(buffer)
+                            .setOffset(0)
+                            .setSize(vk::WholeSize);
+
+    auto dep_info =
+      vk::DependencyInfo{}.setBufferMemoryBarriers(buffer_barrier);
+
+    cmd.pipelineBarrier2(dep_info);
+}
+void
 copy_image_to_image(
   vk::CommandBuffer cmd,
   vk::Image src,
@@ -82,5 +118,56 @@ copy_image_to_image(
 
     cmd.blitImage2(blit_info);
 }
+
+std::optional<std::vector<std::byte>>
+read_file(const std::filesystem::path &filepath)
+{
+    std::ifstream file{ filepath, std::ios::binary | std::ios::ate };
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    std::vector<std::byte> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+    if (!file) {
+        return std::nullopt;
+    }
+    return bytes;
+}
+
+bool
+write_file_atomically(
+  const std::filesystem::path &filepath,
+  std::span<const std::byte> bytes
+)
+{
+    auto tmp_filepath = filepath;
+    tmp_filepath += ".tmp";
+    {
+        std::ofstream file{ tmp_filepath, std::ios::binary | std::ios::trunc };
+        if (!file.is_open()) {
+            spdlog::error("Failed to create file: {}", filepath.string());
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        if (!file) {
+            spdlog::error("Failed to write file: {}", filepath.string());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmp_filepath, filepath, error);
+    if (error) {
+        spdlog::error(
+          "Failed to move file into place: {}; ERROR: {}",
+          filepath.string(),
+          error.message()
+        );
+        std::filesystem::remove(tmp_filepath, error);
+        return false;
+    }
+    return true;
+}
 } // namespace utils
 } // namespace kovra
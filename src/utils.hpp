@@ -1,6 +1,12 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 namespace kovra {
@@ -23,7 +29,12 @@ transition_image_layout(
   vk::ImageLayout new_layout,
   int layer_count =
     1, // Specify for images with multiple layers (e.g. cube maps)
-  int level_count = 1 // Specify for images with multiple mip levels
+  int level_count = 1, // Specify for images with multiple mip levels
+  // Set both to record one half of a queue family ownership transfer
+  // The release (on the source queue) and the acquire (on the destination
+  // queue) must use the same layouts and queue families
+  uint32_t src_queue_family = vk::QueueFamilyIgnored,
+  uint32_t dst_queue_family = vk::QueueFamilyIgnored
 );
 
 void
@@ -38,6 +49,52 @@ copy_image_to_image(
   vk::Filter filter = vk::Filter::eNearest
 );
 
+void
+buffer_barrier(
+  vk::CommandBuffer cmd,
+  vk::Buffer buffer,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access,
+  // Set both to record one half of a queue family ownership transfer
+  uint32_t src_queue_family = vk::QueueFamilyIgnored,
+  uint32_t dst_queue_family = vk::QueueFamilyIgnored
+);
+
+// 64-bit FNV-1a over 8-byte words (and the remaining bytes one at a time)
+// Pass the previous result as the seed to hash several buffers together
+inline uint64_t
+hash_bytes(
+  std::span<const std::byte> bytes,
+  uint64_t seed = 0xcbf29ce484222325ull
+)
+{
+    constexpr uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = seed;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes.data() + i, sizeof(uint64_t));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < bytes.size(); i++) {
+        hash = (hash ^ static_cast<uint64_t>(bytes[i])) * prime;
+    }
+    return hash;
+}
+
+// Whole contents of a file
+[[nodiscard]] std::optional<std::vector<std::byte>>
+read_file(const std::filesystem::path &filepath);
+// Write to a temporary file first and rename it into place, so readers never
+// see a partial file even if the process dies halfway through
+bool
+write_file_atomically(
+  const std::filesystem::path &filepath,
+  std::span<const std::byte> bytes
+);
+
 // NOTE: Lifetime of returned span is tied to the lifetime of the data
 template<typename T>
 std::span<const std::byte>
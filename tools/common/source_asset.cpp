@@ -0,0 +1,144 @@
+#include "source_asset.hpp"
+#include "mip_chain.hpp"
+#include "utils.hpp"
+
+#include "fastgltf/core.hpp"
+#include "fastgltf/tools.hpp"
+#include "spdlog/spdlog.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+
+namespace kovra::tools {
+// Takes ownership of pixels decoded by stb_image
+[[nodiscard]] static RgbaImage
+to_rgba_image(unsigned char *data, int width, int height)
+{
+    const size_t size = static_cast<size_t>(width) * height * 4;
+    auto image = RgbaImage{ .width = static_cast<uint32_t>(width),
+                            .height = static_cast<uint32_t>(height),
+                            .texels = std::vector<uint8_t>(data, data + size) };
+    stbi_image_free(data);
+    return image;
+}
+
+std::optional<RgbaImage>
+decode_rgba(std::span<const std::byte> bytes)
+{
+    int width, height, channels;
+    unsigned char *data = stbi_load_from_memory(
+      reinterpret_cast<const stbi_uc *>(bytes.data()),
+      static_cast<int>(bytes.size()),
+      &width,
+      &height,
+      &channels,
+      4
+    );
+    if (!data) {
+        return std::nullopt;
+    }
+    return to_rgba_image(data, width, height);
+}
+
+std::optional<RgbaImage>
+decode_rgba(const std::filesystem::path &filepath)
+{
+    int width, height, channels;
+    unsigned char *data =
+      stbi_load(filepath.c_str(), &width, &height, &channels, 4);
+    if (!data) {
+        return std::nullopt;
+    }
+    return to_rgba_image(data, width, height);
+}
+
+RgbaImage
+downsample(const RgbaImage &image)
+{
+    return RgbaImage{ .width = std::max(image.width / 2, 1u),
+                      .height = std::max(image.height / 2, 1u),
+                      .texels = downsample_rgba8(
+                        image.texels, image.width, image.height
+                      ) };
+}
+
+bool
+has_alpha(const RgbaImage &image)
+{
+    for (size_t i = 3; i < image.texels.size(); i += 4) {
+        if (image.texels[i] < 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<fastgltf::Asset>
+load_gltf_asset(const std::filesystem::path &filepath)
+{
+    fastgltf::GltfDataBuffer data;
+    data.loadFromFile(filepath);
+
+    fastgltf::Parser parser{ fastgltf::Extensions::KHR_texture_basisu };
+    constexpr auto parse_opts = fastgltf::Options::DontRequireValidAssetMember |
+                                fastgltf::Options::AllowDouble |
+                                fastgltf::Options::LoadGLBBuffers |
+                                fastgltf::Options::LoadExternalBuffers;
+    auto parse_result =
+      parser.loadGltf(&data, filepath.parent_path(), parse_opts);
+    if (auto error = parse_result.error(); error != fastgltf::Error::None) {
+        spdlog::error(
+          "Failed to load GLTF file: {}; ERROR: {}",
+          filepath.string(),
+          fastgltf::to_underlying(error)
+        );
+        return std::nullopt;
+    }
+    return std::move(parse_result.get());
+}
+
+std::optional<std::vector<std::byte>>
+read_gltf_image(
+  const fastgltf::Asset &gltf,
+  const std::filesystem::path &filepath,
+  size_t image_index
+)
+{
+    const auto copy_bytes = [](const auto *data, size_t size) {
+        const auto *bytes = reinterpret_cast<const std::byte *>(data);
+        return std::vector<std::byte>(bytes, bytes + size);
+    };
+
+    std::optional<std::vector<std::byte>> bytes;
+    std::visit(
+      fastgltf::visitor{
+        [](auto &) {},
+        [&](const fastgltf::sources::URI &uri) {
+            bytes =
+              utils::read_file(filepath.parent_path() / uri.uri.path());
+        },
+        [&](const fastgltf::sources::Vector &vector) {
+            bytes = copy_bytes(vector.bytes.data(), vector.bytes.size());
+        },
+        [&](const fastgltf::sources::BufferView &view) {
+            const auto &buffer_view = gltf.bufferViews[view.bufferViewIndex];
+            const auto &buffer = gltf.buffers[buffer_view.bufferIndex];
+            std::visit(
+              fastgltf::visitor{
+                [](auto &) {},
+                [&](const fastgltf::sources::Array &array) {
+                    bytes = copy_bytes(
+                      array.bytes.data() + buffer_view.byteOffset,
+                      buffer_view.byteLength
+                    );
+                } },
+              buffer.data
+            );
+        } },
+      gltf.images[image_index].data
+    );
+    return bytes;
+}
+} // namespace kovra::tools
@@ -0,0 +1,45 @@
+#pragma once
+
+// Loading of the source assets the offline tools process
+
+#include "fastgltf/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace kovra::tools {
+struct RgbaImage
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> texels;
+};
+
+[[nodiscard]] std::optional<RgbaImage>
+decode_rgba(std::span<const std::byte> bytes);
+[[nodiscard]] std::optional<RgbaImage>
+decode_rgba(const std::filesystem::path &filepath);
+
+// Half the size of the image, see downsample_rgba8
+[[nodiscard]] RgbaImage
+downsample(const RgbaImage &image);
+
+[[nodiscard]] bool
+has_alpha(const RgbaImage &image);
+
+// Parse a glTF file with its buffers loaded
+[[nodiscard]] std::optional<fastgltf::Asset>
+load_gltf_asset(const std::filesystem::path &filepath);
+
+// Encoded bytes of an image of a glTF file, wherever they are stored
+[[nodiscard]] std::optional<std::vector<std::byte>>
+read_gltf_image(
+  const fastgltf::Asset &gltf,
+  const std::filesystem::path &filepath,
+  size_t image_index
+);
+} // namespace kovra::tools
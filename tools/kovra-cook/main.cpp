@@ -0,0 +1,492 @@
+// Offline scene cooker
+// Converts glTF files to scene packs, which hold the vertex, index, material
+// and texture data in the layout the renderer uploads, so loading a pack
+// skips parsing, accessor conversion, bounds and mip generation entirely.
+
+#include "ktx2.hpp"
+#include "mip_chain.hpp"
+#include "scene_pack.hpp"
+#include "source_asset.hpp"
+
+#include "fastgltf/core.hpp"
+#include "fastgltf/glm_element_traits.hpp"
+#include "fastgltf/tools.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "spdlog/spdlog.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kovra::cook {
+[[nodiscard]] static vk::Filter
+extract_filter(fastgltf::Filter filter)
+{
+    switch (filter) {
+        case fastgltf::Filter::Linear:
+        case fastgltf::Filter::LinearMipMapNearest:
+        case fastgltf::Filter::LinearMipMapLinear:
+            return vk::Filter::eLinear;
+        default:
+            return vk::Filter::eNearest;
+    }
+}
+
+[[nodiscard]] static vk::SamplerMipmapMode
+extract_mipmap_mode(fastgltf::Filter filter)
+{
+    switch (filter) {
+        case fastgltf::Filter::NearestMipMapLinear:
+        case fastgltf::Filter::LinearMipMapLinear:
+            return vk::SamplerMipmapMode::eLinear;
+        default:
+            return vk::SamplerMipmapMode::eNearest;
+    }
+}
+
+// Block-compressed version written by kovra-texc, or the image itself if it
+// is a KTX2 file already
+[[nodiscard]] static std::optional<Ktx2Image>
+load_compressed_image(
+  const std::filesystem::path &filepath,
+  size_t image_index,
+  std::span<const std::byte> bytes
+)
+{
+    const auto compressed_filepath =
+      get_compressed_texture_path(filepath, image_index);
+    if (std::filesystem::exists(compressed_filepath)) {
+        return read_ktx2(compressed_filepath);
+    }
+    if (is_ktx2(bytes)) {
+        return read_ktx2(bytes);
+    }
+    return std::nullopt;
+}
+
+// Returns the pack texture of each image, or -1 if it failed to load
+[[nodiscard]] static std::vector<int32_t>
+cook_textures(
+  const fastgltf::Asset &gltf,
+  const std::filesystem::path &filepath,
+  bool use_compressed,
+  ScenePackContents &contents
+)
+{
+    std::vector<int32_t> image_textures(gltf.images.size(), -1);
+    for (size_t i = 0; i < gltf.images.size(); i++) {
+        const auto bytes = tools::read_gltf_image(gltf, filepath, i);
+        std::optional<Ktx2Image> texture;
+        if (use_compressed) {
+            texture = load_compressed_image(
+              filepath,
+              i,
+              bytes.has_value() ? std::span<const std::byte>{ bytes.value() }
+                                : std::span<const std::byte>{}
+            );
+        }
+        if (!texture.has_value() && bytes.has_value()) {
+            if (auto image = tools::decode_rgba(bytes.value());
+                image.has_value()) {
+                texture = build_rgba8_mip_chain(
+                  image->texels, image->width, image->height
+                );
+            }
+        }
+        if (!texture.has_value()) {
+            spdlog::error(
+              "Failed to load image {} of {}", i, filepath.string()
+            );
+            continue;
+        }
+
+        image_textures[i] = static_cast<int32_t>(contents.textures.size());
+        contents.textures.emplace_back(
+          PackTexture{ .format = texture->format,
+                       .width = texture->width,
+                       .height = texture->height,
+                       .level_count = texture->level_count,
+                       .data_offset = contents.texture_data.size(),
+                       .data_size = texture->data.size() }
+        );
+        contents.texture_data.insert(
+          contents.texture_data.end(),
+          texture->data.begin(),
+          texture->data.end()
+        );
+    }
+    return image_textures;
+}
+
+static void
+cook_materials(
+  const fastgltf::Asset &gltf,
+  std::span<const int32_t> image_textures,
+  ScenePackContents &contents
+)
+{
+    // KHR_texture_basisu images are preferred if they could be loaded
+    const auto get_texture_ref =
+      [&](const auto &texture_info) -> PackTextureRef {
+        if (!texture_info.has_value() ||
+            texture_info->textureIndex >= gltf.textures.size()) {
+            return { .texture = -1, .sampler = -1 };
+        }
+        const auto &tex = gltf.textures[texture_info->textureIndex];
+        int32_t texture = -1;
+        for (const auto &image_index : { tex.basisuImageIndex, tex.imageIndex }
+        ) {
+            if (image_index.has_value() &&
+                image_index.value() < image_textures.size() &&
+                image_textures[image_index.value()] >= 0) {
+                texture = image_textures[image_index.value()];
+                break;
+            }
+        }
+        const int32_t sampler =
+          tex.samplerIndex.has_value() &&
+              tex.samplerIndex.value() < gltf.samplers.size()
+            ? static_cast<int32_t>(tex.samplerIndex.value())
+            : -1;
+        return { .texture = texture, .sampler = sampler };
+    };
+
+    for (const fastgltf::Material &mat : gltf.materials) {
+        contents.materials.emplace_back(PackMaterial{
+          .pass = mat.alphaMode == fastgltf::AlphaMode::Blend
+                    ? PackMaterialPass::Transparent
+                    : PackMaterialPass::Opaque,
+          .albedo = get_texture_ref(mat.pbrData.baseColorTexture),
+          .metal_rough = get_texture_ref(mat.pbrData.metallicRoughnessTexture),
+          .ambient_occlusion = get_texture_ref(mat.occlusionTexture),
+          .emissive = get_texture_ref(mat.emissiveTexture),
+          .alpha_mask = mat.alphaMode == fastgltf::AlphaMode::Mask ? 1u : 0u,
+        });
+        contents.material_data.emplace_back(GpuPbrMaterialData{
+          .color_factors = glm::vec4(
+            mat.pbrData.baseColorFactor[0],
+            mat.pbrData.baseColorFactor[1],
+            mat.pbrData.baseColorFactor[2],
+            mat.pbrData.baseColorFactor[3]
+          ),
+          .metal_rough_factors = glm::vec4(
+            mat.pbrData.metallicFactor,
+            mat.pbrData.roughnessFactor,
+            mat.alphaCutoff,
+            0.0f
+          ),
+          ._padding = {},
+        });
+    }
+
+    // Surfaces without a material use the first one, so there has to be one
+    if (contents.materials.empty()) {
+        constexpr auto no_texture = PackTextureRef{ .texture = -1,
+                                                    .sampler = -1 };
+        contents.materials.emplace_back(
+          PackMaterial{ .pass = PackMaterialPass::Opaque,
+                        .albedo = no_texture,
+                        .metal_rough = no_texture,
+                        .ambient_occlusion = no_texture,
+                        .emissive = no_texture,
+                        .alpha_mask = 0 }
+        );
+        contents.material_data.emplace_back(
+          GpuPbrMaterialData{ .color_factors = glm::vec4(1.0f),
+                              .metal_rough_factors =
+                                glm::vec4(1.0f, 1.0f, 0.0f, 0.0f),
+                              ._padding = {} }
+        );
+    }
+}
+
+static void
+cook_meshes(const fastgltf::Asset &gltf, ScenePackContents &contents)
+{
+    for (const fastgltf::Mesh &mesh : gltf.meshes) {
+        auto pack_mesh = PackMesh{
+            .name_offset = static_cast<uint32_t>(contents.strings.size()),
+            .name_size = static_cast<uint32_t>(mesh.name.size()),
+            .first_surface = static_cast<uint32_t>(contents.surfaces.size()),
+            .surface_count = 0,
+            .first_vertex = static_cast<uint32_t>(contents.vertices.size()),
+            .vertex_count = 0,
+            .first_index = static_cast<uint32_t>(contents.indices.size()),
+            .index_count = 0,
+        };
+        contents.strings.append(mesh.name.data(), mesh.name.size());
+
+        for (const auto &p : mesh.primitives) {
+            const auto position = p.findAttribute("POSITION");
+            if (!p.indicesAccessor.has_value() ||
+                position == p.attributes.end()) {
+                spdlog::warn(
+                  "Skipping a primitive without indices or positions in "
+                  "mesh: {}",
+                  mesh.name
+                );
+                continue;
+            }
+
+            // Indices are relative to the first vertex of the mesh
+            const size_t first_vertex = contents.vertices.size();
+            const auto mesh_vertex = static_cast<uint32_t>(
+              first_vertex - pack_mesh.first_vertex
+            );
+            const auto &index_accessor =
+              gltf.accessors[p.indicesAccessor.value()];
+            auto surface = PackSurface{
+                .start_index = static_cast<uint32_t>(
+                  contents.indices.size() - pack_mesh.first_index
+                ),
+                .count = static_cast<uint32_t>(index_accessor.count),
+                .material = 0,
+                ._padding = 0,
+                .origin = {},
+                .sphere_radius = 0.0f,
+                .extents = {},
+                ._padding2 = 0.0f,
+            };
+            if (p.materialIndex.has_value() &&
+                p.materialIndex.value() < gltf.materials.size()) {
+                surface.material =
+                  static_cast<uint32_t>(p.materialIndex.value());
+            }
+            contents.indices.reserve(
+              contents.indices.size() + index_accessor.count
+            );
+            fastgltf::iterateAccessor<uint32_t>(
+              gltf,
+              index_accessor,
+              [&](uint32_t idx) {
+                  contents.indices.push_back(mesh_vertex + idx);
+              }
+            );
+
+            // Vertices are written in the layout the shaders read
+            const auto &position_accessor = gltf.accessors[position->second];
+            contents.vertices.resize(first_vertex + position_accessor.count);
+            auto vertices =
+              std::span{ contents.vertices }.subspan(first_vertex);
+            for (auto &vertex : vertices) {
+                vertex = GpuVertexData{ .position = glm::vec3(0.0f),
+                                        .uv_x = 0.0f,
+                                        .normal = glm::vec3(0.0f, 1.0f, 0.0f),
+                                        .uv_y = 0.0f,
+                                        .color = glm::vec4(1.0f) };
+            }
+            fastgltf::iterateAccessorWithIndex<glm::vec3>(
+              gltf,
+              position_accessor,
+              [&](glm::vec3 pos, size_t idx) { vertices[idx].position = pos; }
+            );
+            if (auto normals = p.findAttribute("NORMAL");
+                normals != p.attributes.end()) {
+                fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                  gltf,
+                  gltf.accessors[normals->second],
+                  [&](glm::vec3 normal, size_t idx) {
+                      vertices[idx].normal = normal;
+                  }
+                );
+            }
+            if (auto uvs = p.findAttribute("TEXCOORD_0");
+                uvs != p.attributes.end()) {
+                fastgltf::iterateAccessorWithIndex<glm::vec2>(
+                  gltf,
+                  gltf.accessors[uvs->second],
+                  [&](glm::vec2 uv, size_t idx) {
+                      vertices[idx].uv_x = uv.x;
+                      vertices[idx].uv_y = uv.y;
+                  }
+                );
+            }
+            if (auto colors = p.findAttribute("COLOR_0");
+                colors != p.attributes.end()) {
+                // The renderer drops vertex color alpha as well
+                fastgltf::iterateAccessorWithIndex<glm::vec4>(
+                  gltf,
+                  gltf.accessors[colors->second],
+                  [&](glm::vec4 color, size_t idx) {
+                      vertices[idx].color = glm::vec4(glm::vec3(color), 1.0f);
+                  }
+                );
+            }
+
+            // Bounds
+            if (!vertices.empty()) {
+                glm::vec3 min_pos = vertices.front().position;
+                glm::vec3 max_pos = vertices.front().position;
+                for (const auto &vertex : vertices) {
+                    min_pos = glm::min(min_pos, vertex.position);
+                    max_pos = glm::max(max_pos, vertex.position);
+                }
+                surface.origin = (min_pos + max_pos) / 2.0f;
+                surface.extents = (max_pos - min_pos) / 2.0f;
+                surface.sphere_radius = glm::length(surface.extents);
+            }
+
+            contents.surfaces.push_back(surface);
+        }
+
+        pack_mesh.surface_count = static_cast<uint32_t>(
+          contents.surfaces.size() - pack_mesh.first_surface
+        );
+        pack_mesh.vertex_count = static_cast<uint32_t>(
+          contents.vertices.size() - pack_mesh.first_vertex
+        );
+        pack_mesh.index_count = static_cast<uint32_t>(
+          contents.indices.size() - pack_mesh.first_index
+        );
+        contents.meshes.push_back(pack_mesh);
+    }
+}
+
+static void
+cook_nodes(const fastgltf::Asset &gltf, ScenePackContents &contents)
+{
+    for (const fastgltf::Node &node : gltf.nodes) {
+        auto pack_node = PackNode{
+            .local_transform = glm::identity<glm::mat4>(),
+            .mesh = node.meshIndex.has_value()
+                      ? static_cast<int32_t>(node.meshIndex.value())
+                      : -1,
+            .first_child =
+              static_cast<uint32_t>(contents.node_children.size()),
+            .child_count = static_cast<uint32_t>(node.children.size()),
+            ._padding = 0,
+        };
+        std::visit(
+          fastgltf::visitor{
+            [&](const fastgltf::Node::TransformMatrix &loc_tf) {
+                std::memcpy(
+                  &pack_node.local_transform, loc_tf.data(), sizeof(loc_tf)
+                );
+            },
+            [&](const fastgltf::TRS &loc_tf) {
+                glm::vec3 t{ loc_tf.translation[0],
+                             loc_tf.translation[1],
+                             loc_tf.translation[2] };
+                glm::quat r{ loc_tf.rotation[3],
+                             loc_tf.rotation[0],
+                             loc_tf.rotation[1],
+                             loc_tf.rotation[2] };
+                glm::vec3 s{ loc_tf.scale[0],
+                             loc_tf.scale[1],
+                             loc_tf.scale[2] };
+                glm::mat4 tm = glm::translate(glm::identity<glm::mat4>(), t);
+                glm::mat4 rm = glm::mat4_cast(r);
+                glm::mat4 sm = glm::scale(glm::identity<glm::mat4>(), s);
+                pack_node.local_transform = tm * rm * sm;
+            } },
+          node.transform
+        );
+        for (const auto child : node.children) {
+            contents.node_children.push_back(static_cast<uint32_t>(child));
+        }
+        contents.nodes.push_back(pack_node);
+    }
+}
+
+static bool
+cook_gltf(
+  const std::filesystem::path &filepath,
+  const std::filesystem::path &output_filepath,
+  bool use_compressed
+)
+{
+    const auto start = std::chrono::system_clock::now();
+    const auto asset = tools::load_gltf_asset(filepath);
+    if (!asset.has_value()) {
+        return false;
+    }
+    const fastgltf::Asset &gltf = asset.value();
+
+    ScenePackContents contents;
+    for (const fastgltf::Sampler &sampler : gltf.samplers) {
+        const auto min_filter =
+          sampler.minFilter.value_or(fastgltf::Filter::Nearest);
+        contents.samplers.emplace_back(PackSampler{
+          .mag_filter = extract_filter(
+            sampler.magFilter.value_or(fastgltf::Filter::Nearest)
+          ),
+          .min_filter = extract_filter(min_filter),
+          .mipmap_mode = extract_mipmap_mode(min_filter),
+          ._padding = 0,
+        });
+    }
+    const auto image_textures =
+      cook_textures(gltf, filepath, use_compressed, contents);
+    cook_materials(gltf, image_textures, contents);
+    cook_meshes(gltf, contents);
+    cook_nodes(gltf, contents);
+
+    if (!write_scene_pack(output_filepath, contents)) {
+        return false;
+    }
+    const auto end = std::chrono::system_clock::now();
+    spdlog::info(
+      "Wrote {} ({} meshes, {} textures, {} materials) in {:.2f} ms",
+      output_filepath.string(),
+      contents.meshes.size(),
+      contents.textures.size(),
+      contents.materials.size(),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count() /
+        1000.0f
+    );
+    return true;
+}
+} // namespace kovra::cook
+
+static void
+print_usage()
+{
+    spdlog::info(
+      "Usage:\n"
+      "  kovra-cook [--no-bc] <model.gltf|model.glb>...\n"
+      "  kovra-cook [--no-bc] <model.gltf|model.glb> -o <output.kpack>\n"
+      "Textures compressed by kovra-texc are packed unless --no-bc is given"
+    );
+}
+
+int
+main(int argc, char *argv[])
+{
+    using namespace kovra::cook;
+
+    bool use_compressed = true;
+    std::optional<std::filesystem::path> output;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "--no-bc") {
+            use_compressed = false;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage();
+            return 0;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    if (inputs.empty() || (output.has_value() && inputs.size() != 1)) {
+        print_usage();
+        return 1;
+    }
+
+    bool success = true;
+    for (const auto &input : inputs) {
+        auto output_filepath = output.value_or(input);
+        if (!output.has_value()) {
+            output_filepath.replace_extension(kovra::SCENE_PACK_EXTENSION);
+        }
+        success &= cook_gltf(input, output_filepath, use_compressed);
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,458 @@
+#include "bc_encoder.hpp"
+#include "format.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <future>
+
+namespace kovra::texc {
+// RGBA texels of a 4x4 block, row by row
+using Block = std::array<std::array<float, 4>, 16>;
+
+// Writes fields into a block from the least significant bit up
+class BitWriter
+{
+  public:
+    explicit BitWriter(std::byte *out)
+      : out{ out }
+    {
+    }
+
+    void write(uint32_t value, uint32_t bit_count) noexcept
+    {
+        for (uint32_t bit = 0; bit < bit_count; bit++, position++) {
+            if ((value >> bit) & 1) {
+                out[position / 8] |= std::byte{ 1 } << (position % 8);
+            }
+        }
+    }
+
+  private:
+    std::byte *out;
+    uint32_t position = 0;
+};
+
+static void
+write_u16(std::byte *out, uint16_t value) noexcept
+{
+    out[0] = static_cast<std::byte>(value & 0xFF);
+    out[1] = static_cast<std::byte>(value >> 8);
+}
+
+static void
+write_u32(std::byte *out, uint32_t value) noexcept
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+template<size_t N>
+static float
+distance_squared(
+  const std::array<float, 4> &a,
+  const std::array<float, 4> &b
+) noexcept
+{
+    float distance = 0.0f;
+    for (size_t c = 0; c < N; c++) {
+        distance += (a[c] - b[c]) * (a[c] - b[c]);
+    }
+    return distance;
+}
+
+// Line through the first N channels of the block that fits them best, given
+// by its two furthest projected texels
+template<size_t N>
+static std::pair<std::array<float, 4>, std::array<float, 4>>
+fit_endpoints(const Block &block) noexcept
+{
+    std::array<float, 4> mean{};
+    for (const auto &texel : block) {
+        for (size_t c = 0; c < N; c++) {
+            mean[c] += texel[c] / 16.0f;
+        }
+    }
+
+    std::array<std::array<float, 4>, 4> covariance{};
+    for (const auto &texel : block) {
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = 0; j < N; j++) {
+                covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+            }
+        }
+    }
+
+    // Power iteration for the principal axis
+    std::array<float, 4> axis{};
+    axis.fill(1.0f);
+    for (int iteration = 0; iteration < 8; iteration++) {
+        std::array<float, 4> next{};
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = 0; j < N; j++) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+        }
+        float length = 0.0f;
+        for (size_t c = 0; c < N; c++) {
+            length += next[c] * next[c];
+        }
+        length = std::sqrt(length);
+        if (length < 1e-6f) {
+            // Every texel is the same
+            return { mean, mean };
+        }
+        for (size_t c = 0; c < N; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float min_t = 0.0f;
+    float max_t = 0.0f;
+    for (const auto &texel : block) {
+        float t = 0.0f;
+        for (size_t c = 0; c < N; c++) {
+            t += (texel[c] - mean[c]) * axis[c];
+        }
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+
+    std::array<float, 4> high{};
+    std::array<float, 4> low{};
+    for (size_t c = 0; c < N; c++) {
+        high[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+        low[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+    }
+    return { high, low };
+}
+
+static uint16_t
+to_rgb565(const std::array<float, 4> &color) noexcept
+{
+    const auto quantize = [](float value, float max) {
+        return static_cast<uint16_t>(std::lround(value * max / 255.0f));
+    };
+    return static_cast<uint16_t>(
+      (quantize(color[0], 31.0f) << 11) | (quantize(color[1], 63.0f) << 5) |
+      quantize(color[2], 31.0f)
+    );
+}
+
+static std::array<float, 4>
+from_rgb565(uint16_t color) noexcept
+{
+    const uint32_t r = (color >> 11) & 31;
+    const uint32_t g = (color >> 5) & 63;
+    const uint32_t b = color & 31;
+    return { static_cast<float>((r << 3) | (r >> 2)),
+             static_cast<float>((g << 2) | (g >> 4)),
+             static_cast<float>((b << 3) | (b >> 2)),
+             255.0f };
+}
+
+// Set punch_through to turn texels with alpha below 128 transparent, which
+// needs the three color mode
+static void
+encode_bc1_block(const Block &block, bool punch_through, std::byte *out)
+{
+    bool has_transparent = false;
+    if (punch_through) {
+        for (const auto &texel : block) {
+            has_transparent |= texel[3] < 128.0f;
+        }
+    }
+
+    const auto [high, low] = fit_endpoints<3>(block);
+    uint16_t color0 = to_rgb565(high);
+    uint16_t color1 = to_rgb565(low);
+    // color0 > color1 selects four colors, otherwise three and transparent
+    if ((color0 < color1) != has_transparent) {
+        std::swap(color0, color1);
+    }
+
+    const auto c0 = from_rgb565(color0);
+    const auto c1 = from_rgb565(color1);
+    std::array<std::array<float, 4>, 4> palette = { c0, c1, c0, c1 };
+    for (size_t c = 0; c < 3; c++) {
+        if (color0 > color1) {
+            palette[2][c] = (2.0f * c0[c] + c1[c]) / 3.0f;
+            palette[3][c] = (c0[c] + 2.0f * c1[c]) / 3.0f;
+        } else {
+            palette[2][c] = (c0[c] + c1[c]) / 2.0f;
+        }
+    }
+    const size_t palette_size = color0 > color1 ? 4 : 3;
+
+    uint32_t indices = 0;
+    for (size_t i = 0; i < block.size(); i++) {
+        uint32_t best_index = 0;
+        if (has_transparent && block[i][3] < 128.0f) {
+            best_index = 3;
+        } else {
+            float best_distance = distance_squared<3>(block[i], palette[0]);
+            for (uint32_t p = 1; p < palette_size; p++) {
+                const float distance =
+                  distance_squared<3>(block[i], palette[p]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+        }
+        indices |= best_index << (2 * i);
+    }
+
+    write_u16(out, color0);
+    write_u16(out + 2, color1);
+    write_u32(out + 4, indices);
+}
+
+// Single channel block, shared by BC3 alpha, BC4 and BC5
+static void
+encode_bc4_block(const Block &block, size_t channel, std::byte *out)
+{
+    float min_value = 255.0f;
+    float max_value = 0.0f;
+    for (const auto &texel : block) {
+        min_value = std::min(min_value, texel[channel]);
+        max_value = std::max(max_value, texel[channel]);
+    }
+    const auto red0 = static_cast<uint8_t>(std::lround(max_value));
+    const auto red1 = static_cast<uint8_t>(std::lround(min_value));
+
+    // red0 > red1 selects six interpolated values between the endpoints
+    std::array<float, 8> palette{};
+    palette[0] = red0;
+    palette[1] = red1;
+    for (int i = 2; i < 8; i++) {
+        palette[i] = ((8 - i) * static_cast<float>(red0) +
+                      (i - 1) * static_cast<float>(red1)) /
+                     7.0f;
+    }
+
+    uint64_t indices = 0;
+    if (red0 > red1) {
+        for (size_t i = 0; i < block.size(); i++) {
+            uint64_t best_index = 0;
+            float best_distance = std::abs(block[i][channel] - palette[0]);
+            for (uint64_t p = 1; p < palette.size(); p++) {
+                const float distance = std::abs(block[i][channel] - palette[p]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best_index = p;
+                }
+            }
+            indices |= best_index << (3 * i);
+        }
+    }
+
+    out[0] = static_cast<std::byte>(red0);
+    out[1] = static_cast<std::byte>(red1);
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<std::byte>((indices >> (8 * i)) & 0xFF);
+    }
+}
+
+// Mode 6: one subset, RGBA endpoints with 7 bits and a p-bit each, and
+// 4-bit indices
+static void
+encode_bc7_block(const Block &block, std::byte *out)
+{
+    constexpr std::array<uint32_t, 16> WEIGHTS = { 0,  4,  9,  13, 17, 21,
+                                                   26, 30, 34, 38, 43, 47,
+                                                   51, 55, 60, 64 };
+
+    const auto [high, low] = fit_endpoints<4>(block);
+
+    // Pick the p-bit that lands the endpoint closest to the fitted one
+    struct Endpoint
+    {
+        std::array<uint32_t, 4> value;
+        uint32_t p_bit;
+    };
+    const auto quantize = [](const std::array<float, 4> &color) {
+        Endpoint best{};
+        float best_error = INFINITY;
+        for (uint32_t p_bit = 0; p_bit < 2; p_bit++) {
+            Endpoint endpoint{ .value = {}, .p_bit = p_bit };
+            float error = 0.0f;
+            for (size_t c = 0; c < 4; c++) {
+                const auto q = std::clamp<long>(
+                  std::lround((color[c] - static_cast<float>(p_bit)) / 2.0f),
+                  0,
+                  127
+                );
+                endpoint.value[c] = static_cast<uint32_t>(q);
+                const auto decoded =
+                  static_cast<float>((endpoint.value[c] << 1) | p_bit);
+                error += (decoded - color[c]) * (decoded - color[c]);
+            }
+            if (error < best_error) {
+                best_error = error;
+                best = endpoint;
+            }
+        }
+        return best;
+    };
+    auto endpoint0 = quantize(high);
+    auto endpoint1 = quantize(low);
+
+    std::array<std::array<float, 4>, 16> palette{};
+    for (size_t i = 0; i < palette.size(); i++) {
+        for (size_t c = 0; c < 4; c++) {
+            const uint32_t e0 = (endpoint0.value[c] << 1) | endpoint0.p_bit;
+            const uint32_t e1 = (endpoint1.value[c] << 1) | endpoint1.p_bit;
+            palette[i][c] = static_cast<float>(
+              ((64 - WEIGHTS[i]) * e0 + WEIGHTS[i] * e1 + 32) >> 6
+            );
+        }
+    }
+
+    std::array<uint32_t, 16> indices{};
+    for (size_t i = 0; i < block.size(); i++) {
+        float best_distance = distance_squared<4>(block[i], palette[0]);
+        for (uint32_t p = 1; p < palette.size(); p++) {
+            const float distance = distance_squared<4>(block[i], palette[p]);
+            if (distance < best_distance) {
+                best_distance = distance;
+                indices[i] = p;
+            }
+        }
+    }
+    // The first index is stored without its top bit, so it has to be zero
+    if (indices[0] & 8) {
+        std::swap(endpoint0, endpoint1);
+        for (auto &index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer{ out };
+    writer.write(1 << 6, 7);
+    for (size_t c = 0; c < 4; c++) {
+        writer.write(endpoint0.value[c], 7);
+        writer.write(endpoint1.value[c], 7);
+    }
+    writer.write(endpoint0.p_bit, 1);
+    writer.write(endpoint1.p_bit, 1);
+    writer.write(indices[0], 3);
+    for (size_t i = 1; i < indices.size(); i++) {
+        writer.write(indices[i], 4);
+    }
+}
+
+bool
+is_encodable(vk::Format format) noexcept
+{
+    switch (format) {
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbSrgbBlock:
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc1RgbaSrgbBlock:
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc3SrgbBlock:
+        case vk::Format::eBc4UnormBlock:
+        case vk::Format::eBc5UnormBlock:
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void
+encode_block(const Block &block, vk::Format format, std::byte *out)
+{
+    switch (format) {
+        case vk::Format::eBc1RgbUnormBlock:
+        case vk::Format::eBc1RgbSrgbBlock:
+            encode_bc1_block(block, false, out);
+            break;
+        case vk::Format::eBc1RgbaUnormBlock:
+        case vk::Format::eBc1RgbaSrgbBlock:
+            encode_bc1_block(block, true, out);
+            break;
+        case vk::Format::eBc3UnormBlock:
+        case vk::Format::eBc3SrgbBlock:
+            // The color half of BC3 always uses four colors
+            encode_bc4_block(block, 3, out);
+            encode_bc1_block(block, false, out + 8);
+            break;
+        case vk::Format::eBc4UnormBlock:
+            encode_bc4_block(block, 0, out);
+            break;
+        case vk::Format::eBc5UnormBlock:
+            encode_bc4_block(block, 0, out);
+            encode_bc4_block(block, 1, out + 8);
+            break;
+        case vk::Format::eBc7UnormBlock:
+        case vk::Format::eBc7SrgbBlock:
+            encode_bc7_block(block, out);
+            break;
+        default:
+            break;
+    }
+}
+
+std::vector<std::byte>
+encode_bc(
+  const uint8_t *rgba,
+  uint32_t width,
+  uint32_t height,
+  vk::Format format,
+  uint32_t thread_count
+)
+{
+    if (!is_encodable(format)) {
+        return {};
+    }
+    const uint32_t block_size = get_format_block(format).size;
+    const uint32_t blocks_x = (width + 3) / 4;
+    const uint32_t blocks_y = (height + 3) / 4;
+    std::vector<std::byte> encoded(
+      static_cast<size_t>(blocks_x) * blocks_y * block_size
+    );
+
+    // Workers take the next row of blocks nobody has started on yet
+    std::atomic<uint32_t> next_row = 0;
+    const auto encode_rows = [&]() {
+        Block block;
+        for (uint32_t by = next_row++; by < blocks_y; by = next_row++) {
+            for (uint32_t bx = 0; bx < blocks_x; bx++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    for (uint32_t x = 0; x < 4; x++) {
+                        const uint32_t sx = std::min(bx * 4 + x, width - 1);
+                        const uint32_t sy = std::min(by * 4 + y, height - 1);
+                        const uint8_t *texel =
+                          rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+                        for (size_t c = 0; c < 4; c++) {
+                            block[y * 4 + x][c] = texel[c];
+                        }
+                    }
+                }
+                encode_block(
+                  block,
+                  format,
+                  encoded.data() +
+                    (static_cast<size_t>(by) * blocks_x + bx) * block_size
+                );
+            }
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    for (uint32_t i = 0; i < std::max(thread_count, 1u); i++) {
+        workers.emplace_back(std::async(std::launch::async, encode_rows));
+    }
+    for (auto &worker : workers) {
+        worker.get();
+    }
+    return encoded;
+}
+} // namespace kovra::texc
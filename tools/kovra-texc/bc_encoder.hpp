@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace kovra::texc {
+// Whether encode_bc supports the format
+[[nodiscard]] bool
+is_encodable(vk::Format format) noexcept;
+
+// Encode tightly packed RGBA8 texels into 4x4 blocks of a BCn format
+// BC1, BC3, BC4 (red), BC5 (red and green) and BC7 (mode 6) are supported
+// Partial blocks at the right and bottom edges repeat the last column and
+// row. Rows of blocks are spread over thread_count threads.
+[[nodiscard]] std::vector<std::byte>
+encode_bc(
+  const uint8_t *rgba,
+  uint32_t width,
+  uint32_t height,
+  vk::Format format,
+  uint32_t thread_count
+);
+} // namespace kovra::texc
@@ -0,0 +1,261 @@
+// Offline texture encoder
+// Converts the PNG and JPG images of glTF files, or single image files, to
+// KTX2 files with prebuilt mip chains in a BCn format that suits how each
+// texture is sampled.
+
+#include "bc_encoder.hpp"
+#include "ktx2.hpp"
+#include "source_asset.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace kovra::texc {
+using tools::RgbaImage;
+
+// How the renderer samples a texture, in order of how much it needs to keep
+// When an image is used in several roles, the one listed first here wins,
+// whatever order the materials use it in
+enum class TextureRole
+{
+    Color,
+    MetalRough,
+    Emissive,
+    Normal,
+    Occlusion,
+};
+
+[[nodiscard]] static std::optional<TextureRole>
+parse_role(std::string_view name)
+{
+    if (name == "color") {
+        return TextureRole::Color;
+    } else if (name == "metal-rough") {
+        return TextureRole::MetalRough;
+    } else if (name == "emissive") {
+        return TextureRole::Emissive;
+    } else if (name == "normal") {
+        return TextureRole::Normal;
+    } else if (name == "occlusion") {
+        return TextureRole::Occlusion;
+    }
+    return std::nullopt;
+}
+
+// Textures are sampled through UNORM views, so no sRGB formats are picked
+[[nodiscard]] static vk::Format
+choose_format(TextureRole role, bool has_alpha)
+{
+    switch (role) {
+        case TextureRole::Color:
+            return has_alpha ? vk::Format::eBc7UnormBlock
+                             : vk::Format::eBc1RgbUnormBlock;
+        case TextureRole::MetalRough:
+            // Metalness and roughness live in separate channels that BC1
+            // would bleed into each other
+            return vk::Format::eBc7UnormBlock;
+        case TextureRole::Emissive:
+            return vk::Format::eBc1RgbUnormBlock;
+        case TextureRole::Normal:
+            return vk::Format::eBc5UnormBlock;
+        case TextureRole::Occlusion:
+            return vk::Format::eBc4UnormBlock;
+    }
+    return vk::Format::eBc7UnormBlock;
+}
+
+// Encode the image and its whole mip chain and write it as KTX2
+static bool
+encode_image(
+  RgbaImage image,
+  TextureRole role,
+  const std::filesystem::path &output_filepath,
+  uint32_t thread_count
+)
+{
+    const auto start = std::chrono::system_clock::now();
+    const auto format = choose_format(role, tools::has_alpha(image));
+    auto ktx2 = Ktx2Image{ .format = format,
+                           .width = image.width,
+                           .height = image.height,
+                           .level_count = 0,
+                           .data = {} };
+    while (true) {
+        const auto level = encode_bc(
+          image.texels.data(), image.width, image.height, format, thread_count
+        );
+        ktx2.data.insert(ktx2.data.end(), level.begin(), level.end());
+        ktx2.level_count++;
+        if (image.width == 1 && image.height == 1) {
+            break;
+        }
+        image = tools::downsample(image);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(output_filepath.parent_path(), error);
+    if (!write_ktx2(output_filepath, ktx2)) {
+        return false;
+    }
+    const auto end = std::chrono::system_clock::now();
+    spdlog::info(
+      "Wrote {} ({}x{}, {} levels, {}) in {:.2f} ms",
+      output_filepath.string(),
+      ktx2.width,
+      ktx2.height,
+      ktx2.level_count,
+      vk::to_string(format),
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count() /
+        1000.0f
+    );
+    return true;
+}
+
+// Encode every image of a glTF file next to it, where the loader looks
+static bool
+encode_gltf(const std::filesystem::path &filepath, uint32_t thread_count)
+{
+    const auto asset = tools::load_gltf_asset(filepath);
+    if (!asset.has_value()) {
+        return false;
+    }
+    const fastgltf::Asset &gltf = asset.value();
+
+    // Work out what each image is used for from the materials
+    std::vector<std::optional<TextureRole>> roles(gltf.images.size());
+    const auto use_as = [&](const auto &texture_info, TextureRole role) {
+        if (!texture_info.has_value() ||
+            texture_info->textureIndex >= gltf.textures.size()) {
+            return;
+        }
+        const auto &texture = gltf.textures[texture_info->textureIndex];
+        if (!texture.imageIndex.has_value() ||
+            texture.imageIndex.value() >= roles.size()) {
+            return;
+        }
+        // Keep the role with the highest priority
+        auto &image_role = roles[texture.imageIndex.value()];
+        if (!image_role.has_value() || role < image_role.value()) {
+            image_role = role;
+        }
+    };
+    for (const auto &material : gltf.materials) {
+        use_as(material.pbrData.baseColorTexture, TextureRole::Color);
+        use_as(
+          material.pbrData.metallicRoughnessTexture, TextureRole::MetalRough
+        );
+        use_as(material.emissiveTexture, TextureRole::Emissive);
+        use_as(material.normalTexture, TextureRole::Normal);
+        use_as(material.occlusionTexture, TextureRole::Occlusion);
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < gltf.images.size(); i++) {
+        const auto bytes = tools::read_gltf_image(gltf, filepath, i);
+        std::optional<RgbaImage> image;
+        if (bytes.has_value()) {
+            image = tools::decode_rgba(bytes.value());
+        }
+        if (!image.has_value()) {
+            spdlog::error(
+              "Failed to decode image {} of {}", i, filepath.string()
+            );
+            success = false;
+            continue;
+        }
+
+        success &= encode_image(
+          std::move(image.value()),
+          roles[i].value_or(TextureRole::Color),
+          get_compressed_texture_path(filepath, i),
+          thread_count
+        );
+    }
+    return success;
+}
+} // namespace kovra::texc
+
+static void
+print_usage()
+{
+    spdlog::info(
+      "Usage:\n"
+      "  kovra-texc [-j threads] <model.gltf|model.glb>...\n"
+      "  kovra-texc [-j threads] --role "
+      "<color|metal-rough|emissive|normal|occlusion> <image> <output.ktx2>"
+    );
+}
+
+int
+main(int argc, char *argv[])
+{
+    using namespace kovra::texc;
+
+    uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    std::optional<TextureRole> role;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            const auto [end, error] = std::from_chars(
+              value.data(), value.data() + value.size(), thread_count
+            );
+            if (error != std::errc{} || end != value.data() + value.size() ||
+                thread_count == 0) {
+                spdlog::error("Invalid thread count: {}", value);
+                print_usage();
+                return 1;
+            }
+        } else if (arg == "--role" && i + 1 < argc) {
+            role = parse_role(argv[++i]);
+            if (!role.has_value()) {
+                spdlog::error("Unknown texture role: {}", argv[i]);
+                return 1;
+            }
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage();
+            return 0;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+
+    if (role.has_value()) {
+        if (inputs.size() != 2) {
+            print_usage();
+            return 1;
+        }
+        auto image = tools::decode_rgba(inputs[0]);
+        if (!image.has_value()) {
+            spdlog::error("Failed to decode image: {}", inputs[0].string());
+            return 1;
+        }
+        return encode_image(
+                 std::move(image.value()), role.value(), inputs[1], thread_count
+               )
+                 ? 0
+                 : 1;
+    }
+
+    if (inputs.empty()) {
+        print_usage();
+        return 1;
+    }
+    bool success = true;
+    for (const auto &input : inputs) {
+        success &= encode_gltf(input, thread_count);
+    }
+    return success ? 0 : 1;
+}